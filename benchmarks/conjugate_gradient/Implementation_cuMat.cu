@@ -4,10 +4,14 @@
 #include <cuMat/Core>
 #include <cuMat/Sparse>
 #include <cuMat/src/ConjugateGradient.h>
+#include <cuMat/src/PipelinedConjugateGradient.h>
+#include <cuMat/src/StencilOperators.h>
+#include <cuMat/src/PolynomialPreconditioners.h>
 #include <iostream>
 #include <cstdlib>
 
-void benchmark_cuMat(
+template<template<typename, typename> class Solver, template<typename> class Preconditioner = cuMat::DiagonalPreconditioner>
+void benchmark_cuMat_impl(
 	const std::vector<std::string>& parameterNames,
 	const Json::Array& parameters,
 	const std::vector<std::string>& returnNames,
@@ -77,7 +81,7 @@ void benchmark_cuMat(
 			cudaDeviceSynchronize();
 			//cudaEventRecord(start, cuMat::Context::current().stream());
 			auto start2 = std::chrono::steady_clock::now();
-			cuMat::ConjugateGradient<SMatrix> cg(mat);
+			Solver<SMatrix, Preconditioner<SMatrix>> cg(mat);
 			cg.setTolerance(1e-4);
 			r.inplace() = cg.solve(rhs);
 
@@ -106,4 +110,105 @@ void benchmark_cuMat(
 		returnValues.PushBack(resultJson);
 		std::cout << " -> " << finalTime << "ms" << " (iterations=" << iterations << ", error=" << error << ")" << std::endl;
 	}
-}
\ No newline at end of file
+}
+void benchmark_cuMat(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	benchmark_cuMat_impl<cuMat::ConjugateGradient>(parameterNames, parameters, returnNames, returnValues);
+}
+
+void benchmark_cuMat_Pipelined(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	benchmark_cuMat_impl<cuMat::PipelinedConjugateGradient>(parameterNames, parameters, returnNames, returnValues);
+}
+
+void benchmark_cuMat_Chebyshev(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	benchmark_cuMat_impl<cuMat::ConjugateGradient, cuMat::ChebyshevPreconditioner>(parameterNames, parameters, returnNames, returnValues);
+}
+
+void benchmark_cuMat_Neumann(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	benchmark_cuMat_impl<cuMat::ConjugateGradient, cuMat::NeumannPreconditioner>(parameterNames, parameters, returnNames, returnValues);
+}
+
+void benchmark_cuMat_Stencil(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	//number of runs for time measures
+	const int runs = 2;
+
+	int numConfigs = parameters.Size();
+	for (int config = 0; config < numConfigs; ++config)
+	{
+		//Input
+		int gridSize = parameters[config][0].AsInt32();
+		double totalTime = 0;
+		std::cout << "  Grid Size: " << gridSize << std::flush;
+		int matrixSize = gridSize * gridSize;
+
+		//Create vector, same as for the assembled matrix
+#define IDX(x, y) ((y) + (x)*gridSize)
+		Eigen::VectorXf erhs = Eigen::VectorXf::Zero(matrixSize);
+		std::srand(42);
+		for (int x = 0; x < gridSize; ++x) for (int y = 0; y < gridSize; ++y) {
+			if (x == 0 || y == 0 || x == gridSize - 1 || y == gridSize - 1)
+				erhs[IDX(x, y)] = std::rand() / float(RAND_MAX);
+		}
+#undef IDX
+
+		//The matrix is never assembled. The diagonal of the Poisson matrix is constant,
+		//hence the identity preconditioner performs the same iterations as the diagonal preconditioner.
+		typedef cuMat::Stencil5PointOperator<float> Stencil;
+		Stencil stencil(gridSize, gridSize);
+
+		cuMat::VectorXf rhs = cuMat::VectorXf::fromEigen(erhs);
+		cuMat::VectorXf r = cuMat::VectorXf::Zero(matrixSize);
+
+		//Run it multiple times
+		int iterations = 0; float error = 0;
+		for (int run = 0; run < runs; ++run)
+		{
+			//Main logic
+			cudaDeviceSynchronize();
+			auto start2 = std::chrono::steady_clock::now();
+			cuMat::ConjugateGradient<Stencil, cuMat::IdentityPreconditioner<Stencil>> cg(stencil);
+			cg.setTolerance(1e-4);
+			r.inplace() = cg.solve(rhs);
+
+			cudaDeviceSynchronize();
+			auto finish2 = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration_cast<
+				std::chrono::duration<double> >(finish2 - start2).count() * 1000;
+
+			iterations = cg.iterations();
+			error = cg.error();
+			totalTime += elapsed;
+		}
+
+		//Result
+		Json::Array resultJson;
+		double finalTime = totalTime / runs;
+		resultJson.PushBack(finalTime);
+		returnValues.PushBack(resultJson);
+		std::cout << " -> " << finalTime << "ms" << " (iterations=" << iterations << ", error=" << error << ")" << std::endl;
+	}
+}
@@ -25,6 +25,10 @@ yscale = 'log'
 
 # now create the plot
 plt.plot(xdata, [d[0] for d in results["CuMat"]], '-o', label='cuMat')
+plt.plot(xdata, [d[0] for d in results["CuMat-Pipelined"]], '-o', label='cuMat (pipelined)')
+plt.plot(xdata, [d[0] for d in results["CuMat-Chebyshev"]], '-o', label='cuMat (Chebyshev preconditioner)')
+plt.plot(xdata, [d[0] for d in results["CuMat-Neumann"]], '-o', label='cuMat (Neumann preconditioner)')
+plt.plot(xdata, [d[0] for d in results["CuMat-Stencil"]], '-o', label='cuMat (matrix-free stencil)')
 plt.plot(xdata, [d[0] for d in results["Eigen"]], '-o', label='Eigen')
 for i,j in zip([xdata[0], xdata[-1]],[results["CuMat"][0][0], results["CuMat"][-1][0]]):
     plt.annotate(str(j),xy=(i,j), xytext=(-10,-10), textcoords='offset points')
@@ -23,6 +23,42 @@ void benchmark_cuMat(
     const std::vector<std::string>& returnNames,
     Json::Array& returnValues);
     
+/**
+ * \brief Launches the pipelined conjugate gradient of cuMat.
+ */
+void benchmark_cuMat_Pipelined(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+/**
+ * \brief Launches the conjugate gradient of cuMat with the Chebyshev polynomial preconditioner.
+ */
+void benchmark_cuMat_Chebyshev(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+/**
+ * \brief Launches the conjugate gradient of cuMat with the truncated Neumann series preconditioner.
+ */
+void benchmark_cuMat_Neumann(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+/**
+ * \brief Launches the conjugate gradient of cuMat with the matrix-free 5-point stencil instead of the assembled CSR matrix.
+ */
+void benchmark_cuMat_Stencil(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
 void benchmark_cuBlas(
     const std::vector<std::string>& parameterNames,
     const Json::Array& parameters,
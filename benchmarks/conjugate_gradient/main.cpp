@@ -73,6 +73,24 @@ int main(int argc, char* argv[])
         Json::Array resultsCuMat;
         benchmark_cuMat(parameterNames, params, returnNames, resultsCuMat);
 
+        //cuMat, pipelined CG
+        std::cout << " Run CuMat (pipelined)" << std::endl;
+        Json::Array resultsCuMatPipelined;
+        benchmark_cuMat_Pipelined(parameterNames, params, returnNames, resultsCuMatPipelined);
+
+        //cuMat, polynomial preconditioners
+        std::cout << " Run CuMat (Chebyshev)" << std::endl;
+        Json::Array resultsCuMatChebyshev;
+        benchmark_cuMat_Chebyshev(parameterNames, params, returnNames, resultsCuMatChebyshev);
+        std::cout << " Run CuMat (Neumann)" << std::endl;
+        Json::Array resultsCuMatNeumann;
+        benchmark_cuMat_Neumann(parameterNames, params, returnNames, resultsCuMatNeumann);
+
+        //cuMat, matrix-free stencil
+        std::cout << " Run CuMat (stencil)" << std::endl;
+        Json::Array resultsCuMatStencil;
+        benchmark_cuMat_Stencil(parameterNames, params, returnNames, resultsCuMatStencil);
+
         //Eigen
         std::cout << " Run Eigen" << std::endl;
         Json::Array resultsEigen;
@@ -81,6 +99,10 @@ int main(int argc, char* argv[])
         //write results
         Json::Object resultAssembled;
         resultAssembled.Insert(std::make_pair("CuMat", resultsCuMat));
+        resultAssembled.Insert(std::make_pair("CuMat-Pipelined", resultsCuMatPipelined));
+        resultAssembled.Insert(std::make_pair("CuMat-Chebyshev", resultsCuMatChebyshev));
+        resultAssembled.Insert(std::make_pair("CuMat-Neumann", resultsCuMatNeumann));
+        resultAssembled.Insert(std::make_pair("CuMat-Stencil", resultsCuMatStencil));
         resultAssembled.Insert(std::make_pair("Eigen", resultsEigen));
         std::ofstream outStream(outputDir + setName + ".json");
         outStream << resultAssembled;
@@ -23,23 +23,12 @@ void benchmark_Eigen(
         //Input
         int gridSize = parameters[config][0].AsInt32();
         double totalTime = 0;
-        std::cout << "  Grid Size: " << gridSize << std::flush;
+        std::string matrixType = parameters[config][1].AsString();
+        std::cout << "  Grid Size: " << gridSize << ", " << matrixType << std::flush;
 		int matrixSize = gridSize * gridSize;
 
 		//Create matrix
-#define IDX(x, y) ((y) + (x)*gridSize)
-		Eigen::SparseMatrix<float, Eigen::RowMajor> matrix(matrixSize, matrixSize);
-		matrix.reserve(Eigen::VectorXi::Constant(matrixSize, 5));
-		for (int x=0; x<gridSize; ++x) for (int y=0; y<gridSize; ++y)
-		{
-			int row = IDX(x, y);
-			if (x > 0) matrix.insert(row, IDX(x - 1, y)) = -1;
-			if (y > 0) matrix.insert(row, IDX(x, y - 1)) = -1;
-			matrix.insert(row, row) = 4;
-			if (y < gridSize - 1) matrix.insert(row, IDX(x, y + 1)) = -1;
-			if (x < gridSize - 1) matrix.insert(row, IDX(x + 1, y)) = -1;
-		}
-		matrix.makeCompressed();
+		Eigen::SparseMatrix<float, Eigen::RowMajor, int> matrix = createBenchmarkMatrix(gridSize, matrixType);
 
 		//Create vector
 		Eigen::VectorXf x = Eigen::VectorXf::Random(matrixSize);
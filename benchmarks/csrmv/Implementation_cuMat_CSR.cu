@@ -10,7 +10,8 @@ void benchmark_cuMat_CSR(
     const std::vector<std::string>& parameterNames,
     const Json::Array& parameters,
     const std::vector<std::string>& returnNames,
-    Json::Array& returnValues)
+    Json::Array& returnValues,
+    int algorithm)
 {
     //number of runs for time measures
     const int runs = 10;
@@ -22,23 +23,12 @@ void benchmark_cuMat_CSR(
 		//Input
 		int gridSize = parameters[config][0].AsInt32();
 		double totalTime = 0;
-		std::cout << "  Grid Size: " << gridSize << std::flush;
+		std::string matrixType = parameters[config][1].AsString();
+		std::cout << "  Grid Size: " << gridSize << ", " << matrixType << std::flush;
 		int matrixSize = gridSize * gridSize;
 
 		//Create matrix
-#define IDX(x, y) ((y) + (x)*gridSize)
-		Eigen::SparseMatrix<float, Eigen::RowMajor, int> matrix(matrixSize, matrixSize);
-		matrix.reserve(Eigen::VectorXi::Constant(matrixSize, 5));
-		for (int x = 0; x<gridSize; ++x) for (int y = 0; y<gridSize; ++y)
-		{
-			int row = IDX(x, y);
-			if (x > 0) matrix.insert(row, IDX(x - 1, y)) = -1;
-			if (y > 0) matrix.insert(row, IDX(x, y - 1)) = -1;
-			matrix.insert(row, row) = 4;
-			if (y < gridSize - 1) matrix.insert(row, IDX(x, y + 1)) = -1;
-			if (x < gridSize - 1) matrix.insert(row, IDX(x + 1, y)) = -1;
-		}
-		matrix.makeCompressed();
+		Eigen::SparseMatrix<float, Eigen::RowMajor, int> matrix = createBenchmarkMatrix(gridSize, matrixType);
 
 		//Create vector
 		Eigen::VectorXf ex = Eigen::VectorXf::Random(matrixSize);
@@ -55,6 +45,8 @@ void benchmark_cuMat_CSR(
         pattern.assertValid();
 		SMatrix mat(pattern);
 		mat.getData().copyFromHost(matrix.valuePtr());
+		mat.getSparsityPattern().setSpMVAlgorithm(static_cast<cuMat::CsrSpMVAlgorithm>(algorithm));
+		std::cout << " (kernel " << static_cast<int>(mat.getSparsityPattern().rowAnalysis().algorithm) << ")" << std::flush;
 
 		cuMat::VectorXf x = cuMat::VectorXf::fromEigen(ex);
 		cuMat::VectorXf r(matrixSize);
@@ -0,0 +1,194 @@
+#include "benchmark.h"
+
+#include <Eigen/Sparse>
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <iostream>
+#include <cstdlib>
+#include <cusparse_v2.h>
+
+namespace {
+
+typedef cuMat::SparseMatrix<float, 1, cuMat::CSR> SMatrix;
+typedef cuMat::SparsityPattern<cuMat::CSR> SPattern;
+
+static void cusparseSafeCall(cusparseStatus_t status, const char *file, const int line)
+{
+    if (CUSPARSE_STATUS_SUCCESS != status) {
+        std::string msg = cuMat::internal::ErrorHelpers::format("cusparseSafeCall() failed at %s:%i : error %d\n",
+            file, line, int(status));
+        std::cerr << msg << std::endl;
+        throw cuMat::cuda_error(msg);
+    }
+}
+#define CUSPARSE_SAFE_CALL( err ) cusparseSafeCall( err, __FILE__, __LINE__ )
+
+//The matrix of the benchmark set. The 2D Poisson matrix gets an upwind convection term in x-direction, hence A != A^T
+static SMatrix createMatrix(int gridSize, const std::string& type)
+{
+    int matrixSize = gridSize * gridSize;
+    Eigen::SparseMatrix<float, Eigen::RowMajor, int> matrix(matrixSize, matrixSize);
+    if (type == "poisson")
+    {
+#define IDX(x, y) ((y) + (x)*gridSize)
+        matrix.reserve(Eigen::VectorXi::Constant(matrixSize, 5));
+        for (int x = 0; x<gridSize; ++x) for (int y = 0; y<gridSize; ++y)
+        {
+            int row = IDX(x, y);
+            if (x > 0) matrix.insert(row, IDX(x - 1, y)) = -1.5f;
+            if (y > 0) matrix.insert(row, IDX(x, y - 1)) = -1;
+            matrix.insert(row, row) = 4.5f;
+            if (y < gridSize - 1) matrix.insert(row, IDX(x, y + 1)) = -1;
+            if (x < gridSize - 1) matrix.insert(row, IDX(x + 1, y)) = -0.5f;
+        }
+        matrix.makeCompressed();
+#undef IDX
+    }
+    else
+        matrix = createBenchmarkMatrix(gridSize, type);
+
+    SPattern pattern;
+    pattern.rows = matrixSize;
+    pattern.cols = matrixSize;
+    pattern.nnz = matrix.nonZeros();
+    pattern.JA = SPattern::IndexVector(matrixSize + 1); pattern.JA.copyFromHost(matrix.outerIndexPtr());
+    pattern.IA = SPattern::IndexVector(pattern.nnz); pattern.IA.copyFromHost(matrix.innerIndexPtr());
+    pattern.assertValid();
+    SMatrix mat(pattern);
+    mat.getData().copyFromHost(matrix.valuePtr());
+    return mat;
+}
+
+}
+
+//r = A^T * x, evaluated directly on the CSR storage of A (scatter with atomics)
+void benchmark_cuMat_CSR_Transposed(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues)
+{
+    //number of runs for time measures
+    const int runs = 10;
+    const int subruns = 10;
+
+    int numConfigs = parameters.Size();
+    for (int config = 0; config < numConfigs; ++config)
+    {
+        //Input
+        int gridSize = parameters[config][0].AsInt32();
+        double totalTime = 0;
+        std::string matrixType = parameters[config][1].AsString();
+        std::cout << "  Grid Size: " << gridSize << ", " << matrixType << std::flush;
+        int matrixSize = gridSize * gridSize;
+
+        SMatrix mat = createMatrix(gridSize, matrixType);
+        cuMat::VectorXf x = cuMat::VectorXf::fromEigen(Eigen::VectorXf::Random(matrixSize));
+        cuMat::VectorXf r(matrixSize);
+
+        //Run it multiple times
+        for (int run = 0; run < runs; ++run)
+        {
+            //Main logic
+            cudaDeviceSynchronize();
+            auto start = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < subruns; ++i) {
+                r.inplace() = mat.transpose() * x;
+            }
+
+            cudaDeviceSynchronize();
+            auto finish = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration_cast<
+                std::chrono::duration<double>>(finish - start).count() * 1000 / subruns;
+
+            totalTime += elapsed;
+        }
+
+        //Result
+        Json::Array result;
+        double finalTime = totalTime / runs;
+        result.PushBack(finalTime);
+        returnValues.PushBack(result);
+        std::cout << " -> " << finalTime << "ms" << std::endl;
+    }
+}
+
+//r = A^T * x, by first transposing A explicitly (cuSPARSE csr2csc) and then using the CSR matrix-vector product.
+//This is the cost of a single transposed product if no transposed copy is kept.
+void benchmark_cuMat_CSR_ExplicitTranspose(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues)
+{
+    //number of runs for time measures
+    const int runs = 10;
+    const int subruns = 10;
+
+    cusparseHandle_t handle = nullptr;
+    CUSPARSE_SAFE_CALL(cusparseCreate(&handle));
+
+    int numConfigs = parameters.Size();
+    for (int config = 0; config < numConfigs; ++config)
+    {
+        //Input
+        int gridSize = parameters[config][0].AsInt32();
+        double totalTime = 0;
+        std::string matrixType = parameters[config][1].AsString();
+        std::cout << "  Grid Size: " << gridSize << ", " << matrixType << std::flush;
+        int matrixSize = gridSize * gridSize;
+
+        SMatrix mat = createMatrix(gridSize, matrixType);
+        cuMat::VectorXf x = cuMat::VectorXf::fromEigen(Eigen::VectorXf::Random(matrixSize));
+        cuMat::VectorXf r(matrixSize);
+
+        //storage of the transposed matrix, the CSC arrays of A are the CSR arrays of A^T
+        const int nnz = static_cast<int>(mat.nnz());
+        SPattern patternT;
+        patternT.rows = matrixSize;
+        patternT.cols = matrixSize;
+        patternT.nnz = nnz;
+        patternT.JA = SPattern::IndexVector(matrixSize + 1);
+        patternT.IA = SPattern::IndexVector(nnz);
+        SMatrix matT(patternT);
+        size_t bufferSize = 0;
+        CUSPARSE_SAFE_CALL(cusparseCsr2cscEx2_bufferSize(handle, matrixSize, matrixSize, nnz,
+            mat.getData().data(), mat.getSparsityPattern().JA.data(), mat.getSparsityPattern().IA.data(),
+            matT.getData().data(), patternT.JA.data(), patternT.IA.data(),
+            CUDA_R_32F, CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO, CUSPARSE_CSR2CSC_ALG1, &bufferSize));
+        cuMat::Matrix<char, cuMat::Dynamic, 1, 1, cuMat::ColumnMajor> buffer(static_cast<cuMat::Index>(bufferSize) + 1);
+
+        //Run it multiple times
+        for (int run = 0; run < runs; ++run)
+        {
+            //Main logic
+            cudaDeviceSynchronize();
+            auto start = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < subruns; ++i) {
+                CUSPARSE_SAFE_CALL(cusparseCsr2cscEx2(handle, matrixSize, matrixSize, nnz,
+                    mat.getData().data(), mat.getSparsityPattern().JA.data(), mat.getSparsityPattern().IA.data(),
+                    matT.getData().data(), patternT.JA.data(), patternT.IA.data(),
+                    CUDA_R_32F, CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO, CUSPARSE_CSR2CSC_ALG1, buffer.data()));
+                r.inplace() = matT * x;
+            }
+
+            cudaDeviceSynchronize();
+            auto finish = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration_cast<
+                std::chrono::duration<double>>(finish - start).count() * 1000 / subruns;
+
+            totalTime += elapsed;
+        }
+
+        //Result
+        Json::Array result;
+        double finalTime = totalTime / runs;
+        result.PushBack(finalTime);
+        returnValues.PushBack(result);
+        std::cout << " -> " << finalTime << "ms" << std::endl;
+    }
+
+    CUSPARSE_SAFE_CALL(cusparseDestroy(handle));
+}
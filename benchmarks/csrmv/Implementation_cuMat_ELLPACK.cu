@@ -22,42 +22,33 @@ void benchmark_cuMat_ELLPACK(
 		//Input
 		int gridSize = parameters[config][0].AsInt32();
 		double totalTime = 0;
-		std::cout << "  Grid Size: " << gridSize << std::flush;
+		std::string matrixType = parameters[config][1].AsString();
+		std::cout << "  Grid Size: " << gridSize << ", " << matrixType << std::flush;
 		int matrixSize = gridSize * gridSize;
 
-		//Create matrix
-#define IDX(x, y) ((y) + (x)*gridSize)
-		int nnzPerRow = 5;
-		Eigen::Matrix<int, Eigen::Dynamic, 5, Eigen::ColMajor> indices(matrixSize, 5); indices.fill(-1);
-		Eigen::Matrix<float, Eigen::Dynamic, 5, Eigen::ColMajor> values(matrixSize, 5);
-		for (int x = 0; x<gridSize; ++x) for (int y = 0; y<gridSize; ++y)
+		//Create matrix, converted from CSR
+		Eigen::SparseMatrix<float, Eigen::RowMajor, int> csr = createBenchmarkMatrix(gridSize, matrixType);
+		int nnzPerRow = 0;
+		for (int row = 0; row < matrixSize; ++row)
+			nnzPerRow = std::max(nnzPerRow, csr.outerIndexPtr()[row + 1] - csr.outerIndexPtr()[row]);
+		if (static_cast<double>(nnzPerRow) * matrixSize > 4.0 * csr.nonZeros())
+		{
+			//too much padding (e.g. power-law row lengths), ELLPACK is not an option
+			std::cout << " -> skipped, " << nnzPerRow << " entries per row" << std::endl;
+			Json::Array result;
+			result.PushBack(0.0);
+			returnValues.PushBack(result);
+			continue;
+		}
+		Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> indices(matrixSize, nnzPerRow); indices.fill(-1);
+		Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> values(matrixSize, nnzPerRow); values.fill(0);
+		for (int row = 0; row < matrixSize; ++row)
 		{
-			int row = IDX(x, y);
 			int ci = 0;
-			if (x > 0) {
-				indices(row, ci) = IDX(x - 1, y);
-				values(row, ci) = -1;
-				ci++;
-			}
-			if (y > 0) {
-				indices(row, ci) = IDX(x, y - 1);
-				values(row, ci) = -1;
-				ci++;
-			}
+			for (Eigen::SparseMatrix<float, Eigen::RowMajor, int>::InnerIterator it(csr, row); it; ++it, ++ci)
 			{
-				indices(row, ci) = row;
-				values(row, ci) = 4;
-				ci++;
-			}
-			if (y < gridSize - 1) {
-				indices(row, ci) = IDX(x, y + 1);
-				values(row, ci) = -1;
-				ci++;
-			}
-			if (x < gridSize - 1) {
-				indices(row, ci) = IDX(x + 1, y);
-				values(row, ci) = -1;
-				ci++;
+				indices(row, ci) = it.col();
+				values(row, ci) = it.value();
 			}
 		}
 
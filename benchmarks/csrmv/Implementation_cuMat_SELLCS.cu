@@ -0,0 +1,70 @@
+#include "benchmark.h"
+
+#include <Eigen/Sparse>
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <iostream>
+#include <cstdlib>
+
+void benchmark_cuMat_SELLCS(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues)
+{
+    //number of runs for time measures
+    const int runs = 10;
+	const int subruns = 10;
+
+    int numConfigs = parameters.Size();
+    for (int config = 0; config < numConfigs; ++config)
+    {
+		//Input
+		int gridSize = parameters[config][0].AsInt32();
+		double totalTime = 0;
+		std::string matrixType = parameters[config][1].AsString();
+		std::cout << "  Grid Size: " << gridSize << ", " << matrixType << std::flush;
+		int matrixSize = gridSize * gridSize;
+
+		//Create matrix, converted from CSR with the default slice height and sorting window
+		Eigen::SparseMatrix<float, Eigen::RowMajor, int> csr = createBenchmarkMatrix(gridSize, matrixType);
+		const cuMat::internal::SellCSigmaLayout layout = cuMat::internal::SellCSigmaLayout::build(
+			csr.outerIndexPtr(), csr.innerIndexPtr(), matrixSize, matrixSize);
+		std::cout << " (padding ratio " << layout.paddingRatio() << ")" << std::flush;
+
+		//Create vector
+		Eigen::VectorXf ex = Eigen::VectorXf::Random(matrixSize);
+
+		//Send to cuMat
+		typedef cuMat::SparseMatrix<float, 1, cuMat::SELLCS> SMatrix;
+		SMatrix mat = layout.toSparseMatrix(csr.valuePtr());
+		cuMat::VectorXf x = cuMat::VectorXf::fromEigen(ex);
+		cuMat::VectorXf r(matrixSize);
+
+        //Run it multiple times
+        for (int run = 0; run < runs; ++run)
+        {
+            //Main logic
+			cudaDeviceSynchronize();
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < subruns; ++i) {
+				r.inplace() = mat * x;
+			}
+
+			cudaDeviceSynchronize();
+			auto finish = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration_cast<
+				std::chrono::duration<double>>(finish - start).count() * 1000 / subruns;
+
+            totalTime += elapsed;
+        }
+
+        //Result
+        Json::Array result;
+        double finalTime = totalTime / runs;
+        result.PushBack(finalTime);
+        returnValues.PushBack(result);
+        std::cout << " -> " << finalTime << "ms" << std::endl;
+    }
+}
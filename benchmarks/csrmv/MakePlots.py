@@ -16,7 +16,7 @@ with open(sys.argv[2], 'r') as f:
     config = json.load(f)
 params = config['Sets'][setName]
 
-title = "CSRMV: Sparse Matrix - Dense Vector multiplication, 2D Poisson matrix"
+title = "CSRMV: Sparse Matrix - Dense Vector multiplication, " + setName[setName.find('-')+1:].strip()
 xlabel = "Matrix size (square)"
 ylabel = "Time (ms)"
 xdata = [vx[0] for vx in params]
@@ -24,10 +24,24 @@ xscale = 'log'
 yscale = 'log'
 
 # now create the plot
-plt.plot(xdata, [d[0] for d in results["CuMat_CSR"]], '-o', label='cuMat - CSR')
-plt.plot(xdata, [d[0] for d in results["CuMat_ELLPACK"]], '-o', label='cuMat - ELLPACK')
-plt.plot(xdata, [d[0] for d in results["CuBlas"]], '-o', label='cuSPARSE')
-plt.plot(xdata, [d[0] for d in results["Eigen"]], '-o', label='Eigen')
+# skipped configurations have a time of zero
+def plot(key, style, label):
+    if key not in results:
+        return
+    points = [(x, d[0]) for x, d in zip(xdata, results[key]) if d[0] > 0]
+    if len(points) > 0:
+        plt.plot([p[0] for p in points], [p[1] for p in points], style, label=label)
+plot("CuMat_CSR", '-o', 'cuMat - CSR')
+plot("CuMat_CSR_Scalar", '--.', 'cuMat - CSR, scalar kernel')
+plot("CuMat_CSR_Vector", '--.', 'cuMat - CSR, vector kernel')
+plot("CuMat_CSR_Stream", '--.', 'cuMat - CSR, stream kernel')
+plot("CuMat_CSR_MergePath", '--.', 'cuMat - CSR, merge-path kernel')
+plot("CuMat_CSR_Transposed", '-o', 'cuMat - CSR, A^T*x')
+plot("CuMat_CSR_ExplicitTranspose", '-o', 'cuMat - CSR, transpose(A)*x')
+plot("CuMat_ELLPACK", '-o', 'cuMat - ELLPACK')
+plot("CuMat_SELLCS", '-o', 'cuMat - SELL-C-sigma')
+plot("CuBlas", '-o', 'cuSPARSE')
+plot("Eigen", '-o', 'Eigen')
 for i,j in zip([xdata[0], xdata[-1]],[results["CuMat_CSR"][0][0], results["CuMat_CSR"][-1][0]]):
     plt.annotate(str(j),xy=(i,j), xytext=(-10,-10), textcoords='offset points')
 for i,j in zip([xdata[0], xdata[-1]],[results["CuBlas"][0][0], results["CuBlas"][-1][0]]):
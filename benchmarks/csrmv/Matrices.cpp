@@ -0,0 +1,70 @@
+#include "benchmark.h"
+
+#include <random>
+#include <cmath>
+#include <stdexcept>
+
+//2D Poisson matrix (5-point stencil) on a gridSize x gridSize grid
+static void createPoisson(int gridSize, std::vector<Eigen::Triplet<float>>& entries)
+{
+#define IDX(x, y) ((y) + (x)*gridSize)
+	for (int x = 0; x<gridSize; ++x) for (int y = 0; y<gridSize; ++y)
+	{
+		int row = IDX(x, y);
+		if (x > 0) entries.emplace_back(row, IDX(x - 1, y), -1.0f);
+		if (y > 0) entries.emplace_back(row, IDX(x, y - 1), -1.0f);
+		entries.emplace_back(row, row, 4.0f);
+		if (y < gridSize - 1) entries.emplace_back(row, IDX(x, y + 1), -1.0f);
+		if (x < gridSize - 1) entries.emplace_back(row, IDX(x + 1, y), -1.0f);
+	}
+#undef IDX
+}
+
+//Row lengths from a Pareto distribution (alpha=2.2, at least 2 entries) at random columns, plus the diagonal.
+//A few rows are very long, most rows are short: the worst case for one thread per row.
+static void createPowerLaw(int matrixSize, std::vector<Eigen::Triplet<float>>& entries)
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> u(0, 1);
+	std::uniform_int_distribution<int> column(0, matrixSize - 1);
+	const double alpha = 2.2;
+	const double minLength = 2;
+	for (int row = 0; row < matrixSize; ++row)
+	{
+		const double length = minLength * std::pow(1 - u(rng), -1.0 / alpha);
+		const int count = static_cast<int>(std::min(length, double(matrixSize)));
+		entries.emplace_back(row, row, 4.0f);
+		for (int i = 0; i < count; ++i)
+			entries.emplace_back(row, column(rng), float(-u(rng)));
+	}
+}
+
+//Band matrix with 8 off-diagonals on each side
+static void createBanded(int matrixSize, std::vector<Eigen::Triplet<float>>& entries)
+{
+	const int bandwidth = 8;
+	for (int row = 0; row < matrixSize; ++row)
+	{
+		for (int col = std::max(0, row - bandwidth); col <= std::min(matrixSize - 1, row + bandwidth); ++col)
+			entries.emplace_back(row, col, row == col ? 2.0f * bandwidth : -1.0f);
+	}
+}
+
+Eigen::SparseMatrix<float, Eigen::RowMajor, int> createBenchmarkMatrix(int gridSize, const std::string& type)
+{
+	const int matrixSize = gridSize * gridSize;
+	std::vector<Eigen::Triplet<float>> entries;
+	if (type == "poisson")
+		createPoisson(gridSize, entries);
+	else if (type == "powerlaw")
+		createPowerLaw(matrixSize, entries);
+	else if (type == "banded")
+		createBanded(matrixSize, entries);
+	else
+		throw std::invalid_argument("unknown matrix type " + type);
+	//duplicated random columns are summed up
+	Eigen::SparseMatrix<float, Eigen::RowMajor, int> matrix(matrixSize, matrixSize);
+	matrix.setFromTriplets(entries.begin(), entries.end());
+	matrix.makeCompressed();
+	return matrix;
+}
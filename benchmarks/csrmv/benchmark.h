@@ -7,8 +7,17 @@
 
 #include <vector>
 #include <string>
+#include <Eigen/Sparse>
 #include "../json_st.h"
 
+/**
+ * \brief Creates the sparse matrix of the benchmark.
+ * \param gridSize the grid size, the matrix has gridSize^2 rows and columns
+ * \param type the matrix type: "poisson" (2D Poisson matrix), "powerlaw" (power-law distributed row lengths)
+ *  or "banded" (17 entries per row)
+ */
+Eigen::SparseMatrix<float, Eigen::RowMajor, int> createBenchmarkMatrix(int gridSize, const std::string& type);
+
 /**
  * \brief Launches the implementations of cuMat.
  * Implemented per benchmark
@@ -16,8 +25,28 @@
  * \param parameters the parameter values
  * \param returnNames 
  * \param returnValues 
+ * \param algorithm the kernel of the product as integer value of cuMat::CsrSpMVAlgorithm, 0=Automatic
  */
 void benchmark_cuMat_CSR(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues,
+    int algorithm = 0);
+
+/**
+ * \brief Transposed product A^T*x with a CSR matrix, evaluated directly on the storage of A
+ */
+void benchmark_cuMat_CSR_Transposed(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+/**
+ * \brief Transposed product A^T*x with a CSR matrix, by transposing A explicitly first
+ */
+void benchmark_cuMat_CSR_ExplicitTranspose(
     const std::vector<std::string>& parameterNames,
     const Json::Array& parameters,
     const std::vector<std::string>& returnNames,
@@ -28,6 +57,15 @@ void benchmark_cuMat_ELLPACK(
 	const Json::Array& parameters,
 	const std::vector<std::string>& returnNames,
 	Json::Array& returnValues);
+
+/**
+ * \brief Sliced ELLPACK with sorting window (SELL-C-sigma), converted from CSR
+ */
+void benchmark_cuMat_SELLCS(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues);
     
 void benchmark_cuBlas(
     const std::vector<std::string>& parameterNames,
@@ -76,12 +76,40 @@ int main(int argc, char* argv[])
         benchmark_cuMat_CSR(parameterNames, params, returnNames, resultsCuMatCSR);
 		resultAssembled.Insert(std::make_pair("CuMat_CSR", resultsCuMatCSR));
 
+		//cuMat - CSR with a forced kernel, see cuMat::CsrSpMVAlgorithm
+		const std::vector<std::pair<int, std::string>> algorithms = {
+			{1, "Scalar"}, {2, "Vector"}, {3, "Stream"}, {4, "MergePath"} };
+		for (const auto& algorithm : algorithms)
+		{
+			std::cout << " Run CuMat - CSR, " << algorithm.second << " kernel" << std::endl;
+			Json::Array resultsCuMatCSRAlgorithm;
+			benchmark_cuMat_CSR(parameterNames, params, returnNames, resultsCuMatCSRAlgorithm, algorithm.first);
+			resultAssembled.Insert(std::make_pair("CuMat_CSR_" + algorithm.second, resultsCuMatCSRAlgorithm));
+		}
+
+		//cuMat - transposed CSR
+		std::cout << " Run CuMat - CSR, transposed" << std::endl;
+		Json::Array resultsCuMatCSRTransposed;
+		benchmark_cuMat_CSR_Transposed(parameterNames, params, returnNames, resultsCuMatCSRTransposed);
+		resultAssembled.Insert(std::make_pair("CuMat_CSR_Transposed", resultsCuMatCSRTransposed));
+
+		std::cout << " Run CuMat - CSR, explicit transposition" << std::endl;
+		Json::Array resultsCuMatCSRExplicitTranspose;
+		benchmark_cuMat_CSR_ExplicitTranspose(parameterNames, params, returnNames, resultsCuMatCSRExplicitTranspose);
+		resultAssembled.Insert(std::make_pair("CuMat_CSR_ExplicitTranspose", resultsCuMatCSRExplicitTranspose));
+
 		//cuMat - ELLPACK
 		std::cout << " Run CuMat - ELLPACK" << std::endl;
 		Json::Array resultsCuMatELLPACK;
 		benchmark_cuMat_ELLPACK(parameterNames, params, returnNames, resultsCuMatELLPACK);
 		resultAssembled.Insert(std::make_pair("CuMat_ELLPACK", resultsCuMatELLPACK));
 
+		//cuMat - SELL-C-sigma
+		std::cout << " Run CuMat - SELL-C-sigma" << std::endl;
+		Json::Array resultsCuMatSELLCS;
+		benchmark_cuMat_SELLCS(parameterNames, params, returnNames, resultsCuMatSELLCS);
+		resultAssembled.Insert(std::make_pair("CuMat_SELLCS", resultsCuMatSELLCS));
+
         //cuBlas
         std::cout << " Run cuBLAS" << std::endl;
         Json::Array resultsCuBlas;
@@ -0,0 +1,98 @@
+#include "benchmark.h"
+
+#include <cuMat/Core>
+#include <iostream>
+#include <cstdlib>
+#include <random>
+
+std::vector<int> createHistogramInput(int entries, int bins)
+{
+	std::default_random_engine rnd(42);
+	std::uniform_real_distribution<double> distr(0, 1);
+	std::vector<int> values(entries);
+	for (int i = 0; i < entries; ++i)
+	{
+		//skewed towards the low bins, ~1% of the values are out of range
+		const double u = distr(rnd);
+		values[i] = static_cast<int>(bins * 1.01 * u * u * u * u);
+	}
+	return values;
+}
+
+namespace
+{
+	//the hand-written version, as previously used in the Buddhabrot demos
+	__global__ void GlobalAtomicsKernel(dim3 virtual_size, const int* values, int* counts, int bins)
+	{
+		CUMAT_KERNEL_1D_LOOP(i, virtual_size)
+			const int v = values[i];
+			if (v >= 0 && v < bins)
+				atomicAdd(counts + v, 1);
+		CUMAT_KERNEL_1D_LOOP_END
+	}
+}
+
+void benchmark_GlobalAtomics(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	//number of runs for time measures
+	const int runs = 10;
+	const int subruns = 10;
+
+	//test if the config is valid
+	assert(parameterNames.size() == 2);
+	assert(parameterNames[0] == "Entries");
+	assert(parameterNames[1] == "Bins");
+	assert(returnNames.size() == 1);
+	assert(returnNames[0] == "Time");
+
+	int numConfigs = parameters.Size();
+	for (int config = 0; config < numConfigs; ++config)
+	{
+		//Input
+		int entries = parameters[config][0].AsInt32();
+		int bins = parameters[config][1].AsInt32();
+		double totalTime = 0;
+		std::cout << "  Entries: " << entries << ", Bins: " << bins << std::flush;
+
+		//Create data
+		std::vector<int> values = createHistogramInput(entries, bins);
+		cuMat::VectorXi v(entries); v.copyFromHost(values.data());
+		cuMat::VectorXi counts(bins);
+
+		//Run it multiple times
+		for (int run = 0; run < runs; ++run)
+		{
+			//Main logic
+			cudaDeviceSynchronize();
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < subruns; ++i)
+			{
+				counts.setZero();
+				cuMat::Context& ctx = cuMat::Context::current();
+				cuMat::KernelLaunchConfig cfg = ctx.createLaunchConfig1D(entries, GlobalAtomicsKernel);
+				GlobalAtomicsKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+					(cfg.virtual_size, v.data(), counts.data(), bins);
+				CUMAT_CHECK_ERROR();
+			}
+
+			cudaDeviceSynchronize();
+			auto finish = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration_cast<
+				std::chrono::duration<double>>(finish - start).count() * 1000 / subruns;
+
+			totalTime += elapsed;
+		}
+
+		//Result
+		Json::Array result;
+		double finalTime = totalTime / runs;
+		result.PushBack(finalTime);
+		returnValues.PushBack(result);
+		std::cout << " -> " << finalTime << "ms" << std::endl;
+	}
+}
@@ -0,0 +1,93 @@
+#include "benchmark.h"
+
+#include <cuMat/Core>
+#include <iostream>
+#include <cstdlib>
+
+template<typename _Algorithm>
+void benchmark_cuMat(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	//number of runs for time measures
+	const int runs = 10;
+	const int subruns = 10;
+
+	//test if the config is valid
+	assert(parameterNames.size() == 2);
+	assert(parameterNames[0] == "Entries");
+	assert(parameterNames[1] == "Bins");
+	assert(returnNames.size() == 1);
+	assert(returnNames[0] == "Time");
+
+	int numConfigs = parameters.Size();
+	for (int config = 0; config < numConfigs; ++config)
+	{
+		//Input
+		int entries = parameters[config][0].AsInt32();
+		int bins = parameters[config][1].AsInt32();
+		double totalTime = 0;
+		std::cout << "  Entries: " << entries << ", Bins: " << bins << std::flush;
+
+		//Create data
+		std::vector<int> values = createHistogramInput(entries, bins);
+		cuMat::VectorXi v(entries); v.copyFromHost(values.data());
+		cuMat::VectorXi counts(bins);
+
+		//Run it multiple times
+		for (int run = 0; run < runs; ++run)
+		{
+			//Main logic
+			cudaDeviceSynchronize();
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < subruns; ++i)
+			{
+				counts = cuMat::bincount<_Algorithm>(v, bins);
+			}
+
+			cudaDeviceSynchronize();
+			auto finish = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration_cast<
+				std::chrono::duration<double>>(finish - start).count() * 1000 / subruns;
+
+			totalTime += elapsed;
+		}
+
+		//Result
+		Json::Array result;
+		double finalTime = totalTime / runs;
+		result.PushBack(finalTime);
+		returnValues.PushBack(result);
+		std::cout << " -> " << finalTime << "ms" << std::endl;
+	}
+}
+
+void benchmark_cuMat_Global(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	benchmark_cuMat<cuMat::HistogramAlg::Global>(parameterNames, parameters, returnNames, returnValues);
+}
+
+void benchmark_cuMat_Shared(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	benchmark_cuMat<cuMat::HistogramAlg::Shared>(parameterNames, parameters, returnNames, returnValues);
+}
+
+void benchmark_cuMat_Auto(
+	const std::vector<std::string>& parameterNames,
+	const Json::Array& parameters,
+	const std::vector<std::string>& returnNames,
+	Json::Array& returnValues)
+{
+	benchmark_cuMat<cuMat::HistogramAlg::Auto>(parameterNames, parameters, returnNames, returnValues);
+}
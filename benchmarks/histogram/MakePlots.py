@@ -0,0 +1,44 @@
+import sys
+import os
+import json
+import matplotlib.pyplot as plt
+
+setPath = sys.argv[1]
+setName = setPath[setPath.rfind('/')+1:]
+
+resultFile = setPath + ".json"
+with open(resultFile, 'r') as f:
+    results = json.load(f)
+
+config = None
+with open(sys.argv[2], 'r') as f:
+    config = json.load(f)
+params = config['Sets'][setName]
+
+# The part that has to be adopted for every test set
+title = "Histogram / bincount, %d bins"%params[0][1]
+xlabel = "Number of entries"
+ylabel = "Time (ms)"
+xdata = [vx[0] for vx in params]
+xscale = 'log'
+yscale = 'log'
+
+# now create the plot
+plt.plot(xdata, [d[0] for d in results["GlobalAtomics"]], '-o', label='hand-written global atomics')
+plt.plot(xdata, [d[0] for d in results["CuMat_Global"]], '-o', label='cuMat - Global')
+plt.plot(xdata, [d[0] for d in results["CuMat_Shared"]], '-o', label='cuMat - Shared')
+plt.plot(xdata, [d[0] for d in results["CuMat_Auto"]], '-o', label='cuMat - Auto')
+for i,j in zip([xdata[0], xdata[-1]],[results["GlobalAtomics"][0][0], results["GlobalAtomics"][-1][0]]):
+    plt.annotate(str(j),xy=(i,j), xytext=(-10,5), textcoords='offset points')
+for i,j in zip([xdata[0], xdata[-1]],[results["CuMat_Shared"][0][0], results["CuMat_Shared"][-1][0]]):
+    plt.annotate(str(j),xy=(i,j), xytext=(-10,-5), textcoords='offset points')
+plt.xscale(xscale)
+plt.yscale(yscale)
+plt.xlabel(xlabel)
+plt.ylabel(ylabel)
+plt.title(title)
+plt.legend()
+plt.xticks(xdata)
+
+#plt.show()
+plt.savefig(setPath+'.png', bbox_inches='tight', dpi=300)
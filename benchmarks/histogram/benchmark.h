@@ -0,0 +1,51 @@
+/*
+ * General entry points to benchmarks
+ */
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <vector>
+#include <string>
+#include "../json_st.h"
+
+/**
+ * \brief Launches the implementations of cuMat.
+ * Implemented per benchmark
+ * \param parameterNames the parameter names
+ * \param parameters the parameter values
+ * \param returnNames 
+ * \param returnValues 
+ */
+void benchmark_cuMat_Global(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+void benchmark_cuMat_Shared(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+void benchmark_cuMat_Auto(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+void benchmark_GlobalAtomics(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues);
+
+/**
+ * \brief Creates the input values for the histogram.
+ * The values are skewed towards the first bins (like the hot spots in the Buddhabrot)
+ * and a few values lie outside of [0, bins).
+ */
+std::vector<int> createHistogramInput(int entries, int bins);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Launches the benchmarks.
+ * The path to the config file is defined in the macro CONFIG_FILE
+ */
+
+#ifdef _MSC_VER
+#include <stdio.h>
+#endif
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <array>
+#include <fstream>
+
+#include "../json_st.h"
+#include "../Json.h"
+#include "benchmark.h"
+#include <cuMat/src/Macros.h>
+
+//https://stackoverflow.com/a/478960/4053176
+std::string exec(const char* cmd) {
+    std::array<char, 128> buffer;
+    std::string result;
+#ifdef _MSC_VER
+    std::shared_ptr<FILE> pipe(_popen(cmd, "rt"), _pclose);
+#else
+    std::shared_ptr<FILE> pipe(popen(cmd, "r"), pclose);
+#endif
+    if (!pipe) throw std::runtime_error("popen() failed!");
+    while (!feof(pipe.get())) {
+        if (fgets(buffer.data(), 128, pipe.get()) != nullptr)
+            result += buffer.data();
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string pythonPath = "\"C:/Program Files (x86)/Microsoft Visual Studio/Shared/Python36_64/python.exe\"";
+    std::string outputDir = CUMAT_STR(OUTPUT_DIR);
+
+    //load json
+    Json::Object config = Json::ParseFile(std::string(CUMAT_STR(CONFIG_FILE)));
+    std::cout << "Start Benchmark '" << config["Title"].AsString() << "'" << std::endl;
+
+    //parse parameter + return names
+    std::vector<std::string> parameterNames;
+    auto parameterArray = config["Parameters"].AsArray();
+    for (auto it = parameterArray.Begin(); it != parameterArray.End(); ++it)
+    {
+        parameterNames.push_back(it->AsString());
+    }
+    std::vector<std::string> returnNames;
+    auto returnArray = config["Returns"].AsArray();
+    for (auto it = returnArray.Begin(); it != returnArray.End(); ++it)
+    {
+        returnNames.push_back(it->AsString());
+    }
+
+    //start test sets
+    const Json::Object& sets = config["Sets"].AsObject();
+    for (auto it = sets.Begin(); it != sets.End(); ++it)
+    {
+        std::string setName = it->first;
+        const Json::Array& params = it->second.AsArray();
+        std::cout << std::endl << "Test Set '" << setName << "'" << std::endl;
+		Json::Object resultAssembled;
+
+        //hand-written global atomics, as in the Buddhabrot demos
+        std::cout << " Run Global Atomics" << std::endl;
+        Json::Array resultsAtomics;
+        benchmark_GlobalAtomics(parameterNames, params, returnNames, resultsAtomics);
+		resultAssembled.Insert(std::make_pair("GlobalAtomics", resultsAtomics));
+
+        //cuMat - global atomics
+        std::cout << " Run CuMat - Global" << std::endl;
+        Json::Array resultsCuMatGlobal;
+        benchmark_cuMat_Global(parameterNames, params, returnNames, resultsCuMatGlobal);
+		resultAssembled.Insert(std::make_pair("CuMat_Global", resultsCuMatGlobal));
+
+        //cuMat - privatized bins
+        std::cout << " Run CuMat - Shared" << std::endl;
+        Json::Array resultsCuMatShared;
+        benchmark_cuMat_Shared(parameterNames, params, returnNames, resultsCuMatShared);
+		resultAssembled.Insert(std::make_pair("CuMat_Shared", resultsCuMatShared));
+
+        //cuMat - automatic selection
+        std::cout << " Run CuMat - Auto" << std::endl;
+        Json::Array resultsCuMatAuto;
+        benchmark_cuMat_Auto(parameterNames, params, returnNames, resultsCuMatAuto);
+		resultAssembled.Insert(std::make_pair("CuMat_Auto", resultsCuMatAuto));
+
+        //write results
+        std::ofstream outStream(outputDir + setName + ".json");
+        outStream << resultAssembled;
+        outStream.close();
+		std::string launchParams = "\"" + pythonPath + " " + std::string(CUMAT_STR(PYTHON_FILES)) + "MakePlots.py" + " \"" + outputDir + setName + "\" " + std::string(CUMAT_STR(CONFIG_FILE)) + "\"";
+        std::cout << launchParams << std::endl;
+        system(launchParams.c_str());
+    }
+    std::cout << "DONE" << std::endl;
+}
@@ -0,0 +1,123 @@
+#include "benchmark.h"
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+//2D Poisson matrix (5-point stencil) on a gridSize x gridSize grid, the nodes are numbered randomly
+static cuMat::SparseMatrix<float, 1, cuMat::CSR> createShuffledPoisson(int gridSize)
+{
+	const int n = gridSize * gridSize;
+	std::vector<int> number(n);
+	for (int i = 0; i < n; ++i) number[i] = i;
+	std::shuffle(number.begin(), number.end(), std::mt19937(42));
+	std::vector<int> rowLength(n);
+	for (int x = 0; x < gridSize; ++x) for (int y = 0; y < gridSize; ++y)
+		rowLength[number[x * gridSize + y]] = 1 + (x > 0) + (y > 0) + (x < gridSize - 1) + (y < gridSize - 1);
+	std::vector<int> JA(n + 1, 0);
+	for (int i = 0; i < n; ++i) JA[i + 1] = JA[i] + rowLength[i];
+	std::vector<int> IA(JA[n]);
+	std::vector<float> values(JA[n]);
+	for (int x = 0; x < gridSize; ++x) for (int y = 0; y < gridSize; ++y)
+	{
+		const int row = number[x * gridSize + y];
+		std::vector<std::pair<int, float>> entries;
+		entries.emplace_back(row, 4.0f);
+		if (x > 0) entries.emplace_back(number[(x - 1) * gridSize + y], -1.0f);
+		if (y > 0) entries.emplace_back(number[x * gridSize + y - 1], -1.0f);
+		if (x < gridSize - 1) entries.emplace_back(number[(x + 1) * gridSize + y], -1.0f);
+		if (y < gridSize - 1) entries.emplace_back(number[x * gridSize + y + 1], -1.0f);
+		std::sort(entries.begin(), entries.end());
+		for (size_t k = 0; k < entries.size(); ++k)
+		{
+			IA[JA[row] + k] = entries[k].first;
+			values[JA[row] + k] = entries[k].second;
+		}
+	}
+	cuMat::SparsityPattern<cuMat::CSR> pattern;
+	pattern.rows = n;
+	pattern.cols = n;
+	pattern.nnz = JA[n];
+	pattern.JA = cuMat::SparsityPattern<cuMat::CSR>::IndexVector(n + 1);
+	pattern.JA.copyFromHost(JA.data());
+	pattern.IA = cuMat::SparsityPattern<cuMat::CSR>::IndexVector(pattern.nnz);
+	pattern.IA.copyFromHost(IA.data());
+	cuMat::SparseMatrix<float, 1, cuMat::CSR> m(pattern);
+	m.getData().copyFromHost(values.data());
+	return m;
+}
+
+void benchmark_cuMat(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues,
+    bool reorder)
+{
+    //number of runs for time measures
+    const int runs = 3;
+	const int subruns = 10;
+
+    int numConfigs = parameters.Size();
+    for (int config = 0; config < numConfigs; ++config)
+    {
+        //Input
+		std::string ordering = parameters[config][0].AsString();
+		int gridSize = parameters[config][1].AsInt32();
+		std::cout << "  " << ordering << ", Grid Size: " << gridSize << std::flush;
+		cuMat::SparseMatrix<float, 1, cuMat::CSR> A = createShuffledPoisson(gridSize);
+		const int n = gridSize * gridSize;
+
+		//Ordering on the host, timed separately from the product
+		double orderingTime = 0;
+		cuMat::SparseReordering r;
+		for (int run = 0; run < runs; ++run)
+		{
+			auto start = std::chrono::steady_clock::now();
+			if (ordering == "rcm") r = cuMat::reverseCuthillMcKee(A.getSparsityPattern());
+			else if (ordering == "nd") r = cuMat::nestedDissection(A.getSparsityPattern());
+			else throw std::runtime_error("Unknown ordering " + ordering);
+			auto finish = std::chrono::steady_clock::now();
+			orderingTime += std::chrono::duration_cast<
+				std::chrono::duration<double>>(finish - start).count() * 1000;
+		}
+		orderingTime /= runs;
+		if (reorder) A = cuMat::permuteSymmetric(A, r);
+		const cuMat::Index bandwidth = reorder ? r.bandwidthAfter : r.bandwidthBefore;
+		const cuMat::Index profile = reorder ? r.profileAfter : r.profileBefore;
+
+		//Product
+		cuMat::VectorXf x = cuMat::VectorXf::Constant(n, 1.0f);
+		cuMat::VectorXf y(n);
+		double productTime = 0;
+        for (int run = 0; run < runs; ++run)
+        {
+			cudaDeviceSynchronize();
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < subruns; ++i) {
+				y.inplace() = A * x;
+			}
+
+			cudaDeviceSynchronize();
+			auto finish = std::chrono::steady_clock::now();
+			productTime += std::chrono::duration_cast<
+				std::chrono::duration<double>>(finish - start).count() * 1000 / subruns;
+        }
+		productTime /= runs;
+
+        //Result
+        Json::Array result;
+        result.PushBack(reorder ? orderingTime : 0.0);
+        result.PushBack(static_cast<double>(bandwidth));
+        result.PushBack(static_cast<double>(profile));
+        result.PushBack(productTime);
+        returnValues.PushBack(result);
+        std::cout << " -> ordering " << orderingTime << "ms, bandwidth " << bandwidth << ", profile " << profile
+			<< ", product " << productTime << "ms" << std::endl;
+    }
+}
@@ -0,0 +1,42 @@
+import sys
+import os
+import json
+import matplotlib.pyplot as plt
+
+setPath = sys.argv[1]
+setName = setPath[setPath.rfind('/')+1:]
+
+resultFile = setPath + ".json"
+print("file:", resultFile)
+with open(resultFile, 'r') as f:
+    results = json.load(f)
+
+config = None
+with open(sys.argv[2], 'r') as f:
+    config = json.load(f)
+params = config['Sets'][setName]
+
+title = setName[setName.find('-')+1:].strip()
+xdata = [vx[1]*vx[1] for vx in params]
+
+# left: time of the ordering and of the products, right: bandwidth
+fig, (ax1, ax2) = plt.subplots(1, 2, figsize=(12, 5))
+ax1.plot(xdata, [d[0] for d in results["CuMat_Reordered"]], '-o', label='ordering (host)')
+ax1.plot(xdata, [d[3] for d in results["CuMat_Original"]], '-o', label='SpMV, original order')
+ax1.plot(xdata, [d[3] for d in results["CuMat_Reordered"]], '-o', label='SpMV, reordered')
+ax1.set_xscale('log')
+ax1.set_yscale('log')
+ax1.set_xlabel("Matrix size (square)")
+ax1.set_ylabel("Time (ms)")
+ax1.legend()
+ax2.plot(xdata, [d[1] for d in results["CuMat_Original"]], '-o', label='original order')
+ax2.plot(xdata, [d[1] for d in results["CuMat_Reordered"]], '-o', label='reordered')
+ax2.set_xscale('log')
+ax2.set_yscale('log')
+ax2.set_xlabel("Matrix size (square)")
+ax2.set_ylabel("Bandwidth")
+ax2.legend()
+fig.suptitle("Sparse reordering: " + title)
+
+#plt.show()
+plt.savefig(setPath+'.png', bbox_inches='tight', dpi=300)
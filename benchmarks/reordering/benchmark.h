@@ -0,0 +1,31 @@
+/*
+ * General entry points to benchmarks
+ */
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <vector>
+#include <string>
+#include "../json_st.h"
+
+/**
+ * \brief Launches the reordering benchmark of cuMat on a 2D Poisson matrix with randomly numbered nodes.
+ * The parameters are the ordering ("rcm": reverse Cuthill-McKee, "nd": nested dissection)
+ * and the grid size, the matrix has gridSize^2 rows and columns.
+ * Returned are the time of the ordering on the host in ms (zero in the original order),
+ * the bandwidth and profile, and the time of the matrix-vector product in ms.
+ * \param parameterNames the parameter names
+ * \param parameters the parameter values
+ * \param returnNames 
+ * \param returnValues 
+ * \param reorder false: measure the matrix in the original order, true: reorder it first
+ */
+void benchmark_cuMat(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues,
+    bool reorder);
+
+#endif
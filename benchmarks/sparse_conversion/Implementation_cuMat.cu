@@ -0,0 +1,139 @@
+#include "benchmark.h"
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+#include <random>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//2D Poisson matrix (5-point stencil) on a gridSize x gridSize grid in CSR format
+static cuMat::SparseMatrix<float, 1, cuMat::CSR> createPoisson(int gridSize)
+{
+	const int n = gridSize * gridSize;
+	std::vector<int> JA(n + 1), IA;
+	std::vector<float> values;
+	IA.reserve(5 * n);
+	values.reserve(5 * n);
+#define IDX(x, y) ((y) + (x)*gridSize)
+	for (int x = 0; x<gridSize; ++x) for (int y = 0; y<gridSize; ++y)
+	{
+		int row = IDX(x, y);
+		JA[row] = static_cast<int>(IA.size());
+		if (x > 0) { IA.push_back(IDX(x - 1, y)); values.push_back(-1); }
+		if (y > 0) { IA.push_back(IDX(x, y - 1)); values.push_back(-1); }
+		IA.push_back(row); values.push_back(4);
+		if (y < gridSize - 1) { IA.push_back(IDX(x, y + 1)); values.push_back(-1); }
+		if (x < gridSize - 1) { IA.push_back(IDX(x + 1, y)); values.push_back(-1); }
+	}
+#undef IDX
+	JA[n] = static_cast<int>(IA.size());
+	cuMat::SparsityPattern<cuMat::CSR> pattern;
+	pattern.rows = n;
+	pattern.cols = n;
+	pattern.nnz = static_cast<cuMat::Index>(IA.size());
+	pattern.JA = cuMat::SparsityPattern<cuMat::CSR>::IndexVector(n + 1);
+	pattern.JA.copyFromHost(JA.data());
+	pattern.IA = cuMat::SparsityPattern<cuMat::CSR>::IndexVector(pattern.nnz);
+	pattern.IA.copyFromHost(IA.data());
+	cuMat::SparseMatrix<float, 1, cuMat::CSR> m(pattern);
+	m.getData().copyFromHost(values.data());
+	return m;
+}
+
+//every entry twice, in random order
+static cuMat::CooMatrix<float, 1> createCoo(const cuMat::SparseMatrix<float, 1, cuMat::CSR>& csr)
+{
+	const cuMat::CooMatrix<float, 1> coo = cuMat::convertToCOO(csr);
+	const cuMat::Index nnz = coo.nnz();
+	std::vector<int> rows(nnz), cols(nnz), order(2 * nnz);
+	std::vector<float> values(nnz);
+	coo.rowIndices.copyToHost(rows.data());
+	coo.colIndices.copyToHost(cols.data());
+	coo.values.copyToHost(values.data());
+	for (int i = 0; i < 2 * nnz; ++i) order[i] = i % nnz;
+	std::shuffle(order.begin(), order.end(), std::mt19937(42));
+	std::vector<int> rows2(2 * nnz), cols2(2 * nnz);
+	std::vector<float> values2(2 * nnz);
+	for (int i = 0; i < 2 * nnz; ++i)
+	{
+		rows2[i] = rows[order[i]];
+		cols2[i] = cols[order[i]];
+		values2[i] = 0.5f * values[order[i]];
+	}
+	cuMat::CooMatrix<float, 1> result;
+	result.rows = coo.rows;
+	result.cols = coo.cols;
+	result.rowIndices = cuMat::CooMatrix<float, 1>::IndexVector(2 * nnz);
+	result.rowIndices.copyFromHost(rows2.data());
+	result.colIndices = cuMat::CooMatrix<float, 1>::IndexVector(2 * nnz);
+	result.colIndices.copyFromHost(cols2.data());
+	result.values = cuMat::CooMatrix<float, 1>::DataVector(2 * nnz);
+	result.values.copyFromHost(values2.data());
+	return result;
+}
+
+void benchmark_cuMat(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues,
+    bool device)
+{
+    //number of runs for time measures
+    const int runs = 5;
+	const cuMat::SparseConversionBackend backend = device ? cuMat::SparseConversionBackend::Device : cuMat::SparseConversionBackend::Host;
+#ifdef _OPENMP
+	if (!device) std::cout << "  OpenMP threads: " << omp_get_max_threads() << std::endl;
+#endif
+
+    int numConfigs = parameters.Size();
+    for (int config = 0; config < numConfigs; ++config)
+    {
+        //Input
+		std::string conversion = parameters[config][0].AsString();
+		int gridSize = parameters[config][1].AsInt32();
+        double totalTime = 0;
+		std::cout << "  " << conversion << ", Grid Size: " << gridSize << std::flush;
+
+		cuMat::SparseMatrix<float, 1, cuMat::CSR> csr = createPoisson(gridSize);
+		cuMat::SparseMatrix<float, 1, cuMat::CSC> csc = cuMat::convertToCSC(csr);
+		cuMat::SparseMatrix<float, 1, cuMat::ELLPACK> ell = cuMat::convertToELLPACK(csr);
+		cuMat::CooMatrix<float, 1> coo = createCoo(csr);
+		cuMat::Index nnz = conversion == "COO-CSR" ? coo.nnz() : csr.getSparsityPattern().nnz;
+
+        //Run it multiple times, including the transfers of the host conversion
+        for (int run = 0; run < runs; ++run)
+        {
+			cudaDeviceSynchronize();
+			auto start = std::chrono::steady_clock::now();
+
+			if (conversion == "CSR-CSC") cuMat::convertToCSC(csr, backend);
+			else if (conversion == "CSC-CSR") cuMat::convertToCSR(csc, backend);
+			else if (conversion == "CSR-ELLPACK") cuMat::convertToELLPACK(csr, backend);
+			else if (conversion == "ELLPACK-CSR") cuMat::convertToCSR(ell, backend);
+			else if (conversion == "COO-CSR") cuMat::convertToCSR(coo, backend);
+			else if (conversion == "CSR-COO") cuMat::convertToCOO(csr, backend);
+			else throw std::runtime_error("Unknown conversion " + conversion);
+
+			cudaDeviceSynchronize();
+			auto finish = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration_cast<
+				std::chrono::duration<double>>(finish - start).count() * 1000;
+
+            totalTime += elapsed;
+        }
+
+        //Result
+        Json::Array result;
+        double finalTime = totalTime / runs;
+        result.PushBack(finalTime);
+        result.PushBack(static_cast<double>(nnz));
+        returnValues.PushBack(result);
+        std::cout << " -> " << finalTime << "ms, " << (nnz / finalTime / 1000) << " M entries/s" << std::endl;
+    }
+}
@@ -0,0 +1,42 @@
+import sys
+import os
+import json
+import matplotlib.pyplot as plt
+
+setPath = sys.argv[1]
+setName = setPath[setPath.rfind('/')+1:]
+
+resultFile = setPath + ".json"
+print("file:", resultFile)
+with open(resultFile, 'r') as f:
+    results = json.load(f)
+
+config = None
+with open(sys.argv[2], 'r') as f:
+    config = json.load(f)
+params = config['Sets'][setName]
+
+title = "Sparse format conversion, " + setName[setName.find('-')+1:].strip()
+xlabel = "Number of entries"
+ylabel = "Throughput (M entries / s)"
+xscale = 'log'
+yscale = 'log'
+
+# throughput = entries / time
+def plot(key, style, label):
+    if key not in results:
+        return
+    xdata = [d[1] for d in results[key]]
+    ydata = [d[1] / d[0] / 1000 for d in results[key]]
+    plt.plot(xdata, ydata, style, label=label)
+plot("CuMat_Host", '-o', 'cuMat - Host (OpenMP)')
+plot("CuMat_Device", '-o', 'cuMat - Device')
+plt.xscale(xscale)
+plt.yscale(yscale)
+plt.xlabel(xlabel)
+plt.ylabel(ylabel)
+plt.title(title)
+plt.legend()
+
+#plt.show()
+plt.savefig(setPath+'.png', bbox_inches='tight', dpi=300)
@@ -0,0 +1,30 @@
+/*
+ * General entry points to benchmarks
+ */
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <vector>
+#include <string>
+#include "../json_st.h"
+
+/**
+ * \brief Launches the conversions of cuMat on a 2D Poisson matrix.
+ * The parameters are the conversion ("CSR-CSC", "CSR-ELLPACK", "ELLPACK-CSR", "COO-CSR", "CSR-COO")
+ * and the grid size, the matrix has gridSize^2 rows and columns.
+ * The COO input contains every entry twice in random order to include the summation of duplicates.
+ * \param parameterNames the parameter names
+ * \param parameters the parameter values
+ * \param returnNames the time in ms and the number of entries of the input
+ * \param returnValues 
+ * \param device true: convert on the device, false: on the host (with OpenMP if enabled)
+ */
+void benchmark_cuMat(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues,
+    bool device);
+
+#endif
@@ -0,0 +1,119 @@
+#include "benchmark.h"
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <stdexcept>
+
+//2D Poisson matrix (5-point stencil) on a gridSize x gridSize grid
+static cuMat::SparseMatrix<float, 1, cuMat::CSR> createPoisson(int gridSize)
+{
+	const int n = gridSize * gridSize;
+	std::vector<int> JA(n + 1, 0);
+	std::vector<int> IA;
+	std::vector<float> values;
+	for (int y = 0; y < gridSize; ++y) for (int x = 0; x < gridSize; ++x)
+	{
+		const int row = x + gridSize * y;
+		if (y > 0) { IA.push_back(row - gridSize); values.push_back(-1.0f); }
+		if (x > 0) { IA.push_back(row - 1); values.push_back(-1.0f); }
+		IA.push_back(row); values.push_back(4.0f);
+		if (x < gridSize - 1) { IA.push_back(row + 1); values.push_back(-1.0f); }
+		if (y < gridSize - 1) { IA.push_back(row + gridSize); values.push_back(-1.0f); }
+		JA[row + 1] = static_cast<int>(IA.size());
+	}
+	cuMat::SparsityPattern<cuMat::CSR> pattern;
+	pattern.rows = n;
+	pattern.cols = n;
+	pattern.nnz = JA[n];
+	pattern.JA = cuMat::SparsityPattern<cuMat::CSR>::IndexVector(n + 1);
+	pattern.JA.copyFromHost(JA.data());
+	pattern.IA = cuMat::SparsityPattern<cuMat::CSR>::IndexVector(pattern.nnz);
+	pattern.IA.copyFromHost(IA.data());
+	cuMat::SparseMatrix<float, 1, cuMat::CSR> m(pattern);
+	m.getData().copyFromHost(values.data());
+	return m;
+}
+
+//average time of one product with all k columns in ms
+template<int Columns>
+static double timeProduct(const cuMat::SparseMatrix<float, 1, cuMat::CSR>& A, Mode mode, int runs, int subruns)
+{
+	const cuMat::Index n = A.rows();
+	typedef cuMat::Matrix<float, cuMat::Dynamic, Columns, 1, cuMat::ColumnMajor> ColumnMajorMatrix;
+	typedef cuMat::Matrix<float, cuMat::Dynamic, Columns, 1, cuMat::RowMajor> RowMajorMatrix;
+	ColumnMajorMatrix xc = ColumnMajorMatrix::Constant(n, Columns, 1.0f), yc(n, Columns);
+	RowMajorMatrix xr = RowMajorMatrix::Constant(n, Columns, 1.0f), yr(n, Columns);
+	std::vector<cuMat::VectorXf> xv, yv;
+	for (int c = 0; c < Columns; ++c)
+	{
+		xv.push_back(cuMat::VectorXf::Constant(n, 1.0f));
+		yv.push_back(cuMat::VectorXf(n));
+	}
+
+	double totalTime = 0;
+	for (int run = 0; run < runs; ++run)
+	{
+		cudaDeviceSynchronize();
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < subruns; ++i) {
+			switch (mode)
+			{
+			case Mode::SpMMColumnMajor: yc.inplace() = A * xc; break;
+			case Mode::SpMMRowMajor: yr.inplace() = A * xr; break;
+			case Mode::IndependentSpMV:
+				for (int c = 0; c < Columns; ++c) yv[c].inplace() = A * xv[c];
+				break;
+			}
+		}
+
+		cudaDeviceSynchronize();
+		auto finish = std::chrono::steady_clock::now();
+		totalTime += std::chrono::duration_cast<
+			std::chrono::duration<double>>(finish - start).count() * 1000 / subruns;
+	}
+	return totalTime / runs;
+}
+
+void benchmark_cuMat(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues,
+    Mode mode)
+{
+    //number of runs for time measures
+    const int runs = 5;
+	const int subruns = 10;
+
+    int numConfigs = parameters.Size();
+    for (int config = 0; config < numConfigs; ++config)
+    {
+        //Input
+		int columns = parameters[config][0].AsInt32();
+		int gridSize = parameters[config][1].AsInt32();
+		std::cout << "  Columns: " << columns << ", Grid Size: " << gridSize << std::flush;
+		cuMat::SparseMatrix<float, 1, cuMat::CSR> A = createPoisson(gridSize);
+
+		//the number of columns is a compile-time parameter of the product
+		double time;
+		switch (columns)
+		{
+		case 4: time = timeProduct<4>(A, mode, runs, subruns); break;
+		case 8: time = timeProduct<8>(A, mode, runs, subruns); break;
+		case 16: time = timeProduct<16>(A, mode, runs, subruns); break;
+		case 32: time = timeProduct<32>(A, mode, runs, subruns); break;
+		case 64: time = timeProduct<64>(A, mode, runs, subruns); break;
+		default: throw std::runtime_error("Unsupported number of columns " + std::to_string(columns));
+		}
+
+        //Result
+        Json::Array result;
+        result.PushBack(time);
+        returnValues.PushBack(result);
+        std::cout << " -> " << time << "ms" << std::endl;
+    }
+}
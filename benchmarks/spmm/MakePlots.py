@@ -0,0 +1,36 @@
+import sys
+import os
+import json
+import matplotlib.pyplot as plt
+
+setPath = sys.argv[1]
+setName = setPath[setPath.rfind('/')+1:]
+
+resultFile = setPath + ".json"
+print("file:", resultFile)
+with open(resultFile, 'r') as f:
+    results = json.load(f)
+
+config = None
+with open(sys.argv[2], 'r') as f:
+    config = json.load(f)
+params = config['Sets'][setName]
+
+title = setName[setName.find('-')+1:].strip()
+# x axis: the number of columns, or the matrix size if the number of columns is fixed
+byColumns = len(set([p[0] for p in params])) > 1
+xdata = [p[0] if byColumns else p[1]*p[1] for p in params]
+
+fig, ax = plt.subplots()
+ax.plot(xdata, [d[0] for d in results["CuMat_SpMM_ColumnMajor"]], '-o', label='SpMM, column-major')
+ax.plot(xdata, [d[0] for d in results["CuMat_SpMM_RowMajor"]], '-o', label='SpMM, row-major')
+ax.plot(xdata, [d[0] for d in results["CuMat_SpMV"]], '-o', label='independent SpMVs')
+ax.set_xscale('log')
+ax.set_yscale('log')
+ax.set_xlabel("Number of columns" if byColumns else "Matrix size (square)")
+ax.set_ylabel("Time (ms)")
+ax.legend()
+fig.suptitle("SpMM: " + title)
+
+#plt.show()
+plt.savefig(setPath+'.png', bbox_inches='tight', dpi=300)
@@ -0,0 +1,40 @@
+/*
+ * General entry points to benchmarks
+ */
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <vector>
+#include <string>
+#include "../json_st.h"
+
+/**
+ * \brief How the product of the sparse matrix with k vectors is computed
+ */
+enum class Mode
+{
+    SpMMColumnMajor, //one product with a column-major n x k matrix
+    SpMMRowMajor,    //one product with a row-major n x k matrix
+    IndependentSpMV  //k products with vectors
+};
+
+/**
+ * \brief Launches the SpMM benchmark of cuMat on a 2D Poisson matrix.
+ * The parameters are the number of columns k (4, 8, 16, 32 or 64)
+ * and the grid size, the matrix has gridSize^2 rows and columns.
+ * Returned is the time of the product with all k columns in ms.
+ * \param parameterNames the parameter names
+ * \param parameters the parameter values
+ * \param returnNames 
+ * \param returnValues 
+ * \param mode the product that is measured
+ */
+void benchmark_cuMat(
+    const std::vector<std::string>& parameterNames,
+    const Json::Array& parameters,
+    const std::vector<std::string>& returnNames,
+    Json::Array& returnValues,
+    Mode mode);
+
+#endif
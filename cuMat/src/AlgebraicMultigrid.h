@@ -0,0 +1,548 @@
+#ifndef __CUMAT_ALGEBRAIC_MULTIGRID_H__
+#define __CUMAT_ALGEBRAIC_MULTIGRID_H__
+
+#include "Macros.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "ForwardDeclarations.h"
+#include "Matrix.h"
+#include "BinaryOps.h"
+#include "ProductOp.h"
+#include "SparseMatrix.h"
+#include "SparseProductEvaluation.h"
+#include "HostCsrMatrix.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+/**
+ * \brief Settings of the AlgebraicMultigridPreconditioner
+ */
+struct AMGSettings
+{
+    enum SmootherType
+    {
+        /** \brief Damped Jacobi with the weight 4/(3*rho(D^-1 A)) */
+        Jacobi,
+        /** \brief Chebyshev polynomial in D^-1 A */
+        Chebyshev
+    };
+
+    /**
+     * \brief Threshold theta of the strength of connection:
+     * the off-diagonal entry a_ij is strong iff <tt>|a_ij| >= theta * sqrt(|a_ii * a_jj|)</tt>.
+     */
+    double strengthThreshold = 0.0;
+    /**
+     * \brief The maximal number of levels, including the finest level
+     */
+    int maxLevels = 10;
+    /**
+     * \brief The coarsening stops as soon as a level has at most this many unknowns.
+     * If the coarsest level is not larger than that, it is solved directly with the dense inverse.
+     */
+    Index coarseSize = 128;
+    /**
+     * \brief The damping weight of the prolongation smoother relative to the spectral radius, omega = weight / rho(D^-1 A)
+     */
+    double prolongationWeight = 4.0 / 3.0;
+    /**
+     * \brief The smoother of the V-cycle
+     */
+    SmootherType smoother = Chebyshev;
+    /**
+     * \brief The number of pre- and post-smoothing steps. The same number is used for both to keep the V-cycle symmetric.
+     */
+    int sweeps = 1;
+    /**
+     * \brief The degree of the Chebyshev polynomial
+     */
+    int chebyshevDegree = 2;
+    /**
+     * \brief The Chebyshev smoother targets the interval <tt>[lambda_max / chebyshevRatio, lambda_max]</tt>
+     */
+    double chebyshevRatio = 30.0;
+};
+
+namespace internal
+{
+    /**
+     * \brief One level of the multigrid hierarchy in host memory
+     */
+    template<typename _Scalar>
+    struct AMGLevelHost
+    {
+        /** \brief The operator of this level */
+        HostCsrMatrix<_Scalar> A;
+        /** \brief Prolongation from the next coarser level to this level. Empty on the coarsest level */
+        HostCsrMatrix<_Scalar> P;
+        /** \brief Restriction to the next coarser level, the transpose of P. Empty on the coarsest level */
+        HostCsrMatrix<_Scalar> R;
+        /** \brief The inverse of the diagonal of A */
+        std::vector<_Scalar> invDiag;
+        /** \brief An estimate of the spectral radius of D^-1 A */
+        _Scalar rho;
+    };
+
+    /**
+     * \brief The host-side setup phase of the smoothed aggregation algebraic multigrid (Vanek, Mandel, Brezina 1996).
+     * All methods run on the CPU.
+     * \tparam _Scalar the scalar type
+     */
+    template<typename _Scalar>
+    struct SmoothedAggregation
+    {
+        typedef _Scalar Scalar;
+        typedef HostCsrMatrix<Scalar> HostMatrix;
+        typedef typename HostMatrix::StorageIndex StorageIndex;
+
+        /**
+         * \brief Computes the strength of connection graph: the off-diagonal entries with
+         * <tt>|a_ij| >= theta * sqrt(|a_ii * a_jj|)</tt>. The values of the returned matrix are meaningless.
+         */
+        static HostMatrix strength(const HostMatrix& A, double theta)
+        {
+            const std::vector<Scalar> d = A.diagonal();
+            HostMatrix S;
+            S.rows = A.rows;
+            S.cols = A.cols;
+            S.JA.assign(A.rows + 1, 0);
+            for (Index i = 0; i < A.rows; ++i)
+            {
+                for (StorageIndex k = A.JA[i]; k < A.JA[i + 1]; ++k)
+                {
+                    const StorageIndex j = A.IA[k];
+                    if (j == i || A.values[k] == Scalar(0)) continue;
+                    using std::abs;
+                    using std::sqrt;
+                    if (abs(A.values[k]) >= theta * sqrt(abs(d[i] * d[j])))
+                    {
+                        S.IA.push_back(j);
+                        S.values.push_back(Scalar(1));
+                    }
+                }
+                S.JA[i + 1] = static_cast<StorageIndex>(S.IA.size());
+            }
+            return S;
+        }
+
+        /**
+         * \brief Standard three-pass aggregation on the strength graph.
+         *  1. every node whose strong neighbors are all unaggregated forms a new aggregate with them,
+         *  2. remaining nodes join an aggregate of the first pass of one of their strong neighbors,
+         *  3. still remaining nodes form new aggregates with their unaggregated strong neighbors.
+         *
+         * \param S the strength graph
+         * \param numAggregates [out] the number of aggregates
+         * \return the aggregate index per node
+         */
+        static std::vector<StorageIndex> aggregate(const HostMatrix& S, Index& numAggregates)
+        {
+            const Index n = S.rows;
+            std::vector<StorageIndex> agg(n, -1);
+            StorageIndex count = 0;
+            //pass 1
+            for (Index i = 0; i < n; ++i)
+            {
+                if (agg[i] >= 0) continue;
+                bool free = true;
+                for (StorageIndex k = S.JA[i]; k < S.JA[i + 1] && free; ++k)
+                    free = agg[S.IA[k]] < 0;
+                if (!free) continue;
+                agg[i] = count;
+                for (StorageIndex k = S.JA[i]; k < S.JA[i + 1]; ++k)
+                    agg[S.IA[k]] = count;
+                count++;
+            }
+            //pass 2
+            const std::vector<StorageIndex> pass1 = agg;
+            for (Index i = 0; i < n; ++i)
+            {
+                if (agg[i] >= 0) continue;
+                for (StorageIndex k = S.JA[i]; k < S.JA[i + 1]; ++k)
+                {
+                    if (pass1[S.IA[k]] >= 0)
+                    {
+                        agg[i] = pass1[S.IA[k]];
+                        break;
+                    }
+                }
+            }
+            //pass 3
+            for (Index i = 0; i < n; ++i)
+            {
+                if (agg[i] >= 0) continue;
+                agg[i] = count;
+                for (StorageIndex k = S.JA[i]; k < S.JA[i + 1]; ++k)
+                    if (agg[S.IA[k]] < 0) agg[S.IA[k]] = count;
+                count++;
+            }
+            numAggregates = count;
+            return agg;
+        }
+
+        /**
+         * \brief The tentative prolongator: the constant vector restricted to every aggregate,
+         * normalized so that the columns are orthonormal.
+         */
+        static HostMatrix tentativeProlongator(const std::vector<StorageIndex>& agg, Index numAggregates)
+        {
+            std::vector<Index> sizes(numAggregates, 0);
+            for (StorageIndex a : agg) sizes[a]++;
+            HostMatrix T;
+            T.rows = static_cast<Index>(agg.size());
+            T.cols = numAggregates;
+            T.JA.resize(agg.size() + 1);
+            T.IA.resize(agg.size());
+            T.values.resize(agg.size());
+            for (size_t i = 0; i < agg.size(); ++i)
+            {
+                using std::sqrt;
+                T.JA[i] = static_cast<StorageIndex>(i);
+                T.IA[i] = agg[i];
+                T.values[i] = Scalar(1) / sqrt(Scalar(sizes[agg[i]]));
+            }
+            T.JA[agg.size()] = static_cast<StorageIndex>(agg.size());
+            return T;
+        }
+
+        /**
+         * \brief Estimates the spectral radius of D^-1 A with a fixed number of power iterations
+         */
+        static Scalar spectralRadius(const HostMatrix& A, const std::vector<Scalar>& invDiag, int iterations = 20)
+        {
+            using std::sqrt;
+            const Index n = A.rows;
+            std::vector<Scalar> v(n), w;
+            for (Index i = 0; i < n; ++i) v[i] = Scalar(1) + Scalar((i * 7919) % 13) / Scalar(13);
+            Scalar lambda = 0;
+            for (int it = 0; it < iterations; ++it)
+            {
+                Scalar norm = 0;
+                for (Index i = 0; i < n; ++i) norm += v[i] * v[i];
+                norm = sqrt(norm);
+                if (norm == Scalar(0)) return Scalar(0);
+                for (Index i = 0; i < n; ++i) v[i] /= norm;
+                A.multiply(v, w);
+                Scalar wnorm = 0;
+                for (Index i = 0; i < n; ++i)
+                {
+                    w[i] *= invDiag[i];
+                    wnorm += w[i] * w[i];
+                }
+                lambda = sqrt(wnorm);
+                v.swap(w);
+            }
+            return lambda;
+        }
+
+        /**
+         * \brief Smooths the tentative prolongator: <tt>P = (I - omega D^-1 A) T</tt> with <tt>omega = weight / rho</tt>
+         */
+        static HostMatrix smoothProlongator(const HostMatrix& A, const std::vector<Scalar>& invDiag, Scalar rho,
+            double weight, const HostMatrix& T)
+        {
+            const Scalar omega = Scalar(weight) / rho;
+            HostMatrix S = A;
+            for (Index i = 0; i < A.rows; ++i)
+                for (StorageIndex k = A.JA[i]; k < A.JA[i + 1]; ++k)
+                    S.values[k] = (A.IA[k] == i ? Scalar(1) : Scalar(0)) - omega * invDiag[i] * A.values[k];
+            return HostMatrix::product(S, T);
+        }
+
+        /**
+         * \brief The inverse of the diagonal, zero entries on the diagonal are replaced by one
+         */
+        static std::vector<Scalar> inverseDiagonal(const HostMatrix& A)
+        {
+            std::vector<Scalar> d = A.diagonal();
+            for (Scalar& v : d) v = (v == Scalar(0)) ? Scalar(1) : Scalar(1) / v;
+            return d;
+        }
+
+        /**
+         * \brief Inverts a small dense matrix with Gauss-Jordan elimination and partial pivoting.
+         * \return the inverse in column-major order
+         */
+        static std::vector<Scalar> denseInverse(const HostMatrix& A)
+        {
+            const Index n = A.rows;
+            std::vector<double> M(n * 2 * n, 0.0); //row-major [A | I]
+            for (Index i = 0; i < n; ++i)
+            {
+                for (StorageIndex k = A.JA[i]; k < A.JA[i + 1]; ++k)
+                    M[i * 2 * n + A.IA[k]] = double(A.values[k]);
+                M[i * 2 * n + n + i] = 1.0;
+            }
+            for (Index c = 0; c < n; ++c)
+            {
+                Index pivot = c;
+                for (Index r = c + 1; r < n; ++r)
+                    if (std::abs(M[r * 2 * n + c]) > std::abs(M[pivot * 2 * n + c])) pivot = r;
+                if (pivot != c)
+                    for (Index j = 0; j < 2 * n; ++j) std::swap(M[c * 2 * n + j], M[pivot * 2 * n + j]);
+                const double p = M[c * 2 * n + c];
+                CUMAT_ASSERT(p != 0.0 && "Coarsest level of the multigrid hierarchy is singular");
+                for (Index j = 0; j < 2 * n; ++j) M[c * 2 * n + j] /= p;
+                for (Index r = 0; r < n; ++r)
+                {
+                    if (r == c) continue;
+                    const double f = M[r * 2 * n + c];
+                    if (f == 0.0) continue;
+                    for (Index j = 0; j < 2 * n; ++j) M[r * 2 * n + j] -= f * M[c * 2 * n + j];
+                }
+            }
+            std::vector<Scalar> inv(n * n);
+            for (Index i = 0; i < n; ++i)
+                for (Index j = 0; j < n; ++j)
+                    inv[i + j * n] = Scalar(M[i * 2 * n + n + j]);
+            return inv;
+        }
+
+        /**
+         * \brief Builds the multigrid hierarchy.
+         * \param A the matrix of the finest level
+         * \param settings the settings
+         * \param coarseInverse [out] the column-major dense inverse of the coarsest level, or empty
+         *   if the coarsest level is larger than AMGSettings::coarseSize
+         */
+        static std::vector<AMGLevelHost<Scalar>> setup(const HostMatrix& A, const AMGSettings& settings,
+            std::vector<Scalar>& coarseInverse)
+        {
+            CUMAT_ASSERT_ARGUMENT(A.rows == A.cols);
+            CUMAT_ASSERT_ARGUMENT(settings.maxLevels >= 1);
+            std::vector<AMGLevelHost<Scalar>> levels;
+            levels.emplace_back();
+            levels.back().A = A;
+            while (true)
+            {
+                AMGLevelHost<Scalar>& level = levels.back();
+                level.invDiag = inverseDiagonal(level.A);
+                level.rho = spectralRadius(level.A, level.invDiag);
+                if (level.A.rows <= settings.coarseSize || int(levels.size()) >= settings.maxLevels)
+                    break;
+                Index numAggregates;
+                const std::vector<StorageIndex> agg = aggregate(strength(level.A, settings.strengthThreshold), numAggregates);
+                if (numAggregates == 0 || numAggregates >= level.A.rows)
+                    break; //no coarsening possible
+                const HostMatrix T = tentativeProlongator(agg, numAggregates);
+                level.P = smoothProlongator(level.A, level.invDiag, level.rho, settings.prolongationWeight, T);
+                level.R = level.P.transpose();
+                HostMatrix coarse = HostMatrix::product(level.R, HostMatrix::product(level.A, level.P));
+                levels.emplace_back();
+                levels.back().A = std::move(coarse);
+            }
+            if (levels.back().A.rows <= settings.coarseSize)
+                coarseInverse = denseInverse(levels.back().A);
+            else
+                coarseInverse.clear();
+            return levels;
+        }
+    };
+}
+
+/**
+ * \brief Smoothed aggregation algebraic multigrid (AMG) preconditioner for symmetric positive definite CSR matrices.
+ *
+ * The multigrid hierarchy is built on the host when the preconditioner is constructed
+ * (see internal::SmoothedAggregation): the unknowns are grouped into aggregates along the strong connections,
+ * the tentative piecewise constant prolongator is smoothed with one damped Jacobi step and the coarse operators
+ * are computed with the Galerkin product <tt>R A P</tt>, <tt>R = P^T</tt>.
+ * The coarsest level is solved with its dense inverse.
+ *
+ * \ref solve() applies one symmetric V-cycle on the device with Jacobi or Chebyshev smoothers,
+ * hence the preconditioner is symmetric positive definite and can be used with the ConjugateGradient:
+ * \code
+ * typedef SparseMatrix<float, 1, SparseFlags::CSR> SMatrix;
+ * ConjugateGradient<SMatrix, AlgebraicMultigridPreconditioner<SMatrix>> cg(A);
+ * \endcode
+ * The hierarchy is built from the first batch of the matrix, the V-cycle is applied to all batches of the right hand side.
+ *
+ * \tparam _MatrixType the matrix type, must be a <tt>SparseMatrix<Scalar, 1, SparseFlags::CSR></tt> with a floating point scalar
+ */
+template<typename _MatrixType>
+class AlgebraicMultigridPreconditioner
+{
+public:
+    typedef typename internal::traits<_MatrixType>::Scalar Scalar;
+    CUMAT_STATIC_ASSERT((std::is_same<_MatrixType, SparseMatrix<Scalar, 1, SparseFlags::CSR>>::value),
+        "The algebraic multigrid only supports non-batched CSR sparse matrices");
+    CUMAT_STATIC_ASSERT(std::is_floating_point<Scalar>::value, "The algebraic multigrid only supports float and double");
+
+private:
+    typedef SparseMatrix<Scalar, 1, SparseFlags::CSR> SMatrix;
+    typedef Matrix<Scalar, Dynamic, 1, 1, ColumnMajor> Vector;
+    typedef Matrix<Scalar, Dynamic, Dynamic, 1, ColumnMajor> DenseMatrix;
+
+    struct Level
+    {
+        SMatrix A, P, R;
+        Vector invDiag;
+        Scalar rho;
+    };
+
+    AMGSettings settings_;
+    std::vector<Level> levels_;
+    bool coarseDirect_;
+    DenseMatrix coarseInverse_;
+
+public:
+    AlgebraicMultigridPreconditioner()
+        : coarseDirect_(false)
+    {}
+
+    /**
+     * \brief Builds the multigrid hierarchy with the default settings
+     */
+    AlgebraicMultigridPreconditioner(const MatrixBase<_MatrixType>& matrix)
+        : coarseDirect_(false)
+    {
+        compute(matrix.derived());
+    }
+
+    /**
+     * \brief Builds the multigrid hierarchy with the specified settings
+     */
+    AlgebraicMultigridPreconditioner(const MatrixBase<_MatrixType>& matrix, const AMGSettings& settings)
+        : settings_(settings), coarseDirect_(false)
+    {
+        compute(matrix.derived());
+    }
+
+    const AMGSettings& settings() const { return settings_; }
+
+    /**
+     * \brief Returns the number of levels of the hierarchy, including the finest level
+     */
+    Index numLevels() const { return static_cast<Index>(levels_.size()); }
+
+    /**
+     * \brief Returns the number of unknowns on the specified level, 0 is the finest level
+     */
+    Index levelSize(Index level) const { return levels_[level].A.rows(); }
+
+    /**
+     * \brief Applies one V-cycle to approximately solve for A.x=b
+     * \tparam _Rhs the type of right hand side
+     * \param b the right hand side of the equation
+     * \return the approximate solution of x
+     */
+    template<typename _Rhs>
+    Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor>
+    solve(const MatrixBase<_Rhs>& b) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(AlgebraicMultigridPreconditioner)
+        typedef Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor> VectorType;
+        CUMAT_ASSERT(!levels_.empty() && "The preconditioner is not initialized");
+        CUMAT_ASSERT(b.rows() == levels_[0].A.rows());
+        VectorType rhs = b.derived();
+        VectorType x(rhs.rows(), 1, rhs.batches());
+        vcycle(0, rhs, x);
+        return x;
+    }
+
+private:
+    void compute(const SMatrix& matrix)
+    {
+        typedef internal::SmoothedAggregation<Scalar> Setup;
+        std::vector<Scalar> coarseInverse;
+        const auto hostLevels = Setup::setup(internal::HostCsrMatrix<Scalar>::fromSparseMatrix(matrix), settings_, coarseInverse);
+        levels_.resize(hostLevels.size());
+        for (size_t l = 0; l < hostLevels.size(); ++l)
+        {
+            levels_[l].A = l == 0 ? matrix : hostLevels[l].A.toSparseMatrix();
+            if (l + 1 < hostLevels.size())
+            {
+                levels_[l].P = hostLevels[l].P.toSparseMatrix();
+                levels_[l].R = hostLevels[l].R.toSparseMatrix();
+            }
+            levels_[l].invDiag = Vector(hostLevels[l].A.rows);
+            levels_[l].invDiag.copyFromHost(hostLevels[l].invDiag.data());
+            levels_[l].rho = hostLevels[l].rho;
+        }
+        coarseDirect_ = !coarseInverse.empty();
+        if (coarseDirect_)
+        {
+            const Index n = hostLevels.back().A.rows;
+            coarseInverse_ = DenseMatrix(n, n);
+            coarseInverse_.copyFromHost(coarseInverse.data());
+        }
+    }
+
+    // x = V-cycle(b) on the specified level, with zero initial guess
+    template<typename _Vector>
+    void vcycle(size_t level, const _Vector& b, _Vector& x) const
+    {
+        const Level& L = levels_[level];
+        if (level + 1 == levels_.size())
+        {
+            if (coarseDirect_)
+                x = coarseInverse_ * b;
+            else
+                smooth(L, b, x, true);
+            return;
+        }
+        smooth(L, b, x, true);
+        _Vector r = b - L.A * x;
+        _Vector bc = L.R * r;
+        _Vector xc(bc.rows(), 1, bc.batches());
+        vcycle(level + 1, bc, xc);
+        x += L.P * xc;
+        smooth(L, b, x, false);
+    }
+
+    template<typename _Vector>
+    void smooth(const Level& L, const _Vector& b, _Vector& x, bool zeroGuess) const
+    {
+        if (settings_.smoother == AMGSettings::Jacobi)
+        {
+            const Scalar omega = Scalar(4) / (Scalar(3) * L.rho);
+            for (int s = 0; s < settings_.sweeps; ++s)
+            {
+                if (zeroGuess && s == 0)
+                    x = omega * L.invDiag.cwiseMul(b);
+                else
+                    x += omega * L.invDiag.cwiseMul(b - L.A * x);
+            }
+        }
+        else
+        {
+            //Chebyshev iteration for D^-1 A on [upper/ratio, upper]
+            const Scalar upper = Scalar(1.1) * L.rho;
+            const Scalar lower = upper / Scalar(settings_.chebyshevRatio);
+            const Scalar theta = (upper + lower) / 2;
+            const Scalar delta = (upper - lower) / 2;
+            const Scalar sigma = theta / delta;
+            _Vector r(b.rows(), 1, b.batches());
+            _Vector d(b.rows(), 1, b.batches());
+            for (int s = 0; s < settings_.sweeps; ++s)
+            {
+                const bool zero = zeroGuess && s == 0;
+                if (zero)
+                    r = L.invDiag.cwiseMul(b);
+                else
+                    r = L.invDiag.cwiseMul(b - L.A * x);
+                d = (Scalar(1) / theta) * r;
+                Scalar rho = Scalar(1) / sigma;
+                for (int k = 0; k < settings_.chebyshevDegree; ++k)
+                {
+                    if (zero && k == 0)
+                        x = d;
+                    else
+                        x += d;
+                    if (k + 1 == settings_.chebyshevDegree) break;
+                    r -= L.invDiag.cwiseMul(L.A * d);
+                    const Scalar rhoNew = Scalar(1) / (Scalar(2) * sigma - rho);
+                    d = (rhoNew * rho) * d + (Scalar(2) * rhoNew / delta) * r;
+                    rho = rhoNew;
+                }
+            }
+        }
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
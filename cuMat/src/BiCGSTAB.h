@@ -0,0 +1,328 @@
+#ifndef __CUMAT_BICGSTAB_H__
+#define __CUMAT_BICGSTAB_H__
+
+#include "Macros.h"
+
+#include <cmath>
+#include <valarray>
+#include <vector>
+
+#include "Matrix.h"
+#include "UnaryOps.h"
+#include "BinaryOps.h"
+#include "ReductionOps.h"
+#include "IterativeSolverBase.h"
+#include "ConvergenceCheck.h"
+#include "ConjugateGradient.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    template<typename _MatrixType, typename _Preconditioner>
+    struct traits<BiCGSTAB<_MatrixType, _Preconditioner> >
+    {
+        using MScalar = typename internal::traits<_MatrixType>::Scalar;
+        using Scalar = typename internal::NumTraits<MScalar>::ElementalType;
+        using MatrixType = _MatrixType;
+        using Preconditioner = _Preconditioner;
+    };
+
+#if CUMAT_NVCC == 1
+    namespace kernels
+    {
+        // marks a breakdown of the batches that have not converged yet if the denominator vanishes,
+        // the batch is restarted at the beginning of the next iteration
+        template <typename _Real>
+        __global__ void BiCGSTABBreakdownKernel(dim3 virtual_size, const _Real* den, const int* convergedAt, int* breakdown)
+        {
+            CUMAT_KERNEL_1D_LOOP(b, virtual_size)
+                if (convergedAt[b] < 0 && den[b] == _Real(0))
+                    breakdown[b] = 1;
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        // per batch: restarts the batch with the shadow residual r0=r on a breakdown (marked in the last iteration or rho=(r0,r) vanishes).
+        // If the batch broke down directly after a restart, it is frozen and reported instead.
+        template <typename _Real>
+        __global__ void BiCGSTABRestartKernel(dim3 virtual_size, _Real eps2, int iteration, const _Real* residualNorm2,
+            _Real* rho, _Real* rhoOld, _Real* alpha, _Real* omega, _Real* shadowNorm2,
+            int* breakdown, int* restart, int* restartedAt, int* convergedAt, int* brokenDown)
+        {
+            CUMAT_KERNEL_1D_LOOP(b, virtual_size)
+                const bool bd = convergedAt[b] < 0 && (breakdown[b] != 0 || abs(rho[b]) <= eps2 * shadowNorm2[b]);
+                breakdown[b] = 0;
+                restart[b] = 0;
+                if (!bd) continue;
+                if (restartedAt[b] == iteration - 1)
+                {
+                    convergedAt[b] = iteration;
+                    brokenDown[b] = 1;
+                    continue;
+                }
+                restart[b] = 1;
+                restartedAt[b] = iteration;
+                rho[b] = residualNorm2[b];
+                shadowNorm2[b] = residualNorm2[b];
+                rhoOld[b] = _Real(1);
+                alpha[b] = _Real(1);
+                omega[b] = _Real(1);
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        // r0 = r, p = v = 0 for the restarted batches
+        template <typename _Vector, typename _Real>
+        __global__ void BiCGSTABRestartVectorsKernel(dim3 virtual_size, const int* restart, const _Vector* r, _Vector* r0, _Vector* p, _Vector* v)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                if (restart[batch] == 0) continue;
+                const Index idx = i + batch * virtual_size.x;
+                const _Vector zero = functor::CastFunctor<_Real, _Vector>::cast(_Real(0));
+                r0[idx] = r[idx];
+                p[idx] = zero;
+                v[idx] = zero;
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+}
+
+/**
+ * \brief Bi-conjugate gradient stabilized solver (BiCGSTAB) for general square, possibly nonsymmetric matrices.
+ *
+ * This class allows to solve for A*x=b linear problems using \code x = BiCGSTAB(A).solve(b) \endcode.
+ * The requirements on the matrix, the right hand side and the preconditioner are the same as for the ConjugateGradient.
+ *
+ * The batches are processed together, all scalars (rho, alpha, omega) stay on the device.
+ * A batch that has converged is frozen (its step sizes are set to zero) until all batches have converged.
+ * On a breakdown of a batch (a vanishing \f$ (\hat r_0, r) \f$, \f$ (\hat r_0, v) \f$ or \f$ (t, t) \f$), the batch is restarted
+ * with the current residual as the new shadow residual \f$ \hat r_0 \f$. If it breaks down again directly after the restart,
+ * the batch is frozen and reported in batchBreakdowns().
+ * The convergence is always evaluated on the device, see IterativeSolverBase::setConvergenceCheckInterval();
+ * an interval of 0 (the default) waits for the device in every iteration.
+ *
+ * The scalar type has to be real, or a blocked type whose dot product (\c functor::BinaryMathFunctor_cwiseDot) returns the real ElementType.
+ *
+ * \tparam _MatrixType any matrix expression with an operator* that takes a dense column vector as right hand side
+ * \tparam _Preconditioner the preconditioner object, default is DiagonalPreconditioner
+ */
+template<typename _MatrixType, typename _Preconditioner = DiagonalPreconditioner<_MatrixType>>
+class BiCGSTAB : public IterativeSolverBase<BiCGSTAB<_MatrixType, _Preconditioner>>
+{
+    CUMAT_STATIC_ASSERT(_MatrixType::Batches != Dynamic, "BiCGSTAB can only work on matrices with compile-time batch count");
+
+public:
+    using Type = BiCGSTAB<_MatrixType, _Preconditioner>;
+    using Base = IterativeSolverBase<Type>;
+    using typename Base::MatrixType;
+    using typename Base::Preconditioner;
+    using typename Base::Scalar;
+    using typename Base::RealScalar;
+    using Base::maxIterations;
+
+private:
+    using Base::matrix_;
+    using Base::preconditioner_;
+    using Base::tolerance_;
+    using Base::iterations_;
+    using Base::batchIterations_;
+    using Base::error_;
+    using Base::convergenceCheckInterval_;
+    mutable std::vector<bool> batchBreakdowns_;
+
+public:
+
+    BiCGSTAB() = default;
+
+    /**
+     * \brief Initializes the BiCGSTAB with the specified matrix.
+     * The preconditioner is created with \code Preconditioner(matrix) \endcode.
+     * \param matrix the matrix that is used in the BiCGSTAB.
+     */
+    BiCGSTAB(const MatrixBase<_MatrixType>& matrix)
+        : Base(matrix)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /**
+     * \brief Initializes the BiCGSTAB with the specified matrix
+     * and specified preconditioner.
+     * \param matrix the matrix that is used in the BiCGSTAB.
+     * \param preconditioner the preconditioner that is used
+     */
+    BiCGSTAB(const MatrixBase<_MatrixType>& matrix, const _Preconditioner& preconditioner)
+        : Base(matrix, preconditioner)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /**
+     * \returns per batch, true if the last solve stopped that batch because it broke down even after a restart.
+     * The batch keeps the solution of the breakdown, batchIterations() contains the iteration of the breakdown
+     * and error() includes its residual.
+     */
+    const std::vector<bool>& batchBreakdowns() const
+    {
+        return batchBreakdowns_;
+    }
+
+    template<typename _RHS, typename _Target>
+    void _solve_impl(const MatrixBase<_RHS>& rhs, MatrixBase<_Target>& target) const
+    {
+        typedef Matrix<typename _Target::Scalar, Dynamic, 1, _Target::Batches, _Target::Flags> GuessType;
+        GuessType guess(target.rows(), 1, target.batches());
+        guess.setZero();
+        _solve_with_guess_impl(rhs.derived(), target.derived(), guess);
+    }
+
+    template<typename _RHS, typename _Target, typename _Guess>
+    void _solve_with_guess_impl(_RHS& rhs, _Target& target, _Guess& guess) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(BiCGSTAB)
+        CUMAT_STATIC_ASSERT(_Target::Batches != Dynamic, "The target matrix must have a compile-time batch count");
+        CUMAT_STATIC_ASSERT(_Target::Columns == 1, "The target must be a compile-time column vector");
+        CUMAT_STATIC_ASSERT(_Guess::Batches != Dynamic, "The initial guess must have a compile-time batch count");
+        CUMAT_STATIC_ASSERT(_Guess::Columns == 1, "The initial guess must be a compile-time column vector");
+        CUMAT_ASSERT(matrix_.cols() == rhs.rows());
+        constexpr int Batches = _Target::Batches;
+        typedef typename _Target::Scalar VectorScalarType;
+        CUMAT_STATIC_ASSERT((std::is_same<typename functor::BinaryMathFunctor_cwiseDot<VectorScalarType>::ReturnType, RealScalar>::value),
+            "BiCGSTAB only supports real scalar types");
+
+        //initialize result and counter
+        iterations_ = 0;
+        batchIterations_.assign(Batches, 0);
+        batchBreakdowns_.assign(Batches, false);
+        error_ = 0;
+        target.inplace() = guess;
+
+        typedef Matrix<RealScalar, 1, 1, Batches, 0> RealScalarDevice;
+        typedef Matrix<int, 1, 1, Batches, 0> IntDevice;
+        typedef Matrix<VectorScalarType, Dynamic, 1, Batches, _Target::Flags> VectorType;
+        using std::sqrt;
+        const Index n = matrix_.cols();
+
+        VectorType r = rhs - matrix_ * target; //initial residual
+        std::valarray<RealScalar> rhsNorm2(Batches);
+        rhs.squaredNorm().eval().copyToHost(&rhsNorm2[0]);
+        bool all = true;
+        for (int b = 0; b < Batches; ++b) all = all && (rhsNorm2[b] < tolerance_ * tolerance_);
+        if (all)
+        {
+            //early out, right-hand side is zero
+            target.setZero();
+            return;
+        }
+        std::valarray<RealScalar> threshold = tolerance_ * tolerance_ * rhsNorm2;
+        std::valarray<RealScalar> residualNorm2(Batches);
+        r.squaredNorm().eval().copyToHost(&residualNorm2[0]);
+        all = true;
+        for (int b = 0; b < Batches; ++b) all = all && residualNorm2[b] < threshold[b];
+        if (all)
+        {
+            //early out, already close enough to the solution
+            error_ = sqrt((residualNorm2 / rhsNorm2).max());
+            return;
+        }
+
+#if CUMAT_NVCC == 1
+        //----------------
+        // BiCGSTAB ALGORITHM, ported from Eigen
+        //----------------
+        const Index maxIter = maxIterations();
+        const internal::ConvergenceCheckSchedule schedule(std::max(Index(1), convergenceCheckInterval_), maxIter);
+        RealScalarDevice thresholdDevice(1, 1, Batches);
+        thresholdDevice.copyFromHost(&threshold[0]);
+        IntDevice convergedAt = IntDevice::Constant(1, 1, Batches, -1); //per batch: iteration of convergence or -1
+        internal::MappedConvergenceStatus status;
+
+        VectorType r0 = r.deepClone(); // the shadow residual
+        VectorType v(n, 1, Batches), p(n, 1, Batches), y(n, 1, Batches), z(n, 1, Batches);
+        VectorType s(n, 1, Batches), t(n, 1, Batches);
+        v.setZero();
+        p.setZero();
+        RealScalarDevice rho = RealScalarDevice::Constant(1, 1, Batches, RealScalar(1));
+        RealScalarDevice alpha = RealScalarDevice::Constant(1, 1, Batches, RealScalar(1));
+        RealScalarDevice omega = RealScalarDevice::Constant(1, 1, Batches, RealScalar(1));
+        RealScalarDevice beta1(1, 1, Batches), beta2(1, 1, Batches), rn2(1, 1, Batches);
+        rn2.copyFromHost(&residualNorm2[0]);
+
+        //breakdown handling
+        const RealScalar eps2 = internal::NumTraits<RealScalar>::epsilon() * internal::NumTraits<RealScalar>::epsilon();
+        RealScalarDevice shadowNorm2 = rn2.deepClone(); // |r0|^2
+        IntDevice breakdown = IntDevice::Constant(1, 1, Batches, 0);
+        IntDevice restart(1, 1, Batches);
+        IntDevice restartedAt = IntDevice::Constant(1, 1, Batches, -2);
+        IntDevice brokenDown = IntDevice::Constant(1, 1, Batches, 0);
+        Context& ctx = Context::current();
+        KernelLaunchConfig cfgBatch = ctx.createLaunchConfig1D(Batches, internal::kernels::BiCGSTABRestartKernel<RealScalar>);
+        KernelLaunchConfig cfgVec = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), Batches,
+            internal::kernels::BiCGSTABRestartVectorsKernel<VectorScalarType, RealScalar>);
+
+        Index i = 0;
+        bool converged = false;
+        for (; i < maxIter; ++i)
+        {
+            RealScalarDevice rhoOld = rho;
+            rho = r0.dot(r);
+            internal::kernels::BiCGSTABRestartKernel<RealScalar>
+                <<<cfgBatch.block_count, cfgBatch.thread_per_block, 0, ctx.stream()>>>(
+                    cfgBatch.virtual_size, eps2, static_cast<int>(i), rn2.data(), rho.data(), rhoOld.data(), alpha.data(), omega.data(),
+                    shadowNorm2.data(), breakdown.data(), restart.data(), restartedAt.data(), convergedAt.data(), brokenDown.data());
+            CUMAT_CHECK_ERROR();
+            internal::kernels::BiCGSTABRestartVectorsKernel<VectorScalarType, RealScalar>
+                <<<cfgVec.block_count, cfgVec.thread_per_block, 0, ctx.stream()>>>(
+                    cfgVec.virtual_size, restart.data(), r.data(), r0.data(), p.data(), v.data());
+            CUMAT_CHECK_ERROR();
+            internal::maskedDivision(rho, rhoOld, convergedAt, beta1);
+            internal::maskedDivision(alpha, omega, convergedAt, beta2);
+            RealScalarDevice beta = beta1.cwiseMul(beta2);
+            p.inplace() = r + beta.template cast<VectorScalarType>().cwiseMul(p - omega.template cast<VectorScalarType>().cwiseMul(v));
+
+            y.inplace() = preconditioner_.solve(p);
+            v.inplace() = matrix_ * y;
+            RealScalarDevice r0v = r0.dot(v);
+            internal::maskedDivision(rho, r0v, convergedAt, alpha);
+            internal::kernels::BiCGSTABBreakdownKernel<RealScalar>
+                <<<cfgBatch.block_count, cfgBatch.thread_per_block, 0, ctx.stream()>>>(
+                    cfgBatch.virtual_size, r0v.data(), convergedAt.data(), breakdown.data());
+            CUMAT_CHECK_ERROR();
+            s.inplace() = r - alpha.template cast<VectorScalarType>().cwiseMul(v);
+
+            z.inplace() = preconditioner_.solve(s);
+            t.inplace() = matrix_ * z;
+            RealScalarDevice ts = t.dot(s);
+            RealScalarDevice tt = t.squaredNorm();
+            internal::maskedDivision(ts, tt, convergedAt, omega);
+            internal::kernels::BiCGSTABBreakdownKernel<RealScalar>
+                <<<cfgBatch.block_count, cfgBatch.thread_per_block, 0, ctx.stream()>>>(
+                    cfgBatch.virtual_size, tt.data(), convergedAt.data(), breakdown.data());
+            CUMAT_CHECK_ERROR();
+
+            target += alpha.template cast<VectorScalarType>().cwiseMul(y) + omega.template cast<VectorScalarType>().cwiseMul(z);
+            r.inplace() = s - omega.template cast<VectorScalarType>().cwiseMul(t);
+
+            rn2 = r.squaredNorm();
+            internal::checkConvergence(rn2, thresholdDevice, convergedAt, status, i);
+            if (schedule.isCheckIteration(i) && status.wait())
+            {
+                converged = true;
+                break;
+            }
+        }
+
+        r.squaredNorm().eval().copyToHost(&residualNorm2[0]);
+        error_ = sqrt((residualNorm2 / rhsNorm2).max());
+        iterations_ = converged ? status.iteration() : maxIter;
+        internal::copyBatchIterations(convergedAt, maxIter, batchIterations_);
+        std::vector<int> brokenDownHost(Batches);
+        brokenDown.copyToHost(brokenDownHost.data());
+        for (int b = 0; b < Batches; ++b) batchBreakdowns_[b] = brokenDownHost[b] != 0;
+#endif
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
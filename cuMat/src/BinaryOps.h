@@ -164,6 +164,19 @@ public:
     {
         return functor_(getLeft(row, col, batch, linear), getRight(row, col, batch, linear), row, col, batch);
     }
+
+    const left_wrapped_t& getLeftMatrix() const
+    {
+        return left_;
+    }
+    const right_wrapped_t& getRightMatrix() const
+    {
+        return right_;
+    }
+    const _BinaryFunctor& getFunctor() const
+    {
+        return functor_;
+    }
 };
 
 
@@ -0,0 +1,406 @@
+#ifndef __CUMAT_BLOCK_CONJUGATE_GRADIENT_H__
+#define __CUMAT_BLOCK_CONJUGATE_GRADIENT_H__
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <valarray>
+#include <vector>
+
+#include "Matrix.h"
+#include "UnaryOps.h"
+#include "BinaryOps.h"
+#include "ReductionOps.h"
+#include "ProductOp.h"
+#include "IterativeSolverBase.h"
+#include "ConjugateGradient.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    template<typename _MatrixType, typename _Preconditioner>
+    struct traits<BlockConjugateGradient<_MatrixType, _Preconditioner> >
+    {
+        using Scalar = typename internal::traits<_MatrixType>::Scalar;
+        using MatrixType = _MatrixType;
+        using Preconditioner = _Preconditioner;
+    };
+
+    //Host routines for the small k x k matrices of the block CG, all matrices are stored column-major in std::vector
+
+    /**
+     * \brief Eigen decomposition of a small symmetric matrix with the cyclic Jacobi method.
+     * \param k the size of the matrix
+     * \param A the column-major k x k matrix, destroyed on output
+     * \param values the eigenvalues, sorted in decreasing order
+     * \param vectors the column-major k x k matrix of the eigenvectors, in the order of the eigenvalues
+     */
+    template<typename _Real>
+    void symmetricEigenDecomposition(int k, std::vector<_Real>& A, std::vector<_Real>& values, std::vector<_Real>& vectors)
+    {
+        using std::abs;
+        using std::sqrt;
+        std::vector<_Real> V(k * k, _Real(0));
+        for (int i = 0; i < k; ++i) V[i + k * i] = _Real(1);
+        for (int sweep = 0; sweep < 50; ++sweep)
+        {
+            _Real off = 0, diag = 0;
+            for (int j = 0; j < k; ++j) for (int i = 0; i < k; ++i)
+                (i == j ? diag : off) += A[i + k * j] * A[i + k * j];
+            if (off <= std::numeric_limits<_Real>::epsilon() * std::numeric_limits<_Real>::epsilon() * diag) break;
+            for (int p = 0; p < k - 1; ++p) for (int q = p + 1; q < k; ++q)
+            {
+                const _Real apq = A[p + k * q];
+                if (apq == _Real(0)) continue;
+                const _Real theta = (A[q + k * q] - A[p + k * p]) / (2 * apq);
+                const _Real t = (theta >= 0 ? _Real(1) : _Real(-1)) / (abs(theta) + sqrt(theta * theta + 1));
+                const _Real c = 1 / sqrt(t * t + 1), s = t * c;
+                for (int i = 0; i < k; ++i) //A = A J
+                {
+                    const _Real aip = A[i + k * p], aiq = A[i + k * q];
+                    A[i + k * p] = c * aip - s * aiq;
+                    A[i + k * q] = s * aip + c * aiq;
+                }
+                for (int j = 0; j < k; ++j) //A = J^T A
+                {
+                    const _Real apj = A[p + k * j], aqj = A[q + k * j];
+                    A[p + k * j] = c * apj - s * aqj;
+                    A[q + k * j] = s * apj + c * aqj;
+                }
+                for (int i = 0; i < k; ++i) //V = V J
+                {
+                    const _Real vip = V[i + k * p], viq = V[i + k * q];
+                    V[i + k * p] = c * vip - s * viq;
+                    V[i + k * q] = s * vip + c * viq;
+                }
+            }
+        }
+        std::vector<int> order(k);
+        for (int i = 0; i < k; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&A, k](int a, int b) {return A[a + k * a] > A[b + k * b]; });
+        values.resize(k);
+        vectors.resize(k * k);
+        for (int j = 0; j < k; ++j)
+        {
+            values[j] = A[order[j] + k * order[j]];
+            for (int i = 0; i < k; ++i) vectors[i + k * j] = V[i + k * order[j]];
+        }
+    }
+
+    /**
+     * \brief Computes the transformation T so that the columns of W*T are orthonormal and span the range of W.
+     * The columns of W are scaled to unit length first, then directions with a relative singular value
+     * below \c tolerance are dropped (deflated). The first \c rank columns of T are filled, the remaining columns are zero.
+     * \param k the number of columns of W
+     * \param gram the column-major k x k Gram matrix W^T W
+     * \param tolerance the relative singular value below which a direction is dropped
+     * \param T the column-major k x k transformation matrix
+     * \return the rank of W
+     */
+    template<typename _Real>
+    int blockOrthonormalization(int k, const std::vector<_Real>& gram, _Real tolerance, std::vector<_Real>& T)
+    {
+        using std::sqrt;
+        std::vector<_Real> scale(k), A(k * k), values, vectors;
+        for (int i = 0; i < k; ++i) scale[i] = gram[i + k * i] > 0 ? 1 / sqrt(gram[i + k * i]) : _Real(0);
+        for (int j = 0; j < k; ++j) for (int i = 0; i < k; ++i)
+            A[i + k * j] = scale[i] * gram[i + k * j] * scale[j];
+        symmetricEigenDecomposition(k, A, values, vectors);
+        T.assign(k * k, _Real(0));
+        int rank = 0;
+        while (rank < k && values[rank] > 0 && values[rank] > tolerance * tolerance * values[0])
+        {
+            const _Real s = 1 / sqrt(values[rank]);
+            for (int i = 0; i < k; ++i)
+                T[i + k * rank] = scale[i] * vectors[i + k * rank] * s;
+            ++rank;
+        }
+        return rank;
+    }
+
+    /**
+     * \brief Solves S X = B in-place for the symmetric positive definite leading r x r block of S with a Cholesky factorization.
+     * \param k the leading dimension of S and B
+     * \param r the size of the system
+     * \param S the column-major k x k matrix, destroyed on output
+     * \param B the column-major k x k right hand sides, the first r rows of every column are replaced by the solution.
+     */
+    template<typename _Real>
+    void smallCholeskySolve(int k, int r, std::vector<_Real>& S, std::vector<_Real>& B)
+    {
+        using std::sqrt;
+        for (int j = 0; j < r; ++j)
+        {
+            _Real d = S[j + k * j];
+            for (int l = 0; l < j; ++l) d -= S[j + k * l] * S[j + k * l];
+            d = sqrt(std::max(d, std::numeric_limits<_Real>::min()));
+            S[j + k * j] = d;
+            for (int i = j + 1; i < r; ++i)
+            {
+                _Real v = S[i + k * j];
+                for (int l = 0; l < j; ++l) v -= S[i + k * l] * S[j + k * l];
+                S[i + k * j] = v / d;
+            }
+        }
+        for (int c = 0; c < k; ++c)
+        {
+            _Real* b = &B[k * c];
+            for (int i = 0; i < r; ++i)
+            {
+                for (int l = 0; l < i; ++l) b[i] -= S[i + k * l] * b[l];
+                b[i] /= S[i + k * i];
+            }
+            for (int i = r - 1; i >= 0; --i)
+            {
+                for (int l = i + 1; l < r; ++l) b[i] -= S[l + k * i] * b[l];
+                b[i] /= S[i + k * i];
+            }
+        }
+    }
+}
+
+/**
+ * \brief Block conjugate gradient solver for many right hand sides of the same matrix.
+ *
+ * The k right hand sides are treated as one dense n x k block B with a compile-time number of columns k.
+ * Instead of k independent Krylov spaces, one block Krylov space is built: every iteration performs
+ * one matrix - multi-vector product <tt>A*P</tt> (for a CSR SparseMatrix, the matrix is read once for all k columns)
+ * and solves small k x k systems for the step matrices on the host.
+ * The search directions are combined from all right hand sides, hence the block CG typically needs fewer iterations
+ * than the single-vector CG for the slowest of the right hand sides.
+ *
+ * The algorithm is the breakdown-free variant of O'Leary's block CG (Ji and Li, 2017):
+ * \code
+ * R = B - A X, Z = M^-1 R, P = orth(Z)
+ * loop:
+ *   Q = A P
+ *   alpha = (P^T Q)^-1 (P^T R)
+ *   X += P alpha, R -= Q alpha
+ *   Z = M^-1 R
+ *   beta = -(P^T Q)^-1 (Q^T Z)
+ *   P = orth(Z + P beta)
+ * \endcode
+ * \c orth normalizes the columns, orthonormalizes them and drops (deflates) linearly dependent directions,
+ * as they appear if right hand sides are linearly dependent. Because of the normalization, a column that has
+ * converged is not dropped: its small residual is scaled up and it keeps its search direction.
+ * The threshold is set with \ref setDeflationTolerance().
+ * If all directions are dropped before convergence, the solver stops early, error() reports the current residual.
+ *
+ * The right hand side has to be a matrix with a compile-time number of columns and a single batch,
+ * e.g. <tt>Matrix<double, Dynamic, 8, 1, ColumnMajor></tt>. The matrix type needs a product with such a block,
+ * the preconditioner has to accept it in \c solve(), as the DiagonalPreconditioner and IdentityPreconditioner do.
+ * Only real scalar types are supported.
+ *
+ * The per-column iteration counts, i.e. the iteration in which the relative residual of each right hand side
+ * dropped below the tolerance, are reported by \ref batchIterations().
+ *
+ * \tparam _MatrixType the type of the matrix, must have a single batch
+ * \tparam _Preconditioner the preconditioner object, default is DiagonalPreconditioner
+ */
+template<typename _MatrixType, typename _Preconditioner = DiagonalPreconditioner<_MatrixType>>
+class BlockConjugateGradient : public IterativeSolverBase<BlockConjugateGradient<_MatrixType, _Preconditioner>>
+{
+    CUMAT_STATIC_ASSERT(_MatrixType::Batches == 1, "The block Conjugate Gradient only supports matrices with a single batch, the right hand sides are stored as columns");
+
+public:
+    using Type = BlockConjugateGradient<_MatrixType, _Preconditioner>;
+    using Base = IterativeSolverBase<Type>;
+    using typename Base::MatrixType;
+    using typename Base::Preconditioner;
+    using typename Base::Scalar;
+    using typename Base::RealScalar;
+    using Base::maxIterations;
+    CUMAT_STATIC_ASSERT(!internal::NumTraits<Scalar>::IsComplex, "The block Conjugate Gradient only supports real scalar types");
+
+private:
+    using Base::matrix_;
+    using Base::preconditioner_;
+    using Base::tolerance_;
+    using Base::iterations_;
+    using Base::batchIterations_;
+    using Base::error_;
+    RealScalar deflationTolerance_ = 10 * std::sqrt(std::numeric_limits<RealScalar>::epsilon());
+    mutable Index rank_ = 0;
+
+public:
+
+    BlockConjugateGradient() = default;
+
+    /**
+     * \brief Initializes the block Conjugate Gradient with the specified matrix.
+     * The preconditioner is created with \code Preconditioner(matrix) \endcode.
+     * \param matrix the matrix that is used in the CG.
+     */
+    BlockConjugateGradient(const MatrixBase<_MatrixType>& matrix)
+        : Base(matrix)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /**
+     * \brief Initializes the block Conjugate Gradient with the specified matrix
+     * and specified preconditioner.
+     * \param matrix the matrix that is used in the CG.
+     * \param preconditioner the preconditioner that is used
+     */
+    BlockConjugateGradient(const MatrixBase<_MatrixType>& matrix, const _Preconditioner& preconditioner)
+        : Base(matrix, preconditioner)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /** \returns the relative singular value below which search directions are dropped, see setDeflationTolerance() */
+    RealScalar deflationTolerance() const { return deflationTolerance_; }
+
+    /** Sets the threshold for the deflation of the search directions.
+     * The columns of the new block of search directions are normalized, then directions with a singular value
+     * below <tt>tolerance * (largest singular value)</tt> are dropped.
+     * The default is <tt>10*sqrt(epsilon)</tt>.
+     */
+    Type& setDeflationTolerance(const RealScalar& tolerance)
+    {
+        CUMAT_ASSERT_ARGUMENT(tolerance >= 0);
+        deflationTolerance_ = tolerance;
+        return *this;
+    }
+
+    /** \returns the number of search directions (the rank of the block after deflation) in the last iteration of the last solve */
+    Index rank() const { return rank_; }
+
+    template<typename _RHS, typename _Target>
+    void _solve_impl(const MatrixBase<_RHS>& rhs, MatrixBase<_Target>& target) const
+    {
+        typedef Matrix<typename _Target::Scalar, Dynamic, _Target::Columns, 1, ColumnMajor> GuessType;
+        GuessType guess(target.rows(), target.cols());
+        guess.setZero();
+        _solve_with_guess_impl(rhs.derived(), target.derived(), guess);
+    }
+
+    template<typename _RHS, typename _Target, typename _Guess>
+    void _solve_with_guess_impl(_RHS& rhs, _Target& target, _Guess& guess) const
+    {
+        CUMAT_STATIC_ASSERT(_Target::Columns != Dynamic, "The target matrix must have a compile-time number of columns");
+        CUMAT_STATIC_ASSERT(_Target::Batches == 1, "The target matrix must have a single batch, the right hand sides are stored as columns");
+        CUMAT_STATIC_ASSERT(_Guess::Columns == _Target::Columns, "The initial guess must have the same number of columns as the target");
+        CUMAT_ASSERT(matrix_.cols() == rhs.rows());
+        constexpr int K = _Target::Columns;
+        typedef Matrix<Scalar, Dynamic, K, 1, ColumnMajor> BlockType;
+        typedef Matrix<Scalar, K, K, 1, ColumnMajor> SmallMatrix;
+        using std::sqrt;
+        const Index n = matrix_.cols();
+
+        //initialize result and counter
+        iterations_ = 0;
+        batchIterations_.assign(K, 0);
+        error_ = 0;
+        rank_ = 0;
+        target.inplace() = guess;
+
+        std::valarray<RealScalar> rhsNorm2(K), residualNorm2(K);
+        rhs.cwiseAbs2().template sum<Axis::Row>().eval().copyToHost(&rhsNorm2[0]);
+        const std::valarray<RealScalar> threshold = tolerance_ * tolerance_ * rhsNorm2;
+        BlockType residual = rhs - matrix_ * target;
+        residual.cwiseAbs2().template sum<Axis::Row>().eval().copyToHost(&residualNorm2[0]);
+        bool all = true;
+        for (int c = 0; c < K; ++c) all = all && residualNorm2[c] <= threshold[c];
+        if (all)
+        {
+            //early out, already close enough to the solution
+            error_ = blockError(residualNorm2, rhsNorm2);
+            return;
+        }
+
+        BlockType z(n, K), p(n, K), q(n, K);
+        SmallMatrix smallDevice, transformDevice, stepDevice;
+        std::vector<RealScalar> gram(K * K), transform, pq(K * K), pqFactor, step(K * K);
+
+        //initial search directions
+        z.inplace() = preconditioner_.solve(residual);
+        smallDevice.inplace() = z.transpose() * z;
+        smallDevice.copyToHost(gram.data());
+        rank_ = internal::blockOrthonormalization<RealScalar>(K, gram, deflationTolerance_, transform);
+        if (rank_ == 0)
+        {
+            //no search direction left, the preconditioned residual vanishes
+            error_ = blockError(residualNorm2, rhsNorm2);
+            return;
+        }
+        transformDevice.copyFromHost(transform.data());
+        p.inplace() = z * transformDevice;
+
+        Index i = 0;
+        const Index maxIter = maxIterations();
+        std::fill(batchIterations_.begin(), batchIterations_.end(), maxIter);
+        while (i < maxIter)
+        {
+            q.inplace() = matrix_ * p; // the bottleneck of the algorithm, one SpMM for all right hand sides
+
+            // alpha = (P^T Q)^-1 (P^T R)
+            smallDevice.inplace() = p.transpose() * q;
+            smallDevice.copyToHost(pq.data());
+            smallDevice.inplace() = p.transpose() * residual;
+            smallDevice.copyToHost(step.data());
+            pqFactor = pq;
+            internal::smallCholeskySolve<RealScalar>(K, static_cast<int>(rank_), pqFactor, step);
+            for (int c = 0; c < K; ++c) for (int r = static_cast<int>(rank_); r < K; ++r) step[r + K * c] = 0;
+            stepDevice.copyFromHost(step.data());
+            target += p * stepDevice; // update solution
+            for (auto& s : step) s = -s;
+            stepDevice.copyFromHost(step.data());
+            residual += q * stepDevice; // update residual
+
+            residual.cwiseAbs2().template sum<Axis::Row>().eval().copyToHost(&residualNorm2[0]);
+            all = true;
+            for (int c = 0; c < K; ++c)
+            {
+                if (residualNorm2[c] <= threshold[c])
+                    batchIterations_[c] = std::min(batchIterations_[c], i);
+                else
+                    all = false;
+            }
+            if (all)
+                break;
+
+            z.inplace() = preconditioner_.solve(residual); // approximately solve for "A Z = R"
+
+            // beta = -(P^T Q)^-1 (Q^T Z), the new directions are A-orthogonal to the old ones
+            smallDevice.inplace() = q.transpose() * z;
+            smallDevice.copyToHost(step.data());
+            pqFactor = pq;
+            internal::smallCholeskySolve<RealScalar>(K, static_cast<int>(rank_), pqFactor, step);
+            for (int c = 0; c < K; ++c) for (int r = 0; r < K; ++r)
+                step[r + K * c] = r < rank_ ? -step[r + K * c] : RealScalar(0);
+            stepDevice.copyFromHost(step.data());
+            z += p * stepDevice;
+
+            // orthonormalize and deflate the new search directions
+            smallDevice.inplace() = z.transpose() * z;
+            smallDevice.copyToHost(gram.data());
+            rank_ = internal::blockOrthonormalization<RealScalar>(K, gram, deflationTolerance_, transform);
+            if (rank_ == 0)
+                break; // all directions deflated, the solver can't make progress
+            transformDevice.copyFromHost(transform.data());
+            p.inplace() = z * transformDevice;
+            i++;
+        }
+        error_ = blockError(residualNorm2, rhsNorm2);
+        iterations_ = i;
+    }
+
+private:
+    static RealScalar blockError(const std::valarray<RealScalar>& residualNorm2, const std::valarray<RealScalar>& rhsNorm2)
+    {
+        using std::sqrt;
+        RealScalar error = 0;
+        for (size_t c = 0; c < rhsNorm2.size(); ++c)
+            if (rhsNorm2[c] > 0) error = std::max(error, sqrt(residualNorm2[c] / rhsNorm2[c]));
+        return error;
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
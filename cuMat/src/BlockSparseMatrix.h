@@ -0,0 +1,414 @@
+#ifndef __CUMAT_BLOCK_SPARSE_MATRIX_H__
+#define __CUMAT_BLOCK_SPARSE_MATRIX_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "SparseMatrixBase.h"
+#include "MatrixFreeOperator.h"
+#include "HostCsrMatrix.h"
+
+#include <vector>
+#include <algorithm>
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    template<typename _Scalar, int _BlockRows, int _BlockCols, int _Batches>
+    struct traits<BlockSparseMatrix<_Scalar, _BlockRows, _BlockCols, _Batches> >
+    {
+        typedef _Scalar Scalar;
+        enum
+        {
+            Flags = ColumnMajor,
+            RowsAtCompileTime = Dynamic,
+            ColsAtCompileTime = Dynamic,
+            BatchesAtCompileTime = _Batches,
+            AccessFlags = 0
+        };
+        typedef MatrixFreeSrcTag SrcTag;
+        typedef DeletedDstTag DstTag;
+    };
+
+    /**
+     * \brief A block sparse row (BSR) matrix in host memory, used to build the BlockSparseMatrix.
+     * \c JA and \c IA form a CSR pattern over the blocks, the blocks are stored row-major one after another in \c values.
+     */
+    template<typename _Scalar>
+    struct HostBsrMatrix
+    {
+        Index blockRows = 0;
+        Index blockCols = 0;
+        std::vector<int> JA;
+        std::vector<int> IA;
+        std::vector<_Scalar> values;
+
+        /**
+         * \brief Groups the entries of a scalar CSR matrix into blocks of size BR x BC.
+         * A block is stored if any of its entries is stored, the other entries of the block are zero.
+         * The column indices of the blocks are sorted.
+         * \param A the scalar matrix, the number of rows and columns must be multiples of the block size
+         * \param BR the number of rows per block
+         * \param BC the number of columns per block
+         */
+        static HostBsrMatrix fromCsr(const HostCsrMatrix<_Scalar>& A, int BR, int BC)
+        {
+            CUMAT_ASSERT_ARGUMENT(A.rows % BR == 0);
+            CUMAT_ASSERT_ARGUMENT(A.cols % BC == 0);
+            HostBsrMatrix m;
+            m.blockRows = A.rows / BR;
+            m.blockCols = A.cols / BC;
+            m.JA.assign(m.blockRows + 1, 0);
+            std::vector<int> blockOf(m.blockCols, -1);
+            for (Index bi = 0; bi < m.blockRows; ++bi)
+            {
+                //the blocks of this block row, in order of the columns
+                std::vector<int> columns;
+                for (Index r = bi * BR; r < (bi + 1) * BR; ++r)
+                    for (int k = A.JA[r]; k < A.JA[r + 1]; ++k)
+                        columns.push_back(A.IA[k] / BC);
+                std::sort(columns.begin(), columns.end());
+                columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+                const int first = static_cast<int>(m.IA.size());
+                for (size_t j = 0; j < columns.size(); ++j)
+                {
+                    blockOf[columns[j]] = first + static_cast<int>(j);
+                    m.IA.push_back(columns[j]);
+                }
+                m.values.resize(m.IA.size() * BR * BC, _Scalar(0));
+                for (Index r = bi * BR; r < (bi + 1) * BR; ++r)
+                    for (int k = A.JA[r]; k < A.JA[r + 1]; ++k)
+                    {
+                        const int block = blockOf[A.IA[k] / BC];
+                        m.values[block * BR * BC + (r - bi * BR) * BC + A.IA[k] % BC] = A.values[k];
+                    }
+                m.JA[bi + 1] = static_cast<int>(m.IA.size());
+            }
+            return m;
+        }
+    };
+
+#if CUMAT_NVCC==1
+    namespace kernels
+    {
+        //y = A*x, one thread per block row and batch. The products of the blocks are unrolled and kept in registers.
+        template<typename _Scalar, int BR, int BC>
+        __global__ void BsrMVKernel(dim3 virtual_size, const int* JA, const int* IA, const _Scalar* A, Index nnzBlocks,
+            const _Scalar* x, Index xBatchStride, Index cols, _Scalar* y)
+        {
+            CUMAT_KERNEL_2D_LOOP(row, batch, virtual_size)
+                const _Scalar* Ab = A + batch * nnzBlocks * BR * BC;
+                const _Scalar* xb = x + batch * xBatchStride;
+                _Scalar acc[BR];
+#pragma unroll
+                for (int r = 0; r < BR; ++r) acc[r] = _Scalar(0);
+                for (int k = JA[row]; k < JA[row + 1]; ++k)
+                {
+                    const _Scalar* block = Ab + k * BR * BC;
+                    const Index col = IA[k] * BC;
+                    _Scalar xv[BC];
+#pragma unroll
+                    for (int c = 0; c < BC; ++c) xv[c] = xb[col + c];
+#pragma unroll
+                    for (int r = 0; r < BR; ++r)
+#pragma unroll
+                        for (int c = 0; c < BC; ++c)
+                            acc[r] += block[r * BC + c] * xv[c];
+                }
+                _Scalar* yb = y + batch * virtual_size.x * BR;
+#pragma unroll
+                for (int r = 0; r < BR; ++r) yb[row * BR + r] = acc[r];
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        //Inverts the diagonal blocks with Gauss-Jordan elimination and partial pivoting, one thread per block row and batch.
+        //Missing or singular diagonal blocks are replaced by the identity.
+        template<typename _Scalar, int B>
+        __global__ void BsrInvertDiagonalKernel(dim3 virtual_size, const int* JA, const int* IA, const _Scalar* A, Index nnzBlocks, _Scalar* Dinv)
+        {
+            CUMAT_KERNEL_2D_LOOP(row, batch, virtual_size)
+                _Scalar m[B][B], inv[B][B];
+                int diag = -1;
+                for (int k = JA[row]; k < JA[row + 1]; ++k)
+                    if (IA[k] == row) diag = k;
+#pragma unroll
+                for (int r = 0; r < B; ++r)
+#pragma unroll
+                    for (int c = 0; c < B; ++c)
+                    {
+                        m[r][c] = diag >= 0 ? A[batch * nnzBlocks * B * B + diag * B * B + r * B + c] : _Scalar(r == c ? 1 : 0);
+                        inv[r][c] = _Scalar(r == c ? 1 : 0);
+                    }
+                bool singular = false;
+                for (int c = 0; c < B; ++c)
+                {
+                    int pivot = c;
+                    for (int r = c + 1; r < B; ++r)
+                        if ((m[r][c] < 0 ? -m[r][c] : m[r][c]) > (m[pivot][c] < 0 ? -m[pivot][c] : m[pivot][c])) pivot = r;
+                    if (m[pivot][c] == _Scalar(0)) { singular = true; break; }
+                    for (int j = 0; j < B; ++j)
+                    {
+                        const _Scalar t1 = m[c][j]; m[c][j] = m[pivot][j]; m[pivot][j] = t1;
+                        const _Scalar t2 = inv[c][j]; inv[c][j] = inv[pivot][j]; inv[pivot][j] = t2;
+                    }
+                    const _Scalar s = _Scalar(1) / m[c][c];
+                    for (int j = 0; j < B; ++j) { m[c][j] *= s; inv[c][j] *= s; }
+                    for (int r = 0; r < B; ++r)
+                    {
+                        if (r == c) continue;
+                        const _Scalar f = m[r][c];
+                        for (int j = 0; j < B; ++j) { m[r][j] -= f * m[c][j]; inv[r][j] -= f * inv[c][j]; }
+                    }
+                }
+                _Scalar* out = Dinv + (batch * virtual_size.x + row) * B * B;
+                for (int r = 0; r < B; ++r)
+                    for (int c = 0; c < B; ++c)
+                        out[r * B + c] = singular ? _Scalar(r == c ? 1 : 0) : inv[r][c];
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        //z = Dinv * b, one thread per block row and batch
+        template<typename _Scalar, int B>
+        __global__ void BlockDiagonalApplyKernel(dim3 virtual_size, const _Scalar* Dinv, Index DinvBatchStride,
+            const _Scalar* b, _Scalar* z)
+        {
+            CUMAT_KERNEL_2D_LOOP(row, batch, virtual_size)
+                const _Scalar* D = Dinv + batch * DinvBatchStride + row * B * B;
+                const Index offset = (batch * virtual_size.x + row) * B;
+                _Scalar bv[B];
+#pragma unroll
+                for (int c = 0; c < B; ++c) bv[c] = b[offset + c];
+#pragma unroll
+                for (int r = 0; r < B; ++r)
+                {
+                    _Scalar acc = _Scalar(0);
+#pragma unroll
+                    for (int c = 0; c < B; ++c) acc += D[r * B + c] * bv[c];
+                    z[offset + r] = acc;
+                }
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+}
+
+/**
+ * \brief A block sparse row (BSR) matrix with dense blocks of compile-time size.
+ *
+ * The pattern is a CSR pattern over the blocks (\ref SparsityPattern<SparseFlags::CSR> with one row per block row
+ * and one column index per block), the blocks are dense and stored row-major one after another.
+ * Compared to a scalar CSR matrix, the product reads one column index per block instead of one per entry,
+ * and the small dense products of the blocks are unrolled and kept in registers.
+ * This is the natural storage of elasticity or multi-physics systems with several unknowns per node.
+ *
+ * The block size is a template parameter and can't be expressed by a \ref SparseFlags value, hence this is a separate class
+ * and not a storage format of SparseMatrix: it is a matrix-free operator (\ref MatrixFreeOperatorBase) that supports
+ * the matrix-vector product <tt>A * x</tt> with dense (batched) vectors and the iterative solvers,
+ * e.g. <tt>ConjugateGradient<BlockSparseMatrix<...>, BlockJacobiPreconditioner<BlockSparseMatrix<...>>></tt>.
+ * It is not supported in component-wise expressions.
+ *
+ * If the matrix is batched, every batch shares the same pattern.
+ * \tparam _Scalar the scalar type
+ * \tparam _BlockRows the number of rows per block
+ * \tparam _BlockCols the number of columns per block
+ * \tparam _Batches the number of batches, has to be known at compile time for the iterative solvers
+ */
+template<typename _Scalar, int _BlockRows, int _BlockCols, int _Batches>
+class BlockSparseMatrix : public MatrixFreeOperatorBase<BlockSparseMatrix<_Scalar, _BlockRows, _BlockCols, _Batches>>
+{
+    CUMAT_STATIC_ASSERT(_BlockRows > 0 && _BlockCols > 0, "The block size must be known at compile time");
+public:
+    typedef _Scalar Scalar;
+    enum
+    {
+        Flags = ColumnMajor,
+        Rows = Dynamic,
+        Columns = Dynamic,
+        Batches = _Batches,
+        BlockRows = _BlockRows,
+        BlockCols = _BlockCols,
+        BlockSize = _BlockRows * _BlockCols
+    };
+    typedef SparsityPattern<SparseFlags::CSR> BlockPattern;
+    /** \brief The blocks, <tt>BlockSize * nnzBlocks</tt> entries per batch */
+    typedef Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor> DataVector;
+
+private:
+    BlockPattern pattern_;
+    Index batches_;
+    DataVector data_;
+
+public:
+    BlockSparseMatrix()
+        : batches_(0)
+    {}
+
+    /**
+     * \brief Creates the matrix with the given pattern over the blocks, the blocks are allocated but uninitialized.
+     * \param blockPattern the CSR pattern of the blocks, \c rows and \c cols count the blocks
+     * \param batches the number of batches
+     */
+    BlockSparseMatrix(const BlockPattern& blockPattern, Index batches = _Batches)
+        : pattern_(blockPattern)
+        , batches_(batches)
+        , data_(blockPattern.nnz * BlockSize, 1, batches)
+    {
+        CUMAT_ASSERT_ARGUMENT(CUMAT_IMPLIES(_Batches != Dynamic, batches == _Batches));
+    }
+
+    /**
+     * \brief Creates the block matrix from a scalar CSR matrix on the host by grouping the entries into blocks,
+     * see \ref internal::HostBsrMatrix::fromCsr(). The matrix has one batch.
+     * \param A the scalar matrix, the number of rows and columns must be multiples of the block size
+     */
+    static BlockSparseMatrix fromHostCsr(const internal::HostCsrMatrix<_Scalar>& A)
+    {
+        const internal::HostBsrMatrix<_Scalar> h = internal::HostBsrMatrix<_Scalar>::fromCsr(A, _BlockRows, _BlockCols);
+        BlockPattern pattern;
+        pattern.rows = h.blockRows;
+        pattern.cols = h.blockCols;
+        pattern.nnz = static_cast<Index>(h.IA.size());
+        pattern.JA = BlockPattern::IndexVector(h.blockRows + 1);
+        pattern.JA.copyFromHost(h.JA.data());
+        pattern.IA = BlockPattern::IndexVector(pattern.nnz);
+        if (pattern.nnz > 0) pattern.IA.copyFromHost(h.IA.data());
+        BlockSparseMatrix m(pattern, 1);
+        if (pattern.nnz > 0) m.getData().copyFromHost(h.values.data());
+        return m;
+    }
+
+    __host__ __device__ CUMAT_STRONG_INLINE Index rows() const { return pattern_.rows * _BlockRows; }
+    __host__ __device__ CUMAT_STRONG_INLINE Index cols() const { return pattern_.cols * _BlockCols; }
+    __host__ __device__ CUMAT_STRONG_INLINE Index batches() const { return batches_; }
+
+    /**
+     * \return the pattern of the blocks
+     */
+    const BlockPattern& getBlockPattern() const { return pattern_; }
+    /**
+     * \return the number of stored blocks
+     */
+    Index nnzBlocks() const { return pattern_.nnz; }
+    /**
+     * \brief Direct access to the blocks, block k of batch b starts at <tt>(b*nnzBlocks() + k) * BlockSize</tt> and is row-major.
+     */
+    DataVector& getData() { return data_; }
+    const DataVector& getData() const { return data_; }
+
+    /**
+     * \brief Computes <tt>out = A * in</tt>.
+     * \param in the input vector of size cols() with one or \c out.batches() batches
+     * \param out the output vector of size rows()
+     */
+    template<typename _In, typename _Out>
+    void applyTo(const _In& in, _Out& out) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(BlockSparseMatrix)
+        CUMAT_STATIC_ASSERT((std::is_same<typename _In::Scalar, Scalar>::value), "The scalar type of the vector must match the matrix");
+        CUMAT_STATIC_ASSERT((std::is_same<typename _Out::Scalar, Scalar>::value), "The scalar type of the vector must match the matrix");
+        CUMAT_ASSERT(in.rows() == cols());
+        CUMAT_ASSERT(out.rows() == rows());
+        CUMAT_ASSERT(out.batches() == batches());
+        CUMAT_ASSERT(in.batches() == 1 || in.batches() == out.batches());
+#if CUMAT_NVCC == 1
+        if (pattern_.rows == 0) return;
+        Context& ctx = Context::current();
+        KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(pattern_.rows), static_cast<unsigned int>(out.batches()),
+            internal::kernels::BsrMVKernel<Scalar, _BlockRows, _BlockCols>);
+        internal::kernels::BsrMVKernel<Scalar, _BlockRows, _BlockCols>
+            <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(
+                cfg.virtual_size, pattern_.JA.data(), pattern_.IA.data(), data_.data(), pattern_.nnz,
+                in.data(), in.batches() == 1 ? 0 : cols(), cols(), out.data());
+        CUMAT_CHECK_ERROR();
+#endif
+    }
+};
+
+/**
+ * \brief Block-Jacobi preconditioner for square BlockSparseMatrix: the inverses of the diagonal blocks are computed once,
+ * each application is a small dense product per block row. This captures the coupling of the unknowns of one node,
+ * e.g. the displacement components in elasticity, which the scalar DiagonalPreconditioner neglects.
+ * Missing or singular diagonal blocks are replaced by the identity.
+ * \tparam _MatrixType the BlockSparseMatrix type with square blocks
+ */
+template<typename _MatrixType>
+class BlockJacobiPreconditioner
+{
+public:
+    typedef typename _MatrixType::Scalar Scalar;
+    enum
+    {
+        Block = _MatrixType::BlockRows,
+        Batches = _MatrixType::Batches
+    };
+    CUMAT_STATIC_ASSERT(int(_MatrixType::BlockRows) == int(_MatrixType::BlockCols), "Block-Jacobi requires square blocks");
+    typedef Matrix<Scalar, Dynamic, 1, Batches, ColumnMajor> Vector;
+
+private:
+    Index blockRows_;
+    /** \brief The inverted diagonal blocks, row-major, one after another */
+    Vector inverseBlocks_;
+
+public:
+    BlockJacobiPreconditioner()
+        : blockRows_(0)
+    {}
+
+    BlockJacobiPreconditioner(const MatrixBase<_MatrixType>& matrix)
+    {
+        const _MatrixType& A = matrix.derived();
+        CUMAT_ASSERT_DIMENSION(A.getBlockPattern().rows == A.getBlockPattern().cols);
+        blockRows_ = A.getBlockPattern().rows;
+        inverseBlocks_ = Vector(blockRows_ * Block * Block, 1, A.batches());
+        CUMAT_ERROR_IF_NO_NVCC(BlockJacobiPreconditioner)
+#if CUMAT_NVCC == 1
+        if (blockRows_ == 0) return;
+        Context& ctx = Context::current();
+        KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(blockRows_), static_cast<unsigned int>(A.batches()),
+            internal::kernels::BsrInvertDiagonalKernel<Scalar, Block>);
+        internal::kernels::BsrInvertDiagonalKernel<Scalar, Block>
+            <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(
+                cfg.virtual_size, A.getBlockPattern().JA.data(), A.getBlockPattern().IA.data(), A.getData().data(),
+                A.nnzBlocks(), inverseBlocks_.data());
+        CUMAT_CHECK_ERROR();
+#endif
+    }
+
+    /**
+     * \brief The inverted diagonal blocks, row-major, one after another
+     */
+    const Vector& getInverseBlocks() const { return inverseBlocks_; }
+
+    /**
+     * \brief Solves for an approximation of A.x=b
+     * \param b the right hand side of the equation
+     * \return the approximate solution of x
+     */
+    template<typename _Rhs>
+    Vector solve(const MatrixBase<_Rhs>& b) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(BlockJacobiPreconditioner)
+        typedef typename internal::MatrixReadWrapper<_Rhs, AccessFlags::ReadDirect>::type wrapped_t;
+        wrapped_t rhs(b.derived());
+        CUMAT_ASSERT(rhs.rows() == blockRows_ * Block);
+        Vector z(rhs.rows(), 1, rhs.batches());
+#if CUMAT_NVCC == 1
+        if (blockRows_ == 0) return z;
+        Context& ctx = Context::current();
+        KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(blockRows_), static_cast<unsigned int>(rhs.batches()),
+            internal::kernels::BlockDiagonalApplyKernel<Scalar, Block>);
+        internal::kernels::BlockDiagonalApplyKernel<Scalar, Block>
+            <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(
+                cfg.virtual_size, inverseBlocks_.data(), inverseBlocks_.batches() == 1 ? 0 : blockRows_ * Block * Block,
+                rhs.data(), z.data());
+        CUMAT_CHECK_ERROR();
+#endif
+        return z;
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -3,14 +3,17 @@
 
 #include "Macros.h"
 
+#include <algorithm>
 #include <cmath>
 #include <valarray>
+#include <vector>
 
 #include "Matrix.h"
 #include "UnaryOps.h"
 #include "BinaryOps.h"
 #include "ReductionOps.h"
 #include "IterativeSolverBase.h"
+#include "ConvergenceCheck.h"
 
 CUMAT_NAMESPACE_BEGIN
 
@@ -24,6 +27,69 @@ namespace internal
         using MatrixType = _MatrixType;
         using Preconditioner = _Preconditioner;
     };
+
+#if CUMAT_NVCC == 1
+    namespace kernels
+    {
+        // masked dot products: out1 += (a,b) and, if out2 != nullptr, out2 += (a,a).
+        // grid: x=blocks per batch, y=batch. Converged batches exit immediately, the outputs have to be zeroed before.
+        template<typename _Vector, typename _Real, int BlockSize>
+        __global__ void CGMaskedDotKernel(Index size, const _Vector* a, const _Vector* b, const int* convergedAt,
+            _Real* out1, _Real* out2)
+        {
+            typedef cub::BlockReduce<_Real, BlockSize> BlockReduceT;
+            __shared__ typename BlockReduceT::TempStorage temp_storage;
+
+            const Index batch = blockIdx.y;
+            if (convergedAt[batch] >= 0) return;
+            const Index offset = batch * size;
+            _Real dot = 0, norm = 0;
+            for (Index i = blockIdx.x * BlockSize + threadIdx.x; i < size; i += gridDim.x * BlockSize)
+            {
+                const _Vector ai = a[offset + i];
+                dot += realPart(functor::BinaryMathFunctor_cwiseDot<_Vector>()(ai, b[offset + i], i, 0, batch));
+                if (out2) norm += realPart(functor::UnaryMathFunctor_cwiseAbs2<_Vector>()(ai, i, 0, batch));
+            }
+            dot = BlockReduceT(temp_storage).Sum(dot);
+            if (threadIdx.x == 0) atomicAdd(out1 + batch, dot);
+            if (out2)
+            {
+                __syncthreads();
+                norm = BlockReduceT(temp_storage).Sum(norm);
+                if (threadIdx.x == 0) atomicAdd(out2 + batch, norm);
+            }
+        }
+
+        // x += alpha*p, r -= alpha*Ap for the batches that have not converged yet
+        template<typename _Vector, typename _Real>
+        __global__ void CGMaskedUpdateKernel(dim3 virtual_size, const _Real* alpha, const int* convergedAt,
+            _Vector* x, _Vector* r, const _Vector* p, const _Vector* Ap)
+        {
+            typedef functor::BinaryMathFunctor_cwiseMul<_Vector> Mul;
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                if (convergedAt[batch] >= 0) continue;
+                const Index idx = i + batch * virtual_size.x;
+                const _Vector a = functor::CastFunctor<_Real, _Vector>::cast(alpha[batch]);
+                x[idx] = x[idx] + Mul()(a, p[idx], i, 0, batch);
+                r[idx] = r[idx] - Mul()(a, Ap[idx], i, 0, batch);
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        // p = z + beta*p for the batches that have not converged yet
+        template<typename _Vector, typename _Real>
+        __global__ void CGMaskedDirectionKernel(dim3 virtual_size, const _Real* beta, const int* convergedAt,
+            _Vector* p, const _Vector* z)
+        {
+            typedef functor::BinaryMathFunctor_cwiseMul<_Vector> Mul;
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                if (convergedAt[batch] >= 0) continue;
+                const Index idx = i + batch * virtual_size.x;
+                const _Vector b = functor::CastFunctor<_Real, _Vector>::cast(beta[batch]);
+                p[idx] = z[idx] + Mul()(b, p[idx], i, 0, batch);
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
 }
 
 /**
@@ -41,8 +107,17 @@ namespace internal
  * Examples are the DiagonalPreconditioner and IdentityPreconditioner.
  * 
  * This solver supports batched matrices and right hand sides.
- * Note that the iterations runs for all batches until all batches have converged. There is no early out 
- * for some batches.
+ * The number of iterations after which every batch has converged is reported by \ref batchIterations().
+ * 
+ * By default, the residual norm is copied to the host in every iteration to test for convergence.
+ * In this mode, the iterations run for all batches until all batches have converged,
+ * but the step sizes of converged batches are set to zero, so they are not updated anymore.
+ * With \ref setConvergenceCheckInterval(), the convergence is instead evaluated on the device and the host only
+ * synchronizes every k iterations. In that mode, batches that have converged are masked out on the device:
+ * the dot products and vector updates skip them, and so does the matrix-vector product if
+ * internal::MaskedMatrixVectorProduct is specialized for the matrix type (as for the CSR SparseMatrix).
+ * Heterogeneous batches then run at close to the cost of the systems that are still active.
+ * Only the preconditioner is still applied to all batches.
  * 
  * This solver can also be used with blocked types. This means, the scalar type of the matrix is not a single element like float,
  * but a small block. For example: The matrix has type float3x3 and the right hand side float3 for 3x3 blocks.
@@ -82,6 +157,7 @@ private:
     using Base::preconditioner_;
     using Base::tolerance_;
     using Base::iterations_;
+    using Base::batchIterations_;
     using Base::error_;
 
 public:
@@ -132,6 +208,7 @@ public:
 
         //initialize result and counter
         iterations_ = 0;
+        batchIterations_.assign(Batches, 0);
         error_ = 0;
         target.inplace() = guess;
 
@@ -170,40 +247,165 @@ public:
             return;
         }
 
+#if CUMAT_NVCC == 1
+        if (Base::convergenceCheckInterval_ > 0)
+        {
+            _solve_device_check_impl(target, residual, rhsNorm2, threshold);
+            return;
+        }
+
+        typedef Matrix<int, 1, 1, Batches, 0> IntDevice;
         VectorType p(n, 1, Batches);
         p = preconditioner_.solve(residual); // initial search direction
 
         VectorType z(n, 1, Batches), tmp(n, 1, Batches);
         RealScalarDevice absNew = residual.dot(p).real(); // the square of the absolute value of r scaled by invM
+        RealScalarDevice absOld(1, 1, Batches), pAp(1, 1, Batches), alpha(1, 1, Batches), beta(1, 1, Batches);
+        IntDevice convergedAt = IntDevice::Constant(1, 1, Batches, -1); //per batch: iteration of convergence or -1
+        std::vector<int> convergedAtHost(Batches, -1);
         Index i = 0;
         const Index maxIter = maxIterations();
+        std::fill(batchIterations_.begin(), batchIterations_.end(), maxIter);
         while (i < maxIter)
         {
             tmp.inplace() = matrix_ * p; // the bottleneck of the algorithm
 
-            auto alpha = absNew.cwiseDiv(p.dot(tmp)); // the amount we travel on dir; expression, cwiseDiv not evaluated (dot is)
+            pAp = p.dot(tmp).real();
+            internal::maskedDivision(absNew, pAp, convergedAt, alpha); // the amount we travel on dir, zero for converged batches
             target += alpha.template cast<VectorScalarType>().cwiseMul(p); // update solution
             residual -= alpha.template cast<VectorScalarType>().cwiseMul(tmp); // update residual
 
             residual.squaredNorm().eval().copyToHost(&residualNorm2[0]);
             //RealScalar residualNorm2 = static_cast<RealScalar>(residual.squaredNorm()); //SLOW: device->host memcopy
             all = true;
-            for (int b = 0; b < Batches; ++b) all = all && residualNorm2[b] < threshold[b];
+            bool newlyConverged = false;
+            for (int b = 0; b < Batches; ++b)
+            {
+                if (convergedAtHost[b] < 0 && residualNorm2[b] < threshold[b])
+                {
+                    convergedAtHost[b] = static_cast<int>(i);
+                    batchIterations_[b] = i;
+                    newlyConverged = true;
+                }
+                all = all && convergedAtHost[b] >= 0;
+            }
             if (all)
                 break;
+            if (newlyConverged)
+                convergedAt.copyFromHost(convergedAtHost.data()); // freeze the converged batches
 
             z.inplace() = preconditioner_.solve(residual); // approximately solve for "A z = residual"
 
-            RealScalarDevice absOld = absNew;
+            absOld = absNew;
             absNew = residual.dot(z).real(); // update the absolute value of r
-            auto beta = absNew.cwiseDiv(absOld); //expression, not evaluated
+            internal::maskedDivision(absNew, absOld, convergedAt, beta);
             // calculate the Gram-Schmidt value used to create the new search direction
             p.inplace() = z + beta.template cast<VectorScalarType>().cwiseMul(p); // update search direction
             i++;
         }
         error_ = sqrt((residualNorm2 / rhsNorm2).max());
         iterations_ = i;
+#endif
+    }
+
+private:
+#if CUMAT_NVCC == 1
+    /**
+     * \brief The main loop of the CG with device-resident convergence checks.
+     * The step sizes alpha and beta never leave the device. Converged batches are masked out:
+     * their step sizes are set to zero and the dot products, vector updates and (if supported by the matrix type)
+     * the matrix-vector product skip them. The host only waits for the device in the iterations given by
+     * internal::ConvergenceCheckSchedule.
+     */
+    template<typename _Target, typename _Vector>
+    void _solve_device_check_impl(_Target& target, _Vector& residual,
+        const std::valarray<RealScalar>& rhsNorm2, const std::valarray<RealScalar>& threshold) const
+    {
+        constexpr int Batches = _Target::Batches;
+        constexpr int BlockSize = 256;
+        typedef Matrix<RealScalar, 1, 1, Batches, 0> RealScalarDevice;
+        typedef Matrix<int, 1, 1, Batches, 0> IntDevice;
+        typedef typename _Target::Scalar VectorScalarType;
+        using std::sqrt;
+        const Index n = matrix_.cols();
+        const Index maxIter = maxIterations();
+        const internal::ConvergenceCheckSchedule schedule(Base::convergenceCheckInterval_, maxIter);
+        Context& ctx = Context::current();
+
+        RealScalarDevice thresholdDevice(1, 1, Batches);
+        thresholdDevice.copyFromHost(&threshold[0]);
+        IntDevice convergedAt = IntDevice::Constant(1, 1, Batches, -1); //per batch: iteration of convergence or -1
+        internal::MappedConvergenceStatus status;
+
+        _Vector p(n, 1, Batches);
+        p = preconditioner_.solve(residual); // initial search direction
+
+        _Vector z(n, 1, Batches), tmp(n, 1, Batches);
+        // absNew is the square of the absolute value of r scaled by invM, the two buffers are swapped in every iteration
+        RealScalarDevice absBuffer1 = residual.dot(p).real(), absBuffer2(1, 1, Batches);
+        RealScalarDevice* absNew = &absBuffer1;
+        RealScalarDevice* absOld = &absBuffer2;
+        RealScalarDevice pAp(1, 1, Batches), alpha(1, 1, Batches), beta(1, 1, Batches);
+        RealScalarDevice residualNorm2(1, 1, Batches);
+
+        const unsigned int numBlocks = static_cast<unsigned int>(std::min(Index(CUMAT_DIV_UP(n, BlockSize)), Index(BlockSize)));
+        KernelLaunchConfig cfgUpdate = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), Batches,
+            internal::kernels::CGMaskedUpdateKernel<VectorScalarType, RealScalar>);
+        KernelLaunchConfig cfgDirection = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), Batches,
+            internal::kernels::CGMaskedDirectionKernel<VectorScalarType, RealScalar>);
+
+        Index i = 0;
+        bool converged = false;
+        for (; i < maxIter; ++i)
+        {
+            // the bottleneck of the algorithm
+            internal::MaskedMatrixVectorProduct<MatrixType>::eval(matrix_, p, tmp, convergedAt);
+
+            pAp.setZero();
+            internal::kernels::CGMaskedDotKernel<VectorScalarType, RealScalar, BlockSize>
+                <<<dim3(numBlocks, Batches, 1), BlockSize, 0, ctx.stream()>>>(
+                    n, p.data(), tmp.data(), convergedAt.data(), pAp.data(), nullptr);
+            CUMAT_CHECK_ERROR();
+            internal::maskedDivision(*absNew, pAp, convergedAt, alpha); // the amount we travel on dir
+            internal::kernels::CGMaskedUpdateKernel<VectorScalarType, RealScalar>
+                <<<cfgUpdate.block_count, cfgUpdate.thread_per_block, 0, ctx.stream()>>>(
+                    cfgUpdate.virtual_size, alpha.data(), convergedAt.data(),
+                    target.data(), residual.data(), p.data(), tmp.data()); // update solution and residual
+            CUMAT_CHECK_ERROR();
+
+            z.inplace() = preconditioner_.solve(residual); // approximately solve for "A z = residual"
+
+            // fused reduction of the new absolute value of r and the residual norm
+            std::swap(absNew, absOld);
+            absNew->setZero();
+            residualNorm2.setZero();
+            internal::kernels::CGMaskedDotKernel<VectorScalarType, RealScalar, BlockSize>
+                <<<dim3(numBlocks, Batches, 1), BlockSize, 0, ctx.stream()>>>(
+                    n, residual.data(), z.data(), convergedAt.data(), absNew->data(), residualNorm2.data());
+            CUMAT_CHECK_ERROR();
+
+            internal::checkConvergence(residualNorm2, thresholdDevice, convergedAt, status, i);
+            if (schedule.isCheckIteration(i) && status.wait())
+            {
+                converged = true;
+                break;
+            }
+
+            internal::maskedDivision(*absNew, *absOld, convergedAt, beta);
+            // calculate the Gram-Schmidt value used to create the new search direction
+            internal::kernels::CGMaskedDirectionKernel<VectorScalarType, RealScalar>
+                <<<cfgDirection.block_count, cfgDirection.thread_per_block, 0, ctx.stream()>>>(
+                    cfgDirection.virtual_size, beta.data(), convergedAt.data(), p.data(), z.data());
+            CUMAT_CHECK_ERROR();
+        }
+
+        std::valarray<RealScalar> residualNorm2Host(Batches);
+        residual.squaredNorm().eval().copyToHost(&residualNorm2Host[0]);
+        error_ = sqrt((residualNorm2Host / rhsNorm2).max());
+        iterations_ = converged ? status.iteration() : maxIter;
+        internal::copyBatchIterations(convergedAt, maxIter, batchIterations_);
     }
+#endif
 };
 
 /**
@@ -138,6 +138,29 @@ namespace ReductionAlg
 	struct Auto {};
 }
 
+/**
+ * \brief Tags for the different histogram / bincount algorithms
+ */
+namespace HistogramAlg
+{
+	/**
+	 * \brief Every entry is directly added to the output bins with global atomics.
+	 */
+	struct Global {};
+	/**
+	 * \brief Privatized bins: each block accumulates into a copy of the bins
+	 * in shared memory and flushes them to the output at the end.
+	 * If the bins do not fit into shared memory, they are split into windows
+	 * and the input is traversed once per window.
+	 */
+	struct Shared {};
+	/**
+	 * \brief Automatic algorithm selection.
+	 * Chooses the algorithm during runtime based on the number of entries and bins.
+	 */
+	struct Auto {};
+}
+
 /**
 * \brief Specifies the assignment mode in \c Assignment::assign() .
 * This is the difference between regular assignment (operator==, \c AssignmentMode::ASSIGN)
@@ -180,6 +203,83 @@ enum SparseFlags
 	 * This format is optimized for matrices with uniform nnz per row.
 	 */
 	ELLPACK = 3,
+	/**
+	 * \brief Sliced ELLPACK format with a sorting window (SELL-C-sigma).
+	 * The rows are sorted by length within windows of sigma rows, then slices of C consecutive
+	 * (sorted) rows are padded to the longest row of the slice only.
+	 * This keeps the coalesced access of ELLPACK with a small overhead on matrices with irregular rows.
+	 */
+	SELLCS = 4,
+};
+
+/**
+ * \brief Kernels for the product of a CSR SparseMatrix with a dense vector.
+ * By default, the kernel is selected automatically from the distribution of the row lengths,
+ * see \ref SparsityPattern<SparseFlags::CSR>::setSpMVAlgorithm() to force a kernel.
+ * Custom scalar types (i.e. not float, double, cfloat or cdouble) always use the scalar kernel.
+ */
+enum class CsrSpMVAlgorithm
+{
+	/**
+	 * \brief Automatic selection based on the row lengths, the default.
+	 */
+	Automatic,
+	/**
+	 * \brief One thread per row. Best for short rows of similar length.
+	 */
+	Scalar,
+	/**
+	 * \brief A group of 2 to 32 threads of a warp per row. Best for long rows of similar length.
+	 */
+	Vector,
+	/**
+	 * \brief Adaptive CSR-stream: every block processes a precomputed range of rows with a similar number of entries,
+	 * the products are staged in shared memory. Rows that are too long for one block are reduced by the whole block.
+	 */
+	Stream,
+	/**
+	 * \brief Merge-path: every thread processes the same number of rows plus entries.
+	 * Independent of the row lengths, best for very irregular matrices (e.g. power-law).
+	 */
+	MergePath
+};
+
+/**
+ * \brief Thread mappings of the evaluation of component-wise expressions into a CSR or CSC SparseMatrix.
+ * By default, the mapping is selected automatically from the distribution of the outer lengths (row lengths for CSR),
+ * see \ref SparsityPattern<SparseFlags::CSR>::setCwiseEvaluation() to force a mapping.
+ */
+enum class SparseCwiseEvaluation
+{
+	/**
+	 * \brief Automatic selection based on the outer lengths, the default.
+	 */
+	Automatic,
+	/**
+	 * \brief One thread per outer index (row or column) that loops over its entries. No additional memory,
+	 * best if all rows have a similar length.
+	 */
+	PerOuter,
+	/**
+	 * \brief One thread per entry. The outer index of every entry is precomputed once and cached with the SparsityPattern.
+	 * Independent of the outer lengths, best for matrices with a few dense rows.
+	 */
+	PerEntry
+};
+
+/**
+ * \brief Where the conversions between the sparse formats (see SparseFormatConversion.h) are executed.
+ */
+enum class SparseConversionBackend
+{
+	/**
+	 * \brief The matrix is copied to the host, converted with OpenMP (if enabled) and copied back
+	 */
+	Host,
+	/**
+	 * \brief The conversion runs on the device with radix sorts and scans, no host transfer of the data
+	 */
+	Device
 };
 
 CUMAT_NAMESPACE_END
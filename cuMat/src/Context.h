@@ -133,6 +133,7 @@ class Context
 {
 private:
 	cudaStream_t stream_;
+	cudaStream_t sideStream_ = nullptr;
 	int device_ = 0;
 
 #if CUMAT_CONTEXT_DEBUG_MEMORY == 1
@@ -166,6 +167,11 @@ public:
 
 	~Context()
 	{
+		if (sideStream_ != nullptr)
+		{
+			cudaStreamDestroy(sideStream_);
+			sideStream_ = nullptr;
+		}
 		if (stream_ != nullptr)
 		{
 			cudaStreamDestroy(stream_);
@@ -187,6 +193,11 @@ public:
 	 */
 	void destroy()
 	{
+		if (sideStream_ != nullptr)
+		{
+			CUMAT_SAFE_CALL(cudaStreamDestroy(sideStream_));
+			sideStream_ = nullptr;
+		}
 		if (stream_ != nullptr)
 		{
 			CUMAT_SAFE_CALL(cudaStreamDestroy(stream_));
@@ -221,6 +232,19 @@ public:
 		return stream_;
 	}
 
+	/**
+	 * \brief Returns a second non-blocking stream of this context, created on the first call and kept until the context is destroyed.
+	 * Algorithms use it to overlap independent work with the main stream \ref stream(),
+	 * the synchronization between both streams (e.g. with \ref Event) is the responsibility of the caller.
+	 * \return the side stream
+	 */
+	cudaStream_t sideStream()
+	{
+		if (sideStream_ == nullptr)
+			CUMAT_SAFE_CALL(cudaStreamCreateWithFlags(&sideStream_, cudaStreamNonBlocking));
+		return sideStream_;
+	}
+
 #if CUMAT_CONTEXT_USE_CUB_ALLOCATOR == 1
 	static cub::CachingDeviceAllocator& getCubAllocator()
 	{
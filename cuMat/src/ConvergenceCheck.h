@@ -0,0 +1,260 @@
+#ifndef __CUMAT_CONVERGENCE_CHECK_H__
+#define __CUMAT_CONVERGENCE_CHECK_H__
+
+#include "Macros.h"
+
+#include <vector>
+
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "Matrix.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+	/**
+	 * \brief The schedule of the host-side convergence checks of iterative solvers
+	 * in the device-resident mode (see IterativeSolverBase::setConvergenceCheckInterval()).
+	 *
+	 * The convergence is evaluated on the device in every iteration, but the host only waits
+	 * for the result every \c interval iterations and in the last iteration.
+	 * At most <tt>interval-1</tt> iterations are therefore launched in vain after convergence.
+	 * This class contains no device code and can be tested on the host.
+	 */
+	class ConvergenceCheckSchedule
+	{
+		Index interval_;
+		Index maxIterations_;
+
+	public:
+		/**
+		 * \param interval the check interval, must be positive
+		 * \param maxIterations the maximal number of iterations
+		 */
+		ConvergenceCheckSchedule(Index interval, Index maxIterations)
+			: interval_(interval), maxIterations_(maxIterations)
+		{
+			CUMAT_ASSERT_ARGUMENT(interval > 0);
+		}
+
+		Index interval() const { return interval_; }
+		Index maxIterations() const { return maxIterations_; }
+
+		/**
+		 * \brief Tests if the host waits for the convergence flag after the (zero-based) iteration \c i.
+		 */
+		bool isCheckIteration(Index i) const
+		{
+			return ((i + 1) % interval_ == 0) || (i + 1 >= maxIterations_);
+		}
+
+		/**
+		 * \brief Returns the first iteration, starting from \c i, in which the host checks for convergence.
+		 * This is the iteration in which a solver that converged in iteration \c i stops.
+		 */
+		Index nextCheckIteration(Index i) const
+		{
+			const Index next = CUMAT_DIV_UP(i + 1, interval_) * interval_ - 1;
+			return std::min(next, maxIterations_ - 1);
+		}
+
+		/**
+		 * \brief Returns the number of host synchronizations if the solver runs for all iterations.
+		 */
+		Index numChecks() const
+		{
+			if (maxIterations_ <= 0) return 0;
+			return CUMAT_DIV_UP(maxIterations_, interval_);
+		}
+	};
+
+	/**
+	 * \brief The convergence status as written by the device into mapped host memory.
+	 */
+	struct DeviceConvergenceStatus
+	{
+		/**
+		 * \brief 1 if all batches have converged
+		 */
+		int converged;
+		/**
+		 * \brief the iteration in which the last batch converged, -1 if not converged
+		 */
+		int iteration;
+	};
+
+	/**
+	 * \brief Mapped and pinned host memory containing a DeviceConvergenceStatus.
+	 * The status is written directly by the convergence check kernel,
+	 * the host only waits for an event recorded after that kernel and then reads the flag without a memcopy.
+	 */
+	class MappedConvergenceStatus
+	{
+		DeviceConvergenceStatus* host_;
+		DeviceConvergenceStatus* device_;
+		Event event_;
+
+		CUMAT_DISALLOW_COPY_AND_ASSIGN(MappedConvergenceStatus);
+
+	public:
+		MappedConvergenceStatus()
+			: host_(static_cast<DeviceConvergenceStatus*>(Context::current().mallocHost(sizeof(DeviceConvergenceStatus))))
+			, device_(nullptr)
+		{
+			host_->converged = 0;
+			host_->iteration = -1;
+			CUMAT_SAFE_CALL(cudaHostGetDevicePointer(reinterpret_cast<void**>(&device_), host_, 0));
+		}
+
+		~MappedConvergenceStatus()
+		{
+			Context::current().freeHost(host_);
+		}
+
+		/**
+		 * \brief The pointer to the status that is passed to the device
+		 */
+		DeviceConvergenceStatus* devicePointer() const { return device_; }
+
+		/**
+		 * \brief Waits until all work that was submitted to the current stream so far has completed
+		 * and then polls the convergence flag.
+		 * \return true iff all batches have converged
+		 */
+		bool wait()
+		{
+			event_.record(Context::current().stream());
+			CUMAT_SAFE_CALL(cudaEventSynchronize(event_.event()));
+			return converged();
+		}
+
+		/**
+		 * \brief Reads the convergence flag without synchronization
+		 */
+		bool converged() const { return static_cast<volatile const DeviceConvergenceStatus*>(host_)->converged != 0; }
+		/**
+		 * \brief Reads the iteration of convergence without synchronization
+		 */
+		int iteration() const { return static_cast<volatile const DeviceConvergenceStatus*>(host_)->iteration; }
+	};
+
+	/**
+	 * \brief Extension point for the matrix-vector products of iterative solvers with per-batch convergence masking.
+	 *
+	 * \c eval computes <tt>out = matrix * x</tt> for all batches that have not converged yet (<tt>convergedAt[b] < 0</tt>).
+	 * The entries of \c out for converged batches are unspecified afterwards, the solvers never read them again.
+	 * The default implementation simply evaluates the full product, specializations (e.g. for the CSR SparseMatrix)
+	 * skip the memory traffic of converged batches.
+	 * \tparam _MatrixType the matrix type of the solver
+	 */
+	template<typename _MatrixType>
+	struct MaskedMatrixVectorProduct
+	{
+		template<typename _Vector, int _Batches>
+		static void eval(const _MatrixType& matrix, const _Vector& x, _Vector& out,
+			const Matrix<int, 1, 1, _Batches, 0>& convergedAt)
+		{
+			out.inplace() = matrix * x;
+		}
+	};
+
+	/**
+	 * \brief Converts the per-batch iteration of convergence (-1 if not converged) into the per-batch iteration counts
+	 * reported by IterativeSolverBase::batchIterations(). Batches that did not converge report \c maxIterations.
+	 */
+	template <int _Batches>
+	void copyBatchIterations(const Matrix<int, 1, 1, _Batches, 0>& convergedAt, Index maxIterations, std::vector<Index>& out)
+	{
+		std::vector<int> host(convergedAt.batches());
+		convergedAt.copyToHost(host.data());
+		out.resize(host.size());
+		for (size_t b = 0; b < host.size(); ++b)
+			out[b] = host[b] < 0 ? maxIterations : Index(host[b]);
+	}
+
+#if CUMAT_NVCC == 1
+	namespace kernels
+	{
+		// out = num / den for the batches that have not converged yet, 0 otherwise or on breakdown (den=0)
+		template <typename _RealScalar>
+		__global__ void MaskedDivisionKernel(dim3 virtual_size, const _RealScalar* num, const _RealScalar* den,
+			const int* convergedAt, _RealScalar* out)
+		{
+			CUMAT_KERNEL_1D_LOOP(b, virtual_size)
+				out[b] = (convergedAt[b] < 0 && den[b] != _RealScalar(0)) ? num[b] / den[b] : _RealScalar(0);
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		// real part of the (possibly complex) result of a dot product
+		template <typename _Scalar>
+		__device__ CUMAT_STRONG_INLINE _Scalar realPart(const _Scalar& x) { return x; }
+		__device__ CUMAT_STRONG_INLINE float realPart(const cfloat& x) { return x.real(); }
+		__device__ CUMAT_STRONG_INLINE double realPart(const cdouble& x) { return x.real(); }
+
+		// single thread: marks batches as converged and writes the summary into the mapped status
+		template <typename _RealScalar>
+		__global__ void ConvergenceCheckKernel(int batches, const _RealScalar* residualNorm2, const _RealScalar* threshold,
+			int* convergedAt, DeviceConvergenceStatus* status, int iteration)
+		{
+			bool all = true;
+			int last = 0;
+			for (int b = 0; b < batches; ++b)
+			{
+				if (convergedAt[b] < 0 && residualNorm2[b] < threshold[b])
+					convergedAt[b] = iteration;
+				if (convergedAt[b] < 0)
+					all = false;
+				else
+					last = max(last, convergedAt[b]);
+			}
+			if (all)
+			{
+				status->iteration = last;
+				__threadfence_system();
+				status->converged = 1;
+			}
+		}
+	}
+
+	/**
+	 * \brief Computes <tt>out = num / den</tt> for every batch that has not converged yet
+	 * (<tt>convergedAt[b] < 0</tt>) and <tt>out = 0</tt> for converged batches or if the denominator vanishes (breakdown).
+	 * This is used for the step sizes (alpha, beta) of the iterative solvers:
+	 * converged batches are frozen and no division by a vanishing denominator can pollute them.
+	 */
+	template <typename _RealScalar, int _Batches>
+	void maskedDivision(const Matrix<_RealScalar, 1, 1, _Batches, 0>& num, const Matrix<_RealScalar, 1, 1, _Batches, 0>& den,
+		const Matrix<int, 1, 1, _Batches, 0>& convergedAt, Matrix<_RealScalar, 1, 1, _Batches, 0>& out)
+	{
+		Context& ctx = Context::current();
+		KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(num.batches()),
+			kernels::MaskedDivisionKernel<_RealScalar>);
+		kernels::MaskedDivisionKernel<_RealScalar>
+			<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(
+				cfg.virtual_size, num.data(), den.data(), convergedAt.data(), out.data());
+		CUMAT_CHECK_ERROR();
+	}
+
+	/**
+	 * \brief Marks every batch with <tt>residualNorm2 < threshold</tt> as converged in the specified iteration
+	 * and writes the summary into the mapped status. No host synchronization is performed.
+	 * \param convergedAt per batch: the iteration in which the batch converged or -1
+	 */
+	template <typename _RealScalar, int _Batches>
+	void checkConvergence(const Matrix<_RealScalar, 1, 1, _Batches, 0>& residualNorm2,
+		const Matrix<_RealScalar, 1, 1, _Batches, 0>& threshold, Matrix<int, 1, 1, _Batches, 0>& convergedAt,
+		MappedConvergenceStatus& status, Index iteration)
+	{
+		Context& ctx = Context::current();
+		kernels::ConvergenceCheckKernel<_RealScalar>
+			<<<1, 1, 0, ctx.stream()>>>(static_cast<int>(residualNorm2.batches()), residualNorm2.data(), threshold.data(),
+				convergedAt.data(), status.devicePointer(), static_cast<int>(iteration));
+		CUMAT_CHECK_ERROR();
+	}
+#endif
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
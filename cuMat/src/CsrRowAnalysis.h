@@ -0,0 +1,586 @@
+#ifndef __CUMAT_CSR_ROW_ANALYSIS_H__
+#define __CUMAT_CSR_ROW_ANALYSIS_H__
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Constants.h"
+#include "Logging.h"
+#include "Matrix.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+	/**
+	 * \brief Statistics of the row lengths (entries per row) of a CSR sparsity pattern.
+	 */
+	struct CsrRowStatistics
+	{
+		Index rows = 0;
+		Index nnz = 0;
+		int minRowLength = 0;
+		int maxRowLength = 0;
+		double meanRowLength = 0;
+		double stdDevRowLength = 0;
+		/** \brief The number of rows without entries */
+		Index emptyRows = 0;
+
+		/**
+		 * \brief Computes the statistics from the outer indices.
+		 * This runs on the host only and can be tested without a GPU.
+		 * \param JA the outer indices, size rows+1
+		 * \param rows the number of rows
+		 */
+		static CsrRowStatistics compute(const int* JA, Index rows)
+		{
+			CsrRowStatistics s;
+			s.rows = rows;
+			if (rows <= 0) return s;
+			s.nnz = JA[rows] - JA[0];
+			s.minRowLength = JA[1] - JA[0];
+			double sumSquares = 0;
+			for (Index i = 0; i < rows; ++i)
+			{
+				const int length = JA[i + 1] - JA[i];
+				s.minRowLength = std::min(s.minRowLength, length);
+				s.maxRowLength = std::max(s.maxRowLength, length);
+				if (length == 0) s.emptyRows++;
+				sumSquares += double(length) * double(length);
+			}
+			s.meanRowLength = double(s.nnz) / double(rows);
+			s.stdDevRowLength = std::sqrt(std::max(0.0, sumSquares / double(rows) - s.meanRowLength * s.meanRowLength));
+			return s;
+		}
+	};
+
+	/**
+	 * \brief Kernel selection and launch parameters of the CSR matrix-vector product.
+	 * This runs on the host only and can be tested without a GPU.
+	 */
+	struct CsrSpMVAlgorithmSelection
+	{
+		/**
+		 * \brief The fixed block size of the vector, stream and merge-path kernels
+		 */
+		static constexpr int BLOCK_SIZE = 256;
+		/**
+		 * \brief The maximal number of entries a block of the stream kernel stages in shared memory
+		 */
+		static constexpr int STREAM_NNZ_PER_BLOCK = 1024;
+		/**
+		 * \brief The number of rows plus entries every thread of the merge-path kernel consumes
+		 */
+		static constexpr int MERGE_PATH_ITEMS_PER_THREAD = 8;
+		/**
+		 * \brief Below this number of entries, the product is too small to profit from load balancing
+		 */
+		static constexpr int MIN_NNZ_LOAD_BALANCING = 8192;
+		/**
+		 * \brief Up to this average row length, regular rows are processed by one thread each
+		 */
+		static constexpr int SCALAR_MAX_MEAN_ROW_LENGTH = 8;
+
+		/**
+		 * \brief Tests if all rows have a similar length, e.g. stencils or banded matrices.
+		 * Then one thread or one group of threads per row is balanced already.
+		 */
+		static bool isRegular(const CsrRowStatistics& s)
+		{
+			return s.maxRowLength <= 2 * s.meanRowLength + SCALAR_MAX_MEAN_ROW_LENGTH;
+		}
+
+		/**
+		 * \brief The number of threads per row of the vector kernel, a power of two from 2 to 32
+		 */
+		static int threadsPerRow(double meanRowLength)
+		{
+			int threads = 2;
+			while (threads < 32 && threads < meanRowLength) threads *= 2;
+			return threads;
+		}
+
+		/**
+		 * \brief Selects the kernel from the row length statistics
+		 */
+		static CsrSpMVAlgorithm select(const CsrRowStatistics& s)
+		{
+			if (s.nnz < MIN_NNZ_LOAD_BALANCING)
+				return CsrSpMVAlgorithm::Scalar;
+			if (isRegular(s))
+				return s.meanRowLength <= SCALAR_MAX_MEAN_ROW_LENGTH ? CsrSpMVAlgorithm::Scalar : CsrSpMVAlgorithm::Vector;
+			//irregular: the stream kernel is faster as long as no row spans many blocks
+			if (s.maxRowLength <= STREAM_NNZ_PER_BLOCK)
+				return CsrSpMVAlgorithm::Stream;
+			return CsrSpMVAlgorithm::MergePath;
+		}
+
+		/**
+		 * \brief Partitions the rows into the blocks of the stream kernel.
+		 * Consecutive rows are merged greedily as long as they have at most \ref STREAM_NNZ_PER_BLOCK entries in total.
+		 * A longer row gets a block on its own.
+		 * \param JA the outer indices, size rows+1
+		 * \param rows the number of rows
+		 * \return the first row of every block, followed by \c rows
+		 */
+		static std::vector<int> streamRowBlocks(const int* JA, Index rows)
+		{
+			std::vector<int> blocks(1, 0);
+			Index start = 0;
+			while (start < rows)
+			{
+				Index end = start + 1;
+				while (end < rows && end - start < STREAM_NNZ_PER_BLOCK && JA[end + 1] - JA[start] <= STREAM_NNZ_PER_BLOCK)
+					++end;
+				blocks.push_back(static_cast<int>(end));
+				start = end;
+			}
+			return blocks;
+		}
+
+		/**
+		 * \brief The number of threads of the merge-path kernel
+		 */
+		static Index mergePathThreads(Index rows, Index nnz)
+		{
+			return std::max(Index(1), CUMAT_DIV_UP(rows + nnz, MERGE_PATH_ITEMS_PER_THREAD));
+		}
+	};
+
+	/**
+	 * \brief Thread mapping of the product of a CSR matrix with a dense matrix with k columns (SpMM).
+	 * The mapping only depends on the compile-time number of columns and the storage order of the dense matrix.
+	 * This runs on the host only and can be tested without a GPU.
+	 *
+	 * - Row per thread: every thread computes a tile of up to \ref MAX_COLUMNS_PER_THREAD columns of a row in registers,
+	 *   every loaded matrix entry is reused for all columns of the tile.
+	 *   Used for column-major dense matrices, where the columns of a row are not contiguous anyway, and for few columns.
+	 * - Lanes over columns: a group of threads of a warp per row, the lanes split the columns and every lane
+	 *   handles a few of them in registers. All lanes read the same matrix entry (a broadcast), and the rows
+	 *   of a row-major dense matrix are read and written coalesced.
+	 */
+	struct CsrSpMMAlgorithmSelection
+	{
+		/**
+		 * \brief The fixed block size of the lanes-over-columns kernel
+		 */
+		static constexpr int BLOCK_SIZE = 256;
+		/**
+		 * \brief The maximal number of columns a thread of the row-per-thread kernel keeps in registers
+		 */
+		static constexpr int MAX_COLUMNS_PER_THREAD = 16;
+		/**
+		 * \brief From this number of columns on, row-major dense matrices use the lanes-over-columns kernel
+		 */
+		static constexpr int LANES_MIN_COLUMNS = 8;
+
+		/**
+		 * \brief Tests if the lanes-over-columns kernel is used
+		 * \param columns the number of columns of the dense matrix
+		 * \param rowMajor true iff the dense matrix is row-major
+		 */
+		static constexpr bool useLanes(int columns, bool rowMajor)
+		{
+			return rowMajor && columns >= LANES_MIN_COLUMNS;
+		}
+
+		/**
+		 * \brief The number of threads per row of the lanes-over-columns kernel, the largest power of two from 8 to 32 not above \c columns
+		 */
+		static constexpr int threadsPerRow(int columns)
+		{
+			return columns >= 32 ? 32 : (columns >= 16 ? 16 : 8);
+		}
+
+		/**
+		 * \brief The number of columns every thread keeps in registers
+		 * \param columns the number of columns of the dense matrix
+		 * \param lanes true for the lanes-over-columns kernel, false for the row-per-thread kernel
+		 */
+		static constexpr int columnsPerThread(int columns, bool lanes)
+		{
+			return lanes
+				? CUMAT_DIV_UP(columns, threadsPerRow(columns))
+				: (columns < MAX_COLUMNS_PER_THREAD ? columns : MAX_COLUMNS_PER_THREAD);
+		}
+
+		/**
+		 * \brief The number of column tiles of the row-per-thread kernel, i.e. the number of threads per row
+		 */
+		static constexpr int columnTiles(int columns)
+		{
+			return CUMAT_DIV_UP(columns, columnsPerThread(columns, false));
+		}
+	};
+
+	/**
+	 * \brief The result of the row analysis of a CSR sparsity pattern, see \ref CsrRowAnalysisCache
+	 */
+	struct CsrRowAnalysis
+	{
+		CsrRowStatistics statistics;
+		/** \brief The kernel that is used, never CsrSpMVAlgorithm::Automatic */
+		CsrSpMVAlgorithm algorithm = CsrSpMVAlgorithm::Scalar;
+		/** \brief Threads per row of the vector kernel */
+		int threadsPerRow = 2;
+		/** \brief The row partition of the stream kernel (see CsrSpMVAlgorithmSelection::streamRowBlocks), only allocated for the stream kernel */
+		Matrix<int, Dynamic, 1, 1, ColumnMajor> streamRowBlocks;
+	};
+
+	/**
+	 * \brief Reference-counted cache of the row analysis of a CSR sparsity pattern.
+	 * All copies of a sparsity pattern share the same cache, like they share the index vectors.
+	 * The analysis is computed on the host on the first product and recomputed
+	 * when the outer indices, the number of rows or the number of entries are replaced.
+	 * The cache keeps a reference to the analyzed outer indices, so their memory can't be reused by another pattern.
+	 */
+	class CsrRowAnalysisCache
+	{
+	private:
+		struct Entry
+		{
+			Matrix<int, Dynamic, 1, 1, ColumnMajor> key; //a reference keeps the memory from being recycled for another pattern
+			Index rows = -1;
+			Index nnz = -1;
+			bool valid = false;
+			CsrSpMVAlgorithm forced = CsrSpMVAlgorithm::Automatic;
+			CsrRowAnalysis analysis;
+		};
+		Entry* entry_;
+		int* counter_;
+
+		__host__ __device__
+		void release()
+		{
+#ifndef __CUDA_ARCH__
+			//no decrement of the counter in CUDA-code, counter is in host-memory
+			if ((counter_) && (--(*counter_) == 0))
+			{
+				delete counter_;
+				delete entry_;
+			}
+#endif
+		}
+
+	public:
+		__host__ __device__
+		CsrRowAnalysisCache()
+			: entry_(nullptr)
+			, counter_(nullptr)
+		{
+#ifndef __CUDA_ARCH__
+			entry_ = new Entry();
+			counter_ = new int(1);
+#endif
+		}
+
+		__host__ __device__
+		CsrRowAnalysisCache(const CsrRowAnalysisCache& rhs)
+			: entry_(rhs.entry_)
+			, counter_(rhs.counter_)
+		{
+#ifndef __CUDA_ARCH__
+			if (counter_) ++(*counter_);
+#endif
+		}
+
+		__host__ __device__
+		CsrRowAnalysisCache& operator=(const CsrRowAnalysisCache& rhs)
+		{
+			if (this == &rhs) return *this;
+			release();
+			entry_ = rhs.entry_;
+			counter_ = rhs.counter_;
+#ifndef __CUDA_ARCH__
+			if (counter_) ++(*counter_);
+#endif
+			return *this;
+		}
+
+		__host__ __device__
+		~CsrRowAnalysisCache()
+		{
+			release();
+		}
+
+		/**
+		 * \brief Forces the specified kernel, or CsrSpMVAlgorithm::Automatic to select it from the row lengths again
+		 */
+		void setAlgorithm(CsrSpMVAlgorithm algorithm) const
+		{
+			entry_->forced = algorithm;
+			entry_->valid = false;
+		}
+		/**
+		 * \return the forced kernel or CsrSpMVAlgorithm::Automatic
+		 */
+		CsrSpMVAlgorithm getAlgorithm() const
+		{
+			return entry_->forced;
+		}
+		/**
+		 * \brief Discards the analysis, it is recomputed on the next product
+		 */
+		void invalidate() const
+		{
+			entry_->valid = false;
+		}
+
+		/**
+		 * \brief Returns the analysis of the specified outer indices, computes it if needed
+		 */
+		const CsrRowAnalysis& get(const Matrix<int, Dynamic, 1, 1, ColumnMajor>& JA, Index rows, Index nnz) const
+		{
+			if (!entry_->valid || entry_->key.data() != JA.data() || entry_->rows != rows || entry_->nnz != nnz)
+			{
+				std::vector<int> ja(rows + 1);
+				JA.copyToHost(ja.data());
+				CsrRowAnalysis& a = entry_->analysis;
+				a.statistics = CsrRowStatistics::compute(ja.data(), rows);
+				a.algorithm = entry_->forced == CsrSpMVAlgorithm::Automatic
+					? CsrSpMVAlgorithmSelection::select(a.statistics)
+					: entry_->forced;
+				a.threadsPerRow = CsrSpMVAlgorithmSelection::threadsPerRow(a.statistics.meanRowLength);
+				if (a.algorithm == CsrSpMVAlgorithm::Stream)
+				{
+					const std::vector<int> blocks = CsrSpMVAlgorithmSelection::streamRowBlocks(ja.data(), rows);
+					a.streamRowBlocks = Matrix<int, Dynamic, 1, 1, ColumnMajor>(static_cast<Index>(blocks.size()));
+					a.streamRowBlocks.copyFromHost(blocks.data());
+				}
+				else
+					a.streamRowBlocks = Matrix<int, Dynamic, 1, 1, ColumnMajor>();
+				CUMAT_LOG_DEBUG("CSR row analysis: rows=" << rows << ", nnz=" << nnz
+					<< ", row length min=" << a.statistics.minRowLength << ", max=" << a.statistics.maxRowLength
+					<< ", mean=" << a.statistics.meanRowLength << ", stddev=" << a.statistics.stdDevRowLength
+					<< " -> algorithm " << static_cast<int>(a.algorithm));
+				entry_->key = JA;
+				entry_->rows = rows;
+				entry_->nnz = nnz;
+				entry_->valid = true;
+			}
+			return entry_->analysis;
+		}
+	};
+
+	/**
+	 * \brief Thread mapping of the evaluation of component-wise expressions into a CSR or CSC matrix.
+	 * The statistics are computed over the outer indices, i.e. \ref CsrRowStatistics::rows is the number of columns for CSC.
+	 * This runs on the host only and can be tested without a GPU.
+	 */
+	struct SparseCwiseEvaluationSelection
+	{
+		/**
+		 * \brief Below this number of entries, the evaluation is too small to profit from one thread per entry
+		 */
+		static constexpr int MIN_NNZ_PER_ENTRY = 4096;
+		/**
+		 * \brief Below this number of threads (outer indices times batches), one thread per outer index does not fill the device
+		 */
+		static constexpr int MIN_OUTER_THREADS = 8192;
+		/**
+		 * \brief The longest outer index may have this many times the mean length ...
+		 */
+		static constexpr int MAX_IMBALANCE = 4;
+		/**
+		 * \brief ... plus this number of entries to count as balanced
+		 */
+		static constexpr int MAX_IMBALANCE_SLACK = 32;
+
+		/**
+		 * \brief Tests if no outer index is much longer than the average,
+		 * then the threads of one thread per outer index finish at about the same time.
+		 */
+		static bool isBalanced(const CsrRowStatistics& s)
+		{
+			return s.maxRowLength <= MAX_IMBALANCE * s.meanRowLength + MAX_IMBALANCE_SLACK;
+		}
+
+		/**
+		 * \brief Selects the thread mapping from the statistics of the outer lengths
+		 * \param s the statistics of the outer lengths
+		 * \param batches the number of batches, every batch adds one thread per outer index
+		 * \return SparseCwiseEvaluation::PerOuter or SparseCwiseEvaluation::PerEntry
+		 */
+		static SparseCwiseEvaluation select(const CsrRowStatistics& s, Index batches)
+		{
+			if (s.nnz < MIN_NNZ_PER_ENTRY)
+				return SparseCwiseEvaluation::PerOuter;
+			if (!isBalanced(s))
+				return SparseCwiseEvaluation::PerEntry;
+			//balanced, but too few long outer indices
+			if (s.rows * batches < MIN_OUTER_THREADS)
+				return SparseCwiseEvaluation::PerEntry;
+			return SparseCwiseEvaluation::PerOuter;
+		}
+
+		/**
+		 * \brief Expands the outer indices: the outer index (row for CSR) of every entry
+		 * \param JA the outer indices, size outerSize+1
+		 * \param outerSize the number of rows (CSR) or columns (CSC)
+		 * \return the outer index of every entry, size nnz
+		 */
+		static std::vector<int> expandOuterIndices(const int* JA, Index outerSize)
+		{
+			std::vector<int> outer(outerSize > 0 ? JA[outerSize] - JA[0] : 0);
+			for (Index o = 0; o < outerSize; ++o)
+				std::fill(outer.begin() + (JA[o] - JA[0]), outer.begin() + (JA[o + 1] - JA[0]), static_cast<int>(o));
+			return outer;
+		}
+	};
+
+	/**
+	 * \brief Reference-counted cache of the thread mapping of component-wise evaluations into a CSR or CSC sparsity pattern.
+	 * All copies of a sparsity pattern share the same cache. The statistics of the outer lengths are computed on the host at
+	 * the first evaluation, the outer index of every entry only when the first evaluation with one thread per entry runs.
+	 * Both are recomputed when the outer indices, the outer size or the number of entries are replaced.
+	 * The cache keeps a reference to the outer indices, so their memory can't be reused by another pattern.
+	 */
+	class SparseCwiseEvaluationCache
+	{
+	public:
+		typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IndexVector;
+
+	private:
+		struct Entry
+		{
+			IndexVector key; //a reference keeps the memory from being recycled for another pattern
+			Index outerSize = -1;
+			Index nnz = -1;
+			bool valid = false;
+			SparseCwiseEvaluation forced = SparseCwiseEvaluation::Automatic;
+			CsrRowStatistics statistics;
+			IndexVector outerIndices;
+		};
+		Entry* entry_;
+		int* counter_;
+
+		__host__ __device__
+		void release()
+		{
+#ifndef __CUDA_ARCH__
+			//no decrement of the counter in CUDA-code, counter is in host-memory
+			if ((counter_) && (--(*counter_) == 0))
+			{
+				delete counter_;
+				delete entry_;
+			}
+#endif
+		}
+
+		void update(const IndexVector& JA, Index outerSize, Index nnz) const
+		{
+			if (entry_->valid && entry_->key.data() == JA.data() && entry_->outerSize == outerSize && entry_->nnz == nnz)
+				return;
+			std::vector<int> ja(outerSize + 1);
+			JA.copyToHost(ja.data());
+			entry_->statistics = CsrRowStatistics::compute(ja.data(), outerSize);
+			entry_->outerIndices = IndexVector();
+			entry_->key = JA;
+			entry_->outerSize = outerSize;
+			entry_->nnz = nnz;
+			entry_->valid = true;
+		}
+
+	public:
+		__host__ __device__
+		SparseCwiseEvaluationCache()
+			: entry_(nullptr)
+			, counter_(nullptr)
+		{
+#ifndef __CUDA_ARCH__
+			entry_ = new Entry();
+			counter_ = new int(1);
+#endif
+		}
+
+		__host__ __device__
+		SparseCwiseEvaluationCache(const SparseCwiseEvaluationCache& rhs)
+			: entry_(rhs.entry_)
+			, counter_(rhs.counter_)
+		{
+#ifndef __CUDA_ARCH__
+			if (counter_) ++(*counter_);
+#endif
+		}
+
+		__host__ __device__
+		SparseCwiseEvaluationCache& operator=(const SparseCwiseEvaluationCache& rhs)
+		{
+			if (this == &rhs) return *this;
+			release();
+			entry_ = rhs.entry_;
+			counter_ = rhs.counter_;
+#ifndef __CUDA_ARCH__
+			if (counter_) ++(*counter_);
+#endif
+			return *this;
+		}
+
+		__host__ __device__
+		~SparseCwiseEvaluationCache()
+		{
+			release();
+		}
+
+		/**
+		 * \brief Forces the specified thread mapping, or SparseCwiseEvaluation::Automatic to select it from the outer lengths again
+		 */
+		void setMode(SparseCwiseEvaluation mode) const
+		{
+			entry_->forced = mode;
+		}
+		/**
+		 * \return the forced thread mapping or SparseCwiseEvaluation::Automatic
+		 */
+		SparseCwiseEvaluation getMode() const
+		{
+			return entry_->forced;
+		}
+		/**
+		 * \brief Discards the statistics and outer indices, they are recomputed on the next evaluation
+		 */
+		void invalidate() const
+		{
+			entry_->valid = false;
+		}
+
+		/**
+		 * \brief Returns the thread mapping for the specified outer indices and batches, computes the statistics if needed
+		 */
+		SparseCwiseEvaluation select(const IndexVector& JA, Index outerSize, Index nnz, Index batches) const
+		{
+			if (entry_->forced != SparseCwiseEvaluation::Automatic)
+				return entry_->forced;
+			update(JA, outerSize, nnz);
+			const SparseCwiseEvaluation mode = SparseCwiseEvaluationSelection::select(entry_->statistics, batches);
+			CUMAT_LOG_DEBUG("Sparse cwise evaluation: outer size=" << outerSize << ", nnz=" << nnz
+				<< ", outer length max=" << entry_->statistics.maxRowLength << ", mean=" << entry_->statistics.meanRowLength
+				<< ", batches=" << batches << " -> mode " << static_cast<int>(mode));
+			return mode;
+		}
+
+		/**
+		 * \brief Returns the outer index of every entry of the specified outer indices, computes it if needed
+		 */
+		const IndexVector& outerIndices(const IndexVector& JA, Index outerSize, Index nnz) const
+		{
+			update(JA, outerSize, nnz);
+			if (entry_->outerIndices.size() != nnz)
+			{
+				std::vector<int> ja(outerSize + 1);
+				JA.copyToHost(ja.data());
+				const std::vector<int> outer = SparseCwiseEvaluationSelection::expandOuterIndices(ja.data(), outerSize);
+				entry_->outerIndices = IndexVector(nnz);
+				if (nnz > 0) entry_->outerIndices.copyFromHost(outer.data());
+			}
+			return entry_->outerIndices;
+		}
+	};
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,474 @@
+#ifndef __CUMAT_DEFLATED_CONJUGATE_GRADIENT_H__
+#define __CUMAT_DEFLATED_CONJUGATE_GRADIENT_H__
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <valarray>
+#include <vector>
+
+#include "Matrix.h"
+#include "UnaryOps.h"
+#include "BinaryOps.h"
+#include "ReductionOps.h"
+#include "ProductOp.h"
+#include "IterativeSolverBase.h"
+#include "ConjugateGradient.h"
+#include "BlockConjugateGradient.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    template<typename _MatrixType, typename _Preconditioner>
+    struct traits<DeflatedConjugateGradient<_MatrixType, _Preconditioner> >
+    {
+        using Scalar = typename internal::traits<_MatrixType>::Scalar;
+        using MatrixType = _MatrixType;
+        using Preconditioner = _Preconditioner;
+    };
+
+    /**
+     * \brief Selects the new deflation space of the DeflatedConjugateGradient by a Rayleigh-Ritz projection.
+     *
+     * The candidate space is spanned by the columns of Y (the old deflation space and the recycled search directions).
+     * With the projected matrices <tt>G = Y^T A Y</tt> and <tt>F = Y^T Y</tt>, the generalized eigenvalue problem
+     * <tt>G u = theta F u</tt> is solved and the Ritz vectors <tt>Y u</tt> of the \c m smallest Ritz values are selected.
+     * Linearly dependent (or zero) columns of Y are dropped with the threshold \c tolerance, see blockOrthonormalization().
+     *
+     * \param k the number of columns of Y
+     * \param G the column-major k x k matrix Y^T A Y, symmetrized internally
+     * \param F the column-major k x k matrix Y^T Y
+     * \param m the maximal number of Ritz vectors to select
+     * \param tolerance the relative singular value below which columns of Y are dropped
+     * \param U the column-major k x count matrix, the new deflation space is <tt>Y U</tt>
+     * \param ritzValues the selected Ritz values in increasing order, may be null
+     * \return the number of selected Ritz vectors (count)
+     */
+    template<typename _Real>
+    int recycleDeflationSpace(int k, const std::vector<_Real>& G, const std::vector<_Real>& F, int m, _Real tolerance,
+        std::vector<_Real>& U, std::vector<_Real>* ritzValues = nullptr)
+    {
+        std::vector<_Real> T;
+        const int rank = k > 0 ? blockOrthonormalization(k, F, tolerance, T) : 0;
+        //C = T^T G T, restricted to the first rank columns of T
+        std::vector<_Real> GT(k * rank, _Real(0)), C(rank * rank, _Real(0)), values, vectors;
+        for (int j = 0; j < rank; ++j) for (int l = 0; l < k; ++l) for (int i = 0; i < k; ++i)
+            GT[i + k * j] += _Real(0.5) * (G[i + k * l] + G[l + k * i]) * T[l + k * j];
+        for (int j = 0; j < rank; ++j) for (int i = 0; i < rank; ++i) for (int l = 0; l < k; ++l)
+            C[i + rank * j] += T[l + k * i] * GT[l + k * j];
+        if (rank > 0) symmetricEigenDecomposition(rank, C, values, vectors);
+        const int count = std::min(m, rank);
+        U.assign(k * count, _Real(0));
+        if (ritzValues) ritzValues->resize(count);
+        for (int j = 0; j < count; ++j)
+        {
+            //the eigenvalues are sorted in decreasing order, take them from the back
+            const int e = rank - 1 - j;
+            for (int l = 0; l < rank; ++l) for (int i = 0; i < k; ++i)
+                U[i + k * j] += T[i + k * l] * vectors[l + rank * e];
+            if (ritzValues) (*ritzValues)[j] = values[e];
+        }
+        return count;
+    }
+}
+
+/**
+ * \brief Deflated conjugate gradient that recycles a Krylov subspace across a sequence of solves.
+ *
+ * For a sequence of slowly changing systems, e.g. from time stepping, the slowly converging components
+ * belong to the same few small eigenvalues in every solve. This solver keeps a deflation space W of
+ * approximate eigenvectors to these eigenvalues and runs the CG in the A-orthogonal complement of W
+ * (Def-CG, Saad, Yeung, Erhel, Guyomarc'h 2000):
+ * \code
+ * x = x0 + W (W^T A W)^-1 W^T r0,  r = b - A x
+ * p = z - W (W^T A W)^-1 (AW)^T z   with z = M^-1 r
+ * \endcode
+ * The CG steps are unchanged apart from this projection of every new search direction,
+ * which costs two small dense matrix-vector products with the n x m matrices W and AW per iteration.
+ *
+ * After every solve, the first \ref recycledDirections() search directions and their products with A,
+ * which the CG computes anyway, are combined with the old deflation space. The Ritz vectors to the
+ * \ref deflationSize() smallest Ritz values in this space become the new deflation space.
+ * The approximation of the small eigenvectors thus improves from solve to solve.
+ *
+ * To carry the deflation space forward to the next system, either replace the matrix with \ref setMatrix(),
+ * which recomputes AW with the new matrix, or pass \ref deflationSpace() of this solver to
+ * \ref setDeflationSpace() of a new one.
+ *
+ * Only a single batch and real scalar types are supported.
+ *
+ * \tparam _MatrixType the type of the matrix, must have a single batch
+ * \tparam _Preconditioner the preconditioner object, default is DiagonalPreconditioner
+ */
+template<typename _MatrixType, typename _Preconditioner = DiagonalPreconditioner<_MatrixType>>
+class DeflatedConjugateGradient : public IterativeSolverBase<DeflatedConjugateGradient<_MatrixType, _Preconditioner>>
+{
+    CUMAT_STATIC_ASSERT(_MatrixType::Batches == 1, "The deflated Conjugate Gradient only supports matrices with a single batch");
+
+public:
+    using Type = DeflatedConjugateGradient<_MatrixType, _Preconditioner>;
+    using Base = IterativeSolverBase<Type>;
+    using typename Base::MatrixType;
+    using typename Base::Preconditioner;
+    using typename Base::Scalar;
+    using typename Base::RealScalar;
+    using Base::maxIterations;
+    CUMAT_STATIC_ASSERT(!internal::NumTraits<Scalar>::IsComplex, "The deflated Conjugate Gradient only supports real scalar types");
+    /** \brief The type of the deflation space W, the columns are the basis vectors */
+    typedef Matrix<Scalar, Dynamic, Dynamic, 1, ColumnMajor> BasisType;
+
+private:
+    using Base::matrix_;
+    using Base::preconditioner_;
+    using Base::tolerance_;
+    using Base::iterations_;
+    using Base::batchIterations_;
+    using Base::error_;
+    typedef Matrix<Scalar, Dynamic, 1, 1, ColumnMajor> VectorType;
+
+    Index deflationSize_ = 8;
+    Index recycledDirections_ = 32;
+    bool recycling_ = true;
+    mutable BasisType W_;     //the deflation space, n x m
+    mutable BasisType AW_;    //A*W
+    mutable BasisType Einv_;  //(W^T A W)^-1, m x m
+    mutable std::vector<Scalar> ritzValues_;
+
+public:
+
+    DeflatedConjugateGradient() = default;
+
+    /**
+     * \brief Initializes the deflated Conjugate Gradient with the specified matrix and an empty deflation space.
+     * The preconditioner is created with \code Preconditioner(matrix) \endcode.
+     * \param matrix the matrix that is used in the CG.
+     */
+    DeflatedConjugateGradient(const MatrixBase<_MatrixType>& matrix)
+        : Base(matrix)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /**
+     * \brief Initializes the deflated Conjugate Gradient with the specified matrix
+     * and specified preconditioner and an empty deflation space.
+     * \param matrix the matrix that is used in the CG.
+     * \param preconditioner the preconditioner that is used
+     */
+    DeflatedConjugateGradient(const MatrixBase<_MatrixType>& matrix, const _Preconditioner& preconditioner)
+        : Base(matrix, preconditioner)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /**
+     * \brief Replaces the matrix for the next solves and keeps the deflation space.
+     * The preconditioner is recreated with \code Preconditioner(matrix) \endcode and A*W is recomputed.
+     * \param matrix the new matrix of the same size
+     */
+    Type& setMatrix(const MatrixBase<_MatrixType>& matrix)
+    {
+        return setMatrix(matrix, Preconditioner(matrix.derived()));
+    }
+
+    /**
+     * \brief Replaces the matrix and the preconditioner for the next solves and keeps the deflation space.
+     * A*W is recomputed with the new matrix.
+     * \param matrix the new matrix of the same size
+     * \param preconditioner the new preconditioner
+     */
+    Type& setMatrix(const MatrixBase<_MatrixType>& matrix, const _Preconditioner& preconditioner)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+        CUMAT_ASSERT((W_.cols() == 0 || matrix.rows() == W_.rows()) && "The size of the matrix must not change");
+        matrix_ = matrix.derived();
+        preconditioner_ = preconditioner;
+        if (W_.cols() > 0) updateProjection(true);
+        return *this;
+    }
+
+    /** \returns the maximal number of vectors in the deflation space, default is 8 */
+    Index deflationSize() const { return deflationSize_; }
+    /** Sets the maximal number of vectors in the deflation space.
+     * The current space is truncated at the next update.
+     */
+    Type& setDeflationSize(Index m)
+    {
+        CUMAT_ASSERT_ARGUMENT(m >= 0);
+        deflationSize_ = m;
+        return *this;
+    }
+
+    /** \returns the number of search directions of every solve that are used to update the deflation space, default is 32 */
+    Index recycledDirections() const { return recycledDirections_; }
+    /** Sets the number of search directions (the first ones of every solve) that are used to update the deflation space.
+     * Every recycled direction costs the memory of two vectors during the solve.
+     */
+    Type& setRecycledDirections(Index l)
+    {
+        CUMAT_ASSERT_ARGUMENT(l >= 0);
+        recycledDirections_ = l;
+        return *this;
+    }
+
+    /** \returns true iff the deflation space is updated after every solve */
+    bool recycling() const { return recycling_; }
+    /** Enables or disables the update of the deflation space after every solve.
+     * If disabled, the current deflation space is kept fixed. Default: enabled.
+     */
+    Type& setRecycling(bool enabled)
+    {
+        recycling_ = enabled;
+        return *this;
+    }
+
+    /** \returns the current deflation space W, an n x m matrix with the approximate eigenvectors as columns */
+    const BasisType& deflationSpace() const { return W_; }
+    /** \returns the number of vectors in the current deflation space */
+    Index deflationSpaceSize() const { return W_.cols(); }
+    /** \returns the Ritz values of the vectors in the deflation space, computed in the last update, in increasing order */
+    const std::vector<Scalar>& ritzValues() const { return ritzValues_; }
+
+    /**
+     * \brief Sets the deflation space, e.g. the space of another solver for a previous system in a sequence.
+     * The space is orthonormalized and reduced to the Ritz vectors of the current matrix, linearly dependent columns are dropped.
+     * \param W the n x m matrix with the basis vectors of the deflation space as columns
+     */
+    Type& setDeflationSpace(const BasisType& W)
+    {
+        CUMAT_ASSERT(W.cols() == 0 || W.rows() == matrix_.rows());
+        W_ = W.deepClone();
+        if (W_.cols() == 0)
+        {
+            clearDeflationSpace();
+            return *this;
+        }
+        AW_ = BasisType(W_.rows(), W_.cols());
+        computeAW();
+        //Rayleigh-Ritz in the given space
+        const int k = static_cast<int>(W_.cols());
+        BasisType gDevice = W_.transpose() * AW_;
+        BasisType fDevice = W_.transpose() * W_;
+        std::vector<Scalar> G(k * k), F(k * k), U;
+        gDevice.copyToHost(G.data());
+        fDevice.copyToHost(F.data());
+        const int count = internal::recycleDeflationSpace<Scalar>(k, G, F, static_cast<int>(deflationSize_), deflationTolerance(), U, &ritzValues_);
+        applyTransformation(W_, AW_, k, count, U);
+        updateProjection(false);
+        return *this;
+    }
+
+    /** Removes all vectors from the deflation space, the next solve is a plain (preconditioned) CG */
+    Type& clearDeflationSpace()
+    {
+        W_ = BasisType();
+        AW_ = BasisType();
+        Einv_ = BasisType();
+        ritzValues_.clear();
+        return *this;
+    }
+
+    template<typename _RHS, typename _Target>
+    void _solve_impl(const MatrixBase<_RHS>& rhs, MatrixBase<_Target>& target) const
+    {
+        VectorType guess(target.rows());
+        guess.setZero();
+        _solve_with_guess_impl(rhs.derived(), target.derived(), guess);
+    }
+
+    template<typename _RHS, typename _Target, typename _Guess>
+    void _solve_with_guess_impl(_RHS& rhs, _Target& target, _Guess& guess) const
+    {
+        CUMAT_STATIC_ASSERT(_Target::Batches == 1, "The target matrix must have a single batch");
+        CUMAT_STATIC_ASSERT(_Target::Columns == 1, "The target must be a compile-time column vector");
+        CUMAT_STATIC_ASSERT(_Guess::Columns == 1, "The initial guess must be a compile-time column vector");
+        CUMAT_ASSERT(matrix_.cols() == rhs.rows());
+        typedef Matrix<RealScalar, 1, 1, 1, 0> RealScalarDevice;
+        using std::sqrt;
+        const Index n = matrix_.cols();
+        const Index m = W_.cols();
+
+        //initialize result and counter
+        iterations_ = 0;
+        batchIterations_.assign(1, 0);
+        error_ = 0;
+        target.inplace() = guess;
+
+        const RealScalar rhsNorm2 = static_cast<RealScalar>(rhs.squaredNorm());
+        if (rhsNorm2 == 0)
+        {
+            //early out, right-hand side is zero
+            target.setZero();
+            return;
+        }
+        const RealScalar threshold = tolerance_ * tolerance_ * rhsNorm2;
+        VectorType residual = rhs - matrix_ * target;
+        VectorType mu, nu;
+        if (m > 0)
+        {
+            //x = x0 + W (W^T A W)^-1 W^T r0, the new residual is r0 - AW (W^T A W)^-1 W^T r0
+            mu = W_.transpose() * residual;
+            nu = Einv_ * mu;
+            target += W_ * nu;
+            nu = -nu;
+            residual += AW_ * nu;
+        }
+        RealScalar residualNorm2 = static_cast<RealScalar>(residual.squaredNorm());
+        if (residualNorm2 < threshold)
+        {
+            //early out, already close enough to the solution
+            error_ = sqrt(residualNorm2 / rhsNorm2);
+            return;
+        }
+
+        //the deflation space and the recycled search directions (and their products with A) span the next deflation space
+        const Index l = recycling_ ? std::min(recycledDirections_, maxIterations()) : 0;
+        BasisType Y, AY;
+        if (l > 0)
+        {
+            Y = BasisType(n, m + l);
+            AY = BasisType(n, m + l);
+            Y.setZero();
+            AY.setZero();
+            if (m > 0)
+            {
+                Y.block(0, 0, 0, n, m, 1) = W_;
+                AY.block(0, 0, 0, n, m, 1) = AW_;
+            }
+        }
+
+        VectorType p(n), z(n), tmp(n);
+        z.inplace() = preconditioner_.solve(residual);
+        p.inplace() = z;
+        projectDirection(p, z, mu, nu);
+        RealScalarDevice absNew = residual.dot(z);
+
+        Index i = 0;
+        const Index maxIter = maxIterations();
+        batchIterations_[0] = maxIter;
+        while (i < maxIter)
+        {
+            tmp.inplace() = matrix_ * p; // the bottleneck of the algorithm
+            if (i < l)
+            {
+                Y.col(m + i) = p;
+                AY.col(m + i) = tmp;
+            }
+
+            auto alpha = absNew.cwiseDiv(p.dot(tmp)); // the amount we travel on dir
+            target += alpha.template cast<Scalar>().cwiseMul(p); // update solution
+            residual -= alpha.template cast<Scalar>().cwiseMul(tmp); // update residual
+
+            residualNorm2 = static_cast<RealScalar>(residual.squaredNorm());
+            if (residualNorm2 < threshold)
+            {
+                batchIterations_[0] = i;
+                break;
+            }
+
+            z.inplace() = preconditioner_.solve(residual); // approximately solve for "A z = residual"
+            RealScalarDevice absOld = absNew;
+            absNew = residual.dot(z);
+            auto beta = absNew.cwiseDiv(absOld);
+            p.inplace() = z + beta.template cast<Scalar>().cwiseMul(p); // update search direction
+            projectDirection(p, z, mu, nu); // keep the search direction A-orthogonal to the deflation space
+            i++;
+        }
+        error_ = sqrt(residualNorm2 / rhsNorm2);
+        iterations_ = i;
+
+        if (l > 0) recycle(Y, AY);
+    }
+
+private:
+    static RealScalar deflationTolerance()
+    {
+        return 10 * std::sqrt(std::numeric_limits<RealScalar>::epsilon());
+    }
+
+    // p -= W (W^T A W)^-1 (AW)^T z
+    void projectDirection(VectorType& p, const VectorType& z, VectorType& mu, VectorType& nu) const
+    {
+        if (W_.cols() == 0) return;
+        mu = AW_.transpose() * z;
+        nu = Einv_ * mu;
+        nu = -nu;
+        p += W_ * nu;
+    }
+
+    // AW = A*W, column by column
+    void computeAW() const
+    {
+        for (Index j = 0; j < W_.cols(); ++j)
+        {
+            VectorType w = W_.col(j);
+            VectorType aw = matrix_ * w;
+            AW_.col(j) = aw;
+        }
+    }
+
+    // W = W*U, AW = AW*U with the k x count matrix U
+    static void applyTransformation(BasisType& W, BasisType& AW, int k, int count, const std::vector<Scalar>& U)
+    {
+        if (count == 0)
+        {
+            W = BasisType();
+            AW = BasisType();
+            return;
+        }
+        BasisType UDevice(k, count);
+        UDevice.copyFromHost(U.data());
+        BasisType W2 = W * UDevice;
+        BasisType AW2 = AW * UDevice;
+        W = W2;
+        AW = AW2;
+    }
+
+    // Recomputes (optionally A*W and) the inverse of the projected matrix W^T A W on the host
+    void updateProjection(bool recomputeAW) const
+    {
+        const int m = static_cast<int>(W_.cols());
+        if (m == 0)
+        {
+            Einv_ = BasisType();
+            return;
+        }
+        if (recomputeAW) computeAW();
+        BasisType eDevice = W_.transpose() * AW_;
+        std::vector<Scalar> E(m * m), inv(m * m, Scalar(0));
+        eDevice.copyToHost(E.data());
+        for (int j = 0; j < m; ++j)
+        {
+            for (int i = 0; i < j; ++i)
+                E[i + m * j] = E[j + m * i] = Scalar(0.5) * (E[i + m * j] + E[j + m * i]);
+            inv[j + m * j] = Scalar(1);
+        }
+        internal::smallCholeskySolve<Scalar>(m, m, E, inv);
+        Einv_ = BasisType(m, m);
+        Einv_.copyFromHost(inv.data());
+    }
+
+    // Selects the Ritz vectors to the smallest Ritz values in the span of the columns of Y as the new deflation space
+    void recycle(const BasisType& Y, const BasisType& AY) const
+    {
+        const int K = static_cast<int>(Y.cols());
+        BasisType gDevice = Y.transpose() * AY;
+        BasisType fDevice = Y.transpose() * Y;
+        std::vector<Scalar> G(K * K), F(K * K), U;
+        gDevice.copyToHost(G.data());
+        fDevice.copyToHost(F.data());
+        //the columns of Y that were not filled (the solve converged in less than l iterations) are zero and dropped by the orthonormalization
+        const int count = internal::recycleDeflationSpace<Scalar>(K, G, F, static_cast<int>(deflationSize_), deflationTolerance(), U, &ritzValues_);
+        W_ = Y;
+        AW_ = AY;
+        applyTransformation(W_, AW_, K, count, U);
+        updateProjection(false);
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -207,14 +207,32 @@ template<int _SparseFlags> struct SparsityPattern;
 template<typename _Derived> class SparseMatrixBase;
 template<typename _Scalar, int _Batches, int _SparseFlags> class SparseMatrix;
 template<typename _Child, int _SparseFlags> class SparseExpressionOp;
+template<typename _Scalar, int _BlockRows, int _BlockCols, int _Batches = 1> class BlockSparseMatrix;
 
 // ITERATIVE LINEAR SOLVER
 
 template<typename _Solver, typename _RHS, typename _Guess> class SolveWithGuessOp;
 template<typename _SolverImpl> class IterativeSolverBase;
 template<typename _MatrixType, typename _Preconditioner> class ConjugateGradient;
+template<typename _MatrixType, typename _Preconditioner> class PipelinedConjugateGradient;
+template<typename _MatrixType, typename _Preconditioner> class BiCGSTAB;
+template<typename _MatrixType, typename _Preconditioner> class GMRES;
+template<typename _MatrixType, typename _Preconditioner> class BlockConjugateGradient;
+template<typename _MatrixType, typename _Preconditioner> class DeflatedConjugateGradient;
 template<typename _MatrixType> class DiagonalPreconditioner;
 template<typename _MatrixType> class IdentityPreconditioner;
+template<typename _Derived> class MatrixFreeOperatorBase;
+template<typename _Scalar, int _Batches = 1> class Stencil5PointOperator;
+template<typename _Scalar, int _Batches = 1> class Stencil7PointOperator;
+struct AMGSettings;
+template<typename _MatrixType> class AlgebraicMultigridPreconditioner;
+template<typename _MatrixType> class IncompleteLUPreconditioner;
+template<typename _MatrixType> class IncompleteCholeskyPreconditioner;
+class SparseTriangularSolver;
+template<typename _MatrixType> class ChebyshevPreconditioner;
+template<typename _MatrixType> class NeumannPreconditioner;
+template<typename _MatrixType> class BlockJacobiPreconditioner;
+template<typename _MatrixType, typename _InnerSolver> class MixedPrecisionRefinement;
 
 CUMAT_NAMESPACE_END
 
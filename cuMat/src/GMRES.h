@@ -0,0 +1,467 @@
+#ifndef __CUMAT_GMRES_H__
+#define __CUMAT_GMRES_H__
+
+#include "Macros.h"
+
+#include <cmath>
+#include <vector>
+#include <valarray>
+
+#include "Matrix.h"
+#include "UnaryOps.h"
+#include "BinaryOps.h"
+#include "ReductionOps.h"
+#include "IterativeSolverBase.h"
+#include "ConvergenceCheck.h"
+#include "ConjugateGradient.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    template<typename _MatrixType, typename _Preconditioner>
+    struct traits<GMRES<_MatrixType, _Preconditioner> >
+    {
+        using MScalar = typename internal::traits<_MatrixType>::Scalar;
+        using Scalar = typename internal::NumTraits<MScalar>::ElementalType;
+        using MatrixType = _MatrixType;
+        using Preconditioner = _Preconditioner;
+    };
+
+    /**
+     * \brief Launch parameters of the fused multi-dot products of GMRES
+     */
+    struct GMRESConfig
+    {
+        /**
+         * \brief The block size of the multi-dot kernel
+         */
+        static constexpr int BLOCK_SIZE = 256;
+        /**
+         * \brief Every block processes at least that many entries per thread
+         */
+        static constexpr int MIN_ITEMS_PER_THREAD = 8;
+        /**
+         * \brief The maximal number of blocks per dot product and batch
+         */
+        static constexpr int MAX_CHUNKS = 64;
+
+        /**
+         * \brief Returns the number of blocks that compute partial sums of a single dot product.
+         * \param size the length of the vectors
+         * \param numDots the number of dot products computed in one launch
+         */
+        static int numChunks(Index size, int numDots)
+        {
+            const Index chunks = CUMAT_DIV_UP(size, Index(BLOCK_SIZE) * MIN_ITEMS_PER_THREAD);
+            return static_cast<int>(std::max(Index(1), std::min(chunks, Index(CUMAT_DIV_UP(MAX_CHUNKS, numDots)))));
+        }
+    };
+
+#if CUMAT_NVCC == 1
+    namespace kernels
+    {
+        // out[j + outStride*b] += (basis[j], w) for j<numVecs, grid: x=chunks, y=vector j, z=batch; out must be zeroed
+        template<typename _Scalar, int BlockSize>
+        __global__ void GMRESMultiDotKernel(Index size, const _Scalar* const* basis, const _Scalar* w, _Scalar* out, int outStride)
+        {
+            typedef cub::BlockReduce<_Scalar, BlockSize> BlockReduceT;
+            __shared__ typename BlockReduceT::TempStorage temp_storage;
+
+            const int j = blockIdx.y;
+            const Index batch = blockIdx.z;
+            const _Scalar* v = basis[j] + batch * size;
+            const _Scalar* x = w + batch * size;
+            _Scalar sum = 0;
+            for (Index i = blockIdx.x * BlockSize + threadIdx.x; i < size; i += gridDim.x * BlockSize)
+                sum += v[i] * x[i];
+            sum = BlockReduceT(temp_storage).Sum(sum);
+            if (threadIdx.x == 0)
+                atomicAdd(out + j + outStride * batch, sum);
+        }
+
+        // w -= sum_j basis[j] * h[j]
+        template<typename _Scalar>
+        __global__ void GMRESOrthogonalizeKernel(dim3 virtual_size, const _Scalar* const* basis, int numVecs,
+            const _Scalar* h, int hStride, _Scalar* w)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                const Index idx = i + batch * virtual_size.x;
+                _Scalar v = w[idx];
+                for (int j = 0; j < numVecs; ++j)
+                    v -= basis[j][idx] * h[j + hStride * batch];
+                w[idx] = v;
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        // out = w * scale[batch]
+        template<typename _Scalar>
+        __global__ void GMRESScaleKernel(dim3 virtual_size, const _Scalar* w, const _Scalar* scale, _Scalar* out)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                const Index idx = i + batch * virtual_size.x;
+                out[idx] = w[idx] * scale[batch];
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        // out = sum_{j<numCols[batch]} basis[j] * y[j]
+        template<typename _Scalar>
+        __global__ void GMRESCombineKernel(dim3 virtual_size, const _Scalar* const* basis, const _Scalar* y, int yStride,
+            const int* numCols, _Scalar* out)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                const Index idx = i + batch * virtual_size.x;
+                _Scalar v = 0;
+                for (int j = 0; j < numCols[batch]; ++j)
+                    v += basis[j][idx] * y[j + yStride * batch];
+                out[idx] = v;
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        // One thread per batch: starts a new cycle with the residual norm (squared) rn2
+        template<typename _Scalar>
+        __global__ void GMRESRestartKernel(dim3 virtual_size, int restart, const _Scalar* rn2,
+            _Scalar* g, _Scalar* scale, int* numCols)
+        {
+            CUMAT_KERNEL_1D_LOOP(batch, virtual_size)
+                const _Scalar beta = sqrt(rn2[batch]);
+                _Scalar* gb = g + (restart + 1) * batch;
+                gb[0] = beta;
+                for (int j = 1; j <= restart; ++j) gb[j] = 0;
+                scale[batch] = beta > 0 ? _Scalar(1) / beta : _Scalar(0);
+                numCols[batch] = 0;
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        // One thread per batch: the batched least-squares update of the Hessenberg system.
+        // The new column h (the sum of both Gram-Schmidt passes and the norm of w) is rotated with the previous
+        // Givens rotations, a new rotation eliminates the subdiagonal and is applied to the right hand side g.
+        template<typename _Scalar>
+        __global__ void GMRESGivensKernel(dim3 virtual_size, int restart, const _Scalar* hc, const _Scalar* wNorm2,
+            const int* convergedAt, _Scalar* R, _Scalar* cs, _Scalar* sn, _Scalar* g, int* numCols,
+            _Scalar* scale, _Scalar* rn2)
+        {
+            CUMAT_KERNEL_1D_LOOP(batch, virtual_size)
+                const _Scalar wNorm = sqrt(wNorm2[batch]);
+                scale[batch] = wNorm > 0 ? _Scalar(1) / wNorm : _Scalar(0);
+                if (convergedAt[batch] >= 0) continue; //frozen
+                const int k = numCols[batch];
+                const int m = restart;
+                const _Scalar* h0 = hc + 2 * (m + 1) * batch;
+                const _Scalar* h1 = h0 + (m + 1);
+                _Scalar* Rk = R + m * m * batch + m * k;
+                _Scalar* c = cs + m * batch;
+                _Scalar* s = sn + m * batch;
+                _Scalar* gb = g + (m + 1) * batch;
+                // assemble the new column and apply the previous rotations
+                for (int i = 0; i <= k; ++i) Rk[i] = h0[i] + h1[i];
+                _Scalar hk1 = wNorm;
+                for (int i = 0; i < k; ++i)
+                {
+                    const _Scalar t = c[i] * Rk[i] + s[i] * Rk[i + 1];
+                    Rk[i + 1] = -s[i] * Rk[i] + c[i] * Rk[i + 1];
+                    Rk[i] = t;
+                }
+                // new rotation
+                const _Scalar r = sqrt(Rk[k] * Rk[k] + hk1 * hk1);
+                const _Scalar ck = r > 0 ? Rk[k] / r : _Scalar(1);
+                const _Scalar sk = r > 0 ? hk1 / r : _Scalar(0);
+                c[k] = ck;
+                s[k] = sk;
+                Rk[k] = r;
+                gb[k + 1] = -sk * gb[k];
+                gb[k] = ck * gb[k];
+                numCols[batch] = k + 1;
+                rn2[batch] = gb[k + 1] * gb[k + 1];
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        // One thread per batch: solves R y = g by back substitution
+        template<typename _Scalar>
+        __global__ void GMRESBackSubstitutionKernel(dim3 virtual_size, int restart, const _Scalar* R, const _Scalar* g,
+            const int* numCols, _Scalar* y)
+        {
+            CUMAT_KERNEL_1D_LOOP(batch, virtual_size)
+                const int m = restart;
+                const int k = numCols[batch];
+                const _Scalar* Rb = R + m * m * batch;
+                const _Scalar* gb = g + (m + 1) * batch;
+                _Scalar* yb = y + m * batch;
+                for (int i = k - 1; i >= 0; --i)
+                {
+                    _Scalar v = gb[i];
+                    for (int j = i + 1; j < k; ++j)
+                        v -= Rb[i + m * j] * yb[j];
+                    yb[i] = Rb[i + m * i] != 0 ? v / Rb[i + m * i] : _Scalar(0);
+                }
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+    }
+#endif
+}
+
+/**
+ * \brief Restarted generalized minimal residual solver GMRES(m) for general square, possibly nonsymmetric matrices.
+ *
+ * This class allows to solve for A*x=b linear problems using \code x = GMRES(A).setRestart(m).solve(b) \endcode.
+ * The requirements on the matrix and the right hand side are the same as for the ConjugateGradient,
+ * the preconditioner is applied from the right, hence the reported error is the true relative residual.
+ *
+ * The Krylov basis is orthogonalized with classical Gram-Schmidt with one reorthogonalization (CGS2).
+ * Each pass computes all dot products against the basis in one fused kernel and subtracts the projection in one kernel.
+ * The small least-squares problem of the Hessenberg matrix is updated with Givens rotations on the device,
+ * one thread per batch, which also yields the residual norm without an additional reduction.
+ * All batches are processed together; a batch that has converged is frozen until all batches have converged.
+ * The convergence is always evaluated on the device, see IterativeSolverBase::setConvergenceCheckInterval();
+ * an interval of 0 (the default) waits for the device in every iteration.
+ *
+ * The scalar type has to be real (float or double).
+ *
+ * \tparam _MatrixType any matrix expression with an operator* that takes a dense column vector as right hand side
+ * \tparam _Preconditioner the preconditioner object, default is DiagonalPreconditioner
+ */
+template<typename _MatrixType, typename _Preconditioner = DiagonalPreconditioner<_MatrixType>>
+class GMRES : public IterativeSolverBase<GMRES<_MatrixType, _Preconditioner>>
+{
+    CUMAT_STATIC_ASSERT(_MatrixType::Batches != Dynamic, "GMRES can only work on matrices with compile-time batch count");
+
+public:
+    using Type = GMRES<_MatrixType, _Preconditioner>;
+    using Base = IterativeSolverBase<Type>;
+    using typename Base::MatrixType;
+    using typename Base::Preconditioner;
+    using typename Base::Scalar;
+    using typename Base::RealScalar;
+    using Base::maxIterations;
+
+private:
+    using Base::matrix_;
+    using Base::preconditioner_;
+    using Base::tolerance_;
+    using Base::iterations_;
+    using Base::batchIterations_;
+    using Base::error_;
+    using Base::convergenceCheckInterval_;
+    Index restart_ = 30;
+
+public:
+
+    GMRES() = default;
+
+    /**
+     * \brief Initializes the GMRES with the specified matrix.
+     * The preconditioner is created with \code Preconditioner(matrix) \endcode.
+     * \param matrix the matrix that is used in the GMRES.
+     */
+    GMRES(const MatrixBase<_MatrixType>& matrix)
+        : Base(matrix)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /**
+     * \brief Initializes the GMRES with the specified matrix
+     * and specified preconditioner.
+     * \param matrix the matrix that is used in the GMRES.
+     * \param preconditioner the preconditioner that is used
+     */
+    GMRES(const MatrixBase<_MatrixType>& matrix, const _Preconditioner& preconditioner)
+        : Base(matrix, preconditioner)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /** \returns the number of iterations between two restarts, i.e. the dimension of the Krylov subspace. */
+    Index restart() const { return restart_; }
+
+    /** Sets the number of iterations between two restarts, i.e. the dimension of the Krylov subspace.
+      * Default is 30.
+      */
+    Type& setRestart(Index restart)
+    {
+        CUMAT_ASSERT_ARGUMENT(restart > 0);
+        restart_ = restart;
+        return *this;
+    }
+
+    template<typename _RHS, typename _Target>
+    void _solve_impl(const MatrixBase<_RHS>& rhs, MatrixBase<_Target>& target) const
+    {
+        typedef Matrix<typename _Target::Scalar, Dynamic, 1, _Target::Batches, _Target::Flags> GuessType;
+        GuessType guess(target.rows(), 1, target.batches());
+        guess.setZero();
+        _solve_with_guess_impl(rhs.derived(), target.derived(), guess);
+    }
+
+    template<typename _RHS, typename _Target, typename _Guess>
+    void _solve_with_guess_impl(_RHS& rhs, _Target& target, _Guess& guess) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(GMRES)
+        CUMAT_STATIC_ASSERT(_Target::Batches != Dynamic, "The target matrix must have a compile-time batch count");
+        CUMAT_STATIC_ASSERT(_Target::Columns == 1, "The target must be a compile-time column vector");
+        CUMAT_STATIC_ASSERT(_Guess::Batches != Dynamic, "The initial guess must have a compile-time batch count");
+        CUMAT_STATIC_ASSERT(_Guess::Columns == 1, "The initial guess must be a compile-time column vector");
+        CUMAT_ASSERT(matrix_.cols() == rhs.rows());
+        constexpr int Batches = _Target::Batches;
+        typedef typename _Target::Scalar VectorScalarType;
+        CUMAT_STATIC_ASSERT((std::is_same<VectorScalarType, RealScalar>::value),
+            "GMRES only supports real scalar types");
+
+        //initialize result and counter
+        iterations_ = 0;
+        batchIterations_.assign(Batches, 0);
+        error_ = 0;
+        target.inplace() = guess;
+
+        typedef Matrix<RealScalar, 1, 1, Batches, 0> RealScalarDevice;
+        typedef Matrix<int, 1, 1, Batches, 0> IntDevice;
+        typedef Matrix<VectorScalarType, Dynamic, 1, Batches, _Target::Flags> VectorType;
+        using std::sqrt;
+        const Index n = matrix_.cols();
+
+        VectorType r = rhs - matrix_ * target; //initial residual
+        std::valarray<RealScalar> rhsNorm2(Batches);
+        rhs.squaredNorm().eval().copyToHost(&rhsNorm2[0]);
+        bool all = true;
+        for (int b = 0; b < Batches; ++b) all = all && (rhsNorm2[b] < tolerance_ * tolerance_);
+        if (all)
+        {
+            //early out, right-hand side is zero
+            target.setZero();
+            return;
+        }
+        std::valarray<RealScalar> threshold = tolerance_ * tolerance_ * rhsNorm2;
+        std::valarray<RealScalar> residualNorm2(Batches);
+        r.squaredNorm().eval().copyToHost(&residualNorm2[0]);
+        all = true;
+        for (int b = 0; b < Batches; ++b) all = all && residualNorm2[b] < threshold[b];
+        if (all)
+        {
+            //early out, already close enough to the solution
+            error_ = sqrt((residualNorm2 / rhsNorm2).max());
+            return;
+        }
+
+#if CUMAT_NVCC == 1
+        //----------------
+        // GMRES(m) ALGORITHM
+        //----------------
+        typedef internal::GMRESConfig Config;
+        const int m = static_cast<int>(std::min(restart_, n));
+        const Index maxIter = maxIterations();
+        const internal::ConvergenceCheckSchedule schedule(std::max(Index(1), convergenceCheckInterval_), maxIter);
+        Context& ctx = Context::current();
+
+        RealScalarDevice thresholdDevice(1, 1, Batches);
+        thresholdDevice.copyFromHost(&threshold[0]);
+        IntDevice convergedAt = IntDevice::Constant(1, 1, Batches, -1); //per batch: iteration of convergence or -1
+        internal::MappedConvergenceStatus status;
+
+        //Krylov basis, every vector is allocated separately so that it can be passed to the matrix and preconditioner
+        std::vector<VectorType> basis;
+        std::vector<VectorScalarType*> basisPointersHost;
+        for (int j = 0; j < m; ++j)
+        {
+            basis.push_back(VectorType(n, 1, Batches));
+            basisPointersHost.push_back(basis.back().data());
+        }
+        DevicePointer<VectorScalarType*> basisPointers(m);
+        CUMAT_SAFE_CALL(cudaMemcpy(basisPointers.pointer(), basisPointersHost.data(),
+            sizeof(VectorScalarType*) * m, cudaMemcpyHostToDevice));
+
+        //the batched Hessenberg least-squares system
+        DevicePointer<RealScalar> hc(2 * (m + 1) * Batches); //projections of both Gram-Schmidt passes
+        DevicePointer<RealScalar> R(m * m * Batches), cs(m * Batches), sn(m * Batches), g((m + 1) * Batches), y(m * Batches);
+        IntDevice numCols(1, 1, Batches);
+        RealScalarDevice scale(1, 1, Batches), wNorm2(1, 1, Batches), rn2(1, 1, Batches);
+        VectorType w(n, 1, Batches), z(n, 1, Batches);
+
+        KernelLaunchConfig cfgVec = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), Batches,
+            internal::kernels::GMRESOrthogonalizeKernel<VectorScalarType>);
+        KernelLaunchConfig cfgBatch = ctx.createLaunchConfig1D(Batches,
+            internal::kernels::GMRESGivensKernel<VectorScalarType>);
+
+        Index i = 0;
+        bool converged = false;
+        while (i < maxIter && !converged)
+        {
+            //start a new cycle: v0 = r / |r|
+            rn2 = r.squaredNorm();
+            internal::kernels::GMRESRestartKernel<VectorScalarType>
+                <<<cfgBatch.block_count, cfgBatch.thread_per_block, 0, ctx.stream()>>>(
+                    cfgBatch.virtual_size, m, rn2.data(), g.pointer(), scale.data(), numCols.data());
+            CUMAT_CHECK_ERROR();
+            internal::kernels::GMRESScaleKernel<VectorScalarType>
+                <<<cfgVec.block_count, cfgVec.thread_per_block, 0, ctx.stream()>>>(
+                    cfgVec.virtual_size, r.data(), scale.data(), basis[0].data());
+            CUMAT_CHECK_ERROR();
+
+            for (int k = 0; k < m && i < maxIter; ++k, ++i)
+            {
+                //w = A M^-1 v_k
+                z.inplace() = preconditioner_.solve(basis[k]);
+                w.inplace() = matrix_ * z; // the bottleneck of the algorithm
+
+                //CGS2: two passes of fused multi-dot + projection
+                CUMAT_SAFE_CALL(cudaMemsetAsync(hc.pointer(), 0, sizeof(RealScalar) * 2 * (m + 1) * Batches, ctx.stream()));
+                const int numChunks = Config::numChunks(n, k + 1);
+                for (int pass = 0; pass < 2; ++pass)
+                {
+                    internal::kernels::GMRESMultiDotKernel<VectorScalarType, Config::BLOCK_SIZE>
+                        <<<dim3(numChunks, k + 1, Batches), Config::BLOCK_SIZE, 0, ctx.stream()>>>(
+                            n, basisPointers.pointer(), w.data(), hc.pointer() + pass * (m + 1), 2 * (m + 1));
+                    CUMAT_CHECK_ERROR();
+                    internal::kernels::GMRESOrthogonalizeKernel<VectorScalarType>
+                        <<<cfgVec.block_count, cfgVec.thread_per_block, 0, ctx.stream()>>>(
+                            cfgVec.virtual_size, basisPointers.pointer(), k + 1, hc.pointer() + pass * (m + 1), 2 * (m + 1), w.data());
+                    CUMAT_CHECK_ERROR();
+                }
+
+                //least-squares update, residual norm estimate and convergence test
+                wNorm2 = w.squaredNorm();
+                internal::kernels::GMRESGivensKernel<VectorScalarType>
+                    <<<cfgBatch.block_count, cfgBatch.thread_per_block, 0, ctx.stream()>>>(
+                        cfgBatch.virtual_size, m, hc.pointer(), wNorm2.data(), convergedAt.data(),
+                        R.pointer(), cs.pointer(), sn.pointer(), g.pointer(), numCols.data(), scale.data(), rn2.data());
+                CUMAT_CHECK_ERROR();
+                internal::checkConvergence(rn2, thresholdDevice, convergedAt, status, i);
+                if (k + 1 < m)
+                {
+                    internal::kernels::GMRESScaleKernel<VectorScalarType>
+                        <<<cfgVec.block_count, cfgVec.thread_per_block, 0, ctx.stream()>>>(
+                            cfgVec.virtual_size, w.data(), scale.data(), basis[k + 1].data());
+                    CUMAT_CHECK_ERROR();
+                }
+
+                if (schedule.isCheckIteration(i) && status.wait())
+                {
+                    converged = true;
+                    ++i;
+                    break;
+                }
+            }
+
+            //x += M^-1 V y
+            internal::kernels::GMRESBackSubstitutionKernel<VectorScalarType>
+                <<<cfgBatch.block_count, cfgBatch.thread_per_block, 0, ctx.stream()>>>(
+                    cfgBatch.virtual_size, m, R.pointer(), g.pointer(), numCols.data(), y.pointer());
+            CUMAT_CHECK_ERROR();
+            internal::kernels::GMRESCombineKernel<VectorScalarType>
+                <<<cfgVec.block_count, cfgVec.thread_per_block, 0, ctx.stream()>>>(
+                    cfgVec.virtual_size, basisPointers.pointer(), y.pointer(), m, numCols.data(), w.data());
+            CUMAT_CHECK_ERROR();
+            target += preconditioner_.solve(w);
+            r.inplace() = rhs - matrix_ * target;
+        }
+
+        r.squaredNorm().eval().copyToHost(&residualNorm2[0]);
+        error_ = sqrt((residualNorm2 / rhsNorm2).max());
+        iterations_ = converged ? status.iteration() : maxIter;
+        internal::copyBatchIterations(convergedAt, maxIter, batchIterations_);
+#endif
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,477 @@
+#ifndef __CUMAT_HISTOGRAM_OPS_H__
+#define __CUMAT_HISTOGRAM_OPS_H__
+
+#include <algorithm>
+#include <type_traits>
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Constants.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "Profiling.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace functor
+{
+	/**
+	 * \brief Maps a value to one of \c bins equally sized bins spanning [min, max].
+	 * Values outside of that range (and NaNs) are mapped to -1 and are ignored.
+	 * As in numpy, the value \c max itself belongs to the last bin.
+	 * \tparam _Scalar the scalar type of the input
+	 */
+	template <typename _Scalar>
+	struct HistogramBinning
+	{
+	private:
+		// integer inputs are binned in double precision
+		typedef typename std::conditional<std::is_floating_point<_Scalar>::value, _Scalar, double>::type RealScalar;
+		RealScalar min_;
+		RealScalar max_;
+		RealScalar scale_;
+		int bins_;
+
+	public:
+		HistogramBinning(int bins, const _Scalar& min, const _Scalar& max)
+			: min_(RealScalar(min)), max_(RealScalar(max)), scale_(RealScalar(bins) / (RealScalar(max) - RealScalar(min))),
+				bins_(bins)
+		{
+		}
+
+		__host__ __device__ CUMAT_STRONG_INLINE int operator()(const _Scalar& value) const
+		{
+			const RealScalar x = RealScalar(value);
+			if (!(x >= min_ && x <= max_))
+				return -1;
+			const int bin = static_cast<int>((x - min_) * scale_);
+			return bin < bins_ ? bin : bins_ - 1;
+		}
+	};
+
+	/**
+	 * \brief Uses the value itself as the bin index (bincount).
+	 * Values outside of [0, bins) are mapped to -1 and are ignored.
+	 * \tparam _Scalar the integral scalar type of the input
+	 */
+	template <typename _Scalar>
+	struct BincountBinning
+	{
+	private:
+		int bins_;
+
+	public:
+		explicit BincountBinning(int bins) : bins_(bins)
+		{
+		}
+
+		__host__ __device__ CUMAT_STRONG_INLINE int operator()(const _Scalar& value) const
+		{
+			return (value >= _Scalar(0) && value < _Scalar(bins_)) ? static_cast<int>(value) : -1;
+		}
+	};
+}	 // namespace functor
+
+namespace internal
+{
+	/**
+	 * \brief Weight functor for plain counting: every entry counts as one.
+	 */
+	template <typename _Count>
+	struct HistogramUnitWeight
+	{
+		__device__ CUMAT_STRONG_INLINE _Count operator()(Index row, Index col, Index batch) const
+		{
+			return _Count(1);
+		}
+	};
+
+	/**
+	 * \brief Weight functor for weighted counts: reads the weight from a second expression
+	 * of the same size as the input.
+	 */
+	template <typename _Weights>
+	struct HistogramExprWeight
+	{
+	private:
+		typedef typename MatrixReadWrapper<_Weights, AccessFlags::ReadCwise>::type weights_wrapped_t;
+		weights_wrapped_t weights_;
+
+	public:
+		explicit HistogramExprWeight(const MatrixBase<_Weights>& weights) : weights_(weights.derived())
+		{
+		}
+
+		__device__ CUMAT_STRONG_INLINE typename internal::traits<_Weights>::Scalar operator()(Index row, Index col,
+																																												 Index batch) const
+		{
+			return weights_.coeff(row, col, batch, -1);
+		}
+	};
+
+	/**
+	 * \brief Algorithms possible during dynamic selection.
+	 * These are the tags from namespace HistogramAlg.
+	 */
+	enum class HistogramAlgorithm
+	{
+		Global,
+		Shared
+	};
+
+	/**
+	 * \brief Launch parameters and the dynamic algorithm selection for histograms.
+	 * Everything in here runs on the host only and can be tested without a GPU.
+	 *
+	 * The heuristic is a simple cost model: privatized bins pay off as soon as
+	 * many entries hit the same bins (contention on the global atomics),
+	 * but every window traverses the whole input again and every block has to clear
+	 * and flush all bins of its window.
+	 * For a different architecture, you might need to tweak the constants.
+	 */
+	struct HistogramAlgorithmSelection
+	{
+		/**
+		 * \brief The fixed block size of the privatized kernel
+		 */
+		static constexpr int BLOCK_SIZE = 256;
+		/**
+		 * \brief Above this number of windows, the input is re-read too often.
+		 */
+		static constexpr int MAX_WINDOWS = 4;
+		/**
+		 * \brief Minimal average number of entries per bin for privatization
+		 */
+		static constexpr int MIN_ENTRIES_PER_BIN = 4;
+
+		/**
+		 * \brief Computes the number of bins that fit into the shared memory of one block
+		 * \param numBins the total number of bins
+		 * \param sharedMemoryBytes the available shared memory per block
+		 * \param countSize sizeof() of the count type
+		 */
+		static int binsPerWindow(int numBins, size_t sharedMemoryBytes, size_t countSize)
+		{
+			const size_t fit = sharedMemoryBytes / countSize;
+			return static_cast<int>(std::max(size_t(1), std::min(size_t(numBins), fit)));
+		}
+
+		/**
+		 * \brief Computes the number of windows (passes over the input) for the privatized kernel
+		 */
+		static int numWindows(int numBins, int binsPerWindow)
+		{
+			return CUMAT_DIV_UP(numBins, binsPerWindow);
+		}
+
+		/**
+		 * \brief Computes how many blocks cooperate on one window of one batch.
+		 * \param numEntries the number of entries per batch
+		 * \param residentBlocks the number of blocks that can be resident on the whole device at once
+		 * \param numWindows the number of windows
+		 * \param numBatches the number of batches
+		 */
+		static int blocksPerWindow(Index numEntries, int residentBlocks, int numWindows, Index numBatches)
+		{
+			const Index maxBlocks = CUMAT_DIV_UP(numEntries, BLOCK_SIZE);
+			const Index blocks = residentBlocks / (Index(numWindows) * numBatches);
+			return static_cast<int>(std::max(Index(1), std::min(maxBlocks, blocks)));
+		}
+
+		/**
+		 * \brief Selects the algorithm
+		 * \param numEntries the number of entries per batch
+		 * \param numBins the number of bins
+		 * \param numWindows the number of windows the privatized version would need
+		 */
+		static HistogramAlgorithm select(Index numEntries, int numBins, int numWindows)
+		{
+			if (numWindows > MAX_WINDOWS)
+				return HistogramAlgorithm::Global;
+			if (numEntries < Index(numBins) * MIN_ENTRIES_PER_BIN)
+				return HistogramAlgorithm::Global;
+			return HistogramAlgorithm::Shared;
+		}
+	};
+
+	/**
+	 * \brief Histogram evaluator / dispatcher.
+	 * Accumulates the (weighted) counts of the input into the output bins.
+	 * The output is not cleared.
+	 *
+	 * Specializations must define the function
+	 * <code>
+	 * static void eval(const _Input& in, const _Weights& weights, const _Binning& binning, int numBins, _Output& out);
+	 * </code>
+	 *
+	 * \tparam _Input the input matrix type, must support ReadCwise
+	 * \tparam _Weights the weight functor
+	 * \tparam _Binning the binning functor
+	 * \tparam _Output the output matrix type, a vector of size numBins per batch
+	 * \tparam _Algorithm tag for selecting the algorithm. Valid tags are in the namespace \ref HistogramAlg.
+	 */
+	template <typename _Input, typename _Weights, typename _Binning, typename _Output, typename _Algorithm>
+	struct HistogramEvaluator
+	{
+		static void eval(const _Input& in, const _Weights& weights, const _Binning& binning, int numBins, _Output& out);
+	};
+
+#if CUMAT_NVCC == 1
+	namespace kernels
+	{
+		template <typename _Input, typename _Weights, typename _Binning, typename _Count>
+		__global__ void HistogramGlobalKernel(dim3 virtual_size, _Input input, _Weights weights, _Binning binning,
+																					_Count* output, Index rows, int numBins)
+		{
+			CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+			const Index row = i % rows;
+			const Index col = i / rows;
+			const int bin = binning(input.coeff(row, col, batch, -1));
+			if (bin >= 0)
+				atomicAdd(output + batch * numBins + bin, weights(row, col, batch));
+			CUMAT_KERNEL_2D_LOOP_END
+		}
+
+		// grid: x = blocks per window, y = window, z = batch
+		template <typename _Input, typename _Weights, typename _Binning, typename _Count>
+		__global__ void HistogramSharedKernel(Index numEntries, _Input input, _Weights weights, _Binning binning,
+																					_Count* output, Index rows, int numBins, int windowSize)
+		{
+			extern __shared__ __align__(8) unsigned char histogramSharedMemory[];
+			_Count* bins = reinterpret_cast<_Count*>(histogramSharedMemory);
+			const Index batch = blockIdx.z;
+			const int windowStart = blockIdx.y * windowSize;
+			const int windowLength = min(windowSize, numBins - windowStart);
+
+			// clear the private bins
+			for (int k = threadIdx.x; k < windowLength; k += blockDim.x)
+				bins[k] = _Count(0);
+			__syncthreads();
+
+			// accumulate into the private bins
+			for (Index i = blockIdx.x * blockDim.x + threadIdx.x; i < numEntries; i += blockDim.x * gridDim.x)
+			{
+				const Index row = i % rows;
+				const Index col = i / rows;
+				const int bin = binning(input.coeff(row, col, batch, -1));
+				if (bin >= windowStart && bin < windowStart + windowLength)
+					atomicAdd(bins + (bin - windowStart), weights(row, col, batch));
+			}
+			__syncthreads();
+
+			// flush into the global bins
+			for (int k = threadIdx.x; k < windowLength; k += blockDim.x)
+			{
+				const _Count v = bins[k];
+				if (v != _Count(0))
+					atomicAdd(output + batch * numBins + windowStart + k, v);
+			}
+		}
+	}	 // namespace kernels
+
+	template <typename _Input, typename _Weights, typename _Binning, typename _Output>
+	struct HistogramEvaluator<_Input, _Weights, _Binning, _Output, HistogramAlg::Global>
+	{
+		static void eval(const _Input& in, const _Weights& weights, const _Binning& binning, int numBins, _Output& out)
+		{
+			typedef typename internal::traits<_Output>::Scalar Count;
+			const Index numEntries = in.rows() * in.cols();
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(
+					static_cast<unsigned int>(numEntries), static_cast<unsigned int>(in.batches()),
+					kernels::HistogramGlobalKernel<_Input, _Weights, _Binning, Count>);
+			kernels::HistogramGlobalKernel<_Input, _Weights, _Binning, Count>
+					<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(cfg.virtual_size, in, weights, binning,
+																																			 out.data(), in.rows(), numBins);
+			CUMAT_CHECK_ERROR();
+		}
+	};
+
+	template <typename _Input, typename _Weights, typename _Binning, typename _Output>
+	struct HistogramEvaluator<_Input, _Weights, _Binning, _Output, HistogramAlg::Shared>
+	{
+		static void eval(const _Input& in, const _Weights& weights, const _Binning& binning, int numBins, _Output& out)
+		{
+			typedef typename internal::traits<_Output>::Scalar Count;
+			const Index numEntries = in.rows() * in.cols();
+			const Index numBatches = in.batches();
+			Context& ctx = Context::current();
+
+			int device = 0, sharedMemory = 0, numSM = 0, blocksPerSM = 0;
+			CUMAT_SAFE_CALL(cudaGetDevice(&device));
+			CUMAT_SAFE_CALL(cudaDeviceGetAttribute(&sharedMemory, cudaDevAttrMaxSharedMemoryPerBlock, device));
+			CUMAT_SAFE_CALL(cudaDeviceGetAttribute(&numSM, cudaDevAttrMultiProcessorCount, device));
+
+			const int windowSize = HistogramAlgorithmSelection::binsPerWindow(numBins, sharedMemory, sizeof(Count));
+			const int numWindows = HistogramAlgorithmSelection::numWindows(numBins, windowSize);
+			const size_t sharedBytes = windowSize * sizeof(Count);
+			CUMAT_SAFE_CALL(cudaOccupancyMaxActiveBlocksPerMultiprocessor(
+					&blocksPerSM, kernels::HistogramSharedKernel<_Input, _Weights, _Binning, Count>,
+					HistogramAlgorithmSelection::BLOCK_SIZE, sharedBytes));
+			const int blocksPerWindow = HistogramAlgorithmSelection::blocksPerWindow(numEntries, blocksPerSM * numSM,
+																																							 numWindows, numBatches);
+			CUMAT_LOG_DEBUG("Histogram with privatized bins: windows=" << numWindows << ", binsPerWindow=" << windowSize
+																																 << ", blocksPerWindow=" << blocksPerWindow);
+
+			dim3 gridDim(blocksPerWindow, numWindows, internal::narrow_cast<unsigned>(numBatches));
+			kernels::HistogramSharedKernel<_Input, _Weights, _Binning, Count>
+					<<<gridDim, HistogramAlgorithmSelection::BLOCK_SIZE, sharedBytes, ctx.stream()>>>(
+							numEntries, in, weights, binning, out.data(), in.rows(), numBins, windowSize);
+			CUMAT_CHECK_ERROR();
+		}
+	};
+
+	template <typename _Input, typename _Weights, typename _Binning, typename _Output>
+	struct HistogramEvaluator<_Input, _Weights, _Binning, _Output, HistogramAlg::Auto>
+	{
+		static void eval(const _Input& in, const _Weights& weights, const _Binning& binning, int numBins, _Output& out)
+		{
+			typedef typename internal::traits<_Output>::Scalar Count;
+			int device = 0, sharedMemory = 0;
+			CUMAT_SAFE_CALL(cudaGetDevice(&device));
+			CUMAT_SAFE_CALL(cudaDeviceGetAttribute(&sharedMemory, cudaDevAttrMaxSharedMemoryPerBlock, device));
+			const int numWindows = HistogramAlgorithmSelection::numWindows(
+					numBins, HistogramAlgorithmSelection::binsPerWindow(numBins, sharedMemory, sizeof(Count)));
+
+			switch (HistogramAlgorithmSelection::select(in.rows() * in.cols(), numBins, numWindows))
+			{
+				case HistogramAlgorithm::Global:
+					HistogramEvaluator<_Input, _Weights, _Binning, _Output, HistogramAlg::Global>::eval(in, weights, binning,
+																																															numBins, out);
+					break;
+				case HistogramAlgorithm::Shared:
+					HistogramEvaluator<_Input, _Weights, _Binning, _Output, HistogramAlg::Shared>::eval(in, weights, binning,
+																																															numBins, out);
+					break;
+				default:
+					throw std::runtime_error("unknown dynamic histogram algorithm");
+			}
+		}
+	};
+#endif
+
+	/**
+	 * \brief Allocates the output, clears it and calls the evaluator
+	 */
+	template <typename _Count, typename _Algorithm, typename _Input, typename _Weights, typename _Binning>
+	Matrix<_Count, Dynamic, 1, internal::traits<_Input>::BatchesAtCompileTime, ColumnMajor> histogramImpl(
+			const MatrixBase<_Input>& expr, const _Weights& weights, const _Binning& binning, int numBins)
+	{
+		CUMAT_ASSERT_ARGUMENT(numBins > 0);
+		typedef Matrix<_Count, Dynamic, 1, internal::traits<_Input>::BatchesAtCompileTime, ColumnMajor> Output;
+		typedef typename MatrixReadWrapper<_Input, AccessFlags::ReadCwise>::type input_wrapped_t;
+
+		CUMAT_PROFILING_INC(EvalReduction);
+		CUMAT_PROFILING_INC(EvalAny);
+		Output out(numBins, 1, expr.batches());
+		out.setZero();
+		if (expr.rows() * expr.cols() * expr.batches() == 0)
+			return out;
+		const input_wrapped_t in(expr.derived());
+		HistogramEvaluator<input_wrapped_t, _Weights, _Binning, Output, _Algorithm>::eval(in, weights, binning, numBins,
+																																											 out);
+		return out;
+	}
+}	 // namespace internal
+
+/**
+ * \brief Computes the histogram of the entries of the expression.
+ * The range [min, max] is split into \c bins equally sized bins, entries outside of that range are ignored.
+ * The histogram is computed per batch, i.e. the result is a column vector with \c bins entries and as many
+ * batches as the input.
+ *
+ * Contention on the bins is reduced by accumulating per block into privatized bins in shared memory,
+ * see the tags in \ref HistogramAlg.
+ *
+ * \param expr the input expression
+ * \param bins the number of bins
+ * \param min the lower end of the range
+ * \param max the upper end of the range, inclusive
+ * \tparam _Algorithm the algorithm, a tag from \ref HistogramAlg
+ * \return the number of entries per bin
+ */
+template <typename _Algorithm = HistogramAlg::Auto, typename _Derived>
+Matrix<int, Dynamic, 1, internal::traits<_Derived>::BatchesAtCompileTime, ColumnMajor> histogram(
+		const MatrixBase<_Derived>& expr, int bins, const typename internal::traits<_Derived>::Scalar& min,
+		const typename internal::traits<_Derived>::Scalar& max)
+{
+	CUMAT_ERROR_IF_NO_NVCC(histogram)
+	typedef typename internal::traits<_Derived>::Scalar Scalar;
+	CUMAT_ASSERT_ARGUMENT(min < max);
+	return internal::histogramImpl<int, _Algorithm>(expr, internal::HistogramUnitWeight<int>(),
+																									functor::HistogramBinning<Scalar>(bins, min, max), bins);
+}
+
+/**
+ * \brief Computes the weighted histogram of the entries of the expression.
+ * Instead of counting the entries, the corresponding entries of \c weights are summed up.
+ * \param expr the input expression
+ * \param weights the weights, same size as the input
+ * \param bins the number of bins
+ * \param min the lower end of the range
+ * \param max the upper end of the range, inclusive
+ * \tparam _Algorithm the algorithm, a tag from \ref HistogramAlg
+ * \return the sum of the weights per bin
+ */
+template <typename _Algorithm = HistogramAlg::Auto, typename _Derived, typename _Weights>
+Matrix<typename internal::traits<_Weights>::Scalar, Dynamic, 1, internal::traits<_Derived>::BatchesAtCompileTime,
+			 ColumnMajor>
+histogram(const MatrixBase<_Derived>& expr, const MatrixBase<_Weights>& weights, int bins,
+					const typename internal::traits<_Derived>::Scalar& min, const typename internal::traits<_Derived>::Scalar& max)
+{
+	CUMAT_ERROR_IF_NO_NVCC(histogram)
+	typedef typename internal::traits<_Derived>::Scalar Scalar;
+	CUMAT_ASSERT_ARGUMENT(min < max);
+	CUMAT_ASSERT_DIMENSION(expr.rows() == weights.rows());
+	CUMAT_ASSERT_DIMENSION(expr.cols() == weights.cols());
+	CUMAT_ASSERT_DIMENSION(expr.batches() == weights.batches());
+	return internal::histogramImpl<typename internal::traits<_Weights>::Scalar, _Algorithm>(
+			expr, internal::HistogramExprWeight<_Weights>(weights), functor::HistogramBinning<Scalar>(bins, min, max), bins);
+}
+
+/**
+ * \brief Counts the occurrences of each value in [0, bins) in the integer expression.
+ * Other values are ignored, i.e. negative values can be used to mark entries that should not be counted.
+ * The counts are computed per batch.
+ * \param expr the input expression of an integral type
+ * \param bins the number of bins
+ * \tparam _Algorithm the algorithm, a tag from \ref HistogramAlg
+ * \return the number of occurrences per value
+ */
+template <typename _Algorithm = HistogramAlg::Auto, typename _Derived>
+Matrix<int, Dynamic, 1, internal::traits<_Derived>::BatchesAtCompileTime, ColumnMajor> bincount(
+		const MatrixBase<_Derived>& expr, int bins)
+{
+	CUMAT_ERROR_IF_NO_NVCC(bincount)
+	typedef typename internal::traits<_Derived>::Scalar Scalar;
+	CUMAT_STATIC_ASSERT(std::is_integral<Scalar>::value, "bincount requires an integral input");
+	return internal::histogramImpl<int, _Algorithm>(expr, internal::HistogramUnitWeight<int>(),
+																									functor::BincountBinning<Scalar>(bins), bins);
+}
+
+/**
+ * \brief Sums up the weights per value in [0, bins) of the integer expression.
+ * \param expr the input expression of an integral type
+ * \param weights the weights, same size as the input
+ * \param bins the number of bins
+ * \tparam _Algorithm the algorithm, a tag from \ref HistogramAlg
+ * \return the sum of the weights per value
+ */
+template <typename _Algorithm = HistogramAlg::Auto, typename _Derived, typename _Weights>
+Matrix<typename internal::traits<_Weights>::Scalar, Dynamic, 1, internal::traits<_Derived>::BatchesAtCompileTime,
+			 ColumnMajor>
+bincount(const MatrixBase<_Derived>& expr, const MatrixBase<_Weights>& weights, int bins)
+{
+	CUMAT_ERROR_IF_NO_NVCC(bincount)
+	typedef typename internal::traits<_Derived>::Scalar Scalar;
+	CUMAT_STATIC_ASSERT(std::is_integral<Scalar>::value, "bincount requires an integral input");
+	CUMAT_ASSERT_DIMENSION(expr.rows() == weights.rows());
+	CUMAT_ASSERT_DIMENSION(expr.cols() == weights.cols());
+	CUMAT_ASSERT_DIMENSION(expr.batches() == weights.batches());
+	return internal::histogramImpl<typename internal::traits<_Weights>::Scalar, _Algorithm>(
+			expr, internal::HistogramExprWeight<_Weights>(weights), functor::BincountBinning<Scalar>(bins), bins);
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
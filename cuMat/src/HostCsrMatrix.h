@@ -0,0 +1,222 @@
+#ifndef __CUMAT_HOST_CSR_MATRIX_H__
+#define __CUMAT_HOST_CSR_MATRIX_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "SparseMatrix.h"
+#include "SellCSigmaLayout.h"
+
+#include <vector>
+#include <algorithm>
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    /**
+     * \brief A CSR matrix in host memory.
+     *
+     * This is used for the setup phases of preconditioners and reorderings that are inherently sequential
+     * (aggregation, symbolic factorization, graph traversals). It contains no device code, hence these setup
+     * phases can be tested on the CPU.
+     * The naming follows SparsityPattern<CSR>: \c JA contains the row offsets (size rows+1), \c IA the column indices (size nnz).
+     * The column indices within a row are sorted.
+     * \tparam _Scalar the scalar type
+     */
+    template<typename _Scalar>
+    struct HostCsrMatrix
+    {
+        typedef _Scalar Scalar;
+        typedef int StorageIndex;
+
+        Index rows;
+        Index cols;
+        /** \brief Outer indices (row offsets), size=rows+1 */
+        std::vector<StorageIndex> JA;
+        /** \brief Inner indices (column indices), size=nnz */
+        std::vector<StorageIndex> IA;
+        /** \brief The values, size=nnz */
+        std::vector<Scalar> values;
+
+        HostCsrMatrix() : rows(0), cols(0), JA(1, 0) {}
+
+        Index nnz() const { return static_cast<Index>(IA.size()); }
+
+        /**
+         * \brief Returns the entry (row, col), zero if it is not stored.
+         */
+        Scalar coeff(Index row, Index col) const
+        {
+            const auto begin = IA.begin() + JA[row];
+            const auto end = IA.begin() + JA[row + 1];
+            const auto it = std::lower_bound(begin, end, static_cast<StorageIndex>(col));
+            return (it != end && *it == col) ? values[it - IA.begin()] : Scalar(0);
+        }
+
+        /**
+         * \brief Returns the main diagonal, missing entries are zero.
+         */
+        std::vector<Scalar> diagonal() const
+        {
+            std::vector<Scalar> d(std::min(rows, cols), Scalar(0));
+            for (Index i = 0; i < Index(d.size()); ++i)
+                d[i] = coeff(i, i);
+            return d;
+        }
+
+        /**
+         * \brief Computes y = this * x
+         */
+        void multiply(const std::vector<Scalar>& x, std::vector<Scalar>& y) const
+        {
+            CUMAT_ASSERT_DIMENSION(Index(x.size()) == cols);
+            y.assign(rows, Scalar(0));
+            for (Index i = 0; i < rows; ++i)
+                for (StorageIndex k = JA[i]; k < JA[i + 1]; ++k)
+                    y[i] += values[k] * x[IA[k]];
+        }
+
+        /**
+         * \brief Returns the transposed matrix, the column indices stay sorted.
+         */
+        HostCsrMatrix transpose() const
+        {
+            HostCsrMatrix t;
+            t.rows = cols;
+            t.cols = rows;
+            t.JA.assign(cols + 1, 0);
+            t.IA.resize(nnz());
+            t.values.resize(nnz());
+            for (StorageIndex c : IA) t.JA[c + 1]++;
+            for (Index i = 0; i < cols; ++i) t.JA[i + 1] += t.JA[i];
+            std::vector<StorageIndex> next(t.JA.begin(), t.JA.end() - 1);
+            for (Index i = 0; i < rows; ++i)
+                for (StorageIndex k = JA[i]; k < JA[i + 1]; ++k)
+                {
+                    const StorageIndex pos = next[IA[k]]++;
+                    t.IA[pos] = static_cast<StorageIndex>(i);
+                    t.values[pos] = values[k];
+                }
+            return t;
+        }
+
+        /**
+         * \brief Sparse matrix-matrix product <tt>a * b</tt> with Gustavson's row-wise algorithm.
+         */
+        static HostCsrMatrix product(const HostCsrMatrix& a, const HostCsrMatrix& b)
+        {
+            CUMAT_ASSERT_DIMENSION(a.cols == b.rows);
+            HostCsrMatrix c;
+            c.rows = a.rows;
+            c.cols = b.cols;
+            c.JA.assign(a.rows + 1, 0);
+            std::vector<StorageIndex> marker(b.cols, -1);
+            std::vector<Scalar> accumulator(b.cols, Scalar(0));
+            std::vector<StorageIndex> rowIndices;
+            for (Index i = 0; i < a.rows; ++i)
+            {
+                rowIndices.clear();
+                for (StorageIndex ka = a.JA[i]; ka < a.JA[i + 1]; ++ka)
+                {
+                    const StorageIndex k = a.IA[ka];
+                    const Scalar va = a.values[ka];
+                    for (StorageIndex kb = b.JA[k]; kb < b.JA[k + 1]; ++kb)
+                    {
+                        const StorageIndex j = b.IA[kb];
+                        if (marker[j] != i)
+                        {
+                            marker[j] = static_cast<StorageIndex>(i);
+                            accumulator[j] = Scalar(0);
+                            rowIndices.push_back(j);
+                        }
+                        accumulator[j] += va * b.values[kb];
+                    }
+                }
+                std::sort(rowIndices.begin(), rowIndices.end());
+                for (StorageIndex j : rowIndices)
+                {
+                    c.IA.push_back(j);
+                    c.values.push_back(accumulator[j]);
+                }
+                c.JA[i + 1] = static_cast<StorageIndex>(c.IA.size());
+            }
+            return c;
+        }
+
+        /**
+         * \brief Copies the (first batch of the) CSR matrix from the device
+         */
+        template<int _Batches>
+        static HostCsrMatrix fromSparseMatrix(const SparseMatrix<Scalar, _Batches, SparseFlags::CSR>& matrix)
+        {
+            const SparsityPattern<SparseFlags::CSR>& pattern = matrix.getSparsityPattern();
+            HostCsrMatrix m;
+            m.rows = pattern.rows;
+            m.cols = pattern.cols;
+            m.JA.resize(pattern.rows + 1);
+            m.IA.resize(pattern.nnz);
+            m.values.resize(pattern.nnz);
+            pattern.JA.copyToHost(m.JA.data());
+            pattern.IA.copyToHost(m.IA.data());
+            matrix.getData().slice(0).eval().copyToHost(m.values.data());
+            //sort the column indices per row, the device code does not require it
+            std::vector<std::pair<StorageIndex, Scalar>> row;
+            for (Index i = 0; i < m.rows; ++i)
+            {
+                row.clear();
+                for (StorageIndex k = m.JA[i]; k < m.JA[i + 1]; ++k) row.emplace_back(m.IA[k], m.values[k]);
+                std::sort(row.begin(), row.end(),
+                    [](const std::pair<StorageIndex, Scalar>& x, const std::pair<StorageIndex, Scalar>& y) {return x.first < y.first; });
+                for (size_t k = 0; k < row.size(); ++k)
+                {
+                    m.IA[m.JA[i] + k] = row[k].first;
+                    m.values[m.JA[i] + k] = row[k].second;
+                }
+            }
+            return m;
+        }
+
+        /**
+         * \brief Copies the pattern to the device
+         */
+        SparsityPattern<SparseFlags::CSR> toSparsityPattern() const
+        {
+            typedef SparsityPattern<SparseFlags::CSR> SPattern;
+            SPattern pattern;
+            pattern.rows = rows;
+            pattern.cols = cols;
+            pattern.nnz = nnz();
+            pattern.JA = SPattern::IndexVector(rows + 1);
+            pattern.JA.copyFromHost(JA.data());
+            pattern.IA = SPattern::IndexVector(nnz());
+            pattern.IA.copyFromHost(IA.data());
+            return pattern;
+        }
+
+        /**
+         * \brief Copies the matrix to the device
+         */
+        SparseMatrix<Scalar, 1, SparseFlags::CSR> toSparseMatrix() const
+        {
+            SparseMatrix<Scalar, 1, SparseFlags::CSR> m(toSparsityPattern());
+            m.getData().copyFromHost(values.data());
+            return m;
+        }
+
+        /**
+         * \brief Converts the matrix to the SELL-C-sigma format and copies it to the device.
+         * \param sliceHeight the slice height C
+         * \param sortWindow the sorting window sigma
+         * \see SellCSigmaLayout::build()
+         */
+        SparseMatrix<Scalar, 1, SparseFlags::SELLCS> toSellMatrix(
+            Index sliceHeight = SellCSigmaLayout::DEFAULT_SLICE_HEIGHT, Index sortWindow = SellCSigmaLayout::DEFAULT_SORT_WINDOW) const
+        {
+            return SellCSigmaLayout::build(JA.data(), IA.data(), rows, cols, sliceHeight, sortWindow).toSparseMatrix(values.data());
+        }
+    };
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef __CUMAT_INCOMPLETE_FACTORIZATION_H__
+#define __CUMAT_INCOMPLETE_FACTORIZATION_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "SparseMatrix.h"
+#include "SparseTriangularSolve.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+#if CUMAT_NVCC==1
+    namespace kernels
+    {
+        //ILU(0), IKJ-variant, for the rows of one level of the lower triangle. The column indices are sorted.
+        template<typename _Scalar>
+        __global__ void ILU0Kernel(dim3 virtual_size, const int* levelRows, const int* JA, const int* IA,
+            const int* diagonal, _Scalar* values, Index nnz)
+        {
+            CUMAT_KERNEL_2D_LOOP(t, batch, virtual_size)
+                const int row = levelRows[t];
+                _Scalar* v = values + batch * nnz;
+                const int rowEnd = JA[row + 1];
+                const int diag = diagonal[row];
+                for (int p = JA[row]; p < diag; ++p)
+                {
+                    const int k = IA[p];
+                    const _Scalar lik = v[p] / v[diagonal[k]];
+                    v[p] = lik;
+                    //a_ij -= l_ik * u_kj for all j>k in the pattern of row i and k
+                    int q = diagonal[k] + 1;
+                    const int kEnd = JA[k + 1];
+                    int r = p + 1;
+                    while (q < kEnd && r < rowEnd)
+                    {
+                        const int cq = IA[q];
+                        const int cr = IA[r];
+                        if (cq == cr)
+                        {
+                            v[r] -= lik * v[q];
+                            ++q; ++r;
+                        }
+                        else if (cq < cr) ++q;
+                        else ++r;
+                    }
+                }
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        //IC(0) for the rows of one level of the lower triangle. Only the lower triangle is written.
+        template<typename _Scalar>
+        __global__ void IC0Kernel(dim3 virtual_size, const int* levelRows, const int* JA, const int* IA,
+            const int* diagonal, _Scalar* values, Index nnz)
+        {
+            CUMAT_KERNEL_2D_LOOP(t, batch, virtual_size)
+                const int row = levelRows[t];
+                _Scalar* v = values + batch * nnz;
+                const int rowStart = JA[row];
+                const int diag = diagonal[row];
+                for (int p = rowStart; p < diag; ++p)
+                {
+                    const int k = IA[p];
+                    //l_ik = (a_ik - sum_{j<k} l_ij * l_kj) / l_kk
+                    _Scalar s = v[p];
+                    int q = JA[k];
+                    const int qEnd = diagonal[k];
+                    int r = rowStart;
+                    while (q < qEnd && r < p)
+                    {
+                        const int cq = IA[q];
+                        const int cr = IA[r];
+                        if (cq == cr)
+                        {
+                            s -= v[r] * v[q];
+                            ++q; ++r;
+                        }
+                        else if (cq < cr) ++q;
+                        else ++r;
+                    }
+                    v[p] = s / v[qEnd];
+                }
+                _Scalar d = v[diag];
+                for (int p = rowStart; p < diag; ++p)
+                    d -= v[p] * v[p];
+                //breakdown (the matrix is not SPD or the dropped fill-in is too large): fall back to the original diagonal
+                v[diag] = d > _Scalar(0) ? sqrt(d) : sqrt(abs(v[diag]));
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+
+    /**
+     * \brief Common base of the IncompleteLUPreconditioner and IncompleteCholeskyPreconditioner.
+     * Stores the factors in the sparsity pattern of the matrix and the two triangular solvers.
+     */
+    template<typename _MatrixType>
+    class IncompleteFactorizationBase
+    {
+    public:
+        typedef typename traits<_MatrixType>::Scalar Scalar;
+        enum
+        {
+            Batches = traits<_MatrixType>::BatchesAtCompileTime
+        };
+        CUMAT_STATIC_ASSERT((std::is_same<_MatrixType, SparseMatrix<Scalar, Batches, SparseFlags::CSR>>::value),
+            "Incomplete factorizations are only supported for CSR sparse matrices");
+        CUMAT_STATIC_ASSERT(std::is_floating_point<Scalar>::value, "Incomplete factorizations only support float and double");
+
+    protected:
+        _MatrixType factor_;
+        SparseTriangularSolver lower_;
+        SparseTriangularSolver upper_;
+        LevelLaunchConfigCache launchConfigs_;
+
+        void analyzePatternImpl(const _MatrixType& matrix, int lowerMode, int upperMode)
+        {
+            const SparsityPattern<SparseFlags::CSR>& pattern = matrix.getSparsityPattern();
+            lower_.analyze(pattern, lowerMode);
+            upper_.analyze(pattern, upperMode);
+            factor_ = _MatrixType(pattern, matrix.batches());
+        }
+
+        template<typename _Kernel>
+        void factorizeImpl(const _MatrixType& matrix, _Kernel kernel)
+        {
+            CUMAT_ASSERT(lower_.mode() != 0 && "analyzePattern() was not called");
+            CUMAT_ASSERT_DIMENSION(matrix.rows() == factor_.rows());
+            CUMAT_ASSERT_DIMENSION(matrix.getSparsityPattern().nnz == factor_.getSparsityPattern().nnz);
+            CUMAT_ASSERT_DIMENSION(matrix.batches() == factor_.batches());
+            factor_.getData().inplace() = matrix.getData();
+#if CUMAT_NVCC==1
+            //level-scheduled numeric factorization, row i depends on the rows k<i in its pattern
+            Context& ctx = Context::current();
+            const std::vector<int>& offsets = lower_.levelOffsets();
+            const SparsityPattern<SparseFlags::CSR>& pattern = factor_.getSparsityPattern();
+            for (Index l = 0; l < lower_.numLevels(); ++l)
+            {
+                const int levelSize = offsets[l + 1] - offsets[l];
+                KernelLaunchConfig cfg = launchConfigs_.get(kernel, levelSize, static_cast<unsigned int>(factor_.batches()));
+                kernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+                    cfg.virtual_size, lower_.levelRows().data() + offsets[l], pattern.JA.data(), pattern.IA.data(),
+                    upper_.diagonalPositions().data(), factor_.getData().data(), pattern.nnz);
+                CUMAT_CHECK_ERROR();
+            }
+#endif
+        }
+
+        template<typename _Rhs>
+        Matrix<Scalar, Dynamic, 1, traits<_Rhs>::BatchesAtCompileTime, ColumnMajor>
+        solveImpl(const MatrixBase<_Rhs>& b) const
+        {
+            typedef Matrix<Scalar, Dynamic, 1, traits<_Rhs>::BatchesAtCompileTime, ColumnMajor> VectorType;
+            CUMAT_ASSERT(lower_.mode() != 0 && "The preconditioner is not initialized");
+            VectorType x(b.rows(), 1, b.batches());
+            x.inplace() = b.derived();
+            lower_.solveInPlace(factor_, x);
+            upper_.solveInPlace(factor_, x);
+            return x;
+        }
+
+    public:
+        /**
+         * \brief The factors, stored in the sparsity pattern of the matrix
+         */
+        const _MatrixType& factors() const { return factor_; }
+        /**
+         * \brief The triangular solver for the lower factor
+         */
+        const SparseTriangularSolver& lowerSolver() const { return lower_; }
+        /**
+         * \brief The triangular solver for the upper factor
+         */
+        const SparseTriangularSolver& upperSolver() const { return upper_; }
+    };
+}
+
+/**
+ * \brief Incomplete LU factorization without fill-in, ILU(0), as preconditioner for the iterative solvers.
+ *
+ * The matrix is factorized into <tt>A ~ L U</tt> where L (unit lower triangular) and U (upper triangular)
+ * have the sparsity pattern of A. The factorization and the triangular solves in \ref solve()
+ * are parallelized over the dependency levels computed by the SparseTriangularSolver.
+ * The analysis in \ref analyzePattern() only depends on the sparsity pattern and is reused
+ * by \ref factorize() for new values.
+ *
+ * The sparsity pattern must contain the diagonal and the column indices within each row must be sorted.
+ * Batched matrices are factorized per batch.
+ *
+ * \tparam _MatrixType the matrix type, must be a <tt>SparseMatrix<Scalar, Batches, SparseFlags::CSR></tt>
+ */
+template<typename _MatrixType>
+class IncompleteLUPreconditioner : public internal::IncompleteFactorizationBase<_MatrixType>
+{
+    using Base = internal::IncompleteFactorizationBase<_MatrixType>;
+public:
+    using typename Base::Scalar;
+
+    IncompleteLUPreconditioner() = default;
+
+    /**
+     * \brief Analyzes and factorizes the matrix
+     */
+    IncompleteLUPreconditioner(const MatrixBase<_MatrixType>& matrix)
+    {
+        compute(matrix.derived());
+    }
+
+    /**
+     * \brief Computes the level schedules of the sparsity pattern (host)
+     */
+    IncompleteLUPreconditioner& analyzePattern(const _MatrixType& matrix)
+    {
+        this->analyzePatternImpl(matrix,
+            SparseTriangularSolver::Lower | SparseTriangularSolver::UnitDiagonal, SparseTriangularSolver::Upper);
+        return *this;
+    }
+
+    /**
+     * \brief Computes the numeric factorization, the matrix must have the sparsity pattern passed to \ref analyzePattern()
+     */
+    IncompleteLUPreconditioner& factorize(const _MatrixType& matrix)
+    {
+        CUMAT_ERROR_IF_NO_NVCC(IncompleteLUPreconditioner)
+#if CUMAT_NVCC==1
+        this->factorizeImpl(matrix, internal::kernels::ILU0Kernel<Scalar>);
+#endif
+        return *this;
+    }
+
+    /**
+     * \brief Calls \ref analyzePattern() and \ref factorize()
+     */
+    IncompleteLUPreconditioner& compute(const _MatrixType& matrix)
+    {
+        analyzePattern(matrix);
+        return factorize(matrix);
+    }
+
+    /**
+     * \brief Solves <tt>L U x = b</tt>
+     * \tparam _Rhs the type of right hand side
+     * \param b the right hand side of the equation
+     * \return the approximate solution of x
+     */
+    template<typename _Rhs>
+    Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor>
+    solve(const MatrixBase<_Rhs>& b) const
+    {
+        return this->solveImpl(b);
+    }
+};
+
+/**
+ * \brief Incomplete Cholesky factorization without fill-in, IC(0), as preconditioner for the iterative solvers.
+ *
+ * The symmetric positive definite matrix is factorized into <tt>A ~ L L^T</tt> where L has the sparsity pattern
+ * of the lower triangle of A. Only the lower triangle of the matrix is read.
+ * If the factorization breaks down (negative pivot), the original diagonal entry is used instead.
+ * As for the IncompleteLUPreconditioner, the factorization and the triangular solves are level-scheduled
+ * and the analysis is reused by \ref factorize().
+ *
+ * The sparsity pattern must be structurally symmetric, contain the diagonal and the column indices within each row must be sorted.
+ *
+ * \tparam _MatrixType the matrix type, must be a <tt>SparseMatrix<Scalar, Batches, SparseFlags::CSR></tt>
+ */
+template<typename _MatrixType>
+class IncompleteCholeskyPreconditioner : public internal::IncompleteFactorizationBase<_MatrixType>
+{
+    using Base = internal::IncompleteFactorizationBase<_MatrixType>;
+public:
+    using typename Base::Scalar;
+
+    IncompleteCholeskyPreconditioner() = default;
+
+    /**
+     * \brief Analyzes and factorizes the matrix
+     */
+    IncompleteCholeskyPreconditioner(const MatrixBase<_MatrixType>& matrix)
+    {
+        compute(matrix.derived());
+    }
+
+    /**
+     * \brief Computes the level schedules of the sparsity pattern (host)
+     */
+    IncompleteCholeskyPreconditioner& analyzePattern(const _MatrixType& matrix)
+    {
+        this->analyzePatternImpl(matrix, SparseTriangularSolver::Lower, SparseTriangularSolver::TransposedLower);
+        return *this;
+    }
+
+    /**
+     * \brief Computes the numeric factorization, the matrix must have the sparsity pattern passed to \ref analyzePattern()
+     */
+    IncompleteCholeskyPreconditioner& factorize(const _MatrixType& matrix)
+    {
+        CUMAT_ERROR_IF_NO_NVCC(IncompleteCholeskyPreconditioner)
+#if CUMAT_NVCC==1
+        this->factorizeImpl(matrix, internal::kernels::IC0Kernel<Scalar>);
+#endif
+        return *this;
+    }
+
+    /**
+     * \brief Calls \ref analyzePattern() and \ref factorize()
+     */
+    IncompleteCholeskyPreconditioner& compute(const _MatrixType& matrix)
+    {
+        analyzePattern(matrix);
+        return factorize(matrix);
+    }
+
+    /**
+     * \brief Solves <tt>L L^T x = b</tt>
+     * \tparam _Rhs the type of right hand side
+     * \param b the right hand side of the equation
+     * \return the approximate solution of x
+     */
+    template<typename _Rhs>
+    Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor>
+    solve(const MatrixBase<_Rhs>& b) const
+    {
+        return this->solveImpl(b);
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -2,6 +2,9 @@
 #define __CUMAT_ITERATIVE_SOLVER_BASE_H__
 
 #include "Macros.h"
+
+#include <vector>
+
 #include "SolverBase.h"
 #include "NumTraits.h"
 
@@ -26,8 +29,10 @@ protected:
     Preconditioner preconditioner_;
     RealScalar tolerance_;
     Index maxIterations_;
+    Index convergenceCheckInterval_;
     bool initialized_;
     mutable Index iterations_;
+    mutable std::vector<Index> batchIterations_;
     mutable RealScalar error_;
 
 public:
@@ -94,6 +99,28 @@ public:
         return impl();
     }
 
+    /** \returns the interval of the device-resident convergence checks, 0 if the convergence is checked on the host.
+      * \sa setConvergenceCheckInterval()
+      */
+    Index convergenceCheckInterval() const { return convergenceCheckInterval_; }
+
+    /** Sets the interval of the convergence checks.
+      *
+      * By default (interval=0), the residual norm is copied to the host in every iteration.
+      * This synchronizes the stream in every iteration, which dominates the runtime for small and mid-sized systems.
+      * With a positive interval k, the convergence is evaluated on the device into a mapped host flag and the step sizes
+      * are computed on the device. The host only waits for the device every k iterations.
+      * Batches that have converged are frozen on the device, hence the result and the reported iteration count
+      * are not affected by the up to k-1 iterations that are launched after convergence.
+      * The device-resident mode requires the solver to be compiled with NVCC.
+      */
+    _SolverImpl& setConvergenceCheckInterval(Index interval)
+    {
+        CUMAT_ASSERT_ARGUMENT(interval >= 0);
+        convergenceCheckInterval_ = interval;
+        return impl();
+    }
+
     /** \returns the number of iterations performed during the last solve */
     Index iterations() const
     {
@@ -101,6 +128,16 @@ public:
         return iterations_;
     }
 
+    /** \returns the number of iterations performed during the last solve per batch.
+      * A batch that converged early reports the iteration in which it converged, even though the solver kept running
+      * until all batches converged. The maximal entry equals iterations().
+      */
+    const std::vector<Index>& batchIterations() const
+    {
+        CUMAT_ASSERT(initialized_ && "Iterative Solver is not initialized.");
+        return batchIterations_;
+    }
+
     /** \returns the tolerance error reached during the last solve.
       * It is a close approximation of the true relative residual error |Ax-b|/|b|.
       */
@@ -128,8 +165,10 @@ protected:
     {
         initialized_ = false;
         maxIterations_ = -1;
+        convergenceCheckInterval_ = 0;
         tolerance_ = internal::NumTraits<Scalar>::epsilon();
         iterations_ = 0;
+        batchIterations_.clear();
         error_ = 0;
     }
 };
@@ -0,0 +1,131 @@
+#ifndef __CUMAT_MATRIX_FREE_OPERATOR_H__
+#define __CUMAT_MATRIX_FREE_OPERATOR_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "MatrixBase.h"
+#include "Matrix.h"
+#include "ProductOp.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    /**
+     * \brief Source tag of matrix-free operators, see MatrixFreeOperatorBase.
+     * Matrix-free operators can't be evaluated, they only appear as the left factor of a matrix-vector product.
+     */
+    struct MatrixFreeSrcTag {};
+}
+
+/**
+ * \brief Base class of matrix-free linear operators.
+ *
+ * A matrix-free operator represents a square matrix A that is never assembled, instead the product
+ * <tt>A * v</tt> is computed by a custom kernel, e.g. a stencil. Matrix-free operators can be used
+ * everywhere where the iterative solvers expect a matrix, e.g. <tt>ConjugateGradient<MyOperator, IdentityPreconditioner<MyOperator>></tt>.
+ * They can't be evaluated or accessed per entry, hence the DiagonalPreconditioner is not supported.
+ *
+ * The derived class \c _Derived has to specialize \c internal::traits with
+ * \code
+ * typedef ... Scalar;
+ * enum {
+ *     Flags = ColumnMajor,
+ *     RowsAtCompileTime = Dynamic,
+ *     ColsAtCompileTime = Dynamic,
+ *     BatchesAtCompileTime = ...; //must be known at compile time for the iterative solvers
+ *     AccessFlags = 0
+ * };
+ * typedef internal::MatrixFreeSrcTag SrcTag;
+ * typedef DeletedDstTag DstTag;
+ * \endcode
+ * and provide the following methods:
+ * \code
+ * Index rows() const;
+ * Index cols() const;
+ * Index batches() const;
+ * //Computes out = A * in. Both are dense column vectors with direct memory access (data()), out is already allocated.
+ * template<typename _In, typename _Out> void applyTo(const _In& in, _Out& out) const;
+ * \endcode
+ * The operator must be default-constructible and cheap to copy.
+ *
+ * \tparam _Derived the operator type
+ */
+template<typename _Derived>
+class MatrixFreeOperatorBase : public MatrixBase<_Derived>
+{
+public:
+    using Base = MatrixBase<_Derived>;
+    using Base::derived;
+
+    /**
+     * \brief Computes <tt>out = A * in</tt>
+     * \param in the input vector, a dense column vector
+     * \param out the output vector, must have the same size as \c in
+     */
+    template<typename _In, typename _Out>
+    void applyTo(const _In& in, _Out& out) const
+    {
+        derived().applyTo(in, out);
+    }
+};
+
+namespace internal
+{
+    //MatrixFreeSrcTag * CwiseSrcTag (Dense-Vector) -> DenseDstTag, matrix-free matrix-vector product
+    template<
+        typename _Dst,
+        typename _SrcLeft,
+        typename _SrcRight,
+        AssignmentMode _AssignmentMode
+    >
+    struct ProductAssignment<
+        _Dst, DenseDstTag, ProductArgOp::NONE,
+        _SrcLeft, MatrixFreeSrcTag, ProductArgOp::NONE,
+        _SrcRight, CwiseSrcTag, ProductArgOp::NONE,
+        _AssignmentMode>
+    {
+        using Op = ProductOp<_SrcLeft, _SrcRight, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE>;
+        using Scalar = typename Op::Scalar;
+        typedef typename MatrixReadWrapper<_SrcRight, AccessFlags::ReadDirect>::type right_wrapped_t;
+
+        CUMAT_STATIC_ASSERT((Op::ColumnsRight == 1),
+            "Matrix-free operators only support column vectors as right argument, use batches instead");
+
+        static void evalImpl(_Dst& dst, const right_wrapped_t& right, const Op& op, std::integral_constant<bool, true> /*direct-write*/)
+        {
+            op.left().derived().applyTo(right, dst);
+        }
+
+        static void evalImpl(_Dst& dst, const right_wrapped_t& right, const Op& op, std::integral_constant<bool, false> /*non-direct-write*/)
+        {
+            //evaluate into a temporary first and then copy / add it to the output (cwise)
+            typedef Matrix<Scalar, Op::Rows, 1, Op::Batches, ColumnMajor> DstTmp;
+            DstTmp tmp(op.rows(), 1, op.batches());
+            op.left().derived().applyTo(right, tmp);
+            Assignment<_Dst, DstTmp, _AssignmentMode, DenseDstTag, CwiseSrcTag>::assign(dst, tmp);
+        }
+
+        static void assign(_Dst& dst, const Op& op) {
+            CUMAT_PROFILING_INC(EvalAny);
+            if (dst.size() == 0) return;
+            CUMAT_ASSERT(op.rows() == dst.rows());
+            CUMAT_ASSERT(op.cols() == dst.cols());
+            CUMAT_ASSERT(op.batches() == dst.batches());
+            CUMAT_ASSERT(op.left().cols() == op.right().rows());
+
+            CUMAT_LOG_DEBUG("Evaluate MatrixFreeOperator-DenseVector multiplication " << typeid(op.derived()).name()
+                << " operator rows=" << op.left().rows() << ", cols=" << op.left().cols());
+
+            right_wrapped_t right(op.right());
+            using DirectWriteTag = std::integral_constant<bool,
+                _AssignmentMode == AssignmentMode::ASSIGN && (int(traits<_Dst>::AccessFlags) & int(AccessFlags::WriteDirect)) != 0>;
+            evalImpl(dst, right, op, DirectWriteTag());
+            CUMAT_LOG_DEBUG("Evaluation done");
+        }
+    };
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef __CUMAT_MIXED_PRECISION_REFINEMENT_H__
+#define __CUMAT_MIXED_PRECISION_REFINEMENT_H__
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <valarray>
+#include <cmath>
+
+#include "ForwardDeclarations.h"
+#include "Matrix.h"
+#include "UnaryOps.h"
+#include "SolverBase.h"
+#include "DecompositionBase.h"
+#include "IterativeSolverBase.h"
+#include "SparseMatrix.h"
+#include "ReductionOps.h"
+#include "ConvergenceCheck.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+#if CUMAT_NVCC == 1
+    namespace kernels
+    {
+        // r = b - Ax in high precision: writes r cast to the inner scalar type and accumulates |r|^2 per batch in high precision
+        template<typename _Scalar, typename _InnerScalar, typename _Real, int BlockSize>
+        __global__ void MixedPrecisionResidualKernel(Index size, const _Scalar* b, const _Scalar* Ax, _InnerScalar* out, _Real* norm2)
+        {
+            typedef cub::BlockReduce<_Real, BlockSize> BlockReduceT;
+            __shared__ typename BlockReduceT::TempStorage temp_storage;
+
+            const Index batch = blockIdx.y;
+            const Index offset = batch * size;
+            _Real norm = 0;
+            for (Index i = blockIdx.x * BlockSize + threadIdx.x; i < size; i += gridDim.x * BlockSize)
+            {
+                const _Scalar r = b[offset + i] - Ax[offset + i];
+                out[offset + i] = functor::CastFunctor<_Scalar, _InnerScalar>::cast(r);
+                norm += realPart(functor::UnaryMathFunctor_cwiseAbs2<_Scalar>()(r, i, 0, batch));
+            }
+            norm = BlockReduceT(temp_storage).Sum(norm);
+            if (threadIdx.x == 0) atomicAdd(norm2 + batch, norm);
+        }
+    }
+#endif
+
+    template<typename _MatrixType, typename _InnerSolver>
+    struct traits<MixedPrecisionRefinement<_MatrixType, _InnerSolver> >
+    {
+        using Scalar = typename internal::traits<_MatrixType>::Scalar;
+        using MatrixType = _MatrixType;
+    };
+
+    /**
+     * \brief Converts a matrix into the matrix type of the inner solver of the MixedPrecisionRefinement.
+     * The default implementation evaluates the CastingOp, sparse matrices keep their sparsity pattern.
+     */
+    template<typename _Src, typename _Dst>
+    struct PrecisionCast
+    {
+        static _Dst cast(const _Src& src)
+        {
+            return src.template cast<typename traits<_Dst>::Scalar>();
+        }
+    };
+    template<typename _SrcScalar, int _SrcBatches, typename _DstScalar, int _DstBatches, int _SparseFlags>
+    struct PrecisionCast<SparseMatrix<_SrcScalar, _SrcBatches, _SparseFlags>, SparseMatrix<_DstScalar, _DstBatches, _SparseFlags> >
+    {
+        static SparseMatrix<_DstScalar, _DstBatches, _SparseFlags> cast(const SparseMatrix<_SrcScalar, _SrcBatches, _SparseFlags>& src)
+        {
+            SparseMatrix<_DstScalar, _DstBatches, _SparseFlags> dst(src.getSparsityPattern(), src.batches());
+            dst.getData() = src.getData().template cast<_DstScalar>();
+            return dst;
+        }
+    };
+}
+
+/**
+ * \brief Mixed-precision iterative refinement.
+ *
+ * Solves <tt>A x = b</tt> to the accuracy of the scalar type of A (typically double)
+ * while the expensive part, the solution of the correction equation, is done in a lower precision (typically float):
+ * \code
+ * x = 0
+ * repeat:
+ *   r = b - A x           (double, the cast to float and the norm are fused into one kernel)
+ *   solve A' d = r        (float, A' is A cast to float)
+ *   x += d                (double, the cast to double is fused into the update kernel)
+ * \endcode
+ * The inner solver can be an iterative solver, e.g. <tt>ConjugateGradient<SparseMatrix<float,1,CSR>, DiagonalPreconditioner<...>></tt>,
+ * or a dense decomposition, e.g. <tt>LUDecomposition<MatrixXf></tt> or <tt>CholeskyDecomposition<MatrixXf></tt>.
+ * The low-precision copy of the matrix and the inner solver are created in the constructor.
+ *
+ * The refinement converges as long as the inner solver reduces the residual, i.e. for matrices
+ * with a condition number well below the inverse of the machine precision of the inner scalar type.
+ *
+ * \tparam _MatrixType the type of the high-precision matrix
+ * \tparam _InnerSolver the type of the low-precision solver for the correction equation
+ */
+template<typename _MatrixType, typename _InnerSolver>
+class MixedPrecisionRefinement : public SolverBase<MixedPrecisionRefinement<_MatrixType, _InnerSolver>>
+{
+public:
+    using Type = MixedPrecisionRefinement<_MatrixType, _InnerSolver>;
+    using Base = SolverBase<Type>;
+    using typename Base::Scalar;
+    using RealScalar = typename internal::NumTraits<Scalar>::RealType;
+    using Base::Batches;
+    using MatrixType = _MatrixType;
+    using InnerSolver = _InnerSolver;
+    using InnerMatrixType = typename internal::traits<_InnerSolver>::MatrixType;
+    using InnerScalar = typename internal::traits<InnerMatrixType>::Scalar;
+    using InnerRealScalar = typename internal::NumTraits<InnerScalar>::RealType;
+
+private:
+    MatrixType matrix_;
+    InnerMatrixType innerMatrix_;
+    InnerSolver innerSolver_;
+    RealScalar tolerance_;
+    Index maxIterations_;
+    mutable Index iterations_;
+    mutable Index innerIterations_;
+    mutable RealScalar error_;
+
+public:
+    /**
+     * \brief Creates the low-precision copy of the matrix and initializes the inner solver with it
+     * \param matrix the high-precision matrix
+     */
+    MixedPrecisionRefinement(const MatrixBase<_MatrixType>& matrix)
+        : matrix_(matrix.derived())
+        , innerMatrix_(internal::PrecisionCast<MatrixType, InnerMatrixType>::cast(matrix.derived()))
+        , innerSolver_(innerMatrix_)
+        , tolerance_(RealScalar(1000) * internal::NumTraits<Scalar>::epsilon())
+        , maxIterations_(20)
+        , iterations_(0)
+        , innerIterations_(0)
+        , error_(0)
+    {
+        setInnerTolerance(InnerRealScalar(1e-3));
+    }
+
+    CUMAT_STRONG_INLINE Index rows() const { return matrix_.rows(); }
+    CUMAT_STRONG_INLINE Index cols() const { return matrix_.cols(); }
+    CUMAT_STRONG_INLINE Index batches() const { return matrix_.batches(); }
+    const MatrixType& matrix() const { return matrix_; }
+    /** \returns the low-precision copy of the matrix */
+    const InnerMatrixType& innerMatrix() const { return innerMatrix_; }
+
+    /** \returns a read-write reference to the inner solver for custom configuration. */
+    InnerSolver& innerSolver() { return innerSolver_; }
+    /** \returns a read-only reference to the inner solver. */
+    const InnerSolver& innerSolver() const { return innerSolver_; }
+
+    /** \returns the tolerance of the relative residual |Ax-b|/|b| of the outer refinement loop */
+    RealScalar tolerance() const { return tolerance_; }
+    /** Sets the tolerance of the relative residual |Ax-b|/|b| of the outer refinement loop.
+     * The default is 1000 times the machine precision of the outer scalar type.
+     */
+    Type& setTolerance(const RealScalar& tolerance)
+    {
+        tolerance_ = tolerance;
+        return *this;
+    }
+
+    /** Sets the tolerance of the inner solver for every correction equation, relative to the current residual.
+     * This only has an effect for iterative inner solvers, direct solvers always solve to full (low) precision.
+     * The default is 1e-3.
+     */
+    Type& setInnerTolerance(const InnerRealScalar& tolerance)
+    {
+        setInnerToleranceImpl(innerSolver_, tolerance);
+        return *this;
+    }
+    /** \returns the tolerance of the inner solver, 0 for direct inner solvers */
+    InnerRealScalar innerTolerance() const { return innerToleranceImpl(innerSolver_); }
+
+    /** \returns the maximal number of refinement steps, default is 20 */
+    Index maxIterations() const { return maxIterations_; }
+    /** Sets the maximal number of refinement steps */
+    Type& setMaxIterations(Index maxIters)
+    {
+        maxIterations_ = maxIters;
+        return *this;
+    }
+
+    /** \returns the number of refinement steps (inner solves) performed during the last solve */
+    Index iterations() const { return iterations_; }
+    /** \returns the total number of iterations of the inner solver during the last solve.
+     * Direct inner solvers count as one iteration per solve.
+     */
+    Index innerIterations() const { return innerIterations_; }
+    /** \returns the relative residual |Ax-b|/|b| (maximum over the batches) after the last solve */
+    RealScalar error() const { return error_; }
+
+    //Internal solve implementation
+    template<typename _RHS, typename _Target>
+    void _solve_impl(const MatrixBase<_RHS>& rhs, MatrixBase<_Target>& target) const
+    {
+        CUMAT_STATIC_ASSERT(_Target::Batches != Dynamic, "The target matrix must have a compile-time batch count");
+        CUMAT_STATIC_ASSERT(_Target::Columns == 1, "The target must be a compile-time column vector");
+        CUMAT_ASSERT(matrix_.cols() == rhs.rows());
+        constexpr int Batches = _Target::Batches;
+        typedef Matrix<Scalar, Dynamic, 1, Batches, ColumnMajor> VectorType;
+        typedef Matrix<InnerScalar, Dynamic, 1, Batches, ColumnMajor> InnerVectorType;
+        using std::sqrt;
+
+        iterations_ = 0;
+        innerIterations_ = 0;
+        error_ = 0;
+        const Index n = matrix_.cols();
+        VectorType b = rhs.derived();
+        VectorType x(n, 1, b.batches());
+        x.setZero();
+
+        std::valarray<RealScalar> rhsNorm2(Batches);
+        b.squaredNorm().eval().copyToHost(&rhsNorm2[0]);
+        std::valarray<RealScalar> residualNorm2(Batches);
+        VectorType Ax(n, 1, b.batches());
+        Matrix<RealScalar, 1, 1, Batches, 0> residualNorm2Device(1, 1, b.batches());
+        InnerVectorType residual(n, 1, b.batches());
+        InnerVectorType correction(n, 1, b.batches());
+        CUMAT_ERROR_IF_NO_NVCC(MixedPrecisionRefinement)
+        while (true)
+        {
+            //residual and its norm in high precision, the stopping test must not lose the precision of the outer solve.
+            //The cast to the inner scalar type and the norm are fused into one kernel.
+            Ax.inplace() = matrix_ * x;
+#if CUMAT_NVCC == 1
+            constexpr int BlockSize = 256;
+            Context& ctx = Context::current();
+            const unsigned int numBlocks = static_cast<unsigned int>(std::min(Index(CUMAT_DIV_UP(n, BlockSize)), Index(BlockSize)));
+            residualNorm2Device.setZero();
+            internal::kernels::MixedPrecisionResidualKernel<Scalar, InnerScalar, RealScalar, BlockSize>
+                <<<dim3(numBlocks, static_cast<unsigned int>(b.batches()), 1), BlockSize, 0, ctx.stream()>>>(
+                    n, b.data(), Ax.data(), residual.data(), residualNorm2Device.data());
+            CUMAT_CHECK_ERROR();
+#endif
+            residualNorm2Device.copyToHost(&residualNorm2[0]);
+            bool all = true;
+            error_ = 0;
+            for (int i = 0; i < Batches; ++i)
+            {
+                const RealScalar e = rhsNorm2[i] > 0 ? sqrt(residualNorm2[i] / rhsNorm2[i]) : RealScalar(0);
+                error_ = std::max(error_, e);
+                all = all && e <= tolerance_;
+            }
+            if (all || iterations_ >= maxIterations_) break;
+
+            //correction in low precision
+            correction.inplace() = innerSolver_.solve(residual);
+            innerIterations_ += innerIterationsImpl(innerSolver_);
+            x += correction.template cast<Scalar>();
+            iterations_++;
+        }
+        target.derived().inplace() = x;
+    }
+
+private:
+    template<typename _Solver>
+    static void setInnerToleranceImpl(IterativeSolverBase<_Solver>& solver, const InnerRealScalar& tolerance) { solver.setTolerance(tolerance); }
+    template<typename _Solver>
+    static void setInnerToleranceImpl(DecompositionBase<_Solver>& solver, const InnerRealScalar& tolerance) {}
+
+    template<typename _Solver>
+    static InnerRealScalar innerToleranceImpl(const IterativeSolverBase<_Solver>& solver) { return solver.tolerance(); }
+    template<typename _Solver>
+    static InnerRealScalar innerToleranceImpl(const DecompositionBase<_Solver>& solver) { return InnerRealScalar(0); }
+
+    template<typename _Solver>
+    static Index innerIterationsImpl(const IterativeSolverBase<_Solver>& solver) { return solver.iterations(); }
+    template<typename _Solver>
+    static Index innerIterationsImpl(const DecompositionBase<_Solver>& solver) { return 1; }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef __CUMAT_PIPELINED_CONJUGATE_GRADIENT__
+#define __CUMAT_PIPELINED_CONJUGATE_GRADIENT__
+
+#include "Macros.h"
+
+#include <cmath>
+#include <valarray>
+
+#include "Matrix.h"
+#include "UnaryOps.h"
+#include "BinaryOps.h"
+#include "ReductionOps.h"
+#include "IterativeSolverBase.h"
+#include "ConvergenceCheck.h"
+#include "ConjugateGradient.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    template<typename _MatrixType, typename _Preconditioner>
+    struct traits<PipelinedConjugateGradient<_MatrixType, _Preconditioner> >
+    {
+        using MScalar = typename internal::traits<_MatrixType>::Scalar;
+        using Scalar = typename internal::NumTraits<MScalar>::ElementalType;
+        using MatrixType = _MatrixType;
+        using Preconditioner = _Preconditioner;
+    };
+
+    /**
+     * \brief Launch parameters of the fused reductions of the pipelined CG
+     */
+    struct PipelinedCGConfig
+    {
+        /**
+         * \brief The block size of the reduction kernels
+         */
+        static constexpr int BLOCK_SIZE = 256;
+        /**
+         * \brief The maximal number of blocks per batch of the fused dot products.
+         * The partial results of all blocks of a batch are reduced by a single block in the second pass.
+         */
+        static constexpr int MAX_BLOCKS = BLOCK_SIZE;
+
+        static Index numBlocks(Index size)
+        {
+            return std::max(Index(1), std::min(Index(CUMAT_DIV_UP(size, BLOCK_SIZE)), Index(MAX_BLOCKS)));
+        }
+    };
+
+#if CUMAT_NVCC == 1
+    namespace kernels
+    {
+        // first pass of the fused dot products gamma=(r,u), delta=(w,u), rr=(r,r)
+        // grid: x=blocks per batch, y=batch
+        template<typename _Vector, typename _Real, int BlockSize>
+        __global__ void PipelinedCGDotsKernel(Index size, const _Vector* r, const _Vector* u, const _Vector* w, _Real* partials)
+        {
+            typedef cub::BlockReduce<_Real, BlockSize> BlockReduceT;
+            __shared__ typename BlockReduceT::TempStorage temp_storage;
+
+            const Index batch = blockIdx.y;
+            const Index offset = batch * size;
+            _Real gamma = 0, delta = 0, rr = 0;
+            for (Index i = blockIdx.x * BlockSize + threadIdx.x; i < size; i += gridDim.x * BlockSize)
+            {
+                const _Vector ri = r[offset + i];
+                const _Vector ui = u[offset + i];
+                const _Vector wi = w[offset + i];
+                gamma += functor::BinaryMathFunctor_cwiseDot<_Vector>()(ri, ui, i, 0, batch);
+                delta += functor::BinaryMathFunctor_cwiseDot<_Vector>()(wi, ui, i, 0, batch);
+                rr += functor::UnaryMathFunctor_cwiseAbs2<_Vector>()(ri, i, 0, batch);
+            }
+            gamma = BlockReduceT(temp_storage).Sum(gamma);
+            __syncthreads();
+            delta = BlockReduceT(temp_storage).Sum(delta);
+            __syncthreads();
+            rr = BlockReduceT(temp_storage).Sum(rr);
+            if (threadIdx.x == 0)
+            {
+                _Real* out = partials + 3 * (batch * gridDim.x + blockIdx.x);
+                out[0] = gamma;
+                out[1] = delta;
+                out[2] = rr;
+            }
+        }
+
+        // second pass: one block per batch, sums the partials and computes the step sizes
+        template<typename _Real, int BlockSize>
+        __global__ void PipelinedCGScalarsKernel(int numBlocks, const _Real* partials, const _Real* threshold,
+            const int* convergedAt, _Real* gammaOld, _Real* alpha, _Real* beta, _Real* residualNorm2, int iteration)
+        {
+            typedef cub::BlockReduce<_Real, BlockSize> BlockReduceT;
+            __shared__ typename BlockReduceT::TempStorage temp_storage;
+
+            const int batch = blockIdx.x;
+            const _Real* in = partials + 3 * batch * numBlocks;
+            _Real gamma = 0, delta = 0, rr = 0;
+            for (int i = threadIdx.x; i < numBlocks; i += BlockSize)
+            {
+                gamma += in[3 * i];
+                delta += in[3 * i + 1];
+                rr += in[3 * i + 2];
+            }
+            gamma = BlockReduceT(temp_storage).Sum(gamma);
+            __syncthreads();
+            delta = BlockReduceT(temp_storage).Sum(delta);
+            __syncthreads();
+            rr = BlockReduceT(temp_storage).Sum(rr);
+            if (threadIdx.x == 0)
+            {
+                residualNorm2[batch] = rr;
+                if (convergedAt[batch] >= 0 || rr < threshold[batch])
+                {
+                    // converged: freeze this batch
+                    alpha[batch] = 0;
+                    beta[batch] = 0;
+                }
+                else if (iteration == 0)
+                {
+                    beta[batch] = 0;
+                    alpha[batch] = gamma / delta;
+                    gammaOld[batch] = gamma;
+                }
+                else
+                {
+                    const _Real b = gamma / gammaOld[batch];
+                    beta[batch] = b;
+                    alpha[batch] = gamma / (delta - b * gamma / alpha[batch]);
+                    gammaOld[batch] = gamma;
+                }
+            }
+        }
+
+        // fused vector updates of the pipelined CG
+        template<typename _Vector, typename _Real>
+        __global__ void PipelinedCGUpdateKernel(dim3 virtual_size, const _Real* alpha, const _Real* beta,
+            _Vector* x, _Vector* r, _Vector* u, _Vector* w, const _Vector* m, const _Vector* n,
+            _Vector* z, _Vector* q, _Vector* s, _Vector* p)
+        {
+            typedef functor::BinaryMathFunctor_cwiseMul<_Vector> Mul;
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                const Index idx = i + batch * virtual_size.x;
+                const _Vector a = functor::CastFunctor<_Real, _Vector>::cast(alpha[batch]);
+                const _Vector b = functor::CastFunctor<_Real, _Vector>::cast(beta[batch]);
+                const _Vector zi = n[idx] + Mul()(b, z[idx], i, 0, batch);
+                const _Vector qi = m[idx] + Mul()(b, q[idx], i, 0, batch);
+                const _Vector si = w[idx] + Mul()(b, s[idx], i, 0, batch);
+                const _Vector pi = u[idx] + Mul()(b, p[idx], i, 0, batch);
+                z[idx] = zi;
+                q[idx] = qi;
+                s[idx] = si;
+                p[idx] = pi;
+                x[idx] = x[idx] + Mul()(a, pi, i, 0, batch);
+                r[idx] = r[idx] - Mul()(a, si, i, 0, batch);
+                u[idx] = u[idx] - Mul()(a, qi, i, 0, batch);
+                w[idx] = w[idx] - Mul()(a, zi, i, 0, batch);
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+}
+
+/**
+ * \brief Pipelined conjugate gradient solver (Ghysels and Vanroose, 2014) for arbitrary (dense, sparse, matrix-free) matrices.
+ *
+ * This is a reformulation of the preconditioned ConjugateGradient with the same interface, preconditioners and
+ * requirements on the matrix type. The standard CG needs three separate reductions per iteration, where each reduction
+ * has to finish before the next step can be launched. The pipelined variant merges them into a single fused
+ * reduction of the dot products \f$ (r,u), (w,u), (r,r) \f$, which runs on a second stream concurrently
+ * to the preconditioner and the matrix-vector product. All vector updates are fused into a single kernel.
+ * This comes at the cost of four additional vectors and a slightly lower numerical stability:
+ * the recursively updated residual may drift from the true residual for very small tolerances.
+ *
+ * The step sizes never leave the device and the convergence is always evaluated on the device,
+ * see IterativeSolverBase::setConvergenceCheckInterval(); an interval of 0 (the default) waits for the device in every iteration.
+ * Because the residual norm is computed in the same reduction as the step sizes,
+ * the convergence is detected one matrix-vector product later than in the ConjugateGradient.
+ *
+ * The scalar type has to be real, or a blocked type whose dot product (\c functor::BinaryMathFunctor_cwiseDot) returns the real ElementType,
+ * see ConjugateGradient for the required specializations.
+ * The vectors are evaluated into dense column vectors, so the solver requires NVCC.
+ *
+ * \tparam _MatrixType any matrix expression with an operator* that takes a dense column vector as right hand side
+ * \tparam _Preconditioner the preconditioner object, default is DiagonalPreconditioner
+ */
+template<typename _MatrixType, typename _Preconditioner = DiagonalPreconditioner<_MatrixType>>
+class PipelinedConjugateGradient : public IterativeSolverBase<PipelinedConjugateGradient<_MatrixType, _Preconditioner>>
+{
+    CUMAT_STATIC_ASSERT(_MatrixType::Batches != Dynamic, "Pipelined Conjugate Gradient can only work on matrices with compile-time batch count");
+
+public:
+    using Type = PipelinedConjugateGradient<_MatrixType, _Preconditioner>;
+    using Base = IterativeSolverBase<Type>;
+    using typename Base::MatrixType;
+    using typename Base::Preconditioner;
+    using typename Base::Scalar;
+    using typename Base::RealScalar;
+    using Base::maxIterations;
+
+private:
+    using Base::matrix_;
+    using Base::preconditioner_;
+    using Base::tolerance_;
+    using Base::iterations_;
+    using Base::batchIterations_;
+    using Base::error_;
+    using Base::convergenceCheckInterval_;
+
+public:
+
+    PipelinedConjugateGradient() = default;
+
+    /**
+     * \brief Initializes the Pipelined Conjugate Gradient with the specified matrix.
+     * The preconditioner is created with \code Preconditioner(matrix) \endcode.
+     * \param matrix the matrix that is used in the CG.
+     */
+    PipelinedConjugateGradient(const MatrixBase<_MatrixType>& matrix)
+        : Base(matrix)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    /**
+     * \brief Initializes the Pipelined Conjugate Gradient with the specified matrix
+     * and specified preconditioner.
+     * \param matrix the matrix that is used in the CG.
+     * \param preconditioner the preconditioner that is used
+     */
+    PipelinedConjugateGradient(const MatrixBase<_MatrixType>& matrix, const _Preconditioner& preconditioner)
+        : Base(matrix, preconditioner)
+    {
+        CUMAT_ASSERT(matrix.rows() == matrix.cols() && "Matrix must be square");
+    }
+
+    template<typename _RHS, typename _Target>
+    void _solve_impl(const MatrixBase<_RHS>& rhs, MatrixBase<_Target>& target) const
+    {
+        typedef Matrix<typename _Target::Scalar, Dynamic, 1, _Target::Batches, _Target::Flags> GuessType;
+        GuessType guess(target.rows(), 1, target.batches());
+        guess.setZero();
+        _solve_with_guess_impl(rhs.derived(), target.derived(), guess);
+    }
+
+    template<typename _RHS, typename _Target, typename _Guess>
+    void _solve_with_guess_impl(_RHS& rhs, _Target& target, _Guess& guess) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(PipelinedConjugateGradient)
+        CUMAT_STATIC_ASSERT(_Target::Batches != Dynamic, "The target matrix must have a compile-time batch count");
+        CUMAT_STATIC_ASSERT(_Target::Columns == 1, "The target must be a compile-time column vector");
+        CUMAT_STATIC_ASSERT(_Guess::Batches != Dynamic, "The initial guess must have a compile-time batch count");
+        CUMAT_STATIC_ASSERT(_Guess::Columns == 1, "The initial guess must be a compile-time column vector");
+        CUMAT_ASSERT(matrix_.cols() == rhs.rows());
+        constexpr int Batches = _Target::Batches;
+        typedef typename _Target::Scalar VectorScalarType;
+        CUMAT_STATIC_ASSERT((std::is_same<typename functor::BinaryMathFunctor_cwiseDot<VectorScalarType>::ReturnType, RealScalar>::value),
+            "The pipelined conjugate gradient only supports real scalar types");
+
+        //initialize result and counter
+        iterations_ = 0;
+        batchIterations_.assign(Batches, 0);
+        error_ = 0;
+        target.inplace() = guess;
+
+        typedef Matrix<RealScalar, 1, 1, Batches, 0> RealScalarDevice;
+        typedef Matrix<int, 1, 1, Batches, 0> IntDevice;
+        typedef Matrix<VectorScalarType, Dynamic, 1, Batches, _Target::Flags> VectorType;
+        using std::sqrt;
+        const Index n = matrix_.cols();
+
+        //early outs, identical to the ConjugateGradient
+        VectorType r = rhs - matrix_ * target; //initial residual
+        std::valarray<RealScalar> rhsNorm2(Batches);
+        rhs.squaredNorm().eval().copyToHost(&rhsNorm2[0]);
+        bool all = true;
+        for (int b = 0; b < Batches; ++b) all = all && (rhsNorm2[b] < tolerance_ * tolerance_);
+        if (all)
+        {
+            //early out, right-hand side is zero
+            target.setZero();
+            return;
+        }
+        std::valarray<RealScalar> threshold = tolerance_ * tolerance_ * rhsNorm2;
+        std::valarray<RealScalar> residualNorm2(Batches);
+        r.squaredNorm().eval().copyToHost(&residualNorm2[0]);
+        all = true;
+        for (int b = 0; b < Batches; ++b) all = all && residualNorm2[b] < threshold[b];
+        if (all)
+        {
+            //early out, already close enough to the solution
+            error_ = sqrt((residualNorm2 / rhsNorm2).max());
+            return;
+        }
+
+#if CUMAT_NVCC == 1
+        //----------------
+        // PIPELINED CG ALGORITHM
+        //----------------
+        typedef internal::PipelinedCGConfig Config;
+        const Index maxIter = maxIterations();
+        const internal::ConvergenceCheckSchedule schedule(std::max(Index(1), convergenceCheckInterval_), maxIter);
+
+        RealScalarDevice thresholdDevice(1, 1, Batches);
+        thresholdDevice.copyFromHost(&threshold[0]);
+        IntDevice convergedAt = IntDevice::Constant(1, 1, Batches, -1); //per batch: iteration of convergence or -1
+        internal::MappedConvergenceStatus status;
+        RealScalarDevice alpha(1, 1, Batches), beta(1, 1, Batches), gammaOld(1, 1, Batches), rrDevice(1, 1, Batches);
+        const int numBlocks = static_cast<int>(Config::numBlocks(n));
+        DevicePointer<RealScalar> partials(3 * numBlocks * Batches);
+
+        VectorType u(n, 1, Batches), w(n, 1, Batches), m(n, 1, Batches), nv(n, 1, Batches);
+        VectorType z(n, 1, Batches), q(n, 1, Batches), s(n, 1, Batches), p(n, 1, Batches);
+        z.setZero(); q.setZero(); s.setZero(); p.setZero();
+        u.inplace() = preconditioner_.solve(r);
+        w.inplace() = matrix_ * u;
+
+        // the fused reduction runs on the side stream of the context, concurrently to the preconditioner and the matrix-vector product
+        Context& ctx = Context::current();
+        cudaStream_t mainStream = ctx.stream();
+        cudaStream_t reductionStream = ctx.sideStream();
+        Event vectorsReady, dotsReady;
+        KernelLaunchConfig cfgUpdate = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), Batches,
+            internal::kernels::PipelinedCGUpdateKernel<VectorScalarType, RealScalar>);
+
+        Index i = 0;
+        bool converged = false;
+        for (; i < maxIter; ++i)
+        {
+            //fused dot products (r,u), (w,u), (r,r)
+            vectorsReady.record(mainStream);
+            vectorsReady.streamWait(reductionStream);
+            internal::kernels::PipelinedCGDotsKernel<VectorScalarType, RealScalar, Config::BLOCK_SIZE>
+                <<<dim3(numBlocks, Batches, 1), Config::BLOCK_SIZE, 0, reductionStream>>>(
+                    n, r.data(), u.data(), w.data(), partials.pointer());
+            CUMAT_CHECK_ERROR();
+            internal::kernels::PipelinedCGScalarsKernel<RealScalar, Config::BLOCK_SIZE>
+                <<<Batches, Config::BLOCK_SIZE, 0, reductionStream>>>(
+                    numBlocks, partials.pointer(), thresholdDevice.data(), convergedAt.data(),
+                    gammaOld.data(), alpha.data(), beta.data(), rrDevice.data(), static_cast<int>(i));
+            CUMAT_CHECK_ERROR();
+            dotsReady.record(reductionStream);
+
+            //overlapped: m = M^-1 w, n = A m
+            m.inplace() = preconditioner_.solve(w);
+            nv.inplace() = matrix_ * m; // the bottleneck of the algorithm
+
+            //wait for the reduction, then test for convergence and update the vectors
+            dotsReady.streamWait(mainStream);
+            internal::checkConvergence(rrDevice, thresholdDevice, convergedAt, status, i);
+            internal::kernels::PipelinedCGUpdateKernel<VectorScalarType, RealScalar>
+                <<<cfgUpdate.block_count, cfgUpdate.thread_per_block, 0, mainStream>>>(
+                    cfgUpdate.virtual_size, alpha.data(), beta.data(),
+                    target.data(), r.data(), u.data(), w.data(), m.data(), nv.data(),
+                    z.data(), q.data(), s.data(), p.data());
+            CUMAT_CHECK_ERROR();
+
+            if (schedule.isCheckIteration(i) && status.wait())
+            {
+                converged = true;
+                break;
+            }
+        }
+        CUMAT_SAFE_CALL(cudaStreamSynchronize(reductionStream));
+
+        r.squaredNorm().eval().copyToHost(&residualNorm2[0]);
+        error_ = sqrt((residualNorm2 / rhsNorm2).max());
+        iterations_ = converged ? status.iteration() : maxIter;
+        internal::copyBatchIterations(convergedAt, maxIter, batchIterations_);
+#endif
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
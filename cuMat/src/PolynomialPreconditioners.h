@@ -0,0 +1,299 @@
+#ifndef __CUMAT_POLYNOMIAL_PRECONDITIONERS_H__
+#define __CUMAT_POLYNOMIAL_PRECONDITIONERS_H__
+
+#include "Macros.h"
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "ForwardDeclarations.h"
+#include "Matrix.h"
+#include "BinaryOps.h"
+#include "ProductOp.h"
+#include "ReductionOps.h"
+#include "UnaryOps.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    /**
+     * \brief Computes the smallest and largest eigenvalue of the symmetric tridiagonal matrix
+     * with the diagonal \c alpha and the off-diagonal \c beta (size alpha.size()-1) with Sturm sequence bisection.
+     * This runs on the host.
+     */
+    template<typename _Scalar>
+    void tridiagonalEigenvalueBounds(const std::vector<_Scalar>& alpha, const std::vector<_Scalar>& beta,
+        _Scalar& lambdaMin, _Scalar& lambdaMax)
+    {
+        using std::abs;
+        const size_t m = alpha.size();
+        CUMAT_ASSERT_ARGUMENT(m > 0);
+        CUMAT_ASSERT_ARGUMENT(beta.size() + 1 >= m);
+        //Gershgorin bounds
+        _Scalar lo = alpha[0], hi = alpha[0];
+        for (size_t i = 0; i < m; ++i)
+        {
+            const _Scalar r = (i > 0 ? abs(beta[i - 1]) : _Scalar(0)) + (i + 1 < m ? abs(beta[i]) : _Scalar(0));
+            lo = std::min(lo, alpha[i] - r);
+            hi = std::max(hi, alpha[i] + r);
+        }
+        //number of eigenvalues smaller than x
+        const auto count = [&](_Scalar x)
+        {
+            size_t c = 0;
+            _Scalar d = 1;
+            for (size_t i = 0; i < m; ++i)
+            {
+                d = alpha[i] - x - (i > 0 ? beta[i - 1] * beta[i - 1] / d : _Scalar(0));
+                if (d == _Scalar(0)) d = std::numeric_limits<_Scalar>::epsilon() * (abs(x) + _Scalar(1));
+                if (d < 0) c++;
+            }
+            return c;
+        };
+        const auto bisect = [&](size_t k)
+        {
+            //smallest x with count(x) >= k
+            _Scalar a = lo, b = hi;
+            for (int it = 0; it < 100 && b - a > std::numeric_limits<_Scalar>::epsilon() * (abs(a) + abs(b)); ++it)
+            {
+                const _Scalar c = (a + b) / 2;
+                if (count(c) >= k) b = c; else a = c;
+            }
+            return (a + b) / 2;
+        };
+        lambdaMin = bisect(1);
+        lambdaMax = bisect(m);
+    }
+
+    /**
+     * \brief Estimates the extreme eigenvalues of <tt>D^-1 A</tt> with the Lanczos method,
+     * where D is the diagonal of the symmetric positive definite matrix A.
+     * The Lanczos vectors are orthogonal in the inner product <tt>(x,y) -> x^T D y</tt>,
+     * in which <tt>D^-1 A</tt> is self-adjoint.
+     * The extreme Ritz values converge from the inside to the extreme eigenvalues.
+     *
+     * Every step performs one matrix-vector product and three reductions that are copied to the host,
+     * hence this is only meant for the setup phase.
+     * \param matrix the matrix A
+     * \param diagonal the diagonal of A
+     * \param steps the number of Lanczos steps
+     * \param lambdaMin [out] the smallest Ritz value
+     * \param lambdaMax [out] the largest Ritz value
+     */
+    template<typename _MatrixType, typename _Scalar>
+    void lanczosEigenvalueBounds(const _MatrixType& matrix, const Matrix<_Scalar, Dynamic, 1, 1, ColumnMajor>& diagonal,
+        int steps, _Scalar& lambdaMin, _Scalar& lambdaMax)
+    {
+        typedef Matrix<_Scalar, Dynamic, 1, 1, ColumnMajor> Vector;
+        using std::sqrt;
+        const Index n = diagonal.rows();
+        CUMAT_ASSERT_ARGUMENT(steps > 0);
+        //deterministic start vector that is not an eigenvector of typical stencils
+        std::vector<_Scalar> start(n);
+        for (Index i = 0; i < n; ++i) start[i] = _Scalar(1) + _Scalar((i * 7919) % 13) / _Scalar(13);
+        Vector v(n), vOld(n), w(n), Av(n);
+        v.copyFromHost(start.data());
+        v *= _Scalar(1) / sqrt(static_cast<_Scalar>(v.dot(diagonal.cwiseMul(v))));
+        vOld.setZero();
+        std::vector<_Scalar> alpha, beta;
+        _Scalar betaOld = 0;
+        for (int j = 0; j < steps && j < n; ++j)
+        {
+            Av.inplace() = matrix * v;
+            const _Scalar a = static_cast<_Scalar>(v.dot(Av));
+            alpha.push_back(a);
+            w.inplace() = Av.cwiseDiv(diagonal) - a * v - betaOld * vOld;
+            const _Scalar b = sqrt(static_cast<_Scalar>(w.dot(diagonal.cwiseMul(w))));
+            if (j + 1 == steps || b <= std::numeric_limits<_Scalar>::epsilon() * std::abs(a))
+                break; //done or invariant subspace found
+            beta.push_back(b);
+            vOld.inplace() = v;
+            v.inplace() = (_Scalar(1) / b) * w;
+            betaOld = b;
+        }
+        tridiagonalEigenvalueBounds(alpha, beta, lambdaMin, lambdaMax);
+    }
+}
+
+/**
+ * \brief Chebyshev polynomial preconditioner for symmetric positive definite matrices.
+ *
+ * The inverse of the matrix is approximated by the polynomial <tt>p(D^-1 A) D^-1</tt> of degree \c degree-1
+ * that is optimal in the Chebyshev sense on the eigenvalue interval of <tt>D^-1 A</tt>, D being the diagonal of A.
+ * The interval is estimated once in the constructor with a few Lanczos steps.
+ * Applying the preconditioner in \ref solve() uses \c degree-1 matrix-vector products and element-wise updates only,
+ * it contains no global reductions. This makes it attractive for batched solves and in combination
+ * with the device-side convergence checks of the ConjugateGradient.
+ *
+ * \tparam _MatrixType the matrix type, must provide \c diagonal() and the product with a vector
+ */
+template<typename _MatrixType>
+class ChebyshevPreconditioner
+{
+public:
+    typedef typename internal::traits<_MatrixType>::Scalar Scalar;
+    CUMAT_STATIC_ASSERT(std::is_floating_point<Scalar>::value, "The Chebyshev preconditioner only supports float and double");
+
+private:
+    typedef Matrix<Scalar, Dynamic, 1, 1, ColumnMajor> Vector;
+    _MatrixType matrix_;
+    Vector invDiagonal_;
+    int degree_;
+    Scalar lower_;
+    Scalar upper_;
+
+public:
+    ChebyshevPreconditioner()
+        : degree_(0), lower_(0), upper_(0)
+    {}
+
+    /**
+     * \brief Estimates the eigenvalue interval of the matrix.
+     * \param matrix the symmetric positive definite matrix
+     * \param degree the number of terms of the polynomial, one term is the diagonal preconditioner
+     * \param lanczosSteps the number of Lanczos steps to estimate the eigenvalues
+     */
+    ChebyshevPreconditioner(const MatrixBase<_MatrixType>& matrix, int degree = 4, int lanczosSteps = 10)
+        : matrix_(matrix.derived()), degree_(degree)
+    {
+        CUMAT_ASSERT_ARGUMENT(degree >= 1);
+        const Vector diagonal = matrix.diagonal();
+        invDiagonal_ = diagonal.cwiseInverse();
+        Scalar lambdaMin, lambdaMax;
+        internal::lanczosEigenvalueBounds(matrix_, diagonal, lanczosSteps, lambdaMin, lambdaMax);
+        //the largest Ritz value underestimates the largest eigenvalue,
+        //the polynomial is only positive (the preconditioner SPD) if the interval contains all larger eigenvalues
+        upper_ = Scalar(1.1) * lambdaMax;
+        lower_ = std::max(lambdaMin, upper_ * std::numeric_limits<Scalar>::epsilon());
+    }
+
+    /**
+     * \brief Sets the eigenvalue interval of <tt>D^-1 A</tt> explicitly
+     */
+    void setEigenvalueBounds(Scalar lower, Scalar upper)
+    {
+        CUMAT_ASSERT_ARGUMENT(0 < lower && lower < upper);
+        lower_ = lower;
+        upper_ = upper;
+    }
+
+    Scalar lowerEigenvalueBound() const { return lower_; }
+    Scalar upperEigenvalueBound() const { return upper_; }
+    int degree() const { return degree_; }
+
+    /**
+     * \brief Applies the Chebyshev polynomial to approximately solve for A.x=b
+     * \tparam _Rhs the type of right hand side
+     * \param b the right hand side of the equation
+     * \return the approximate solution of x
+     */
+    template<typename _Rhs>
+    Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor>
+    solve(const MatrixBase<_Rhs>& b) const
+    {
+        typedef Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor> VectorType;
+        CUMAT_ASSERT(degree_ > 0 && "The preconditioner is not initialized");
+        //Chebyshev iteration for D^-1 A x = D^-1 b, starting from x=0
+        const Scalar theta = (upper_ + lower_) / 2;
+        const Scalar delta = (upper_ - lower_) / 2;
+        const Scalar sigma = theta / delta;
+        VectorType r = invDiagonal_.cwiseMul(b.derived());
+        VectorType d = (Scalar(1) / theta) * r;
+        VectorType x = d.deepClone();
+        VectorType tmp(x.rows(), 1, x.batches());
+        Scalar rho = Scalar(1) / sigma;
+        for (int k = 1; k < degree_; ++k)
+        {
+            tmp.inplace() = matrix_ * d;
+            r -= invDiagonal_.cwiseMul(tmp);
+            const Scalar rhoNew = Scalar(1) / (Scalar(2) * sigma - rho);
+            d = (rhoNew * rho) * d + (Scalar(2) * rhoNew / delta) * r;
+            x += d;
+            rho = rhoNew;
+        }
+        return x;
+    }
+};
+
+/**
+ * \brief Truncated Neumann series preconditioner for symmetric positive definite matrices.
+ *
+ * The inverse of the matrix is approximated by <tt>sum_{k=0}^{degree-1} (I - w D^-1 A)^k w D^-1</tt>,
+ * D being the diagonal of A, which is the same as \c degree-1 damped Jacobi iterations starting from zero.
+ * The damping <tt>w = 1/lambda_max(D^-1 A)</tt> is estimated once in the constructor with a few Lanczos steps.
+ * As the ChebyshevPreconditioner, \ref solve() contains no global reductions.
+ *
+ * \tparam _MatrixType the matrix type, must provide \c diagonal() and the product with a vector
+ */
+template<typename _MatrixType>
+class NeumannPreconditioner
+{
+public:
+    typedef typename internal::traits<_MatrixType>::Scalar Scalar;
+    CUMAT_STATIC_ASSERT(std::is_floating_point<Scalar>::value, "The Neumann preconditioner only supports float and double");
+
+private:
+    typedef Matrix<Scalar, Dynamic, 1, 1, ColumnMajor> Vector;
+    _MatrixType matrix_;
+    Vector invDiagonal_; //scaled by the damping factor
+    int degree_;
+    Scalar omega_;
+
+public:
+    NeumannPreconditioner()
+        : degree_(0), omega_(0)
+    {}
+
+    /**
+     * \brief Estimates the damping factor.
+     * \param matrix the symmetric positive definite matrix
+     * \param degree the number of terms of the series, one term is the diagonal preconditioner
+     * \param lanczosSteps the number of Lanczos steps to estimate the largest eigenvalue
+     */
+    NeumannPreconditioner(const MatrixBase<_MatrixType>& matrix, int degree = 4, int lanczosSteps = 10)
+        : matrix_(matrix.derived()), degree_(degree)
+    {
+        CUMAT_ASSERT_ARGUMENT(degree >= 1);
+        const Vector diagonal = matrix.diagonal();
+        Scalar lambdaMin, lambdaMax;
+        internal::lanczosEigenvalueBounds(matrix_, diagonal, lanczosSteps, lambdaMin, lambdaMax);
+        omega_ = Scalar(1) / (Scalar(1.1) * lambdaMax);
+        invDiagonal_ = omega_ * diagonal.cwiseInverse();
+    }
+
+    /**
+     * \brief The damping factor w
+     */
+    Scalar omega() const { return omega_; }
+    int degree() const { return degree_; }
+
+    /**
+     * \brief Applies the truncated Neumann series to approximately solve for A.x=b
+     * \tparam _Rhs the type of right hand side
+     * \param b the right hand side of the equation
+     * \return the approximate solution of x
+     */
+    template<typename _Rhs>
+    Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor>
+    solve(const MatrixBase<_Rhs>& b) const
+    {
+        typedef Matrix<Scalar, Dynamic, 1, internal::traits<_Rhs>::BatchesAtCompileTime, ColumnMajor> VectorType;
+        CUMAT_ASSERT(degree_ > 0 && "The preconditioner is not initialized");
+        VectorType rhs = b.derived();
+        VectorType x = invDiagonal_.cwiseMul(rhs);
+        VectorType tmp(x.rows(), 1, x.batches());
+        for (int k = 1; k < degree_; ++k)
+        {
+            tmp.inplace() = matrix_ * x;
+            x += invDiagonal_.cwiseMul(rhs - tmp);
+        }
+        return x;
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
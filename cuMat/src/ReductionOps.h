@@ -645,6 +645,25 @@ SPECIALIZE_ALG(ReductionAlg::Device<1>);
 #undef SPECIALIZE_ALG
 #undef SPECIALIZE_ALG_PARAM
 
+//-------------------------------------------------
+// DISPATCHER
+//-------------------------------------------------
+
+/**
+ * \brief Entry point of the reduction expressions, forwards to \ref ReductionEvaluator.
+ * Partial specializations can bypass the dense evaluators for special inputs,
+ * e.g. the reductions over the stored entries of sparse matrices in SparseReductionOps.h.
+ * The last parameter is for enable_if.
+ */
+template <typename _Input, typename _Output, int _Axis, typename _Op, typename _Scalar, typename _Algorithm, typename = void>
+struct ReductionDispatcher
+{
+	static void eval(const MatrixBase<_Input>& in, _Output& out, const _Op& op, const _Scalar& initial)
+	{
+		ReductionEvaluator<_Input, _Output, _Axis, _Op, _Scalar, _Algorithm>::eval(in, out, op, initial);
+	}
+};
+
 //-------------------------------------------------
 // ASSIGNMENT
 //-------------------------------------------------
@@ -751,35 +770,35 @@ public:
 		switch (axisSimplified)
 		{
 			case 0:
-				internal::ReductionEvaluator<_Child, Derived, 0, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 0, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			case 1:
-				internal::ReductionEvaluator<_Child, Derived, 1, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 1, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			case 2:
-				internal::ReductionEvaluator<_Child, Derived, 2, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 2, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			case 3:
-				internal::ReductionEvaluator<_Child, Derived, 3, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 3, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			case 4:
-				internal::ReductionEvaluator<_Child, Derived, 4, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 4, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			case 5:
-				internal::ReductionEvaluator<_Child, Derived, 5, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 5, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			case 6:
-				internal::ReductionEvaluator<_Child, Derived, 6, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 6, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			case 7:
-				internal::ReductionEvaluator<_Child, Derived, 7, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
+				internal::ReductionDispatcher<_Child, Derived, 7, _ReductionOp, Scalar, _Algorithm>::eval(child_, m.derived(),
 																																																 op_, initialValue_);
 				break;
 			default:
@@ -877,7 +896,7 @@ public:
 										<< ((AxisSimplified & Axis::Column) ? "C" : "") << ((AxisSimplified & Axis::Batch) ? "B" : ""));
 
 		// compile-time switch to the implementations
-		internal::ReductionEvaluator<_Child, Derived, AxisSimplified, _ReductionOp, Scalar, _Algorithm>::eval(
+		internal::ReductionDispatcher<_Child, Derived, AxisSimplified, _ReductionOp, Scalar, _Algorithm>::eval(
 				child_, m.derived(), op_, initialValue_);
 		CUMAT_LOG_DEBUG("Evaluation done");
 	}
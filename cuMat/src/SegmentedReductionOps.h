@@ -0,0 +1,440 @@
+#ifndef __CUMAT_SEGMENTED_REDUCTION_OPS_H__
+#define __CUMAT_SEGMENTED_REDUCTION_OPS_H__
+
+#include <array>
+#include <vector>
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Constants.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "NullaryOps.h"
+#include "ReductionOps.h"
+#include "ReductionAlgorithmSelection.h"
+#include "HistogramOps.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+extern std::string LastReductionAlgorithm;
+#endif
+
+namespace internal
+{
+	/**
+	 * \brief Histogram of the segment lengths of an offset vector in logarithmic buckets.
+	 * Bucket 0 contains the empty segments, bucket b>0 the segments with a length in [2^(b-1), 2^b).
+	 * Besides the number of segments per bucket, also the number of entries in those segments is stored.
+	 * This is the input to the algorithm selection of the segmented reduction,
+	 * but it can also be used as a general statistic of, e.g., the row lengths of a sparse matrix.
+	 */
+	struct SegmentLengthHistogram
+	{
+		static constexpr int NUM_BUCKETS = 32;
+
+		/**
+		 * \brief The number of segments per bucket
+		 */
+		std::array<Index, NUM_BUCKETS> segments;
+		/**
+		 * \brief The number of entries in the segments of each bucket
+		 */
+		std::array<Index, NUM_BUCKETS> entries;
+
+		SegmentLengthHistogram()
+		{
+			segments.fill(0);
+			entries.fill(0);
+		}
+
+		/**
+		 * \brief Returns the bucket of a segment with the specified length
+		 */
+		static __host__ __device__ CUMAT_STRONG_INLINE int bucket(int length)
+		{
+#ifdef __CUDA_ARCH__
+			return length <= 0 ? 0 : 32 - __clz(length);
+#else
+			int b = 0;
+			while (length > 0)
+			{
+				length >>= 1;
+				++b;
+			}
+			return b;
+#endif
+		}
+
+		/**
+		 * \brief Builds the histogram on the host from the given offset vector
+		 * \param offsets the offset vector of size numSegments+1
+		 */
+		static SegmentLengthHistogram fromOffsets(const std::vector<int>& offsets)
+		{
+			SegmentLengthHistogram h;
+			for (size_t i = 0; i + 1 < offsets.size(); ++i)
+			{
+				const int length = offsets[i + 1] - offsets[i];
+				const int b = bucket(length);
+				h.segments[b]++;
+				h.entries[b] += length;
+			}
+			return h;
+		}
+
+#if CUMAT_NVCC == 1
+		/**
+		 * \brief Builds the histogram on the device from the given offset vector.
+		 * Only the two histograms are copied back to the host.
+		 * \param offsets the offset vector of size numSegments+1
+		 */
+		static SegmentLengthHistogram fromOffsets(const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets);
+#endif
+
+		Index numSegments() const
+		{
+			Index n = 0;
+			for (int i = 0; i < NUM_BUCKETS; ++i)
+				n += segments[i];
+			return n;
+		}
+		Index numEntries() const
+		{
+			Index n = 0;
+			for (int i = 0; i < NUM_BUCKETS; ++i)
+				n += entries[i];
+			return n;
+		}
+		/**
+		 * \brief Returns the number of entries that are in segments of at least the specified length
+		 * \param minLength the minimal length, rounded down to the bucket boundary
+		 */
+		Index entriesInSegmentsOfLength(int minLength) const
+		{
+			Index n = 0;
+			for (int i = bucket(minLength); i < NUM_BUCKETS; ++i)
+				n += entries[i];
+			return n;
+		}
+	};
+
+	/**
+	 * \brief Selects the algorithm for the segmented reduction based on the segment length histogram.
+	 * Candidates are warp-per-segment (ReductionAlgorithm::Warp), block-per-segment (ReductionAlgorithm::Block256)
+	 * and cub::DeviceSegmentedReduce (ReductionAlgorithm::Segmented).
+	 *
+	 * The decision is based on where most of the work, i.e. the entries, lies:
+	 * short segments are best handled by a warp, long segments by a block.
+	 * cub is only faster for a few very long segments, see the benchmarks of the batched reduction.
+	 */
+	struct SegmentedReductionSelection
+	{
+		/**
+		 * \brief Segments shorter than this are handled well by a single warp.
+		 */
+		static constexpr int WARP_MAX_LENGTH = 128;
+		/**
+		 * \brief Segments of at least this length are considered for cub::DeviceSegmentedReduce
+		 */
+		static constexpr int SEGMENTED_MIN_LENGTH = 4096;
+		/**
+		 * \brief cub::DeviceSegmentedReduce is only used for at most that many segments
+		 */
+		static constexpr Index SEGMENTED_MAX_SEGMENTS = 512;
+
+		static ReductionAlgorithm select(const SegmentLengthHistogram& h)
+		{
+			const Index numSegments = h.numSegments();
+			const Index numEntries = h.numEntries();
+			const Index longEntries = h.entriesInSegmentsOfLength(WARP_MAX_LENGTH);
+			if (2 * longEntries <= numEntries)
+				return ReductionAlgorithm::Warp;
+			const Index veryLongEntries = h.entriesInSegmentsOfLength(SEGMENTED_MIN_LENGTH);
+			if (numSegments <= SEGMENTED_MAX_SEGMENTS && 2 * veryLongEntries > numEntries)
+				return ReductionAlgorithm::Segmented;
+			return ReductionAlgorithm::Block256;
+		}
+	};
+
+	/**
+	 * \brief Segmented reduction evaluator / dispatcher.
+	 *
+	 * Specializations must define the function
+	 * <code>
+	 * static void eval(const _Input& in, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets, _Output& out, const _Op& op, const _Scalar& initial);
+	 * </code>
+	 * The input is a (batched) column vector, the offsets are shared among all batches.
+	 *
+	 * \tparam _Algorithm tag for selecting the algorithm. Valid tags are ReductionAlg::Warp, ReductionAlg::Block,
+	 *   ReductionAlg::Segmented and ReductionAlg::Auto.
+	 */
+	template <typename _Input, typename _Output, typename _Op, typename _Scalar, typename _Algorithm>
+	struct SegmentedReductionEvaluator
+	{
+		static void eval(const _Input& in, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets, _Output& out,
+										 const _Op& op, const _Scalar& initial);
+	};
+
+#if CUMAT_NVCC == 1
+	// length of the segment (Nullary functor)
+	struct SegmentLengthFunctor
+	{
+		const int* offsets;
+		typedef int ReturnType;
+		__device__ CUMAT_STRONG_INLINE int operator()(Index row, Index col, Index batch) const
+		{
+			return offsets[row + 1] - offsets[row];
+		}
+	};
+	// bucket of the segment length (Nullary functor)
+	struct SegmentLengthBucketFunctor
+	{
+		const int* offsets;
+		typedef int ReturnType;
+		__device__ CUMAT_STRONG_INLINE int operator()(Index row, Index col, Index batch) const
+		{
+			return SegmentLengthHistogram::bucket(offsets[row + 1] - offsets[row]);
+		}
+	};
+
+	inline SegmentLengthHistogram SegmentLengthHistogram::fromOffsets(
+			const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets)
+	{
+		SegmentLengthHistogram h;
+		const Index numSegments = offsets.rows() - 1;
+		if (numSegments <= 0)
+			return h;
+		typedef NullaryOp<int, Dynamic, 1, 1, ColumnMajor, SegmentLengthFunctor> LengthOp;
+		typedef NullaryOp<int, Dynamic, 1, 1, ColumnMajor, SegmentLengthBucketFunctor> BucketOp;
+		const LengthOp lengths(numSegments, 1, 1, SegmentLengthFunctor{ offsets.data() });
+		const BucketOp buckets(numSegments, 1, 1, SegmentLengthBucketFunctor{ offsets.data() });
+
+		// counts and entries per bucket
+		const Matrix<int, Dynamic, 1, 1, ColumnMajor> segmentCounts = bincount(buckets, NUM_BUCKETS);
+		const Matrix<int, Dynamic, 1, 1, ColumnMajor> entryCounts = bincount(buckets, lengths, NUM_BUCKETS);
+		std::vector<int> hostSegments(NUM_BUCKETS), hostEntries(NUM_BUCKETS);
+		segmentCounts.copyToHost(hostSegments.data());
+		entryCounts.copyToHost(hostEntries.data());
+		for (int i = 0; i < NUM_BUCKETS; ++i)
+		{
+			h.segments[i] = hostSegments[i];
+			h.entries[i] = hostEntries[i];
+		}
+		return h;
+	}
+
+	namespace kernels
+	{
+		// one warp per segment and batch
+		template <typename _Input, typename _Op, typename _Scalar>
+		__global__ void SegmentedReduceWarpKernel(dim3 virtual_size, _Input input, const int* offsets, _Scalar* output,
+																							_Op op, _Scalar initial, Index numEntries)
+		{
+			const Index numSegments = virtual_size.x / 32;
+			CUMAT_KERNEL_2D_LOOP(i_, batch, virtual_size)
+			const Index i = i_ / 32;
+			const int warp = i_ % 32;
+			const Index start = offsets[i] + batch * numEntries;
+			const Index end = offsets[i + 1] + batch * numEntries;
+			// local reduce
+			_Scalar v = initial;
+			for (Index n = start + warp; n < end; n += 32)
+				v = op(v, input[n]);
+			// final warp reduce
+#pragma unroll
+			for (int offset = 16; offset > 0; offset /= 2)
+				v = op(v, __shfl_down_sync(0xffffffff, v, offset));
+			// write output
+			if (warp == 0)
+				output[i + batch * numSegments] = v;
+			CUMAT_KERNEL_2D_LOOP_END
+		}
+
+		// one block per segment and batch
+		template <typename _Input, typename _Op, typename _Scalar, int BlockSize>
+		__global__ void SegmentedReduceBlockKernel(dim3 virtual_size, _Input input, const int* offsets, _Scalar* output,
+																							 _Op op, _Scalar initial, Index numEntries)
+		{
+			const int part = threadIdx.x;
+			const Index numSegments = virtual_size.x;
+
+			typedef cub::BlockReduce<_Scalar, BlockSize> BlockReduceT;
+			__shared__ typename BlockReduceT::TempStorage temp_storage;
+
+			for (Index s = blockIdx.x; s < Index(virtual_size.x) * virtual_size.y; s += gridDim.x)
+			{
+				const Index batch = s / numSegments;
+				const Index i = s - batch * numSegments;
+				const Index start = offsets[i] + batch * numEntries;
+				const Index end = offsets[i + 1] + batch * numEntries;
+				// local reduce
+				_Scalar v = initial;
+				for (Index n = start + part; n < end; n += BlockSize)
+					v = op(v, input[n]);
+				// block reduce
+				v = BlockReduceT(temp_storage).Reduce(v, op);
+				if (part == 0)
+					output[s] = v;
+				__syncthreads();	// temp_storage is reused
+			}
+		}
+	}	 // namespace kernels
+
+	template <typename _Input, typename _Output, typename _Op, typename _Scalar>
+	struct SegmentedReductionEvaluator<_Input, _Output, _Op, _Scalar, ReductionAlg::Warp>
+	{
+		static void eval(const _Input& in, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets, _Output& out,
+										 const _Op& op, const _Scalar& initial)
+		{
+			StridedMatrixInputIterator<_Input> iterIn(in, thrust::make_tuple(1, in.rows(), in.rows()));
+			const Index numSegments = offsets.rows() - 1;
+
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(
+					static_cast<unsigned int>(numSegments * 32), static_cast<unsigned int>(in.batches()),
+					kernels::SegmentedReduceWarpKernel<decltype(iterIn), _Op, _Scalar>);
+			kernels::SegmentedReduceWarpKernel<decltype(iterIn), _Op, _Scalar>
+					<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(cfg.virtual_size, iterIn, offsets.data(),
+																																			 out.data(), op, initial, in.rows());
+			CUMAT_CHECK_ERROR();
+
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+			LastReductionAlgorithm = "Warp";
+#endif
+		}
+	};
+
+	template <typename _Input, typename _Output, typename _Op, typename _Scalar, int BlockSize>
+	struct SegmentedReductionEvaluator<_Input, _Output, _Op, _Scalar, ReductionAlg::Block<BlockSize>>
+	{
+		static void eval(const _Input& in, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets, _Output& out,
+										 const _Op& op, const _Scalar& initial)
+		{
+			StridedMatrixInputIterator<_Input> iterIn(in, thrust::make_tuple(1, in.rows(), in.rows()));
+			const Index numSegments = offsets.rows() - 1;
+			const Index numBatches = in.batches();
+
+			Context& ctx = Context::current();
+			int minGridSize = 0, bestBlockSize = 0;
+			CUMAT_SAFE_CALL(cudaOccupancyMaxPotentialBlockSize(
+					&minGridSize, &bestBlockSize, kernels::SegmentedReduceBlockKernel<decltype(iterIn), _Op, _Scalar, BlockSize>));
+			minGridSize = static_cast<int>(std::min(numSegments * numBatches, Index(minGridSize)));
+			KernelLaunchConfig cfg = { dim3(internal::narrow_cast<unsigned>(numSegments),
+																			internal::narrow_cast<unsigned>(numBatches), 1),
+																 dim3(BlockSize, 1, 1), dim3(minGridSize, 1, 1) };
+			kernels::SegmentedReduceBlockKernel<decltype(iterIn), _Op, _Scalar, BlockSize>
+					<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(cfg.virtual_size, iterIn, offsets.data(),
+																																			 out.data(), op, initial, in.rows());
+			CUMAT_CHECK_ERROR();
+
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+			LastReductionAlgorithm = "Block<" + std::to_string(BlockSize) + ">";
+#endif
+		}
+	};
+
+	template <typename _Input, typename _Output, typename _Op, typename _Scalar>
+	struct SegmentedReductionEvaluator<_Input, _Output, _Op, _Scalar, ReductionAlg::Segmented>
+	{
+		static void eval(const _Input& in, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets, _Output& out,
+										 const _Op& op, const _Scalar& initial)
+		{
+			StridedMatrixInputIterator<_Input> iterIn(in, thrust::make_tuple(1, in.rows(), in.rows()));
+			const int numSegments = static_cast<int>(offsets.rows() - 1);
+			const Index numEntries = in.rows();
+
+			Context& ctx = Context::current();
+			size_t temp_storage_bytes = 0;
+			CUMAT_SAFE_CALL(cub::DeviceSegmentedReduce::Reduce(NULL, temp_storage_bytes, iterIn, out.data(), numSegments,
+																												 offsets.data(), offsets.data() + 1, op, initial,
+																												 ctx.stream(), CUMAT_CUB_DEBUG));
+			DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+			for (Index b = 0; b < in.batches(); ++b)
+			{
+				CUMAT_SAFE_CALL(cub::DeviceSegmentedReduce::Reduce(
+						static_cast<void*>(temp_storage.pointer()), temp_storage_bytes, iterIn + (numEntries * b),
+						out.data() + (numSegments * b), numSegments, offsets.data(), offsets.data() + 1, op, initial, ctx.stream(),
+						CUMAT_CUB_DEBUG));
+			}
+
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+			LastReductionAlgorithm = "Segmented";
+#endif
+		}
+	};
+
+	template <typename _Input, typename _Output, typename _Op, typename _Scalar>
+	struct SegmentedReductionEvaluator<_Input, _Output, _Op, _Scalar, ReductionAlg::Auto>
+	{
+		static void eval(const _Input& in, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets, _Output& out,
+										 const _Op& op, const _Scalar& initial)
+		{
+			const SegmentLengthHistogram h = SegmentLengthHistogram::fromOffsets(offsets);
+			switch (SegmentedReductionSelection::select(h))
+			{
+				case ReductionAlgorithm::Warp:
+					SegmentedReductionEvaluator<_Input, _Output, _Op, _Scalar, ReductionAlg::Warp>::eval(in, offsets, out, op,
+																																															 initial);
+					break;
+				case ReductionAlgorithm::Block256:
+					SegmentedReductionEvaluator<_Input, _Output, _Op, _Scalar, ReductionAlg::Block<256>>::eval(in, offsets, out,
+																																																		 op, initial);
+					break;
+				case ReductionAlgorithm::Segmented:
+					SegmentedReductionEvaluator<_Input, _Output, _Op, _Scalar, ReductionAlg::Segmented>::eval(in, offsets, out,
+																																																		op, initial);
+					break;
+				default:
+					throw std::runtime_error("unknown dynamic segmented reduction algorithm");
+			}
+		}
+	};
+#endif
+}	 // namespace internal
+
+/**
+ * \brief Reduces ragged segments of a vector.
+ * Segment \c i spans the entries <tt>[offsets[i], offsets[i+1])</tt> of \c values,
+ * empty segments evaluate to \c initial. The values can be batched, the offsets are then
+ * applied to every batch.
+ *
+ * This is e.g. the row-reduction of a CSR matrix: <tt>segmentedReduce(A.getData(), A.getSparsityPattern().JA, functor::Sum<float>(), 0.0f)</tt>.
+ *
+ * \param values the values, a (batched) column vector
+ * \param offsets the segment offsets, a vector of size numSegments+1 with non-decreasing entries
+ * \param op the reduction operator, e.g. functor::Sum
+ * \param initial the initial value, must be the neutral element of the operator
+ * \tparam _Algorithm the algorithm, one of ReductionAlg::Warp, ReductionAlg::Block<N>, ReductionAlg::Segmented or ReductionAlg::Auto.
+ *   The automatic selection computes a histogram of the segment lengths first, see internal::SegmentedReductionSelection.
+ * \return a (batched) column vector with one entry per segment
+ */
+template <typename _Algorithm = ReductionAlg::Auto, typename _Values, typename _Op>
+Matrix<typename internal::traits<_Values>::Scalar, Dynamic, 1, internal::traits<_Values>::BatchesAtCompileTime, ColumnMajor>
+segmentedReduce(const MatrixBase<_Values>& values, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& offsets, const _Op& op,
+								const typename internal::traits<_Values>::Scalar& initial)
+{
+	CUMAT_ERROR_IF_NO_NVCC(segmentedReduce)
+	typedef typename internal::traits<_Values>::Scalar Scalar;
+	typedef Matrix<Scalar, Dynamic, 1, internal::traits<_Values>::BatchesAtCompileTime, ColumnMajor> Output;
+	typedef typename MatrixReadWrapper<_Values, AccessFlags::ReadCwise>::type values_wrapped_t;
+	CUMAT_STATIC_ASSERT(internal::traits<_Values>::ColsAtCompileTime == 1 || internal::traits<_Values>::ColsAtCompileTime == Dynamic,
+											"The values must be a column vector");
+	CUMAT_ASSERT_DIMENSION(values.cols() == 1);
+	CUMAT_ASSERT_ARGUMENT(offsets.rows() >= 1);
+
+	CUMAT_PROFILING_INC(EvalReduction);
+	CUMAT_PROFILING_INC(EvalAny);
+	const Index numSegments = offsets.rows() - 1;
+	Output out(numSegments, 1, values.batches());
+	if (numSegments == 0 || values.batches() == 0)
+		return out;
+	const values_wrapped_t in(values.derived());
+	internal::SegmentedReductionEvaluator<values_wrapped_t, Output, _Op, Scalar, _Algorithm>::eval(in, offsets, out, op,
+																																																	initial);
+	return out;
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
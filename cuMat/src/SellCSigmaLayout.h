@@ -0,0 +1,192 @@
+#ifndef __CUMAT_SELL_C_SIGMA_LAYOUT_H__
+#define __CUMAT_SELL_C_SIGMA_LAYOUT_H__
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Constants.h"
+#include "Logging.h"
+#include "SparseMatrixBase.h"
+#include "SparseMatrix.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+	/**
+	 * \brief Host-side construction of the SELL-C-sigma format (\ref SparseFlags::SELLCS) from a CSR matrix.
+	 * The layout is computed on the host only and can be tested without a GPU,
+	 * \ref toSparsityPattern() and \ref toSparseMatrix() copy it to the device.
+	 */
+	struct SellCSigmaLayout
+	{
+		/**
+		 * \brief The default slice height C, one warp
+		 */
+		static constexpr int DEFAULT_SLICE_HEIGHT = 32;
+		/**
+		 * \brief The default sorting window sigma.
+		 * Larger windows reduce the padding, but scatter the accesses into the result and, for banded matrices, into the input vector.
+		 */
+		static constexpr int DEFAULT_SORT_WINDOW = 256;
+
+		Index rows = 0;
+		Index cols = 0;
+		Index sliceHeight = DEFAULT_SLICE_HEIGHT;
+		Index sortWindow = DEFAULT_SORT_WINDOW;
+		/** \brief Number of entries of the CSR matrix, i.e. without the padding */
+		Index csrNnz = 0;
+		/** \brief Offsets of the slices in the storage, size=numSlices+1 */
+		std::vector<int> sliceOffsets;
+		/** \brief Column indices in the padded storage, -1 for padding */
+		std::vector<int> IA;
+		/** \brief Sorted position -> original row, size=numSlices*sliceHeight, -1 for the empty positions of the last slice */
+		std::vector<int> permutation;
+		/** \brief Original row -> sorted position, size=rows */
+		std::vector<int> inversePermutation;
+		/** \brief For every stored entry the index of the CSR entry, -1 for padding */
+		std::vector<int> source;
+
+		/**
+		 * \return the number of stored entries including the padding
+		 */
+		Index nnz() const { return static_cast<Index>(IA.size()); }
+		/**
+		 * \return the number of slices
+		 */
+		Index numSlices() const { return static_cast<Index>(sliceOffsets.size()) - 1; }
+		/**
+		 * \return the ratio of the stored entries to the entries of the CSR matrix, 1 means no padding
+		 */
+		double paddingRatio() const { return csrNnz > 0 ? double(nnz()) / double(csrNnz) : 1.0; }
+
+		/**
+		 * \brief Builds the layout from the CSR pattern.
+		 * The rows are sorted by decreasing length within windows of \c sortWindow consecutive rows (stable, i.e. rows of the same
+		 * length keep their order). Slices of \c sliceHeight sorted rows are padded to the longest row of the slice and stored
+		 * column-major within the slice: entry j of the row at lane r of slice s is at <tt>sliceOffsets[s] + j*sliceHeight + r</tt>.
+		 * A sorting window of 1 disables the sorting, the window should be a multiple of the slice height.
+		 * \param JA the outer indices, size rows+1
+		 * \param IA the inner indices
+		 * \param rows the number of rows
+		 * \param cols the number of columns
+		 * \param sliceHeight the slice height C, a multiple of the warp size for coalesced access
+		 * \param sortWindow the sorting window sigma
+		 */
+		static SellCSigmaLayout build(const int* JA, const int* IA, Index rows, Index cols,
+			Index sliceHeight = DEFAULT_SLICE_HEIGHT, Index sortWindow = DEFAULT_SORT_WINDOW)
+		{
+			CUMAT_ASSERT_ARGUMENT(rows > 0);
+			CUMAT_ASSERT_ARGUMENT(sliceHeight > 0);
+			CUMAT_ASSERT_ARGUMENT(sortWindow > 0);
+			SellCSigmaLayout l;
+			l.rows = rows;
+			l.cols = cols;
+			l.sliceHeight = sliceHeight;
+			l.sortWindow = sortWindow;
+			l.csrNnz = JA[rows] - JA[0];
+
+			//sort within the windows
+			const Index numSlices = CUMAT_DIV_UP(rows, sliceHeight);
+			l.permutation.assign(numSlices * sliceHeight, -1);
+			std::iota(l.permutation.begin(), l.permutation.begin() + rows, 0);
+			for (Index start = 0; start < rows; start += sortWindow)
+			{
+				const Index end = std::min(rows, start + sortWindow);
+				std::stable_sort(l.permutation.begin() + start, l.permutation.begin() + end,
+					[JA](int a, int b) {return JA[a + 1] - JA[a] > JA[b + 1] - JA[b]; });
+			}
+			l.inversePermutation.resize(rows);
+			for (Index p = 0; p < rows; ++p)
+				l.inversePermutation[l.permutation[p]] = static_cast<int>(p);
+
+			//slice widths and offsets
+			l.sliceOffsets.assign(numSlices + 1, 0);
+			for (Index s = 0; s < numSlices; ++s)
+			{
+				int width = 0;
+				for (Index r = 0; r < sliceHeight; ++r)
+				{
+					const int row = l.permutation[s * sliceHeight + r];
+					if (row >= 0) width = std::max(width, JA[row + 1] - JA[row]);
+				}
+				l.sliceOffsets[s + 1] = l.sliceOffsets[s] + static_cast<int>(width * sliceHeight);
+			}
+
+			//fill the columns
+			l.IA.assign(l.sliceOffsets[numSlices], -1);
+			l.source.assign(l.sliceOffsets[numSlices], -1);
+			for (Index s = 0; s < numSlices; ++s)
+				for (Index r = 0; r < sliceHeight; ++r)
+				{
+					const int row = l.permutation[s * sliceHeight + r];
+					if (row < 0) continue;
+					for (int k = JA[row]; k < JA[row + 1]; ++k)
+					{
+						const Index pos = l.sliceOffsets[s] + (k - JA[row]) * sliceHeight + r;
+						l.IA[pos] = IA[k];
+						l.source[pos] = k;
+					}
+				}
+			CUMAT_LOG_DEBUG("SELL-C-sigma layout: rows=" << rows << ", C=" << sliceHeight << ", sigma=" << sortWindow
+				<< ", nnz=" << l.csrNnz << ", stored=" << l.nnz() << " (padding ratio " << l.paddingRatio() << ")");
+			return l;
+		}
+
+		/**
+		 * \brief Reorders the values of the CSR matrix into the padded storage, the padding is set to <tt>_Scalar()</tt>
+		 * \param csrValues the values of the CSR matrix, size csrNnz
+		 */
+		template<typename _Scalar>
+		std::vector<_Scalar> scatterValues(const _Scalar* csrValues) const
+		{
+			std::vector<_Scalar> values(nnz(), _Scalar());
+			for (Index i = 0; i < nnz(); ++i)
+				if (source[i] >= 0) values[i] = csrValues[source[i]];
+			return values;
+		}
+
+		/**
+		 * \brief Copies the pattern to the device
+		 */
+		SparsityPattern<SparseFlags::SELLCS> toSparsityPattern() const
+		{
+			typedef SparsityPattern<SparseFlags::SELLCS> SPattern;
+			SPattern pattern;
+			pattern.rows = rows;
+			pattern.cols = cols;
+			pattern.nnz = nnz();
+			pattern.sliceHeight = sliceHeight;
+			pattern.sortWindow = sortWindow;
+			pattern.sliceOffsets = SPattern::IndexVector(numSlices() + 1);
+			pattern.sliceOffsets.copyFromHost(sliceOffsets.data());
+			pattern.IA = SPattern::IndexVector(nnz());
+			if (nnz() > 0) pattern.IA.copyFromHost(IA.data());
+			pattern.permutation = SPattern::IndexVector(static_cast<Index>(permutation.size()));
+			pattern.permutation.copyFromHost(permutation.data());
+			pattern.inversePermutation = SPattern::IndexVector(rows);
+			pattern.inversePermutation.copyFromHost(inversePermutation.data());
+			return pattern;
+		}
+
+		/**
+		 * \brief Copies the pattern and the values of the CSR matrix to the device
+		 * \param csrValues the values of the CSR matrix, size csrNnz
+		 */
+		template<typename _Scalar>
+		SparseMatrix<_Scalar, 1, SparseFlags::SELLCS> toSparseMatrix(const _Scalar* csrValues) const
+		{
+			SparseMatrix<_Scalar, 1, SparseFlags::SELLCS> m(toSparsityPattern());
+			const std::vector<_Scalar> values = scatterValues(csrValues);
+			if (nnz() > 0) m.getData().copyFromHost(values.data());
+			return m;
+		}
+	};
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef __CUMAT_SPARSE_ASSEMBLY_H__
+#define __CUMAT_SPARSE_ASSEMBLY_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Constants.h"
+#include "Matrix.h"
+#include "SparseMatrix.h"
+#include "SparseFormatConversion.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+/**
+ * \brief The mapping from a list of triplets to the entries of a sparse matrix, computed by \ref setFromTriplets().
+ * Entry k of the sparse matrix is the sum of the triplets <tt>source[segments[k]]</tt> to <tt>source[segments[k+1]-1]</tt>.
+ * With it, \ref setValuesFromTriplets() assembles new values with the same triplet indices without sorting again.
+ */
+struct TripletPermutation
+{
+    typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IndexVector;
+
+    /** \brief The number of triplets */
+    Index numTriplets = 0;
+    /** \brief The number of entries of the sparse matrix, i.e. the number of unique (row, column) pairs */
+    Index nnz = 0;
+    /** \brief The triplets sorted by the entry of the sparse matrix, size=numTriplets */
+    IndexVector source;
+    /** \brief Start of the triplets of every entry in \c source, size=nnz+1 */
+    IndexVector segments;
+};
+
+/**
+ * \brief Builds the sparse matrix from triplets (row, column, value) on the device, analogous to Eigen's setFromTriplets.
+ * The triplets are sorted by a radix sort, duplicates are summed up and the outer indices are computed by a scan.
+ * All batches of the values share the same row and column indices, hence the same sparsity pattern.
+ * The previous pattern and data of \c dst are replaced, the inner indices of the new pattern are sorted.
+ *
+ * The returned permutation can be passed to \ref setValuesFromTriplets() to assemble new values
+ * (e.g. the next assembly of a finite element matrix with a fixed mesh), that only gathers and sums the values.
+ *
+ * \param dst the target matrix, CSR or CSC
+ * \param triplets the triplets, they can be in any order and contain duplicates
+ * \return the mapping from the triplets to the entries of \c dst
+ */
+template<typename _Scalar, int _Batches, int _SparseFlags>
+TripletPermutation setFromTriplets(SparseMatrix<_Scalar, _Batches, _SparseFlags>& dst, const CooMatrix<_Scalar, _Batches>& triplets)
+{
+    CUMAT_STATIC_ASSERT(_SparseFlags == SparseFlags::CSR || _SparseFlags == SparseFlags::CSC,
+        "setFromTriplets only supports the compressed formats CSR and CSC, use the format conversions for the others");
+    CUMAT_ASSERT_DIMENSION(triplets.colIndices.size() == triplets.nnz());
+    CUMAT_ASSERT_DIMENSION(triplets.values.rows() == triplets.nnz());
+    CUMAT_ERROR_IF_NO_NVCC(setFromTriplets)
+#if CUMAT_NVCC==1
+    const bool csr = _SparseFlags == SparseFlags::CSR;
+    const internal::DeviceSparseConversion::Conversion c = internal::DeviceSparseConversion::cooToCompressed(
+        csr ? triplets.rowIndices : triplets.colIndices, csr ? triplets.colIndices : triplets.rowIndices,
+        triplets.nnz(), csr ? triplets.rows : triplets.cols, csr ? triplets.cols : triplets.rows);
+
+    SparsityPattern<_SparseFlags> pattern;
+    pattern.rows = triplets.rows;
+    pattern.cols = triplets.cols;
+    pattern.nnz = c.IA.size();
+    pattern.JA = c.JA;
+    pattern.IA = c.IA;
+    dst = SparseMatrix<_Scalar, _Batches, _SparseFlags>(pattern, triplets.batches());
+    internal::DeviceSparseConversion::sumValues(triplets.values.data(), triplets.nnz(), c, triplets.batches(), dst.getData().data());
+
+    TripletPermutation permutation;
+    permutation.numTriplets = triplets.nnz();
+    permutation.nnz = pattern.nnz;
+    permutation.source = c.source;
+    permutation.segments = c.segments;
+    return permutation;
+#endif
+}
+
+/**
+ * \brief Assembles new values into a sparse matrix created by \ref setFromTriplets(),
+ * the triplets must have the same row and column indices in the same order as in the call to setFromTriplets().
+ * The sparsity pattern of \c dst is kept, the values of the duplicates are summed up.
+ *
+ * \param dst the target matrix with the pattern computed by setFromTriplets()
+ * \param permutation the permutation returned by setFromTriplets()
+ * \param values the values of the triplets, size=numTriplets per batch
+ */
+template<typename _Scalar, int _Batches, int _SparseFlags>
+void setValuesFromTriplets(SparseMatrix<_Scalar, _Batches, _SparseFlags>& dst, const TripletPermutation& permutation,
+    const Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor>& values)
+{
+    CUMAT_STATIC_ASSERT(_SparseFlags == SparseFlags::CSR || _SparseFlags == SparseFlags::CSC,
+        "setValuesFromTriplets only supports the compressed formats CSR and CSC");
+    CUMAT_ASSERT_DIMENSION(values.rows() == permutation.numTriplets);
+    CUMAT_ASSERT_DIMENSION(values.batches() == dst.batches());
+    CUMAT_ASSERT_DIMENSION(dst.getSparsityPattern().nnz == permutation.nnz);
+    CUMAT_ERROR_IF_NO_NVCC(setValuesFromTriplets)
+#if CUMAT_NVCC==1
+    internal::DeviceSparseConversion::Conversion c;
+    c.source = permutation.source;
+    c.segments = permutation.segments;
+    internal::DeviceSparseConversion::sumValues(values.data(), permutation.numTriplets, c, dst.batches(), dst.getData().data());
+#endif
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -53,6 +53,22 @@ namespace internal
 				}
 			CUMAT_KERNEL_2D_LOOP_END
 		}
+		//one thread per entry, the outer index of every entry is precomputed (SparseCwiseEvaluationCache)
+		template <typename T, typename M, AssignmentMode Mode, bool CSR>
+		__global__ void CwiseCompressedEntryEvaluationKernel(dim3 virtual_size, const T expr, M matrix, const int* outerIndices)
+		{
+			const int* IA = matrix.getSparsityPattern().IA.data();
+			Index batchStride = matrix.getSparsityPattern().nnz;
+			CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+				Index outer = outerIndices[i];
+				Index inner = IA[i];
+				Index row = CSR ? outer : inner;
+				Index col = CSR ? inner : outer;
+				Index idx = i + batch * batchStride;
+				auto val = expr.coeff(row, col, batch, idx);
+				internal::CwiseAssignmentHandler<M, decltype(val), Mode>::assign(matrix, val, idx);
+			CUMAT_KERNEL_2D_LOOP_END
+		}
 		template <typename T, typename M, AssignmentMode Mode>
 		__global__ void CwiseELLPACKEvaluationKernel(dim3 virtual_size, const T expr, M matrix)
 		{
@@ -72,6 +88,31 @@ namespace internal
 				}
 			CUMAT_KERNEL_2D_LOOP_END
 		}
+		template <typename T, typename M, AssignmentMode Mode>
+		__global__ void CwiseSELLCSEvaluationKernel(dim3 virtual_size, const T expr, M matrix)
+		{
+			const int* sliceOffsets = matrix.getSparsityPattern().sliceOffsets.data();
+			const int* IA = matrix.getSparsityPattern().IA.data();
+			const int* permutation = matrix.getSparsityPattern().permutation.data();
+			const int sliceHeight = static_cast<int>(matrix.getSparsityPattern().sliceHeight);
+			Index batchStride = matrix.getSparsityPattern().nnz;
+			//one thread per sorted position, neighboring threads access neighboring entries
+			CUMAT_KERNEL_2D_LOOP(position, batch, virtual_size)
+				const int row = permutation[position];
+				if (row < 0) continue; //empty position of the last slice
+				const int slice = static_cast<int>(position) / sliceHeight;
+				const int start = sliceOffsets[slice] + static_cast<int>(position) % sliceHeight;
+				const int end = sliceOffsets[slice + 1];
+				for (int i = start; i < end; i += sliceHeight)
+				{
+					int inner = IA[i];
+					if (inner < 0) break; //the remaining entries of this row are padding
+					Index idx = i + batch * batchStride;
+					auto val = expr.coeff(row, inner, batch, idx);
+					internal::CwiseAssignmentHandler<M, decltype(val), Mode>::assign(matrix, val, idx);
+				}
+			CUMAT_KERNEL_2D_LOOP_END
+		}
 	}
 }
 
@@ -84,8 +125,28 @@ namespace internal {
     struct Assignment<_Dst, _Src, _Mode, SparseDstTag, CwiseSrcTag>
     {
     private:
+		//one thread per entry, returns false if the pattern prefers one thread per outer index
+		template<bool CSR>
+		static bool assignPerEntry(_Dst& dst, const _Src& src)
+		{
+			const auto& pattern = dst.derived().getSparsityPattern();
+			const Index outerSize = dst.derived().outerSize();
+			if (pattern.cwiseEvaluationCache.select(pattern.JA, outerSize, pattern.nnz, dst.derived().batches()) != SparseCwiseEvaluation::PerEntry)
+				return false;
+			if (pattern.nnz == 0) return true;
+			const auto& outerIndices = pattern.cwiseEvaluationCache.outerIndices(pattern.JA, outerSize, pattern.nnz);
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(pattern.nnz), static_cast<unsigned int>(dst.derived().batches()),
+				kernels::CwiseCompressedEntryEvaluationKernel<typename _Src::Type, typename _Dst::Type, _Mode, CSR>);
+			kernels::CwiseCompressedEntryEvaluationKernel<typename _Src::Type, typename _Dst::Type, _Mode, CSR>
+				<<< cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+				(cfg.virtual_size, src.derived(), dst.derived(), outerIndices.data());
+			CUMAT_CHECK_ERROR();
+			return true;
+		}
 		static void assign(_Dst& dst, const _Src& src, std::integral_constant<int, SparseFlags::CSR>)
 		{
+			if (assignPerEntry<true>(dst, src)) return;
 			//here is now the real logic
 			Context& ctx = Context::current();
 			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(dst.derived().outerSize()), static_cast<unsigned int>(dst.derived().batches()),
@@ -97,6 +158,7 @@ namespace internal {
 		}
 		static void assign(_Dst& dst, const _Src& src, std::integral_constant<int, SparseFlags::CSC>)
 		{
+			if (assignPerEntry<false>(dst, src)) return;
 			//here is now the real logic
 			Context& ctx = Context::current();
 			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(dst.derived().outerSize()), static_cast<unsigned int>(dst.derived().batches()),
@@ -117,6 +179,17 @@ namespace internal {
 				(cfg.virtual_size, src.derived(), dst.derived());
 			CUMAT_CHECK_ERROR();
 		}
+		static void assign(_Dst& dst, const _Src& src, std::integral_constant<int, SparseFlags::SELLCS>)
+		{
+			const auto& pattern = dst.derived().getSparsityPattern();
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(pattern.numSlices() * pattern.sliceHeight), static_cast<unsigned int>(dst.derived().batches()),
+				kernels::CwiseSELLCSEvaluationKernel<typename _Src::Type, typename _Dst::Type, _Mode>);
+			kernels::CwiseSELLCSEvaluationKernel<typename _Src::Type, typename _Dst::Type, _Mode>
+				<<< cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+				(cfg.virtual_size, src.derived(), dst.derived());
+			CUMAT_CHECK_ERROR();
+		}
 
     public:
         static void assign(_Dst& dst, const _Src& src)
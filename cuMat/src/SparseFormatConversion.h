@@ -0,0 +1,1071 @@
+#ifndef __CUMAT_SPARSE_FORMAT_CONVERSION_H__
+#define __CUMAT_SPARSE_FORMAT_CONVERSION_H__
+
+#include "Macros.h"
+
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ForwardDeclarations.h"
+#include "Constants.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "DevicePointer.h"
+#include "SparseMatrix.h"
+
+#if CUMAT_NVCC==1
+#include <cub/cub.cuh>
+#endif
+
+CUMAT_NAMESPACE_BEGIN
+
+/**
+ * \brief A sparse matrix in coordinate format (COO) in device memory: the row index, column index and value of every entry.
+ * The entries can be in any order and may contain duplicates, they are summed up by \ref convertToCSR().
+ * This is only a container for the conversion, it can't be used in expressions.
+ * \tparam _Scalar the scalar type
+ * \tparam _Batches the number of batches on compile time or Dynamic, all batches share the row and column indices
+ */
+template<typename _Scalar, int _Batches>
+struct CooMatrix
+{
+	typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IndexVector;
+	typedef Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor> DataVector;
+
+	Index rows = 0;
+	Index cols = 0;
+	/** \brief Row index of every entry, size=nnz */
+	IndexVector rowIndices;
+	/** \brief Column index of every entry, size=nnz */
+	IndexVector colIndices;
+	/** \brief Values, size=nnz per batch */
+	DataVector values;
+
+	/**
+	 * \return the number of entries, including duplicates
+	 */
+	Index nnz() const { return rowIndices.size(); }
+	/**
+	 * \return the number of batches
+	 */
+	Index batches() const { return values.batches(); }
+};
+
+/**
+ * \brief Statistics of the padding of a conversion to ELLPACK, see \ref convertToELLPACK()
+ */
+struct EllpackPaddingReport
+{
+	Index rows = 0;
+	/** \brief Number of entries of the input matrix */
+	Index nnz = 0;
+	/** \brief Entries per row of the ELLPACK matrix, i.e. the length of the longest row */
+	Index nnzPerRow = 0;
+	/** \brief Number of stored entries, rows*nnzPerRow */
+	Index storedEntries = 0;
+	double meanRowLength = 0;
+
+	/**
+	 * \return the ratio of stored entries to actual entries, 1 means no padding
+	 */
+	double paddingRatio() const { return nnz > 0 ? double(storedEntries) / double(nnz) : 1.0; }
+};
+
+namespace internal
+{
+	/**
+	 * \brief The result of a conversion of a sparsity pattern.
+	 * The values are converted by copying the entries listed in \c source (\ref HostSparseConversion::gatherValues()),
+	 * or, if \c segments is not empty, by summing them up (\ref HostSparseConversion::sumValues()).
+	 * This allows to convert batched data matrices or several matrices with the same sparsity pattern consistently.
+	 * \tparam _IndexArray std::vector<int> on the host, the index vector on the device
+	 */
+	template<typename _IndexArray>
+	struct SparsePatternConversion
+	{
+		/** \brief Outer indices of a compressed output (CSR, CSC), size=outerSize+1 */
+		_IndexArray JA;
+		/**
+		 * \brief Inner indices of a compressed output,
+		 * the column indices of an ELLPACK output (column-major rows x nnzPerRow, -1 for padding)
+		 * or the outer index of every entry of a COO output
+		 */
+		_IndexArray IA;
+		/**
+		 * \brief For every stored entry of the output the entry of the input it is copied from, -1 for padding.
+		 * With duplicate summation: the entries of the input ordered by the output entry.
+		 */
+		_IndexArray source;
+		/** \brief Only with duplicate summation: output entry k is the sum of the input entries source[segments[k]] to source[segments[k+1]-1] */
+		_IndexArray segments;
+		/** \brief Entries per row of an ELLPACK output */
+		Index nnzPerRow = 0;
+	};
+
+	/**
+	 * \brief Conversions between the sparse formats on the host, multi-threaded with OpenMP if enabled.
+	 * This contains no device code and can be tested without a GPU.
+	 * All indices are zero-based and the outer indices start at zero.
+	 */
+	struct HostSparseConversion
+	{
+		typedef SparsePatternConversion<std::vector<int>> Conversion;
+
+		/**
+		 * \return the number of threads: the OpenMP threads, or one thread without OpenMP
+		 */
+		static int maxThreads()
+		{
+#ifdef _OPENMP
+			return omp_get_max_threads();
+#else
+			return 1;
+#endif
+		}
+
+		/**
+		 * \brief The number of threads of a counting sort into \c buckets buckets.
+		 * Every thread needs its own counters, this limits them to about four counters per entry.
+		 */
+		static int countingSortThreads(Index nnz, Index buckets)
+		{
+			const Index limit = std::max(Index(1), 4 * nnz / std::max(Index(1), buckets));
+			return static_cast<int>(std::min(Index(maxThreads()), limit));
+		}
+
+		/**
+		 * \brief Exclusive prefix sum in-place, returns the total
+		 */
+		static int exclusiveScan(std::vector<int>& v)
+		{
+			int sum = 0;
+			for (int& x : v)
+			{
+				const int tmp = x;
+				x = sum;
+				sum += tmp;
+			}
+			return sum;
+		}
+
+		/**
+		 * \brief Transposes a compressed pattern with a parallel counting sort: CSR to CSC and CSC to CSR.
+		 * The outer ranges are distributed to the threads by their number of entries, every thread counts
+		 * the entries per inner index, a prefix sum over (inner index, thread) yields the positions, then
+		 * every thread scatters its entries. The sort is stable, the inner indices of the output are sorted.
+		 * \param JA the outer indices, size outerSize+1
+		 * \param IA the inner indices
+		 * \param outerSize number of rows for CSR, columns for CSC
+		 * \param innerSize number of columns for CSR, rows for CSC
+		 */
+		static Conversion transpose(const int* JA, const int* IA, Index outerSize, Index innerSize)
+		{
+			const Index nnz = JA[outerSize];
+			const int threads = countingSortThreads(nnz, innerSize);
+			//outer ranges with about the same number of entries
+			std::vector<Index> chunks(threads + 1, outerSize);
+			for (int t = 0; t < threads; ++t)
+				chunks[t] = std::lower_bound(JA, JA + outerSize + 1, static_cast<int>(nnz * t / threads)) - JA;
+
+			std::vector<int> counts(threads * innerSize, 0);
+#pragma omp parallel for schedule(static)
+			for (int t = 0; t < threads; ++t)
+			{
+				int* c = counts.data() + t * innerSize;
+				for (int k = JA[chunks[t]]; k < JA[chunks[t + 1]]; ++k)
+					c[IA[k]]++;
+			}
+			Conversion result;
+			result.JA.resize(innerSize + 1);
+			int sum = 0;
+			for (Index i = 0; i < innerSize; ++i)
+			{
+				result.JA[i] = sum;
+				for (int t = 0; t < threads; ++t)
+				{
+					const int tmp = counts[t * innerSize + i];
+					counts[t * innerSize + i] = sum;
+					sum += tmp;
+				}
+			}
+			result.JA[innerSize] = sum;
+
+			result.IA.resize(nnz);
+			result.source.resize(nnz);
+#pragma omp parallel for schedule(static)
+			for (int t = 0; t < threads; ++t)
+			{
+				int* c = counts.data() + t * innerSize;
+				for (Index o = chunks[t]; o < chunks[t + 1]; ++o)
+					for (int k = JA[o]; k < JA[o + 1]; ++k)
+					{
+						const int pos = c[IA[k]]++;
+						result.IA[pos] = static_cast<int>(o);
+						result.source[pos] = k;
+					}
+			}
+			return result;
+		}
+
+		/**
+		 * \brief Converts a pattern in coordinate format to a compressed format, duplicates are summed up.
+		 * For CSR, pass the row indices as outer indices and the column indices as inner indices, for CSC the other way around.
+		 * The entries are sorted by a parallel, stable counting sort by the outer index and then by the inner index per outer index.
+		 * Hence, the inner indices of the output are sorted and duplicates are summed up in the input order.
+		 * \param outerIndices the outer index of every entry
+		 * \param innerIndices the inner index of every entry
+		 * \param nnz the number of entries
+		 * \param outerSize number of rows for CSR, columns for CSC
+		 * \param innerSize number of columns for CSR, rows for CSC
+		 */
+		static Conversion cooToCompressed(const int* outerIndices, const int* innerIndices, Index nnz, Index outerSize, Index innerSize)
+		{
+			//counting sort by the outer index, the entries are split evenly
+			const int threads = countingSortThreads(nnz, outerSize);
+			std::vector<int> counts(threads * outerSize, 0);
+#pragma omp parallel for schedule(static)
+			for (int t = 0; t < threads; ++t)
+			{
+				int* c = counts.data() + t * outerSize;
+				for (Index k = nnz * t / threads; k < nnz * (t + 1) / threads; ++k)
+				{
+					CUMAT_ASSERT(outerIndices[k] >= 0 && outerIndices[k] < outerSize);
+					CUMAT_ASSERT(innerIndices[k] >= 0 && innerIndices[k] < innerSize);
+					c[outerIndices[k]]++;
+				}
+			}
+			std::vector<int> outerStart(outerSize + 1);
+			int sum = 0;
+			for (Index o = 0; o < outerSize; ++o)
+			{
+				outerStart[o] = sum;
+				for (int t = 0; t < threads; ++t)
+				{
+					const int tmp = counts[t * outerSize + o];
+					counts[t * outerSize + o] = sum;
+					sum += tmp;
+				}
+			}
+			outerStart[outerSize] = sum;
+			Conversion result;
+			result.source.resize(nnz);
+#pragma omp parallel for schedule(static)
+			for (int t = 0; t < threads; ++t)
+			{
+				int* c = counts.data() + t * outerSize;
+				for (Index k = nnz * t / threads; k < nnz * (t + 1) / threads; ++k)
+					result.source[c[outerIndices[k]]++] = static_cast<int>(k);
+			}
+
+			//sort by the inner index and count the unique entries per outer index
+			result.JA.assign(outerSize + 1, 0);
+#pragma omp parallel for schedule(dynamic, 64)
+			for (Index o = 0; o < outerSize; ++o)
+			{
+				int* begin = result.source.data() + outerStart[o];
+				int* end = result.source.data() + outerStart[o + 1];
+				std::stable_sort(begin, end, [innerIndices](int a, int b) {return innerIndices[a] < innerIndices[b]; });
+				int unique = 0;
+				for (int* k = begin; k != end; ++k)
+					if (k == begin || innerIndices[*k] != innerIndices[*(k - 1)]) unique++;
+				result.JA[o] = unique;
+			}
+			const int nnzOut = exclusiveScan(result.JA);
+
+			//inner indices and segments
+			result.IA.resize(nnzOut);
+			result.segments.resize(nnzOut + 1);
+#pragma omp parallel for schedule(dynamic, 64)
+			for (Index o = 0; o < outerSize; ++o)
+			{
+				int pos = result.JA[o];
+				for (int i = outerStart[o]; i < outerStart[o + 1]; ++i)
+					if (i == outerStart[o] || innerIndices[result.source[i]] != innerIndices[result.source[i - 1]])
+					{
+						result.IA[pos] = innerIndices[result.source[i]];
+						result.segments[pos] = i;
+						pos++;
+					}
+			}
+			result.segments[nnzOut] = static_cast<int>(nnz);
+			return result;
+		}
+
+		/**
+		 * \brief Converts a compressed pattern to coordinate format, \c IA of the result contains the outer index of every entry.
+		 * The inner indices and the values are unchanged.
+		 */
+		static Conversion compressedToCoo(const int* JA, Index outerSize)
+		{
+			Conversion result;
+			result.IA.resize(JA[outerSize]);
+#pragma omp parallel for schedule(dynamic, 256)
+			for (Index o = 0; o < outerSize; ++o)
+				for (int k = JA[o]; k < JA[o + 1]; ++k)
+					result.IA[k] = static_cast<int>(o);
+			return result;
+		}
+
+		/**
+		 * \brief Converts a CSR pattern to ELLPACK, every row is padded to the longest row.
+		 * \param JA the outer indices, size rows+1
+		 * \param IA the column indices
+		 * \param rows the number of rows
+		 * \param report if not null, receives the padding statistics
+		 */
+		static Conversion csrToEllpack(const int* JA, const int* IA, Index rows, EllpackPaddingReport* report = nullptr)
+		{
+			int nnzPerRow = 1; //at least one column for a valid pattern
+			for (Index r = 0; r < rows; ++r)
+				nnzPerRow = std::max(nnzPerRow, JA[r + 1] - JA[r]);
+			Conversion result;
+			result.nnzPerRow = nnzPerRow;
+			result.IA.assign(rows * nnzPerRow, -1);
+			result.source.assign(rows * nnzPerRow, -1);
+#pragma omp parallel for schedule(static)
+			for (Index r = 0; r < rows; ++r)
+				for (int k = JA[r]; k < JA[r + 1]; ++k)
+				{
+					const Index pos = r + (k - JA[r]) * rows;
+					result.IA[pos] = IA[k];
+					result.source[pos] = k;
+				}
+			if (report)
+			{
+				report->rows = rows;
+				report->nnz = JA[rows];
+				report->nnzPerRow = nnzPerRow;
+				report->storedEntries = rows * nnzPerRow;
+				report->meanRowLength = rows > 0 ? double(JA[rows]) / double(rows) : 0.0;
+			}
+			return result;
+		}
+
+		/**
+		 * \brief Converts an ELLPACK pattern to CSR, the padding (-1) is removed. The order of the entries within a row is kept.
+		 * \param indices the column indices, column-major rows x nnzPerRow
+		 * \param rows the number of rows
+		 * \param nnzPerRow the entries per row
+		 */
+		static Conversion ellpackToCsr(const int* indices, Index rows, Index nnzPerRow)
+		{
+			Conversion result;
+			result.JA.resize(rows + 1);
+#pragma omp parallel for schedule(static)
+			for (Index r = 0; r < rows; ++r)
+			{
+				int count = 0;
+				for (Index ci = 0; ci < nnzPerRow; ++ci)
+					if (indices[r + ci * rows] >= 0) count++;
+				result.JA[r] = count;
+			}
+			result.JA[rows] = 0;
+			const int nnz = exclusiveScan(result.JA);
+			result.IA.resize(nnz);
+			result.source.resize(nnz);
+#pragma omp parallel for schedule(static)
+			for (Index r = 0; r < rows; ++r)
+			{
+				int pos = result.JA[r];
+				for (Index ci = 0; ci < nnzPerRow; ++ci)
+				{
+					const int c = indices[r + ci * rows];
+					if (c < 0) continue;
+					result.IA[pos] = c;
+					result.source[pos] = static_cast<int>(r + ci * rows);
+					pos++;
+				}
+			}
+			return result;
+		}
+
+		/**
+		 * \brief Copies the (batched) values according to \c conversion.source, the padding is set to <tt>_Scalar()</tt>.
+		 * \param values the values of the input, batch b starts at <tt>values + b*inputStride</tt>
+		 * \param inputStride the number of stored entries per batch of the input
+		 * \param conversion the conversion of the pattern
+		 * \param batches the number of batches
+		 * \return the values of the output, batch after batch
+		 */
+		template<typename _Scalar>
+		static std::vector<_Scalar> gatherValues(const _Scalar* values, Index inputStride, const Conversion& conversion, Index batches)
+		{
+			const Index n = static_cast<Index>(conversion.source.size());
+			std::vector<_Scalar> out(n * batches);
+#pragma omp parallel for schedule(static)
+			for (Index i = 0; i < n * batches; ++i)
+			{
+				const Index b = i / n;
+				const int s = conversion.source[i - b * n];
+				out[i] = s >= 0 ? values[s + b * inputStride] : _Scalar();
+			}
+			return out;
+		}
+
+		/**
+		 * \brief Sums the (batched) values of the duplicates according to \c conversion.segments.
+		 * \param values the values of the input, batch b starts at <tt>values + b*inputStride</tt>
+		 * \param inputStride the number of entries per batch of the input
+		 * \param conversion the conversion of the pattern, with segments
+		 * \param batches the number of batches
+		 * \return the values of the output, batch after batch
+		 */
+		template<typename _Scalar>
+		static std::vector<_Scalar> sumValues(const _Scalar* values, Index inputStride, const Conversion& conversion, Index batches)
+		{
+			const Index n = static_cast<Index>(conversion.segments.size()) - 1;
+			std::vector<_Scalar> out(n * batches);
+#pragma omp parallel for schedule(static)
+			for (Index i = 0; i < n * batches; ++i)
+			{
+				const Index b = i / n;
+				const Index k = i - b * n;
+				_Scalar sum = values[conversion.source[conversion.segments[k]] + b * inputStride];
+				for (int j = conversion.segments[k] + 1; j < conversion.segments[k + 1]; ++j)
+					sum += values[conversion.source[j] + b * inputStride];
+				out[i] = sum;
+			}
+			return out;
+		}
+	};
+
+#if CUMAT_NVCC==1
+	namespace kernels
+	{
+		__global__ void SparseConversionIotaKernel(dim3 virtual_size, int* out)
+		{
+			CUMAT_KERNEL_1D_LOOP(i, virtual_size)
+				out[i] = static_cast<int>(i);
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		//writes the outer index of every entry, one thread per outer index
+		__global__ void SparseConversionExpandKernel(dim3 virtual_size, const int* JA, int* out)
+		{
+			CUMAT_KERNEL_1D_LOOP(o, virtual_size)
+				for (int k = JA[o]; k < JA[o + 1]; ++k)
+					out[k] = static_cast<int>(o);
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		__global__ void SparseConversionGatherIndicesKernel(dim3 virtual_size, const int* in, const int* source, int* out)
+		{
+			CUMAT_KERNEL_1D_LOOP(i, virtual_size)
+				out[i] = in[source[i]];
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		//outer indices from the sorted outer index of every entry: JA[o] = number of entries with an outer index < o
+		template<typename _Key>
+		__global__ void SparseConversionCompressKernel(dim3 virtual_size, const _Key* sortedOuter, int nnz, _Key scale, int* JA)
+		{
+			CUMAT_KERNEL_1D_LOOP(o, virtual_size)
+				const _Key key = static_cast<_Key>(o) * scale;
+				int lo = 0, hi = nnz;
+				while (lo < hi)
+				{
+					const int mid = (lo + hi) / 2;
+					if (sortedOuter[mid] < key) lo = mid + 1; else hi = mid;
+				}
+				JA[o] = lo;
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		__global__ void SparseConversionCooKeysKernel(dim3 virtual_size, const int* outer, const int* inner, long long innerSize, long long* keys)
+		{
+			CUMAT_KERNEL_1D_LOOP(i, virtual_size)
+				keys[i] = outer[i] * innerSize + inner[i];
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		__global__ void SparseConversionCooInnerKernel(dim3 virtual_size, const long long* uniqueKeys, long long innerSize, int* IA)
+		{
+			CUMAT_KERNEL_1D_LOOP(i, virtual_size)
+				IA[i] = static_cast<int>(uniqueKeys[i] % innerSize);
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		__global__ void SparseConversionRowLengthKernel(dim3 virtual_size, const int* JA, int* lengths)
+		{
+			CUMAT_KERNEL_1D_LOOP(r, virtual_size)
+				lengths[r] = JA[r + 1] - JA[r];
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		__global__ void SparseConversionCsrToEllpackKernel(dim3 virtual_size, const int* JA, const int* IA, int nnzPerRow, int* indices, int* source)
+		{
+			const Index rows = virtual_size.x;
+			CUMAT_KERNEL_1D_LOOP(r, virtual_size)
+				const int start = JA[r];
+				const int length = JA[r + 1] - start;
+				for (int ci = 0; ci < nnzPerRow; ++ci)
+				{
+					indices[r + ci * rows] = ci < length ? IA[start + ci] : -1;
+					source[r + ci * rows] = ci < length ? start + ci : -1;
+				}
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		__global__ void SparseConversionEllpackCountKernel(dim3 virtual_size, const int* indices, int nnzPerRow, int* counts)
+		{
+			const Index rows = virtual_size.x;
+			CUMAT_KERNEL_1D_LOOP(r, virtual_size)
+				int count = 0;
+				for (int ci = 0; ci < nnzPerRow; ++ci)
+					if (indices[r + ci * rows] >= 0) count++;
+				counts[r] = count;
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		__global__ void SparseConversionEllpackToCsrKernel(dim3 virtual_size, const int* indices, int nnzPerRow, const int* JA, int* IA, int* source)
+		{
+			const Index rows = virtual_size.x;
+			CUMAT_KERNEL_1D_LOOP(r, virtual_size)
+				int pos = JA[r];
+				for (int ci = 0; ci < nnzPerRow; ++ci)
+				{
+					const int c = indices[r + ci * rows];
+					if (c < 0) continue;
+					IA[pos] = c;
+					source[pos] = static_cast<int>(r + ci * rows);
+					pos++;
+				}
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+
+		template<typename _Scalar>
+		__global__ void SparseConversionGatherValuesKernel(dim3 virtual_size, const _Scalar* in, Index inputStride, const int* source, _Scalar* out)
+		{
+			CUMAT_KERNEL_2D_LOOP(i, b, virtual_size)
+				const int s = source[i];
+				out[i + b * virtual_size.x] = s >= 0 ? in[s + b * inputStride] : _Scalar();
+			CUMAT_KERNEL_2D_LOOP_END
+		}
+
+		template<typename _Scalar>
+		__global__ void SparseConversionSumValuesKernel(dim3 virtual_size, const _Scalar* in, Index inputStride, const int* source, const int* segments, _Scalar* out)
+		{
+			CUMAT_KERNEL_2D_LOOP(i, b, virtual_size)
+				const _Scalar* inb = in + b * inputStride;
+				_Scalar sum = inb[source[segments[i]]];
+				for (int j = segments[i] + 1; j < segments[i + 1]; ++j)
+					sum += inb[source[j]];
+				out[i + b * virtual_size.x] = sum;
+			CUMAT_KERNEL_2D_LOOP_END
+		}
+	}
+
+	/**
+	 * \brief Conversions between the sparse formats on the device, the counterpart of \ref HostSparseConversion.
+	 * Sorting is done with cub::DeviceRadixSort (stable), the outer indices are computed by a binary search per outer index.
+	 */
+	struct DeviceSparseConversion
+	{
+		typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IndexVector;
+		typedef SparsePatternConversion<IndexVector> Conversion;
+
+		/**
+		 * \brief The number of bits needed for keys in [0, maxKey]
+		 */
+		static int keyBits(long long maxKey)
+		{
+			int bits = 1;
+			while (bits < 63 && (1LL << bits) <= maxKey) ++bits;
+			return bits;
+		}
+
+		/**
+		 * \brief Stable radix sort of (key, entry index) pairs.
+		 */
+		template<typename _Key>
+		static void sortPairs(const _Key* keysIn, _Key* keysOut, int* valuesOut, Index nnz, long long maxKey)
+		{
+			Context& ctx = Context::current();
+			IndexVector iota(nnz);
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(nnz), kernels::SparseConversionIotaKernel);
+			kernels::SparseConversionIotaKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (cfg.virtual_size, iota.data());
+			CUMAT_CHECK_ERROR();
+			size_t temp_storage_bytes = 0;
+			CUMAT_SAFE_CALL(cub::DeviceRadixSort::SortPairs(NULL, temp_storage_bytes, keysIn, keysOut, iota.data(), valuesOut,
+				static_cast<int>(nnz), 0, keyBits(maxKey), ctx.stream()));
+			DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+			CUMAT_SAFE_CALL(cub::DeviceRadixSort::SortPairs(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+				keysIn, keysOut, iota.data(), valuesOut, static_cast<int>(nnz), 0, keyBits(maxKey), ctx.stream()));
+		}
+
+		/**
+		 * \brief Computes the outer indices from the sorted keys <tt>outer*scale + inner</tt>
+		 */
+		template<typename _Key>
+		static IndexVector compress(const _Key* sortedKeys, Index nnz, Index outerSize, _Key scale)
+		{
+			Context& ctx = Context::current();
+			IndexVector JA(outerSize + 1);
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(outerSize + 1), kernels::SparseConversionCompressKernel<_Key>);
+			kernels::SparseConversionCompressKernel<_Key> <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+				cfg.virtual_size, sortedKeys, static_cast<int>(nnz), scale, JA.data());
+			CUMAT_CHECK_ERROR();
+			return JA;
+		}
+
+		/**
+		 * \brief Writes the outer index of every entry of a compressed pattern
+		 */
+		static IndexVector expand(const IndexVector& JA, Index outerSize, Index nnz)
+		{
+			Context& ctx = Context::current();
+			IndexVector out(nnz);
+			if (nnz == 0) return out;
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(outerSize), kernels::SparseConversionExpandKernel);
+			kernels::SparseConversionExpandKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (cfg.virtual_size, JA.data(), out.data());
+			CUMAT_CHECK_ERROR();
+			return out;
+		}
+
+		/**
+		 * \brief Transposes a compressed pattern: CSR to CSC and CSC to CSR, see \ref HostSparseConversion::transpose()
+		 */
+		static Conversion transpose(const IndexVector& JA, const IndexVector& IA, Index outerSize, Index innerSize, Index nnz)
+		{
+			Context& ctx = Context::current();
+			Conversion result;
+			IndexVector outer = expand(JA, outerSize, nnz);
+			IndexVector sortedInner(nnz);
+			result.source = IndexVector(nnz);
+			result.IA = IndexVector(nnz);
+			if (nnz > 0)
+			{
+				sortPairs<int>(IA.data(), sortedInner.data(), result.source.data(), nnz, innerSize);
+				KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(nnz), kernels::SparseConversionGatherIndicesKernel);
+				kernels::SparseConversionGatherIndicesKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+					cfg.virtual_size, outer.data(), result.source.data(), result.IA.data());
+				CUMAT_CHECK_ERROR();
+			}
+			result.JA = compress<int>(sortedInner.data(), nnz, innerSize, 1);
+			return result;
+		}
+
+		/**
+		 * \brief Converts a pattern in coordinate format to a compressed format, duplicates are summed up,
+		 * see \ref HostSparseConversion::cooToCompressed()
+		 */
+		static Conversion cooToCompressed(const IndexVector& outerIndices, const IndexVector& innerIndices, Index nnz, Index outerSize, Index innerSize)
+		{
+			typedef Matrix<long long, Dynamic, 1, 1, ColumnMajor> KeyVector;
+			Context& ctx = Context::current();
+			Conversion result;
+			if (nnz == 0)
+			{
+				result.JA = IndexVector(outerSize + 1);
+				result.JA.setZero();
+				return result;
+			}
+			//sort by outer*innerSize+inner
+			KeyVector keys(nnz), sortedKeys(nnz);
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(nnz), kernels::SparseConversionCooKeysKernel);
+			kernels::SparseConversionCooKeysKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+				cfg.virtual_size, outerIndices.data(), innerIndices.data(), innerSize, keys.data());
+			CUMAT_CHECK_ERROR();
+			result.source = IndexVector(nnz);
+			sortPairs<long long>(keys.data(), sortedKeys.data(), result.source.data(), nnz, (long long)outerSize * innerSize - 1);
+
+			//unique keys, segments = exclusive sum of the run lengths
+			KeyVector uniqueKeys(nnz);
+			IndexVector counts(nnz + 1);
+			IndexVector numRunsDevice(1);
+			size_t temp_storage_bytes = 0;
+			CUMAT_SAFE_CALL(cub::DeviceRunLengthEncode::Encode(NULL, temp_storage_bytes, sortedKeys.data(), uniqueKeys.data(),
+				counts.data(), numRunsDevice.data(), static_cast<int>(nnz), ctx.stream()));
+			DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+			CUMAT_SAFE_CALL(cub::DeviceRunLengthEncode::Encode(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+				sortedKeys.data(), uniqueKeys.data(), counts.data(), numRunsDevice.data(), static_cast<int>(nnz), ctx.stream()));
+			int numRuns;
+			numRunsDevice.copyToHost(&numRuns);
+			result.segments = IndexVector(numRuns + 1);
+			temp_storage_bytes = 0;
+			//the last element of counts is arbitrary, the exclusive sum ends with nnz
+			CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(NULL, temp_storage_bytes, counts.data(), result.segments.data(), numRuns + 1, ctx.stream()));
+			DevicePointer<uint8_t> temp_storage2(temp_storage_bytes);
+			CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(static_cast<void*>(temp_storage2.pointer()), temp_storage_bytes,
+				counts.data(), result.segments.data(), numRuns + 1, ctx.stream()));
+
+			//split the keys
+			result.IA = IndexVector(numRuns);
+			KernelLaunchConfig cfg2 = ctx.createLaunchConfig1D(static_cast<unsigned int>(numRuns), kernels::SparseConversionCooInnerKernel);
+			kernels::SparseConversionCooInnerKernel <<<cfg2.block_count, cfg2.thread_per_block, 0, ctx.stream() >>> (
+				cfg2.virtual_size, uniqueKeys.data(), innerSize, result.IA.data());
+			CUMAT_CHECK_ERROR();
+			result.JA = compress<long long>(uniqueKeys.data(), numRuns, outerSize, innerSize);
+			return result;
+		}
+
+		/**
+		 * \brief Converts a CSR pattern to ELLPACK, see \ref HostSparseConversion::csrToEllpack()
+		 */
+		static Conversion csrToEllpack(const IndexVector& JA, Index rows, const IndexVector& IA, EllpackPaddingReport* report = nullptr)
+		{
+			Context& ctx = Context::current();
+			IndexVector lengths(rows);
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(rows), kernels::SparseConversionRowLengthKernel);
+			kernels::SparseConversionRowLengthKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (cfg.virtual_size, JA.data(), lengths.data());
+			CUMAT_CHECK_ERROR();
+			IndexVector maxLength(1);
+			size_t temp_storage_bytes = 0;
+			CUMAT_SAFE_CALL(cub::DeviceReduce::Max(NULL, temp_storage_bytes, lengths.data(), maxLength.data(), static_cast<int>(rows), ctx.stream()));
+			DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+			CUMAT_SAFE_CALL(cub::DeviceReduce::Max(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+				lengths.data(), maxLength.data(), static_cast<int>(rows), ctx.stream()));
+			int nnzPerRow;
+			maxLength.copyToHost(&nnzPerRow);
+			nnzPerRow = std::max(1, nnzPerRow);
+
+			Conversion result;
+			result.nnzPerRow = nnzPerRow;
+			result.IA = IndexVector(rows * nnzPerRow);
+			result.source = IndexVector(rows * nnzPerRow);
+			kernels::SparseConversionCsrToEllpackKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+				cfg.virtual_size, JA.data(), IA.data(), nnzPerRow, result.IA.data(), result.source.data());
+			CUMAT_CHECK_ERROR();
+			if (report)
+			{
+				report->rows = rows;
+				report->nnz = IA.size();
+				report->nnzPerRow = nnzPerRow;
+				report->storedEntries = rows * nnzPerRow;
+				report->meanRowLength = double(IA.size()) / double(rows);
+			}
+			return result;
+		}
+
+		/**
+		 * \brief Converts an ELLPACK pattern to CSR, see \ref HostSparseConversion::ellpackToCsr()
+		 */
+		static Conversion ellpackToCsr(const Matrix<int, Dynamic, Dynamic, 1, ColumnMajor>& indices, Index rows, Index nnzPerRow)
+		{
+			Context& ctx = Context::current();
+			IndexVector counts(rows + 1);
+			counts.setZero();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(rows), kernels::SparseConversionEllpackCountKernel);
+			kernels::SparseConversionEllpackCountKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+				cfg.virtual_size, indices.data(), static_cast<int>(nnzPerRow), counts.data());
+			CUMAT_CHECK_ERROR();
+			Conversion result;
+			result.JA = IndexVector(rows + 1);
+			size_t temp_storage_bytes = 0;
+			CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(NULL, temp_storage_bytes, counts.data(), result.JA.data(), static_cast<int>(rows + 1), ctx.stream()));
+			DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+			CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+				counts.data(), result.JA.data(), static_cast<int>(rows + 1), ctx.stream()));
+			int nnz;
+			CUMAT_SAFE_CALL(cudaMemcpyAsync(&nnz, result.JA.data() + rows, sizeof(int), cudaMemcpyDeviceToHost, ctx.stream()));
+			CUMAT_SAFE_CALL(cudaStreamSynchronize(ctx.stream()));
+			result.IA = IndexVector(nnz);
+			result.source = IndexVector(nnz);
+			kernels::SparseConversionEllpackToCsrKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+				cfg.virtual_size, indices.data(), static_cast<int>(nnzPerRow), result.JA.data(), result.IA.data(), result.source.data());
+			CUMAT_CHECK_ERROR();
+			return result;
+		}
+
+		/**
+		 * \brief Copies the (batched) values according to \c conversion.source, see \ref HostSparseConversion::gatherValues()
+		 */
+		template<typename _Scalar>
+		static void gatherValues(const _Scalar* values, Index inputStride, const Conversion& conversion, Index batches, _Scalar* out)
+		{
+			const Index n = conversion.source.size();
+			if (n == 0) return;
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), static_cast<unsigned int>(batches),
+				kernels::SparseConversionGatherValuesKernel<_Scalar>);
+			kernels::SparseConversionGatherValuesKernel<_Scalar> <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+				cfg.virtual_size, values, inputStride, conversion.source.data(), out);
+			CUMAT_CHECK_ERROR();
+		}
+
+		/**
+		 * \brief Sums the (batched) values of the duplicates according to \c conversion.segments, see \ref HostSparseConversion::sumValues()
+		 */
+		template<typename _Scalar>
+		static void sumValues(const _Scalar* values, Index inputStride, const Conversion& conversion, Index batches, _Scalar* out)
+		{
+			const Index n = conversion.segments.size() - 1;
+			if (n <= 0) return;
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), static_cast<unsigned int>(batches),
+				kernels::SparseConversionSumValuesKernel<_Scalar>);
+			kernels::SparseConversionSumValuesKernel<_Scalar> <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+				cfg.virtual_size, values, inputStride, conversion.source.data(), conversion.segments.data(), out);
+			CUMAT_CHECK_ERROR();
+		}
+	};
+#endif
+
+	/**
+	 * \brief Copies a compressed pattern and all batches of the data to the host
+	 */
+	template<typename _Scalar, int _Batches, int _SparseFlags>
+	void copyCompressedToHost(const SparseMatrix<_Scalar, _Batches, _SparseFlags>& m,
+		std::vector<int>& JA, std::vector<int>& IA, std::vector<_Scalar>& values)
+	{
+		const auto& pattern = m.getSparsityPattern();
+		JA.resize(pattern.JA.size());
+		IA.resize(pattern.nnz);
+		values.resize(pattern.nnz * m.batches());
+		pattern.JA.copyToHost(JA.data());
+		if (pattern.nnz > 0)
+		{
+			pattern.IA.copyToHost(IA.data());
+			m.getData().copyToHost(values.data());
+		}
+	}
+
+	/**
+	 * \brief Creates a compressed sparsity pattern from the host data
+	 */
+	template<int _SparseFlags>
+	SparsityPattern<_SparseFlags> compressedPatternFromHost(Index rows, Index cols, const std::vector<int>& JA, const std::vector<int>& IA)
+	{
+		typedef SparsityPattern<_SparseFlags> SPattern;
+		SPattern pattern;
+		pattern.rows = rows;
+		pattern.cols = cols;
+		pattern.nnz = static_cast<Index>(IA.size());
+		pattern.JA = typename SPattern::IndexVector(static_cast<Index>(JA.size()));
+		pattern.JA.copyFromHost(JA.data());
+		pattern.IA = typename SPattern::IndexVector(pattern.nnz);
+		if (pattern.nnz > 0) pattern.IA.copyFromHost(IA.data());
+		return pattern;
+	}
+
+	/**
+	 * \brief CSR to CSC and CSC to CSR, the same matrix in the other compressed format
+	 */
+	template<int _DstFlags, typename _Scalar, int _Batches, int _SrcFlags>
+	SparseMatrix<_Scalar, _Batches, _DstFlags> transposeCompressedStorage(
+		const SparseMatrix<_Scalar, _Batches, _SrcFlags>& m, SparseConversionBackend backend)
+	{
+		const auto& pattern = m.getSparsityPattern();
+		const Index outerSize = _SrcFlags == SparseFlags::CSR ? m.rows() : m.cols();
+		const Index innerSize = _SrcFlags == SparseFlags::CSR ? m.cols() : m.rows();
+		if (backend == SparseConversionBackend::Host)
+		{
+			std::vector<int> JA, IA;
+			std::vector<_Scalar> values;
+			copyCompressedToHost(m, JA, IA, values);
+			const HostSparseConversion::Conversion c = HostSparseConversion::transpose(JA.data(), IA.data(), outerSize, innerSize);
+			SparseMatrix<_Scalar, _Batches, _DstFlags> result(compressedPatternFromHost<_DstFlags>(m.rows(), m.cols(), c.JA, c.IA), m.batches());
+			const std::vector<_Scalar> newValues = HostSparseConversion::gatherValues(values.data(), pattern.nnz, c, m.batches());
+			if (!newValues.empty()) result.getData().copyFromHost(newValues.data());
+			return result;
+		}
+		CUMAT_ERROR_IF_NO_NVCC(transposeCompressedStorage)
+#if CUMAT_NVCC==1
+		const DeviceSparseConversion::Conversion c = DeviceSparseConversion::transpose(pattern.JA, pattern.IA, outerSize, innerSize, pattern.nnz);
+		SparsityPattern<_DstFlags> newPattern;
+		newPattern.rows = m.rows();
+		newPattern.cols = m.cols();
+		newPattern.nnz = pattern.nnz;
+		newPattern.JA = c.JA;
+		newPattern.IA = c.IA;
+		SparseMatrix<_Scalar, _Batches, _DstFlags> result(newPattern, m.batches());
+		DeviceSparseConversion::gatherValues(m.getData().data(), pattern.nnz, c, m.batches(), result.getData().data());
+		return result;
+#endif
+	}
+}
+
+/**
+ * \brief Converts a CSR matrix to CSC. All batches are converted, the row indices per column are sorted.
+ * \param m the CSR matrix
+ * \param backend host (OpenMP) or device
+ * \return the same matrix in CSC format
+ */
+template<typename _Scalar, int _Batches>
+SparseMatrix<_Scalar, _Batches, SparseFlags::CSC> convertToCSC(
+	const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& m, SparseConversionBackend backend = SparseConversionBackend::Host)
+{
+	return internal::transposeCompressedStorage<SparseFlags::CSC>(m, backend);
+}
+
+/**
+ * \brief Converts a CSC matrix to CSR. All batches are converted, the column indices per row are sorted.
+ * \param m the CSC matrix
+ * \param backend host (OpenMP) or device
+ * \return the same matrix in CSR format
+ */
+template<typename _Scalar, int _Batches>
+SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> convertToCSR(
+	const SparseMatrix<_Scalar, _Batches, SparseFlags::CSC>& m, SparseConversionBackend backend = SparseConversionBackend::Host)
+{
+	return internal::transposeCompressedStorage<SparseFlags::CSR>(m, backend);
+}
+
+/**
+ * \brief Converts a CSR matrix to ELLPACK, every row is padded to the longest row. All batches are converted.
+ * The padding is a waste of memory and bandwidth for irregular matrices, check the padding ratio in the report.
+ * \param m the CSR matrix
+ * \param backend host (OpenMP) or device
+ * \param report if not null, receives the padding statistics
+ * \return the same matrix in ELLPACK format, the padded entries are zero
+ */
+template<typename _Scalar, int _Batches>
+SparseMatrix<_Scalar, _Batches, SparseFlags::ELLPACK> convertToELLPACK(
+	const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& m, SparseConversionBackend backend = SparseConversionBackend::Host,
+	EllpackPaddingReport* report = nullptr)
+{
+	typedef SparsityPattern<SparseFlags::ELLPACK> SPattern;
+	const auto& pattern = m.getSparsityPattern();
+	SPattern newPattern;
+	newPattern.rows = m.rows();
+	newPattern.cols = m.cols();
+	if (backend == SparseConversionBackend::Host)
+	{
+		std::vector<int> JA, IA;
+		std::vector<_Scalar> values;
+		internal::copyCompressedToHost(m, JA, IA, values);
+		const internal::HostSparseConversion::Conversion c = internal::HostSparseConversion::csrToEllpack(JA.data(), IA.data(), m.rows(), report);
+		newPattern.nnzPerRow = c.nnzPerRow;
+		newPattern.indices = SPattern::IndexMatrix(m.rows(), c.nnzPerRow);
+		newPattern.indices.copyFromHost(c.IA.data());
+		SparseMatrix<_Scalar, _Batches, SparseFlags::ELLPACK> result(newPattern, m.batches());
+		const std::vector<_Scalar> newValues = internal::HostSparseConversion::gatherValues(values.data(), pattern.nnz, c, m.batches());
+		result.getData().copyFromHost(newValues.data());
+		return result;
+	}
+	CUMAT_ERROR_IF_NO_NVCC(convertToELLPACK)
+#if CUMAT_NVCC==1
+	const internal::DeviceSparseConversion::Conversion c = internal::DeviceSparseConversion::csrToEllpack(pattern.JA, m.rows(), pattern.IA, report);
+	newPattern.nnzPerRow = c.nnzPerRow;
+	newPattern.indices = SPattern::IndexMatrix(c.IA.dataPointer(), m.rows(), c.nnzPerRow, 1);
+	SparseMatrix<_Scalar, _Batches, SparseFlags::ELLPACK> result(newPattern, m.batches());
+	internal::DeviceSparseConversion::gatherValues(m.getData().data(), pattern.nnz, c, m.batches(), result.getData().data());
+	return result;
+#endif
+}
+
+/**
+ * \brief Converts an ELLPACK matrix to CSR, the padding is removed. All batches are converted.
+ * \param m the ELLPACK matrix
+ * \param backend host (OpenMP) or device
+ * \return the same matrix in CSR format
+ */
+template<typename _Scalar, int _Batches>
+SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> convertToCSR(
+	const SparseMatrix<_Scalar, _Batches, SparseFlags::ELLPACK>& m, SparseConversionBackend backend = SparseConversionBackend::Host)
+{
+	const auto& pattern = m.getSparsityPattern();
+	const Index stored = pattern.getNNZ();
+	if (backend == SparseConversionBackend::Host)
+	{
+		std::vector<int> indices(stored);
+		std::vector<_Scalar> values(stored * m.batches());
+		pattern.indices.copyToHost(indices.data());
+		m.getData().copyToHost(values.data());
+		const internal::HostSparseConversion::Conversion c = internal::HostSparseConversion::ellpackToCsr(indices.data(), m.rows(), pattern.nnzPerRow);
+		SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> result(internal::compressedPatternFromHost<SparseFlags::CSR>(m.rows(), m.cols(), c.JA, c.IA), m.batches());
+		const std::vector<_Scalar> newValues = internal::HostSparseConversion::gatherValues(values.data(), stored, c, m.batches());
+		if (!newValues.empty()) result.getData().copyFromHost(newValues.data());
+		return result;
+	}
+	CUMAT_ERROR_IF_NO_NVCC(convertToCSR)
+#if CUMAT_NVCC==1
+	const internal::DeviceSparseConversion::Conversion c = internal::DeviceSparseConversion::ellpackToCsr(pattern.indices, m.rows(), pattern.nnzPerRow);
+	SparsityPattern<SparseFlags::CSR> newPattern;
+	newPattern.rows = m.rows();
+	newPattern.cols = m.cols();
+	newPattern.nnz = c.IA.size();
+	newPattern.JA = c.JA;
+	newPattern.IA = c.IA;
+	SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> result(newPattern, m.batches());
+	internal::DeviceSparseConversion::gatherValues(m.getData().data(), stored, c, m.batches(), result.getData().data());
+	return result;
+#endif
+}
+
+/**
+ * \brief Converts a matrix in coordinate format to CSR, duplicated entries are summed up. All batches are converted.
+ * The column indices per row are sorted.
+ * \param m the COO matrix
+ * \param backend host (OpenMP) or device
+ * \return the CSR matrix
+ */
+template<typename _Scalar, int _Batches>
+SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> convertToCSR(
+	const CooMatrix<_Scalar, _Batches>& m, SparseConversionBackend backend = SparseConversionBackend::Host)
+{
+	CUMAT_ASSERT_DIMENSION(m.colIndices.size() == m.nnz());
+	CUMAT_ASSERT_DIMENSION(m.values.rows() == m.nnz());
+	const Index nnz = m.nnz();
+	if (backend == SparseConversionBackend::Host)
+	{
+		std::vector<int> rowIndices(nnz), colIndices(nnz);
+		std::vector<_Scalar> values(nnz * m.batches());
+		if (nnz > 0)
+		{
+			m.rowIndices.copyToHost(rowIndices.data());
+			m.colIndices.copyToHost(colIndices.data());
+			m.values.copyToHost(values.data());
+		}
+		const internal::HostSparseConversion::Conversion c = internal::HostSparseConversion::cooToCompressed(
+			rowIndices.data(), colIndices.data(), nnz, m.rows, m.cols);
+		SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> result(internal::compressedPatternFromHost<SparseFlags::CSR>(m.rows, m.cols, c.JA, c.IA), m.batches());
+		const std::vector<_Scalar> newValues = internal::HostSparseConversion::sumValues(values.data(), nnz, c, m.batches());
+		if (!newValues.empty()) result.getData().copyFromHost(newValues.data());
+		return result;
+	}
+	CUMAT_ERROR_IF_NO_NVCC(convertToCSR)
+#if CUMAT_NVCC==1
+	const internal::DeviceSparseConversion::Conversion c = internal::DeviceSparseConversion::cooToCompressed(
+		m.rowIndices, m.colIndices, nnz, m.rows, m.cols);
+	SparsityPattern<SparseFlags::CSR> newPattern;
+	newPattern.rows = m.rows;
+	newPattern.cols = m.cols;
+	newPattern.nnz = c.IA.size();
+	newPattern.JA = c.JA;
+	newPattern.IA = c.IA;
+	SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> result(newPattern, m.batches());
+	internal::DeviceSparseConversion::sumValues(m.values.data(), nnz, c, m.batches(), result.getData().data());
+	return result;
+#endif
+}
+
+/**
+ * \brief Converts a CSR matrix to coordinate format, the entries are ordered by row. All batches are converted.
+ * The column indices and the values are shared with the CSR matrix, only the row indices are computed.
+ * \param m the CSR matrix
+ * \param backend host (OpenMP) or device
+ * \return the COO matrix
+ */
+template<typename _Scalar, int _Batches>
+CooMatrix<_Scalar, _Batches> convertToCOO(
+	const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& m, SparseConversionBackend backend = SparseConversionBackend::Host)
+{
+	const auto& pattern = m.getSparsityPattern();
+	CooMatrix<_Scalar, _Batches> result;
+	result.rows = m.rows();
+	result.cols = m.cols();
+	result.colIndices = pattern.IA;
+	result.values = m.getData();
+	if (backend == SparseConversionBackend::Host)
+	{
+		std::vector<int> JA(m.rows() + 1);
+		pattern.JA.copyToHost(JA.data());
+		const internal::HostSparseConversion::Conversion c = internal::HostSparseConversion::compressedToCoo(JA.data(), m.rows());
+		result.rowIndices = typename CooMatrix<_Scalar, _Batches>::IndexVector(pattern.nnz);
+		if (pattern.nnz > 0) result.rowIndices.copyFromHost(c.IA.data());
+		return result;
+	}
+	CUMAT_ERROR_IF_NO_NVCC(convertToCOO)
+#if CUMAT_NVCC==1
+	result.rowIndices = internal::DeviceSparseConversion::expand(pattern.JA, m.rows(), pattern.nnz);
+	return result;
+#endif
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -43,12 +43,13 @@ namespace internal
  * 
  * \tparam _Scalar the scalar type
  * \tparam _Batches the number of batches on compile time or Dynamic
- * \tparam _SparseFlags the storage mode, must be either \c SparseFlags::CSC or \c SparseFlags::CSR
+ * \tparam _SparseFlags the storage mode, a member of \ref SparseFlags
  */
 template<typename _Scalar, int _Batches, int _SparseFlags>
 class SparseMatrix : public SparseMatrixBase<SparseMatrix<_Scalar, _Batches, _SparseFlags> >
 {
-    CUMAT_STATIC_ASSERT(_SparseFlags == SparseFlags::CSR || _SparseFlags == SparseFlags::CSC || _SparseFlags == SparseFlags::ELLPACK,
+    CUMAT_STATIC_ASSERT(_SparseFlags == SparseFlags::CSR || _SparseFlags == SparseFlags::CSC || _SparseFlags == SparseFlags::ELLPACK
+        || _SparseFlags == SparseFlags::SELLCS,
         "_SparseFlags must be a member of cuMat::SparseFlags");
 public:
 
@@ -507,6 +508,34 @@ __host__ std::ostream& operator<<(std::ostream& os, const SparseMatrix<_Scalar,
 	}
 	return os;
 }
+/**
+* \brief Custom operator<< that prints the sparse matrix and additional information.
+* First, information about the matrix like shape and storage options are printed,
+* followed by the sparse data of the matrix.
+*
+* This operations involves copying the matrix from device to host.
+* It is slow, use it only for debugging purpose.
+* \param os the output stream
+* \param m the matrix
+* \return the output stream again
+*/
+template <typename _Scalar, int _Batches>
+__host__ std::ostream& operator<<(std::ostream& os, const SparseMatrix<_Scalar, _Batches, SparseFlags::SELLCS>& m)
+{
+	os << "SparseMatrix: " << std::endl;
+	os << " rows=" << m.rows();
+	os << ", cols=" << m.cols();
+	os << ", batches=" << m.batches() << " (" << (_Batches == Dynamic ? "dynamic" : "compile-time") << ")";
+	os << ", storage=SELL-C-sigma, C=" << m.getSparsityPattern().sliceHeight << ", sigma=" << m.getSparsityPattern().sortWindow << std::endl;
+	os << " Slice Offsets: " << m.getSparsityPattern().sliceOffsets.toEigen().transpose() << std::endl;
+	os << " Permutation (sorted position -> row): " << m.getSparsityPattern().permutation.toEigen().transpose() << std::endl;
+	os << " Column Indices: " << m.getSparsityPattern().IA.toEigen().transpose() << std::endl;
+	for (int batch = 0; batch < m.batches(); ++batch)
+	{
+		os << " Data (Batch " << batch << "): " << m.getData().slice(batch).eval().toEigen().transpose() << std::endl;
+	}
+	return os;
+}
 
 namespace internal
 {
@@ -590,12 +619,13 @@ namespace internal
 * cuMat defines several typedef shortcuts for most common sparse matrix types.
 *
 * The general patterns are the following:
-* \code [B]SMatrixX&lt;T&gt;[_CSR|_CSC] \endcode
+* \code [B]SMatrixX&lt;T&gt;[_CSR|_CSC|_ELLPACK|_SELLCS] \endcode
 *
 * The type of the matrix is encoded in <tt>&lt;T&gt;</tt> and can be \c b for boolean, \c i for integer, \c f for float, \c d for double, \c cf for complex float, \c cd
 * for complex double.
 * The prefix <tt>[B]</tt> indicates batched sparse matrices of dynamic batch size. If absent, the matrix will a compile-time batch size of 1.
-* The suffices <tt>_CSR</tt> or <tt>_CSC</tt> specify if the matrix is in Compressed Sparse Row (CSR) or Compressed Sparse Column (CSC) format.
+* The suffices <tt>_CSR</tt> or <tt>_CSC</tt> specify if the matrix is in Compressed Sparse Row (CSR) or Compressed Sparse Column (CSC) format,
+* <tt>_ELLPACK</tt> and <tt>_SELLCS</tt> select the ELLPACK and the sliced ELLPACK (SELL-C-sigma) format.
 * The default (if the suffix is absent) is CSR.
 *
 * For example, \c BSMatrixXf is a batched sparse matrix of floats in CSR format.
@@ -612,6 +642,8 @@ namespace internal
     /** \ingroup sparsematrixtypedefs */ typedef SparseMatrix<scalar1, 1, CSR> SMatrixX ## scalar2 ## _CSR; \
     /** \ingroup sparsematrixtypedefs */ typedef SparseMatrix<scalar1, 1, CSC> SMatrixX ## scalar2 ## _CSC; \
 	/** \ingroup sparsematrixtypedefs */ typedef SparseMatrix<scalar1, 1, ELLPACK> SMatrixX ## scalar2 ## _ELLPACK; \
+	/** \ingroup sparsematrixtypedefs */ typedef SparseMatrix<scalar1, Dynamic, SELLCS> BSMatrixX ## scalar2 ## _SELLCS; \
+	/** \ingroup sparsematrixtypedefs */ typedef SparseMatrix<scalar1, 1, SELLCS> SMatrixX ## scalar2 ## _SELLCS; \
 
 CUMAT_DEF_MATRIX1(bool, b)
 CUMAT_DEF_MATRIX1(int, i)
@@ -3,6 +3,7 @@
 
 #include "Macros.h"
 #include "ForwardDeclarations.h"
+#include "CsrRowAnalysis.h"
 
 CUMAT_NAMESPACE_BEGIN
 
@@ -46,6 +47,10 @@ struct SparsityPattern<SparseFlags::CSC>
     IndexVector IA;
     /** \brief Outer indices, size=N+1 */
     IndexVector JA;
+    /**
+     * \brief The cached thread mapping of component-wise evaluations, shared by all copies of this pattern.
+     */
+    internal::SparseCwiseEvaluationCache cwiseEvaluationCache;
 
     /**
     * \brief Checks with assertions that this SparsityPattern is valid.
@@ -82,8 +87,33 @@ struct SparsityPattern<SparseFlags::CSC>
 		clone.cols = cols;
 		clone.IA = IA.deepClone();
 		clone.JA = JA.deepClone();
+		clone.cwiseEvaluationCache.setMode(cwiseEvaluationCache.getMode());
 		return clone;
     }
+
+    /**
+     * \brief Forces the thread mapping of component-wise evaluations into matrices with this pattern.
+     * The default, SparseCwiseEvaluation::Automatic, selects it from the column lengths.
+     * This applies to all matrices sharing this sparsity pattern.
+     */
+    void setCwiseEvaluation(SparseCwiseEvaluation mode) const
+    {
+        cwiseEvaluationCache.setMode(mode);
+    }
+    /**
+     * \return the forced thread mapping of component-wise evaluations or SparseCwiseEvaluation::Automatic
+     */
+    SparseCwiseEvaluation getCwiseEvaluation() const
+    {
+        return cwiseEvaluationCache.getMode();
+    }
+    /**
+     * \brief Discards the cached statistics of the column lengths, needed after in-place modifications of JA
+     */
+    void invalidateCwiseEvaluation() const
+    {
+        cwiseEvaluationCache.invalidate();
+    }
 };
 
 template<>
@@ -106,6 +136,15 @@ struct SparsityPattern<SparseFlags::CSR>
 	IndexVector IA;
 	/** \brief Outer indices, size=N+1 */
 	IndexVector JA;
+	/**
+	 * \brief The cached analysis of the row lengths that selects the kernel of the matrix-vector product.
+	 * Shared by all copies of this pattern.
+	 */
+	internal::CsrRowAnalysisCache rowAnalysisCache;
+	/**
+	 * \brief The cached thread mapping of component-wise evaluations, shared by all copies of this pattern.
+	 */
+	internal::SparseCwiseEvaluationCache cwiseEvaluationCache;
 
 	/**
 	* \brief Checks with assertions that this SparsityPattern is valid.
@@ -142,8 +181,68 @@ struct SparsityPattern<SparseFlags::CSR>
 		clone.cols = cols;
 		clone.IA = IA.deepClone();
 		clone.JA = JA.deepClone();
+		clone.rowAnalysisCache.setAlgorithm(rowAnalysisCache.getAlgorithm());
+		clone.cwiseEvaluationCache.setMode(cwiseEvaluationCache.getMode());
 		return clone;
 	}
+
+	/**
+	 * \brief Returns the analysis of the row lengths.
+	 * It is computed on the host at the first call (this copies JA to the host) and cached afterwards.
+	 * Replacing JA, rows or nnz triggers a new analysis, call \ref invalidateRowAnalysis()
+	 * if the outer indices are modified in-place.
+	 */
+	const internal::CsrRowAnalysis& rowAnalysis() const
+	{
+		return rowAnalysisCache.get(JA, rows, nnz);
+	}
+	/**
+	 * \brief Forces the kernel for the sparse matrix - dense vector product.
+	 * The default, CsrSpMVAlgorithm::Automatic, selects it from the row lengths.
+	 * This applies to all matrices sharing this sparsity pattern.
+	 */
+	void setSpMVAlgorithm(CsrSpMVAlgorithm algorithm) const
+	{
+		rowAnalysisCache.setAlgorithm(algorithm);
+	}
+	/**
+	 * \return the forced kernel of the matrix-vector product or CsrSpMVAlgorithm::Automatic
+	 */
+	CsrSpMVAlgorithm getSpMVAlgorithm() const
+	{
+		return rowAnalysisCache.getAlgorithm();
+	}
+	/**
+	 * \brief Discards the cached row analysis and cwise evaluation statistics, needed after in-place modifications of JA
+	 */
+	void invalidateRowAnalysis() const
+	{
+		rowAnalysisCache.invalidate();
+		invalidateCwiseEvaluation();
+	}
+	/**
+	 * \brief Forces the thread mapping of component-wise evaluations into matrices with this pattern.
+	 * The default, SparseCwiseEvaluation::Automatic, selects it from the row lengths.
+	 * This applies to all matrices sharing this sparsity pattern.
+	 */
+	void setCwiseEvaluation(SparseCwiseEvaluation mode) const
+	{
+		cwiseEvaluationCache.setMode(mode);
+	}
+	/**
+	 * \return the forced thread mapping of component-wise evaluations or SparseCwiseEvaluation::Automatic
+	 */
+	SparseCwiseEvaluation getCwiseEvaluation() const
+	{
+		return cwiseEvaluationCache.getMode();
+	}
+	/**
+	 * \brief Discards the cached statistics of the row lengths for component-wise evaluations, needed after in-place modifications of JA
+	 */
+	void invalidateCwiseEvaluation() const
+	{
+		cwiseEvaluationCache.invalidate();
+	}
 };
 
 template<>
@@ -205,6 +304,95 @@ struct SparsityPattern<SparseFlags::ELLPACK>
 	}
 };
 
+/**
+ * \brief Sparsity pattern of the sliced ELLPACK format with sorting window (SELL-C-sigma).
+ * Build it from a CSR matrix with internal::SellCSigmaLayout or internal::HostCsrMatrix::toSellMatrix().
+ *
+ * The rows are permuted (sorted by length within windows of \ref sortWindow rows),
+ * the sorted rows are grouped into slices of \ref sliceHeight rows and each slice is padded to its longest row.
+ * Entry j of the row at lane r of slice s is stored at <tt>sliceOffsets[s] + j*sliceHeight + r</tt>.
+ * The permutation is internal to the storage: rows, products and component-wise expressions use the original row indices.
+ */
+template<>
+struct SparsityPattern<SparseFlags::SELLCS>
+{
+	/**
+	* \brief The type of the storage indices.
+	* This is fixed to an integer and not using Index, because this is faster for CUDA.
+	*/
+	typedef int StorageIndex;
+
+	typedef Matrix<StorageIndex, Dynamic, 1, 1, Flags::ColumnMajor> IndexVector;
+	typedef const Matrix<StorageIndex, Dynamic, 1, 1, Flags::ColumnMajor> ConstIndexVector; //TODO: this is no proper const-correctness
+	template<typename _Scalar, int _Batches> using DataMatrix = Matrix<_Scalar, Dynamic, 1, _Batches, Flags::ColumnMajor>;
+
+	/** \brief Number of stored entries, including the padding */
+	Index nnz;
+	Index rows;
+	Index cols;
+	/** \brief The slice height C */
+	Index sliceHeight;
+	/** \brief The sorting window sigma */
+	Index sortWindow;
+	/** \brief Offsets of the slices into IA and the data, size=numSlices+1 */
+	IndexVector sliceOffsets;
+	/** \brief Column indices, -1 indicates padding. Size=nnz */
+	IndexVector IA;
+	/** \brief Sorted position -> original row, -1 for the empty positions of the last slice. Size=numSlices*sliceHeight */
+	IndexVector permutation;
+	/** \brief Original row -> sorted position. Size=rows */
+	IndexVector inversePermutation;
+
+	/**
+	 * \return the number of slices
+	 */
+	__host__ __device__ CUMAT_STRONG_INLINE Index numSlices() const { return CUMAT_DIV_UP(rows, sliceHeight); }
+
+	/**
+	* \brief Checks with assertions that this SparsityPattern is valid.
+	*/
+	void assertValid() const
+	{
+		CUMAT_ASSERT_DIMENSION(rows > 0);
+		CUMAT_ASSERT_DIMENSION(cols > 0);
+		CUMAT_ASSERT_DIMENSION(sliceHeight > 0);
+		CUMAT_ASSERT_DIMENSION(sliceOffsets.size() == numSlices() + 1);
+		CUMAT_ASSERT_DIMENSION(IA.size() == nnz);
+		CUMAT_ASSERT_DIMENSION(permutation.size() == numSlices() * sliceHeight);
+		CUMAT_ASSERT_DIMENSION(inversePermutation.size() == rows);
+	}
+	/**
+	 * \return the number of stored entries, including the padding
+	 */
+	__host__ __device__ CUMAT_STRONG_INLINE Index getNNZ() const { return nnz; }
+	/**
+	 * \brief Allocates the data matrix for this sparsity type with the specified number of batches.
+	 */
+	template<typename _Scalar, int _Batches>
+	DataMatrix<_Scalar, _Batches> allocateDataMatrix(Index batches) const
+	{
+		return DataMatrix<_Scalar, _Batches>(nnz, 1, batches);
+	}
+
+	/**
+	 * \return a deep clone of this sparsity pattern
+	 */
+	SparsityPattern<SparseFlags::SELLCS> deepClone() const
+	{
+		SparsityPattern<SparseFlags::SELLCS> clone;
+		clone.nnz = nnz;
+		clone.rows = rows;
+		clone.cols = cols;
+		clone.sliceHeight = sliceHeight;
+		clone.sortWindow = sortWindow;
+		clone.sliceOffsets = sliceOffsets.deepClone();
+		clone.IA = IA.deepClone();
+		clone.permutation = permutation.deepClone();
+		clone.inversePermutation = inversePermutation.deepClone();
+		return clone;
+	}
+};
+
 
 namespace internal
 {
@@ -347,6 +535,48 @@ namespace internal
 			return -1;
 		}
 	};
+
+	//SELL-C-sigma specialization
+	template <>
+	struct SparseMatrixIndexEvaluator<SparseFlags::SELLCS>
+	{
+		using Sparsity = SparsityPattern<SparseFlags::SELLCS>;
+		/**
+		 * \brief Converts linear index of nnz to row+col+batch index. This is required for AccessFlags::WriteCwise
+		 */
+		static __device__ void linearToCoords(const Sparsity& sparsity, Index index, Index& row, Index& col, Index& batch)
+		{
+			batch = index / sparsity.nnz;
+			index = index % sparsity.nnz;
+			//binary search for the slice
+			Index lo = 0, hi = sparsity.numSlices();
+			while (hi - lo > 1)
+			{
+				const Index mid = (lo + hi) / 2;
+				if (sparsity.sliceOffsets.getRawCoeff(mid) <= index) lo = mid; else hi = mid;
+			}
+			const Index lane = (index - sparsity.sliceOffsets.getRawCoeff(lo)) % sparsity.sliceHeight;
+			row = sparsity.permutation.getRawCoeff(lo * sparsity.sliceHeight + lane);
+			col = sparsity.IA.getRawCoeff(index);
+		}
+		/**
+		 * \brief Converts coordinate indices to the linear index. This is required for AccessFlags::ReadCwise
+		 */
+		static __device__ Index coordsToLinear(const Sparsity& sparsity, Index row, Index col, Index batch)
+		{
+			const Index position = sparsity.inversePermutation.getRawCoeff(row);
+			const Index slice = position / sparsity.sliceHeight;
+			const int start = sparsity.sliceOffsets.getRawCoeff(slice) + static_cast<int>(position % sparsity.sliceHeight);
+			const int end = sparsity.sliceOffsets.getRawCoeff(slice + 1);
+			for (int i = start; i < end; i += static_cast<int>(sparsity.sliceHeight))
+			{
+				int c = sparsity.IA.getRawCoeff(i);
+				if (c < 0) break; //the remaining entries of this row are padding
+				if (c == col) return i + sparsity.nnz * batch;
+			}
+			return -1;
+		}
+	};
 }
 
 
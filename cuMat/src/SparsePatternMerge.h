@@ -0,0 +1,366 @@
+#ifndef __CUMAT_SPARSE_PATTERN_MERGE_H__
+#define __CUMAT_SPARSE_PATTERN_MERGE_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "BinaryOps.h"
+#include "SparseMatrix.h"
+#include "SparseFormatConversion.h"
+
+#include <algorithm>
+
+CUMAT_NAMESPACE_BEGIN
+
+/**
+ * \brief The symbolic phase of a component-wise operation between two sparse matrices with different patterns,
+ * computed by \ref sparsePatternUnion() or \ref sparsePatternIntersection().
+ *
+ * It contains the merged pattern and, for every entry of it, the entry of the left and right operand (-1 if the operand has no entry there).
+ * With it, \ref sparseMergeNumeric() evaluates the operation for new values of the operands without any sorting.
+ *
+ * The merge also remembers the patterns it was computed for (it keeps references to their index vectors), so that
+ * \ref sparseAdd(), \ref sparseSub() and \ref sparseCwiseMul() can reuse it as a cache as long as the operands keep their patterns.
+ * Holding the index vectors prevents their memory from being recycled for a different pattern while the merge is cached.
+ * \tparam _SparseFlags the compressed format, CSR or CSC
+ */
+template<int _SparseFlags>
+struct SparsePatternMerge
+{
+    typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IndexVector;
+
+    /** \brief The merged pattern, the inner indices are sorted */
+    SparsityPattern<_SparseFlags> pattern;
+    /** \brief true for the intersection, false for the union */
+    bool intersection = false;
+    /** \brief Entry of the left operand per entry of the merged pattern or -1, size=pattern.nnz */
+    IndexVector leftEntries;
+    /** \brief Entry of the right operand per entry of the merged pattern or -1, size=pattern.nnz */
+    IndexVector rightEntries;
+
+    //the identity of the operands, the index vectors are shared with the operands' patterns
+    IndexVector leftJA;
+    IndexVector leftIA;
+    Index leftNnz = -1;
+    IndexVector rightJA;
+    IndexVector rightIA;
+    Index rightNnz = -1;
+
+    /**
+     * \brief Tests if this merge was computed for the specified patterns and kind of merge
+     */
+    bool matches(const SparsityPattern<_SparseFlags>& left, const SparsityPattern<_SparseFlags>& right, bool isIntersection) const
+    {
+        return intersection == isIntersection
+            && leftNnz == left.nnz && leftJA.data() == left.JA.data() && leftIA.data() == left.IA.data()
+            && rightNnz == right.nnz && rightJA.data() == right.JA.data() && rightIA.data() == right.IA.data();
+    }
+};
+
+namespace internal
+{
+#if CUMAT_NVCC==1
+    namespace kernels
+    {
+        //the entries of the left and right operand of every merged entry, the entries of the right operand follow the left ones in 'source'
+        __global__ void SparseMergeSourcesKernel(dim3 virtual_size, const int* source, const int* segments, int leftNnz, int* left, int* right)
+        {
+            CUMAT_KERNEL_1D_LOOP(k, virtual_size)
+                int l = -1, r = -1;
+                for (int t = segments[k]; t < segments[k + 1]; ++t)
+                {
+                    const int s = source[t];
+                    if (s < leftNnz) l = s; else r = s - leftNnz;
+                }
+                left[k] = l;
+                right[k] = r;
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        //1 if both operands have the entry, the last element is zero
+        __global__ void SparseMergeFlagKernel(dim3 virtual_size, const int* left, const int* right, int n, int* flags)
+        {
+            CUMAT_KERNEL_1D_LOOP(k, virtual_size)
+                flags[k] = (k < n && left[k] >= 0 && right[k] >= 0) ? 1 : 0;
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        //moves the flagged entries to the positions of the exclusive sum of the flags
+        __global__ void SparseMergeCompactKernel(dim3 virtual_size, const int* positions,
+            const int* outer, const int* inner, const int* left, const int* right,
+            int* outOuter, int* outInner, int* outLeft, int* outRight)
+        {
+            CUMAT_KERNEL_1D_LOOP(k, virtual_size)
+                const int p = positions[k];
+                if (positions[k + 1] == p) continue;
+                outOuter[p] = outer[k];
+                outInner[p] = inner[k];
+                outLeft[p] = left[k];
+                outRight[p] = right[k];
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        //evaluates the functor per merged entry and batch, a missing entry of an operand is zero
+        template<typename _Scalar, typename _Functor>
+        __global__ void SparseMergeNumericKernel(dim3 virtual_size, const _Scalar* left, Index leftStride, const _Scalar* right, Index rightStride,
+            const int* leftEntries, const int* rightEntries, _Functor functor, _Scalar* out)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, b, virtual_size)
+                const int l = leftEntries[i];
+                const int r = rightEntries[i];
+                const _Scalar x = l >= 0 ? left[l + b * leftStride] : _Scalar();
+                const _Scalar y = r >= 0 ? right[r + b * rightStride] : _Scalar();
+                out[i + b * virtual_size.x] = functor(x, y, -1, -1, b);
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+
+    /**
+     * \brief Computes the union or intersection of two compressed patterns on the device.
+     * The entries of both patterns are concatenated and sorted by (outer, inner) with the COO conversion,
+     * every merged entry then has one or two source entries.
+     */
+    template<int _SparseFlags>
+    SparsePatternMerge<_SparseFlags> mergePatterns(const SparsityPattern<_SparseFlags>& A, const SparsityPattern<_SparseFlags>& B, bool intersection)
+    {
+        CUMAT_STATIC_ASSERT(_SparseFlags == SparseFlags::CSR || _SparseFlags == SparseFlags::CSC,
+            "Only the compressed formats CSR and CSC can be merged");
+        CUMAT_ASSERT_DIMENSION(A.rows == B.rows);
+        CUMAT_ASSERT_DIMENSION(A.cols == B.cols);
+        typedef DeviceSparseConversion Conv;
+        typedef typename SparsePatternMerge<_SparseFlags>::IndexVector IndexVector;
+        Context& ctx = Context::current();
+        const bool csr = _SparseFlags == SparseFlags::CSR;
+        const Index outerSize = csr ? A.rows : A.cols;
+        const Index innerSize = csr ? A.cols : A.rows;
+        const Index n = A.nnz + B.nnz;
+
+        //concatenate the entries of A and B
+        IndexVector outer(n), inner(n);
+        {
+            const IndexVector outerA = Conv::expand(A.JA, outerSize, A.nnz);
+            const IndexVector outerB = Conv::expand(B.JA, outerSize, B.nnz);
+            if (A.nnz > 0)
+            {
+                CUMAT_SAFE_CALL(cudaMemcpyAsync(outer.data(), outerA.data(), sizeof(int) * A.nnz, cudaMemcpyDeviceToDevice, ctx.stream()));
+                CUMAT_SAFE_CALL(cudaMemcpyAsync(inner.data(), A.IA.data(), sizeof(int) * A.nnz, cudaMemcpyDeviceToDevice, ctx.stream()));
+            }
+            if (B.nnz > 0)
+            {
+                CUMAT_SAFE_CALL(cudaMemcpyAsync(outer.data() + A.nnz, outerB.data(), sizeof(int) * B.nnz, cudaMemcpyDeviceToDevice, ctx.stream()));
+                CUMAT_SAFE_CALL(cudaMemcpyAsync(inner.data() + A.nnz, B.IA.data(), sizeof(int) * B.nnz, cudaMemcpyDeviceToDevice, ctx.stream()));
+            }
+        }
+
+        //union
+        const Conv::Conversion c = Conv::cooToCompressed(outer, inner, n, outerSize, innerSize);
+        const Index numUnion = c.IA.size();
+        IndexVector left(numUnion), right(numUnion);
+        if (numUnion > 0)
+        {
+            KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(numUnion), kernels::SparseMergeSourcesKernel);
+            kernels::SparseMergeSourcesKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+                cfg.virtual_size, c.source.data(), c.segments.data(), static_cast<int>(A.nnz), left.data(), right.data());
+            CUMAT_CHECK_ERROR();
+        }
+
+        SparsePatternMerge<_SparseFlags> result;
+        result.intersection = intersection;
+        result.pattern.rows = A.rows;
+        result.pattern.cols = A.cols;
+        if (!intersection || numUnion == 0)
+        {
+            result.pattern.nnz = numUnion;
+            result.pattern.JA = c.JA;
+            result.pattern.IA = c.IA;
+            result.leftEntries = left;
+            result.rightEntries = right;
+        }
+        else
+        {
+            //keep the entries present in both operands
+            IndexVector flags(numUnion + 1), positions(numUnion + 1);
+            KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(numUnion + 1), kernels::SparseMergeFlagKernel);
+            kernels::SparseMergeFlagKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+                cfg.virtual_size, left.data(), right.data(), static_cast<int>(numUnion), flags.data());
+            CUMAT_CHECK_ERROR();
+            size_t temp_storage_bytes = 0;
+            CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(NULL, temp_storage_bytes, flags.data(), positions.data(), static_cast<int>(numUnion + 1), ctx.stream()));
+            DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+            CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+                flags.data(), positions.data(), static_cast<int>(numUnion + 1), ctx.stream()));
+            int count;
+            CUMAT_SAFE_CALL(cudaMemcpyAsync(&count, positions.data() + numUnion, sizeof(int), cudaMemcpyDeviceToHost, ctx.stream()));
+            CUMAT_SAFE_CALL(cudaStreamSynchronize(ctx.stream()));
+
+            const IndexVector unionOuter = Conv::expand(c.JA, outerSize, numUnion);
+            IndexVector outOuter(count);
+            result.pattern.nnz = count;
+            result.pattern.IA = IndexVector(count);
+            result.leftEntries = IndexVector(count);
+            result.rightEntries = IndexVector(count);
+            if (count > 0)
+            {
+                KernelLaunchConfig cfg2 = ctx.createLaunchConfig1D(static_cast<unsigned int>(numUnion), kernels::SparseMergeCompactKernel);
+                kernels::SparseMergeCompactKernel <<<cfg2.block_count, cfg2.thread_per_block, 0, ctx.stream() >>> (
+                    cfg2.virtual_size, positions.data(), unionOuter.data(), c.IA.data(), left.data(), right.data(),
+                    outOuter.data(), result.pattern.IA.data(), result.leftEntries.data(), result.rightEntries.data());
+                CUMAT_CHECK_ERROR();
+            }
+            result.pattern.JA = Conv::compress<int>(outOuter.data(), count, outerSize, 1);
+        }
+
+        result.leftJA = A.JA;
+        result.leftIA = A.IA;
+        result.leftNnz = A.nnz;
+        result.rightJA = B.JA;
+        result.rightIA = B.IA;
+        result.rightNnz = B.nnz;
+        return result;
+    }
+#endif
+}
+
+/**
+ * \brief Computes the union of the patterns of two CSR or CSC matrices, the symbolic phase of \ref sparseAdd() and \ref sparseSub().
+ * \param A the pattern of the left operand
+ * \param B the pattern of the right operand, same size and format as A
+ * \return the merged pattern and the entries of the operands per merged entry
+ */
+template<int _SparseFlags>
+SparsePatternMerge<_SparseFlags> sparsePatternUnion(const SparsityPattern<_SparseFlags>& A, const SparsityPattern<_SparseFlags>& B)
+{
+    CUMAT_ERROR_IF_NO_NVCC(sparsePatternUnion)
+#if CUMAT_NVCC==1
+    return internal::mergePatterns(A, B, false);
+#else
+    return SparsePatternMerge<_SparseFlags>();
+#endif
+}
+
+/**
+ * \brief Computes the intersection of the patterns of two CSR or CSC matrices, the symbolic phase of \ref sparseCwiseMul().
+ * \param A the pattern of the left operand
+ * \param B the pattern of the right operand, same size and format as A
+ * \return the merged pattern and the entries of the operands per merged entry
+ */
+template<int _SparseFlags>
+SparsePatternMerge<_SparseFlags> sparsePatternIntersection(const SparsityPattern<_SparseFlags>& A, const SparsityPattern<_SparseFlags>& B)
+{
+    CUMAT_ERROR_IF_NO_NVCC(sparsePatternIntersection)
+#if CUMAT_NVCC==1
+    return internal::mergePatterns(A, B, true);
+#else
+    return SparsePatternMerge<_SparseFlags>();
+#endif
+}
+
+/**
+ * \brief Evaluates the binary functor per entry of the merged pattern, a missing entry of an operand counts as zero.
+ * The values of \c C are overwritten, the pattern is kept. Only this phase has to be repeated if the values of A or B change.
+ *
+ * All batches share the same pattern. If one operand has a single batch, it is broadcasted over the batches of the other operand.
+ * \param merge the symbolic phase computed for the patterns of A and B
+ * \param A the left operand
+ * \param B the right operand
+ * \param C the result, must have the pattern \c merge.pattern and <tt>max(A.batches(), B.batches())</tt> batches
+ * \param functor the binary functor, e.g. \c functor::BinaryMathFunctor_cwiseAdd
+ */
+template<typename _Functor, typename _Scalar, int _Batches, int _SparseFlags>
+void sparseMergeNumeric(const SparsePatternMerge<_SparseFlags>& merge,
+    const SparseMatrix<_Scalar, _Batches, _SparseFlags>& A, const SparseMatrix<_Scalar, _Batches, _SparseFlags>& B,
+    SparseMatrix<_Scalar, _Batches, _SparseFlags>& C, const _Functor& functor = _Functor())
+{
+    CUMAT_ASSERT_DIMENSION(A.getSparsityPattern().nnz == merge.leftNnz);
+    CUMAT_ASSERT_DIMENSION(B.getSparsityPattern().nnz == merge.rightNnz);
+    CUMAT_ASSERT_DIMENSION(C.getSparsityPattern().nnz == merge.pattern.nnz);
+    CUMAT_ASSERT_DIMENSION(A.batches() == B.batches() || A.batches() == 1 || B.batches() == 1);
+    CUMAT_ASSERT_DIMENSION(C.batches() == std::max(A.batches(), B.batches()));
+    CUMAT_ERROR_IF_NO_NVCC(sparseMergeNumeric)
+#if CUMAT_NVCC==1
+    const Index n = merge.pattern.nnz;
+    if (n == 0) return;
+    Context& ctx = Context::current();
+    KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), static_cast<unsigned int>(C.batches()),
+        internal::kernels::SparseMergeNumericKernel<_Scalar, _Functor>);
+    internal::kernels::SparseMergeNumericKernel<_Scalar, _Functor> <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+        cfg.virtual_size, A.getData().data(), A.batches() == 1 ? 0 : merge.leftNnz,
+        B.getData().data(), B.batches() == 1 ? 0 : merge.rightNnz,
+        merge.leftEntries.data(), merge.rightEntries.data(), functor, C.getData().data());
+    CUMAT_CHECK_ERROR();
+#endif
+}
+
+namespace internal
+{
+    //computes the merge or reuses the cache if it matches
+    template<int _SparseFlags>
+    const SparsePatternMerge<_SparseFlags>& cachedMerge(const SparsityPattern<_SparseFlags>& A, const SparsityPattern<_SparseFlags>& B,
+        bool intersection, SparsePatternMerge<_SparseFlags>* cache, SparsePatternMerge<_SparseFlags>& local)
+    {
+        SparsePatternMerge<_SparseFlags>& target = cache ? *cache : local;
+        if (!target.matches(A, B, intersection))
+            target = intersection ? sparsePatternIntersection(A, B) : sparsePatternUnion(A, B);
+        return target;
+    }
+
+    template<typename _Functor, typename _Scalar, int _Batches, int _SparseFlags>
+    SparseMatrix<_Scalar, _Batches, _SparseFlags> sparseMerge(
+        const SparseMatrix<_Scalar, _Batches, _SparseFlags>& A, const SparseMatrix<_Scalar, _Batches, _SparseFlags>& B,
+        bool intersection, SparsePatternMerge<_SparseFlags>* cache)
+    {
+        SparsePatternMerge<_SparseFlags> local;
+        const SparsePatternMerge<_SparseFlags>& merge = cachedMerge(A.getSparsityPattern(), B.getSparsityPattern(), intersection, cache, local);
+        SparseMatrix<_Scalar, _Batches, _SparseFlags> C(merge.pattern, std::max(A.batches(), B.batches()));
+        sparseMergeNumeric<_Functor>(merge, A, B, C);
+        return C;
+    }
+}
+
+/**
+ * \brief Computes <tt>A + B</tt> of two CSR or CSC matrices with different patterns, the result has the union of the patterns.
+ * \param A the left operand
+ * \param B the right operand
+ * \param cache optional: the union of the patterns is stored in it and reused in the next call with the same patterns
+ */
+template<typename _Scalar, int _Batches, int _SparseFlags>
+SparseMatrix<_Scalar, _Batches, _SparseFlags> sparseAdd(
+    const SparseMatrix<_Scalar, _Batches, _SparseFlags>& A, const SparseMatrix<_Scalar, _Batches, _SparseFlags>& B,
+    SparsePatternMerge<_SparseFlags>* cache = nullptr)
+{
+    return internal::sparseMerge<functor::BinaryMathFunctor_cwiseAdd<_Scalar>>(A, B, false, cache);
+}
+
+/**
+ * \brief Computes <tt>A - B</tt> of two CSR or CSC matrices with different patterns, the result has the union of the patterns.
+ * \param A the left operand
+ * \param B the right operand
+ * \param cache optional: the union of the patterns is stored in it and reused in the next call with the same patterns
+ */
+template<typename _Scalar, int _Batches, int _SparseFlags>
+SparseMatrix<_Scalar, _Batches, _SparseFlags> sparseSub(
+    const SparseMatrix<_Scalar, _Batches, _SparseFlags>& A, const SparseMatrix<_Scalar, _Batches, _SparseFlags>& B,
+    SparsePatternMerge<_SparseFlags>* cache = nullptr)
+{
+    return internal::sparseMerge<functor::BinaryMathFunctor_cwiseSub<_Scalar>>(A, B, false, cache);
+}
+
+/**
+ * \brief Computes the component-wise product of two CSR or CSC matrices with different patterns,
+ * the result has the intersection of the patterns.
+ * \param A the left operand
+ * \param B the right operand
+ * \param cache optional: the intersection of the patterns is stored in it and reused in the next call with the same patterns
+ */
+template<typename _Scalar, int _Batches, int _SparseFlags>
+SparseMatrix<_Scalar, _Batches, _SparseFlags> sparseCwiseMul(
+    const SparseMatrix<_Scalar, _Batches, _SparseFlags>& A, const SparseMatrix<_Scalar, _Batches, _SparseFlags>& B,
+    SparsePatternMerge<_SparseFlags>* cache = nullptr)
+{
+    return internal::sparseMerge<functor::BinaryMathFunctor_cwiseMul<_Scalar>>(A, B, true, cache);
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -4,6 +4,7 @@
 #include "Macros.h"
 #include "ProductOp.h"
 #include "SparseMatrix.h"
+#include "ConvergenceCheck.h"
 
 CUMAT_NAMESPACE_BEGIN
 
@@ -40,9 +41,12 @@ namespace internal
     namespace kernels
     {
 
+    //CSR Matrix-Vector kernel (gather). One thread per row.
+    //With the outer and inner indices of a CSC matrix, this computes the product with the transposed matrix.
     template <typename L, typename R, typename M, AssignmentMode Mode, int Batches,
         bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime==1,
-        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1,
+        bool Conjugate = false>
     __global__ void CSRMVKernel_StaticBatches(dim3 virtual_size, const L matrix, const R vector, M output)
     {
         typedef typename L::Scalar LeftScalar;
@@ -55,7 +59,14 @@ namespace internal
         CUMAT_KERNEL_1D_LOOP(outer, virtual_size)
             int start = JA.getRawCoeff(outer);
             int end = JA.getRawCoeff(outer + 1);
-            if (start>=end) continue;
+            if (start>=end) {
+                //empty row, value-initialization gives zero also for custom blocked types
+#pragma unroll
+                for (int b = 0; b < Batches; ++b) {
+                    internal::CwiseAssignmentHandler<M, OutputScalar, Mode>::assign(output, OutputScalar(), outer + b*output.rows());
+                }
+                continue;
+            }
             int inner = IA.getRawCoeff(start);
             OutputScalar value[Batches];
 #pragma unroll
@@ -63,6 +74,7 @@ namespace internal
                 LeftScalar tmp1 = BroadcastMatrix
                     ? matrix.getSparseCoeff(outer, inner, 0, start)
                     : matrix.getSparseCoeff(outer, inner, b, start + b * nnz);
+                tmp1 = internal::conjugateCoeff<LeftScalar, Conjugate>(tmp1);
                 RightScalar tmp2 = vector.coeff(inner, 0, BroadcastRhs ? 0 : b, -1);
                 OutputScalar tmp3 = Functor::mult(tmp1, tmp2);
                 value[b] = tmp3;
@@ -75,6 +87,7 @@ namespace internal
                     LeftScalar tmp1 = BroadcastMatrix
                         ? matrix.getSparseCoeff(outer, inner, 0, i)
                         : matrix.getSparseCoeff(outer, inner, b, i + b * nnz);
+                    tmp1 = internal::conjugateCoeff<LeftScalar, Conjugate>(tmp1);
                     RightScalar tmp2 = vector.coeff(inner, 0, BroadcastRhs ? 0 : b, -1);
                     OutputScalar tmp3 = Functor::mult(tmp1, tmp2);
                     value[b] += tmp3;
@@ -87,11 +100,361 @@ namespace internal
 		CUMAT_KERNEL_1D_LOOP_END
     }
 
+    //CSR Matrix-Matrix kernel (SpMM) for a dense right hand side with a compile-time number of columns, row per thread.
+    //One thread per row, tile of ColumnsPerThread columns and batch (virtual_size.x = rows * tiles, the rows run fastest),
+    //every loaded matrix entry is reused for all columns of the tile.
+    template <typename L, typename R, typename M, AssignmentMode Mode, int Columns, int ColumnsPerThread = Columns,
+        bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1,
+        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+    __global__ void CSRMMKernel_StaticColumns(dim3 virtual_size, const L matrix, const R right, M output)
+    {
+        typedef typename L::Scalar LeftScalar;
+        typedef typename R::Scalar RightScalar;
+        typedef typename M::Scalar OutputScalar;
+        typedef ProductElementFunctor<LeftScalar, RightScalar, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE> Functor;
+        SparsityPattern<CSR>::IndexVector JA = matrix.getSparsityPattern().JA;
+        SparsityPattern<CSR>::IndexVector IA = matrix.getSparsityPattern().IA;
+        const int nnz = matrix.getSparsityPattern().nnz;
+        const Index rows = output.rows();
+        CUMAT_KERNEL_2D_LOOP(index, batch, virtual_size)
+            const Index outer = index % rows;
+            const int firstColumn = static_cast<int>(index / rows) * ColumnsPerThread;
+            const int start = JA.getRawCoeff(outer);
+            const int end = JA.getRawCoeff(outer + 1);
+            OutputScalar value[ColumnsPerThread];
+#pragma unroll
+            for (int c = 0; c < ColumnsPerThread; ++c) value[c] = OutputScalar(0);
+            for (int i = start; i < end; ++i)
+            {
+                const int inner = IA.getRawCoeff(i);
+                const LeftScalar a = BroadcastMatrix
+                    ? matrix.getSparseCoeff(outer, inner, 0, i)
+                    : matrix.getSparseCoeff(outer, inner, batch, i + batch * nnz);
+#pragma unroll
+                for (int c = 0; c < ColumnsPerThread; ++c) {
+                    if (Columns % ColumnsPerThread != 0 && firstColumn + c >= Columns) break;
+                    RightScalar b = right.coeff(inner, firstColumn + c, BroadcastRhs ? 0 : batch, -1);
+                    value[c] += Functor::mult(a, b);
+                }
+            }
+#pragma unroll
+            for (int c = 0; c < ColumnsPerThread; ++c) {
+                if (Columns % ColumnsPerThread != 0 && firstColumn + c >= Columns) break;
+                const Index idx = CUMAT_IS_COLUMN_MAJOR(internal::traits<M>::Flags)
+                    ? outer + rows * (firstColumn + c + Columns * batch)
+                    : firstColumn + c + Columns * (outer + rows * batch);
+                internal::CwiseAssignmentHandler<M, OutputScalar, Mode>::assign(output, value[c], idx);
+            }
+        CUMAT_KERNEL_2D_LOOP_END
+    }
+
+    //CSR Matrix-Matrix kernel (SpMM) for a row-major dense right hand side, lanes over columns.
+    //A group of ThreadsPerRow threads of a warp per row and batch, lane l handles the columns l, l+ThreadsPerRow, ...
+    //All lanes read the same matrix entry, the rows of the right hand side are read coalesced.
+    //Launched with CsrSpMMAlgorithmSelection::BLOCK_SIZE threads per block.
+    template <typename L, typename R, typename M, AssignmentMode Mode, int Columns, int ThreadsPerRow,
+        bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1,
+        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+    __global__ void CSRMMKernel_Lanes(Index rows, Index batches, const L matrix, const R right, M output)
+    {
+        typedef typename L::Scalar LeftScalar;
+        typedef typename R::Scalar RightScalar;
+        typedef typename M::Scalar OutputScalar;
+        typedef ProductElementFunctor<LeftScalar, RightScalar, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE> Functor;
+        constexpr int GroupsPerBlock = CsrSpMMAlgorithmSelection::BLOCK_SIZE / ThreadsPerRow;
+        constexpr int ColumnsPerLane = CUMAT_DIV_UP(Columns, ThreadsPerRow);
+        SparsityPattern<CSR>::IndexVector JA = matrix.getSparsityPattern().JA;
+        SparsityPattern<CSR>::IndexVector IA = matrix.getSparsityPattern().IA;
+        const int nnz = matrix.getSparsityPattern().nnz;
+        const int lane = threadIdx.x % ThreadsPerRow;
+        const int group = threadIdx.x / ThreadsPerRow;
+        for (Index index = Index(blockIdx.x) * GroupsPerBlock + group; index < rows * batches; index += Index(gridDim.x) * GroupsPerBlock)
+        {
+            const Index outer = index % rows;
+            const Index batch = index / rows;
+            const int start = JA.getRawCoeff(outer);
+            const int end = JA.getRawCoeff(outer + 1);
+            OutputScalar value[ColumnsPerLane];
+#pragma unroll
+            for (int j = 0; j < ColumnsPerLane; ++j) value[j] = OutputScalar(0);
+            for (int i = start; i < end; ++i)
+            {
+                const int inner = IA.getRawCoeff(i);
+                const LeftScalar a = BroadcastMatrix
+                    ? matrix.getSparseCoeff(outer, inner, 0, i)
+                    : matrix.getSparseCoeff(outer, inner, batch, i + batch * nnz);
+#pragma unroll
+                for (int j = 0; j < ColumnsPerLane; ++j) {
+                    const int c = lane + j * ThreadsPerRow;
+                    if (Columns % ThreadsPerRow != 0 && c >= Columns) break;
+                    RightScalar b = right.coeff(inner, c, BroadcastRhs ? 0 : batch, -1);
+                    value[j] += Functor::mult(a, b);
+                }
+            }
+#pragma unroll
+            for (int j = 0; j < ColumnsPerLane; ++j) {
+                const int c = lane + j * ThreadsPerRow;
+                if (Columns % ThreadsPerRow != 0 && c >= Columns) break;
+                const Index idx = CUMAT_IS_COLUMN_MAJOR(internal::traits<M>::Flags)
+                    ? outer + rows * (c + Columns * batch)
+                    : c + Columns * (outer + rows * batch);
+                internal::CwiseAssignmentHandler<M, OutputScalar, Mode>::assign(output, value[j], idx);
+            }
+        }
+    }
+
+    //atomic addition for the scatter kernels, complex numbers are updated per component
+    __device__ CUMAT_STRONG_INLINE void atomicAddScalar(int* address, int value) { atomicAdd(address, value); }
+    __device__ CUMAT_STRONG_INLINE void atomicAddScalar(float* address, float value) { atomicAdd(address, value); }
+    __device__ CUMAT_STRONG_INLINE void atomicAddScalar(double* address, double value) { atomicAdd(address, value); }
+    __device__ CUMAT_STRONG_INLINE void atomicAddScalar(cfloat* address, cfloat value)
+    {
+        float* a = reinterpret_cast<float*>(address);
+        atomicAdd(a, value.real());
+        atomicAdd(a + 1, value.imag());
+    }
+    __device__ CUMAT_STRONG_INLINE void atomicAddScalar(cdouble* address, cdouble value)
+    {
+        double* a = reinterpret_cast<double*>(address);
+        atomicAdd(a, value.real());
+        atomicAdd(a + 1, value.imag());
+    }
+
+    //Compressed Matrix-Vector kernel (scatter). One thread per outer index (row of a CSR matrix, column of a CSC matrix),
+    //the products with the entry of the vector at the outer index are added to the output at the inner indices with atomics.
+    //This computes the product with the transposed CSR matrix or with the non-transposed CSC matrix.
+    //The output is a dense column vector with 'outputRows' rows per batch and must be initialized.
+    template <typename L, typename R, typename OutputScalar, int Batches, bool Conjugate,
+        bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1,
+        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+    __global__ void CompressedScatterMVKernel_StaticBatches(dim3 virtual_size, const L matrix, const R vector, OutputScalar* output, Index outputRows)
+    {
+        typedef typename L::Scalar LeftScalar;
+        typedef typename R::Scalar RightScalar;
+        typedef ProductElementFunctor<LeftScalar, RightScalar, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE> Functor;
+        SparsityPattern<CSR>::IndexVector JA = matrix.getSparsityPattern().JA;
+        SparsityPattern<CSR>::IndexVector IA = matrix.getSparsityPattern().IA;
+        const int nnz = matrix.getSparsityPattern().nnz;
+        CUMAT_KERNEL_1D_LOOP(outer, virtual_size)
+            const int start = JA.getRawCoeff(outer);
+            const int end = JA.getRawCoeff(outer + 1);
+            if (start >= end) continue;
+            RightScalar x[Batches];
+#pragma unroll
+            for (int b = 0; b < Batches; ++b) {
+                x[b] = vector.coeff(outer, 0, BroadcastRhs ? 0 : b, -1);
+            }
+            for (int i = start; i < end; ++i)
+            {
+                const int inner = IA.getRawCoeff(i);
+#pragma unroll
+                for (int b = 0; b < Batches; ++b) {
+                    LeftScalar a = BroadcastMatrix
+                        ? matrix.getSparseCoeff(outer, inner, 0, i)
+                        : matrix.getSparseCoeff(outer, inner, b, i + b * nnz);
+                    a = internal::conjugateCoeff<LeftScalar, Conjugate>(a);
+                    atomicAddScalar(output + inner + b * outputRows, Functor::mult(a, x[b]));
+                }
+            }
+        CUMAT_KERNEL_1D_LOOP_END
+    }
+
+    //product of the entry i (row outer, column inner) of a CSR matrix with the matching entry of the vector in batch b
+    template <typename OutputScalar, bool BroadcastMatrix, bool BroadcastRhs, typename L, typename R>
+    __device__ CUMAT_STRONG_INLINE OutputScalar csrEntryProduct(const L& matrix, const R& vector, int outer, int inner, int i, int b, int nnz)
+    {
+        typedef ProductElementFunctor<typename L::Scalar, typename R::Scalar, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE> Functor;
+        const typename L::Scalar a = BroadcastMatrix
+            ? matrix.getSparseCoeff(outer, inner, 0, i)
+            : matrix.getSparseCoeff(outer, inner, b, i + b * nnz);
+        return Functor::mult(a, vector.coeff(inner, 0, BroadcastRhs ? 0 : b, -1));
+    }
+
+    //CSR Matrix-Vector kernel (vector). A group of ThreadsPerRow threads of a warp per row, the entries of a row are read coalesced.
+    //Launched with CsrSpMVAlgorithmSelection::BLOCK_SIZE threads per block.
+    template <typename L, typename R, typename M, AssignmentMode Mode, int Batches, int ThreadsPerRow,
+        bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1,
+        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+    __global__ void CSRMVKernel_Vector(Index rows, const L matrix, const R vector, M output)
+    {
+        typedef typename M::Scalar OutputScalar;
+        constexpr int GroupsPerBlock = CsrSpMVAlgorithmSelection::BLOCK_SIZE / ThreadsPerRow;
+        typedef cub::WarpReduce<OutputScalar, ThreadsPerRow> WarpReduceT;
+        __shared__ typename WarpReduceT::TempStorage temp_storage[GroupsPerBlock];
+
+        SparsityPattern<CSR>::IndexVector JA = matrix.getSparsityPattern().JA;
+        SparsityPattern<CSR>::IndexVector IA = matrix.getSparsityPattern().IA;
+        const int nnz = matrix.getSparsityPattern().nnz;
+        const int lane = threadIdx.x % ThreadsPerRow;
+        const int group = threadIdx.x / ThreadsPerRow;
+        //the loop condition is uniform within a group, all threads of a group take part in the reduction
+        for (Index outer = Index(blockIdx.x) * GroupsPerBlock + group; outer < rows; outer += Index(gridDim.x) * GroupsPerBlock)
+        {
+            const int start = JA.getRawCoeff(outer);
+            const int end = JA.getRawCoeff(outer + 1);
+            OutputScalar value[Batches];
+#pragma unroll
+            for (int b = 0; b < Batches; ++b) value[b] = OutputScalar(0);
+            for (int i = start + lane; i < end; i += ThreadsPerRow)
+            {
+                const int inner = IA.getRawCoeff(i);
+#pragma unroll
+                for (int b = 0; b < Batches; ++b)
+                    value[b] += csrEntryProduct<OutputScalar, BroadcastMatrix, BroadcastRhs>(matrix, vector, outer, inner, i, b, nnz);
+            }
+#pragma unroll
+            for (int b = 0; b < Batches; ++b) {
+                const OutputScalar sum = WarpReduceT(temp_storage[group]).Sum(value[b]);
+                if (lane == 0)
+                    internal::CwiseAssignmentHandler<M, OutputScalar, Mode>::assign(output, sum, outer + b * output.rows());
+            }
+        }
+    }
+
+    //CSR Matrix-Vector kernel (adaptive CSR-stream). One block per range of rows from CsrSpMVAlgorithmSelection::streamRowBlocks,
+    //launched with CsrSpMVAlgorithmSelection::BLOCK_SIZE threads per block.
+    //A block with several rows stages the products of all its entries in shared memory and one thread per row sums them up,
+    //a block with a single row reduces it with the whole block.
+    template <typename L, typename R, typename M, AssignmentMode Mode, int Batches,
+        bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1,
+        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+    __global__ void CSRMVKernel_Stream(const int* rowBlocks, const L matrix, const R vector, M output)
+    {
+        typedef typename M::Scalar OutputScalar;
+        constexpr int BlockSize = CsrSpMVAlgorithmSelection::BLOCK_SIZE;
+        typedef cub::BlockReduce<OutputScalar, BlockSize> BlockReduceT;
+        __shared__ typename BlockReduceT::TempStorage temp_storage;
+        __shared__ cub::Uninitialized<OutputScalar> products[CsrSpMVAlgorithmSelection::STREAM_NNZ_PER_BLOCK];
+
+        SparsityPattern<CSR>::IndexVector JA = matrix.getSparsityPattern().JA;
+        SparsityPattern<CSR>::IndexVector IA = matrix.getSparsityPattern().IA;
+        const int nnz = matrix.getSparsityPattern().nnz;
+        const int firstRow = rowBlocks[blockIdx.x];
+        const int lastRow = rowBlocks[blockIdx.x + 1];
+        const int start = JA.getRawCoeff(firstRow);
+        const int end = JA.getRawCoeff(lastRow);
+        for (int b = 0; b < Batches; ++b)
+        {
+            if (lastRow - firstRow > 1)
+            {
+                //SparseMatrix::getSparseCoeff only needs the linear index, the row is not known here
+                for (int i = start + threadIdx.x; i < end; i += BlockSize)
+                    products[i - start].Alias() = csrEntryProduct<OutputScalar, BroadcastMatrix, BroadcastRhs>(matrix, vector, -1, IA.getRawCoeff(i), i, b, nnz);
+                __syncthreads();
+                for (int outer = firstRow + threadIdx.x; outer < lastRow; outer += BlockSize)
+                {
+                    OutputScalar sum = OutputScalar(0);
+                    const int rowEnd = JA.getRawCoeff(outer + 1);
+                    for (int i = JA.getRawCoeff(outer); i < rowEnd; ++i)
+                        sum += products[i - start].Alias();
+                    internal::CwiseAssignmentHandler<M, OutputScalar, Mode>::assign(output, sum, outer + b * output.rows());
+                }
+            }
+            else
+            {
+                OutputScalar sum = OutputScalar(0);
+                for (int i = start + threadIdx.x; i < end; i += BlockSize)
+                    sum += csrEntryProduct<OutputScalar, BroadcastMatrix, BroadcastRhs>(matrix, vector, firstRow, IA.getRawCoeff(i), i, b, nnz);
+                sum = BlockReduceT(temp_storage).Sum(sum);
+                if (threadIdx.x == 0)
+                    internal::CwiseAssignmentHandler<M, OutputScalar, Mode>::assign(output, sum, firstRow + b * output.rows());
+            }
+            __syncthreads(); //the shared memory is reused in the next batch
+        }
+    }
+
+    //Searches the merge path of the row end offsets (JA[1..rows]) and the indices of the entries (0..nnz-1)
+    //for the coordinate (x=row, y=entry) on the specified diagonal, x+y=diagonal.
+    __device__ CUMAT_STRONG_INLINE void csrMergePathSearch(Index diagonal, const SparsityPattern<CSR>::IndexVector& JA,
+        Index rows, Index nnz, Index& x, Index& y)
+    {
+        Index xMin = diagonal > nnz ? diagonal - nnz : 0;
+        Index xMax = diagonal < rows ? diagonal : rows;
+        while (xMin < xMax)
+        {
+            const Index pivot = (xMin + xMax) / 2;
+            if (JA.getRawCoeff(pivot + 1) <= diagonal - pivot - 1)
+                xMin = pivot + 1;
+            else
+                xMax = pivot;
+        }
+        x = xMin;
+        y = diagonal - xMin;
+    }
+
+    //CSR Matrix-Vector kernel (merge-path). Every thread consumes MERGE_PATH_ITEMS_PER_THREAD rows plus entries, independent of the row lengths.
+    //Rows that are completed by a thread are written to the output (a dense column vector with 'rows' rows per batch),
+    //the partial sum of the row a thread ends in is stored in the carries and added by CSRMVKernel_MergePathFixup.
+    template <typename L, typename R, typename OutputScalar, int Batches,
+        bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1,
+        bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+    __global__ void CSRMVKernel_MergePath(dim3 virtual_size, const L matrix, const R vector, OutputScalar* output,
+        int* carryRows, OutputScalar* carryValues)
+    {
+        SparsityPattern<CSR>::IndexVector JA = matrix.getSparsityPattern().JA;
+        SparsityPattern<CSR>::IndexVector IA = matrix.getSparsityPattern().IA;
+        const Index rows = matrix.getSparsityPattern().rows;
+        const int nnz = matrix.getSparsityPattern().nnz;
+        const Index total = rows + nnz;
+        const Index numThreads = virtual_size.x;
+        CUMAT_KERNEL_1D_LOOP(thread, virtual_size)
+            Index diagonalStart = thread * CsrSpMVAlgorithmSelection::MERGE_PATH_ITEMS_PER_THREAD;
+            Index diagonalEnd = diagonalStart + CsrSpMVAlgorithmSelection::MERGE_PATH_ITEMS_PER_THREAD;
+            if (diagonalStart > total) diagonalStart = total;
+            if (diagonalEnd > total) diagonalEnd = total;
+            Index x, y;
+            csrMergePathSearch(diagonalStart, JA, rows, nnz, x, y);
+            OutputScalar value[Batches];
+#pragma unroll
+            for (int b = 0; b < Batches; ++b) value[b] = OutputScalar(0);
+            for (Index d = diagonalStart; d < diagonalEnd; ++d)
+            {
+                if (x < rows && y < JA.getRawCoeff(x + 1))
+                {
+                    //consume an entry
+                    const int inner = IA.getRawCoeff(y);
+#pragma unroll
+                    for (int b = 0; b < Batches; ++b)
+                        value[b] += csrEntryProduct<OutputScalar, BroadcastMatrix, BroadcastRhs>(matrix, vector, int(x), inner, int(y), b, nnz);
+                    ++y;
+                }
+                else
+                {
+                    //complete a row
+#pragma unroll
+                    for (int b = 0; b < Batches; ++b) {
+                        output[x + b * rows] = value[b];
+                        value[b] = OutputScalar(0);
+                    }
+                    ++x;
+                }
+            }
+            //x==rows marks an empty carry
+            carryRows[thread] = static_cast<int>(x);
+#pragma unroll
+            for (int b = 0; b < Batches; ++b)
+                carryValues[thread + b * numThreads] = value[b];
+        CUMAT_KERNEL_1D_LOOP_END
+    }
+
+    //Adds the carries of the merge-path kernel, reduced by row, to the output of one batch
+    template <typename OutputScalar>
+    __global__ void CSRMVKernel_MergePathFixup(dim3 virtual_size, const int* carryRows, const OutputScalar* carrySums,
+        const int* numCarries, OutputScalar* output, Index rows)
+    {
+        const int n = *numCarries;
+        CUMAT_KERNEL_1D_LOOP(i, virtual_size)
+            if (i < n && carryRows[i] < rows)
+                output[carryRows[i]] += carrySums[i];
+        CUMAT_KERNEL_1D_LOOP_END
+    }
+
     }
 
-    //CwiseSrcTag (Sparse) * CwiseSrcTag (Dense-Vector) -> DenseDstTag (Vector-Vector), sparse matrix-vector product
+    //CwiseSrcTag (Sparse) * CwiseSrcTag (Dense-Vector or Dense-Matrix) -> DenseDstTag, sparse matrix-vector product (SpMV) or sparse matrix-multivector product (SpMM)
     //Currently, only non-batched CSR matrices are supported
-    //TODO: support also CSC, vector on the left, transposed and conjugated versions
+    //CSC, transposed and adjoint matrices are handled by the specialization below
+    //TODO: support also vector on the left
     template<
         typename _Dst,// ProductArgOp _DstOp,
         typename _SrcLeftScalar, int _SrcLeftBatches,// ProductArgOp _SrcLeftOp,
@@ -108,14 +471,13 @@ namespace internal
         using Op = ProductOp<SrcLeft, _SrcRight, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE>;
         using Scalar = typename Op::Scalar;
 
-        CUMAT_STATIC_ASSERT((Op::ColumnsRight == 1),
-                "SparseMatrix - DenseVector product only supports column vectors as right argument, use batches instead");
+        CUMAT_STATIC_ASSERT((Op::ColumnsRight != Dynamic),
+                "SparseMatrix - DenseMatrix product only supports right arguments with a compile-time number of columns, use batches instead");
         CUMAT_STATIC_ASSERT((Op::Batches != Dynamic),
                 "SparseMatrix - DenseVector does only support compile-time fixed batch count");
 
         static void assign(_Dst& dst, const Op& op) {
             
-            typedef typename _Dst::Type DstActual;
             CUMAT_PROFILING_INC(EvalMatmulSparse);
             CUMAT_PROFILING_INC(EvalAny);
             if (dst.size() == 0) return;
@@ -124,18 +486,187 @@ namespace internal
             CUMAT_ASSERT(op.batches() == dst.batches());
             CUMAT_ASSERT(op.batches() == Op::Batches);
 
+            launch(dst, op, std::integral_constant<bool, Op::ColumnsRight == 1>());
+        }
+
+    private:
+        //sparse matrix - dense vector product (SpMV), the kernel is selected from the row analysis of the sparsity pattern
+        static void launch(_Dst& dst, const Op& op, std::integral_constant<bool, true> /*vector*/)
+        {
 			CUMAT_LOG_DEBUG("Evaluate SparseMatrix-DenseVector multiplication " << typeid(op.derived()).name()
 				<< " matrix rows=" << op.derived().left().rows() << ", cols=" << op.left().cols());;
 
-            //here is now the real logic
+            launchSelected(dst, op, std::integral_constant<bool, NumTraits<Scalar>::IsCudaNumeric>());
+            CUMAT_LOG_DEBUG("Evaluation done");
+        }
+
+        //custom scalar types (e.g. blocked types) always use the scalar kernel
+        static void launchSelected(_Dst& dst, const Op& op, std::integral_constant<bool, false> /*custom scalar*/)
+        {
+            launchScalar(dst, op);
+        }
+        static void launchSelected(_Dst& dst, const Op& op, std::integral_constant<bool, true> /*cuda numeric*/)
+        {
+            const CsrRowAnalysis& analysis = op.derived().left().getSparsityPattern().rowAnalysis();
+            switch (analysis.algorithm)
+            {
+            case CsrSpMVAlgorithm::Vector:
+                switch (analysis.threadsPerRow)
+                {
+                case 2: launchVector<2>(dst, op); break;
+                case 4: launchVector<4>(dst, op); break;
+                case 8: launchVector<8>(dst, op); break;
+                case 16: launchVector<16>(dst, op); break;
+                default: launchVector<32>(dst, op); break;
+                }
+                break;
+            case CsrSpMVAlgorithm::Stream:
+                launchStream(dst, op, analysis);
+                break;
+            case CsrSpMVAlgorithm::MergePath:
+                launchMergePath(dst, op);
+                break;
+            default:
+                launchScalar(dst, op);
+                break;
+            }
+        }
+
+        //one thread per row
+        static void launchScalar(_Dst& dst, const Op& op)
+        {
+            typedef typename _Dst::Type DstActual;
             Context& ctx = Context::current();
             KernelLaunchConfig cfg = ctx.createLaunchConfig1D(dst.rows(), kernels::CSRMVKernel_StaticBatches<SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::Batches>);
 			kernels::CSRMVKernel_StaticBatches<SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::Batches>
                 <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
                 (cfg.virtual_size, op.derived().left().derived(), op.derived().right().derived(), dst.derived());
             CUMAT_CHECK_ERROR();
+        }
+
+        //a group of threads per row
+        template<int ThreadsPerRow>
+        static void launchVector(_Dst& dst, const Op& op)
+        {
+            typedef typename _Dst::Type DstActual;
+            constexpr int BlockSize = CsrSpMVAlgorithmSelection::BLOCK_SIZE;
+            const unsigned int blocks = static_cast<unsigned int>(CUMAT_DIV_UP(dst.rows(), BlockSize / ThreadsPerRow));
+            kernels::CSRMVKernel_Vector<SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::Batches, ThreadsPerRow>
+                <<<blocks, BlockSize, 0, Context::current().stream() >>>
+                (dst.rows(), op.derived().left().derived(), op.derived().right().derived(), dst.derived());
+            CUMAT_CHECK_ERROR();
+        }
+
+        //one block per precomputed range of rows
+        static void launchStream(_Dst& dst, const Op& op, const CsrRowAnalysis& analysis)
+        {
+            typedef typename _Dst::Type DstActual;
+            const unsigned int blocks = static_cast<unsigned int>(analysis.streamRowBlocks.size() - 1);
+            kernels::CSRMVKernel_Stream<SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::Batches>
+                <<<blocks, CsrSpMVAlgorithmSelection::BLOCK_SIZE, 0, Context::current().stream() >>>
+                (analysis.streamRowBlocks.data(), op.derived().left().derived(), op.derived().right().derived(), dst.derived());
+            CUMAT_CHECK_ERROR();
+        }
+
+        //merge-path, the complete rows are written directly into the destination if possible, otherwise into a temporary
+        static void launchMergePath(_Dst& dst, const Op& op)
+        {
+            using DirectTag = std::integral_constant<bool,
+                (int(traits<_Dst>::AccessFlags) & int(AccessFlags::WriteDirect)) != 0 &&
+                _AssignmentMode == AssignmentMode::ASSIGN>;
+            mergePath(dst, op, DirectTag());
+        }
+        static void mergePath(_Dst& dst, const Op& op, std::integral_constant<bool, true> /*direct*/)
+        {
+            mergePathInto(dst.data(), op);
+        }
+        static void mergePath(_Dst& dst, const Op& op, std::integral_constant<bool, false> /*temporary*/)
+        {
+            typedef Matrix<Scalar, Dynamic, 1, Op::Batches, ColumnMajor> DstTmp;
+            DstTmp tmp(op.rows(), 1, op.batches());
+            mergePathInto(tmp.data(), op);
+            Assignment<_Dst, DstTmp, _AssignmentMode, DenseDstTag, CwiseSrcTag>::assign(dst, tmp);
+        }
+        static void mergePathInto(Scalar* output, const Op& op)
+        {
+            typedef typename _SrcRight::Type SrcRightActual;
+            typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IntVector;
+            typedef Matrix<Scalar, Dynamic, 1, 1, ColumnMajor> ScalarVector;
+            const SrcLeft& matrix = op.derived().left().derived();
+            const Index rows = matrix.rows();
+            const Index numThreads = CsrSpMVAlgorithmSelection::mergePathThreads(rows, matrix.getSparsityPattern().nnz);
+            Context& ctx = Context::current();
+
+            //complete rows and carries
+            IntVector carryRows(numThreads);
+            ScalarVector carryValues(numThreads * Op::Batches);
+            KernelLaunchConfig cfg = ctx.createLaunchConfig1D(numThreads, kernels::CSRMVKernel_MergePath<SrcLeft, SrcRightActual, Scalar, Op::Batches>);
+            kernels::CSRMVKernel_MergePath<SrcLeft, SrcRightActual, Scalar, Op::Batches>
+                <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+                (cfg.virtual_size, matrix, op.derived().right().derived(), output, carryRows.data(), carryValues.data());
+            CUMAT_CHECK_ERROR();
+
+            //reduce the carries by row (consecutive threads can end in the same long row) and add them
+            IntVector uniqueRows(numThreads);
+            ScalarVector carrySums(numThreads);
+            IntVector numCarries(1);
+            size_t temp_storage_bytes = 0;
+            CUMAT_SAFE_CALL(cub::DeviceReduce::ReduceByKey(NULL, temp_storage_bytes, carryRows.data(), uniqueRows.data(),
+                carryValues.data(), carrySums.data(), numCarries.data(), cub::Sum(), int(numThreads), ctx.stream()));
+            DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+            KernelLaunchConfig cfgFixup = ctx.createLaunchConfig1D(numThreads, kernels::CSRMVKernel_MergePathFixup<Scalar>);
+            for (Index b = 0; b < Op::Batches; ++b)
+            {
+                CUMAT_SAFE_CALL(cub::DeviceReduce::ReduceByKey(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+                    carryRows.data(), uniqueRows.data(), carryValues.data() + b * numThreads, carrySums.data(), numCarries.data(),
+                    cub::Sum(), int(numThreads), ctx.stream()));
+                kernels::CSRMVKernel_MergePathFixup<Scalar>
+                    <<<cfgFixup.block_count, cfgFixup.thread_per_block, 0, ctx.stream() >>>
+                    (cfgFixup.virtual_size, uniqueRows.data(), carrySums.data(), numCarries.data(), output + b * rows, rows);
+                CUMAT_CHECK_ERROR();
+            }
+        }
+
+        //sparse matrix - dense multi-vector product (SpMM), every loaded matrix entry is reused for several columns.
+        //The thread mapping is selected from the number of columns and the storage order of the right hand side, see CsrSpMMAlgorithmSelection
+        static void launch(_Dst& dst, const Op& op, std::integral_constant<bool, false> /*multi-vector*/)
+        {
+            typedef typename _SrcRight::Type SrcRightActual;
+            CUMAT_LOG_DEBUG("Evaluate SparseMatrix-DenseMatrix multiplication " << typeid(op.derived()).name()
+                << " matrix rows=" << op.derived().left().rows() << ", cols=" << op.left().cols() << ", right cols=" << op.cols());
+
+            launchMM(dst, op, std::integral_constant<bool, CsrSpMMAlgorithmSelection::useLanes(
+                Op::ColumnsRight, CUMAT_IS_ROW_MAJOR(traits<SrcRightActual>::Flags) != 0)>());
             CUMAT_LOG_DEBUG("Evaluation done");
         }
+
+        //one thread per row and tile of columns
+        static void launchMM(_Dst& dst, const Op& op, std::integral_constant<bool, false> /*row per thread*/)
+        {
+            typedef typename _Dst::Type DstActual;
+            constexpr int ColumnsPerThread = CsrSpMMAlgorithmSelection::columnsPerThread(Op::ColumnsRight, false);
+            constexpr int Tiles = CsrSpMMAlgorithmSelection::columnTiles(Op::ColumnsRight);
+            Context& ctx = Context::current();
+            KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(dst.rows() * Tiles), dst.batches(),
+                kernels::CSRMMKernel_StaticColumns<SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::ColumnsRight, ColumnsPerThread>);
+            kernels::CSRMMKernel_StaticColumns<SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::ColumnsRight, ColumnsPerThread>
+                <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+                (cfg.virtual_size, op.derived().left().derived(), op.derived().right().derived(), dst.derived());
+            CUMAT_CHECK_ERROR();
+        }
+
+        //a group of threads per row, the lanes split the columns
+        static void launchMM(_Dst& dst, const Op& op, std::integral_constant<bool, true> /*lanes over columns*/)
+        {
+            typedef typename _Dst::Type DstActual;
+            constexpr int BlockSize = CsrSpMMAlgorithmSelection::BLOCK_SIZE;
+            constexpr int ThreadsPerRow = CsrSpMMAlgorithmSelection::threadsPerRow(Op::ColumnsRight);
+            const unsigned int blocks = static_cast<unsigned int>(CUMAT_DIV_UP(dst.rows() * dst.batches(), BlockSize / ThreadsPerRow));
+            kernels::CSRMMKernel_Lanes<SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::ColumnsRight, ThreadsPerRow>
+                <<<blocks, BlockSize, 0, Context::current().stream() >>>
+                (dst.rows(), dst.batches(), op.derived().left().derived(), op.derived().right().derived(), dst.derived());
+            CUMAT_CHECK_ERROR();
+        }
     };
 
     //CwiseSrcTag (SparseExpressionOp) * CwiseSrcTag (Dense-Vector) -> DenseDstTag (Vector-Vector), sparse matrix-vector product
@@ -188,6 +719,108 @@ namespace internal
 
 
 
+    //CwiseSrcTag (CSR or CSC SparseMatrix, optionally transposed or adjoint) * CwiseSrcTag (Dense-Vector) -> DenseDstTag, sparse matrix-vector product
+    //The product with a transposed CSR matrix or a non-transposed CSC matrix scatters the entries of every outer index into the result with atomics,
+    //the product with a transposed CSC matrix gathers like the non-transposed CSR product.
+    //Both work on the existing storage, no transposed copy of the matrix is created.
+    //The non-transposed CSR product is handled by the specialization above.
+    template<
+        typename _Dst,
+        typename _SrcLeftScalar, int _SrcLeftBatches, int _SrcLeftSparseFlags, ProductArgOp _SrcLeftOp,
+        typename _SrcRight,
+        AssignmentMode _AssignmentMode
+    >
+    struct ProductAssignment<
+        _Dst, DenseDstTag, ProductArgOp::NONE,
+        SparseMatrix<_SrcLeftScalar, _SrcLeftBatches, _SrcLeftSparseFlags>, CwiseSrcTag, _SrcLeftOp,
+        _SrcRight, CwiseSrcTag, ProductArgOp::NONE,
+        _AssignmentMode>
+    {
+        using SrcLeft = SparseMatrix<_SrcLeftScalar, _SrcLeftBatches, _SrcLeftSparseFlags>;
+        using Op = ProductOp<SrcLeft, _SrcRight, _SrcLeftOp, ProductArgOp::NONE, ProductArgOp::NONE>;
+        using Scalar = typename Op::Scalar;
+        enum
+        {
+            Conjugate = Op::ConjugateLeft,
+            Scatter = (_SrcLeftSparseFlags == SparseFlags::CSR) == bool(Op::TransposedLeft)
+        };
+
+        CUMAT_STATIC_ASSERT(_SrcLeftSparseFlags != SparseFlags::ELLPACK && _SrcLeftSparseFlags != SparseFlags::SELLCS,
+            "ELLPACK and SELL-C-sigma matrices only support the non-transposed product with a vector");
+        CUMAT_STATIC_ASSERT((Op::ColumnsRight == 1),
+            "The product with a transposed or CSC SparseMatrix only supports column vectors as right argument");
+        CUMAT_STATIC_ASSERT((Op::Batches != Dynamic),
+            "SparseMatrix - DenseVector does only support compile-time fixed batch count");
+
+        static void assign(_Dst& dst, const Op& op) {
+
+            CUMAT_PROFILING_INC(EvalMatmulSparse);
+            CUMAT_PROFILING_INC(EvalAny);
+            if (dst.size() == 0) return;
+            CUMAT_ASSERT(op.rows() == dst.rows());
+            CUMAT_ASSERT(op.cols() == dst.cols());
+            CUMAT_ASSERT(op.batches() == dst.batches());
+            CUMAT_ASSERT(op.batches() == Op::Batches);
+
+            CUMAT_LOG_DEBUG("Evaluate " << (Op::TransposedLeft ? "transposed " : "") << (_SrcLeftSparseFlags == SparseFlags::CSR ? "CSR" : "CSC")
+                << " SparseMatrix-DenseVector multiplication " << typeid(op.derived()).name()
+                << " matrix rows=" << op.derived().left().rows() << ", cols=" << op.left().cols());
+            launch(dst, op, std::integral_constant<bool, Scatter>());
+            CUMAT_LOG_DEBUG("Evaluation done");
+        }
+
+    private:
+        //gather, one thread per row of the result
+        static void launch(_Dst& dst, const Op& op, std::integral_constant<bool, false> /*gather*/)
+        {
+            typedef typename _Dst::Type DstActual;
+            typedef typename _SrcRight::Type SrcRightActual;
+            Context& ctx = Context::current();
+            KernelLaunchConfig cfg = ctx.createLaunchConfig1D(dst.rows(), kernels::CSRMVKernel_StaticBatches<SrcLeft, SrcRightActual, DstActual, _AssignmentMode, Op::Batches,
+                _SrcLeftBatches == 1, internal::traits<SrcRightActual>::BatchesAtCompileTime == 1, Conjugate>);
+            kernels::CSRMVKernel_StaticBatches<SrcLeft, SrcRightActual, DstActual, _AssignmentMode, Op::Batches,
+                _SrcLeftBatches == 1, internal::traits<SrcRightActual>::BatchesAtCompileTime == 1, Conjugate>
+                <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+                (cfg.virtual_size, op.derived().left().derived(), op.derived().right().derived(), dst.derived());
+            CUMAT_CHECK_ERROR();
+        }
+
+        //scatter, one thread per outer index of the matrix
+        static void launch(_Dst& dst, const Op& op, std::integral_constant<bool, true> /*scatter*/)
+        {
+            //accumulate directly into the destination if possible, otherwise into a temporary
+            using DirectTag = std::integral_constant<bool,
+                (int(traits<_Dst>::AccessFlags) & int(AccessFlags::WriteDirect)) != 0 &&
+                (_AssignmentMode == AssignmentMode::ASSIGN || _AssignmentMode == AssignmentMode::ADD)>;
+            scatter(dst, op, DirectTag());
+        }
+        static void scatter(_Dst& dst, const Op& op, std::integral_constant<bool, true> /*direct*/)
+        {
+            if (_AssignmentMode == AssignmentMode::ASSIGN) dst.setZero();
+            scatterInto(dst.data(), op);
+        }
+        static void scatter(_Dst& dst, const Op& op, std::integral_constant<bool, false> /*temporary*/)
+        {
+            typedef Matrix<Scalar, Dynamic, 1, Op::Batches, ColumnMajor> DstTmp;
+            DstTmp tmp(op.rows(), 1, op.batches());
+            tmp.setZero();
+            scatterInto(tmp.data(), op);
+            Assignment<_Dst, DstTmp, _AssignmentMode, DenseDstTag, CwiseSrcTag>::assign(dst, tmp);
+        }
+        static void scatterInto(Scalar* output, const Op& op)
+        {
+            typedef typename _SrcRight::Type SrcRightActual;
+            const SrcLeft& matrix = op.derived().left().derived();
+            Context& ctx = Context::current();
+            KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(matrix.outerSize()),
+                kernels::CompressedScatterMVKernel_StaticBatches<SrcLeft, SrcRightActual, Scalar, Op::Batches, Conjugate>);
+            kernels::CompressedScatterMVKernel_StaticBatches<SrcLeft, SrcRightActual, Scalar, Op::Batches, Conjugate>
+                <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+                (cfg.virtual_size, matrix, op.derived().right().derived(), output, op.rows());
+            CUMAT_CHECK_ERROR();
+        }
+    };
+
 	namespace kernels
 	{
 		//ELLPACK Matrix-Vector kernel. One thread per row
@@ -322,9 +955,229 @@ namespace internal
 			CUMAT_LOG_DEBUG("Evaluation done");
 		}
 	};
+
+	namespace kernels
+	{
+		//SELL-C-sigma Matrix-Vector kernel. One thread per sorted row position, the result is written to the original row
+		template <typename L, typename R, typename M, AssignmentMode Mode, int Batches,
+			bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1,
+			bool BroadcastRhs = internal::traits<R>::BatchesAtCompileTime == 1>
+			__global__ void SELLCSMVKernel_StaticBatches(dim3 virtual_size, const L matrix, const R vector, M output)
+		{
+			typedef typename L::Scalar LeftScalar;
+			typedef typename R::Scalar RightScalar;
+			typedef typename M::Scalar OutputScalar;
+			typedef ProductElementFunctor<LeftScalar, RightScalar, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE> Functor;
+			const int* sliceOffsets = matrix.getSparsityPattern().sliceOffsets.data();
+			const int* IA = matrix.getSparsityPattern().IA.data();
+			const int* permutation = matrix.getSparsityPattern().permutation.data();
+			const int sliceHeight = static_cast<int>(matrix.getSparsityPattern().sliceHeight);
+			const Index nnz = matrix.getSparsityPattern().nnz;
+			CUMAT_KERNEL_1D_LOOP(position, virtual_size)
+				const int row = permutation[position];
+				if (row < 0) continue; //empty position of the last slice
+				const int slice = static_cast<int>(position) / sliceHeight;
+				const int start = sliceOffsets[slice] + static_cast<int>(position) % sliceHeight;
+				const int end = sliceOffsets[slice + 1];
+				OutputScalar value[Batches];
+#pragma unroll
+				for (int b = 0; b < Batches; ++b) value[b] = OutputScalar();
+				for (int i = start; i < end; i += sliceHeight) {
+					int col = IA[i];
+					if (col < 0) break; //the remaining entries of this row are padding
+#pragma unroll
+					for (int b = 0; b < Batches; ++b) {
+						LeftScalar tmp1 = BroadcastMatrix
+							? matrix.getSparseCoeff(row, col, 0, i)
+							: matrix.getSparseCoeff(row, col, b, i + b*nnz);
+						RightScalar tmp2 = vector.coeff(col, 0, BroadcastRhs ? 0 : b, -1);
+						OutputScalar tmp3 = Functor::mult(tmp1, tmp2);
+						value[b] += tmp3;
+					}
+				}
+#pragma unroll
+				for (int b = 0; b < Batches; ++b) {
+					internal::CwiseAssignmentHandler<M, OutputScalar, Mode>::assign(output, value[b], row + b * output.rows());
+				}
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+	}
+
+	//CwiseSrcTag (Sparse) * CwiseSrcTag (Dense-Vector) -> DenseDstTag (Vector-Vector), sparse matrix-vector product
+	//SELL-C-sigma, for SparseMatrix and SparseExpressionOp
+	template<
+		typename _Dst,
+		typename _SrcLeft,
+		typename _SrcRight,
+		AssignmentMode _AssignmentMode
+	>
+	struct SELLCSProductAssignment
+	{
+		using Op = ProductOp<_SrcLeft, _SrcRight, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE>;
+		using Scalar = typename Op::Scalar;
+
+		CUMAT_STATIC_ASSERT((Op::ColumnsRight == 1),
+			"SparseMatrix - DenseVector product only supports column vectors as right argument, use batches instead");
+		CUMAT_STATIC_ASSERT((Op::Batches != Dynamic),
+			"SparseMatrix - DenseVector does only support compile-time fixed batch count");
+
+		static void assign(_Dst& dst, const Op& op) {
+
+			typedef typename _Dst::Type DstActual;
+			CUMAT_PROFILING_INC(EvalMatmulSparse);
+			CUMAT_PROFILING_INC(EvalAny);
+			if (dst.size() == 0) return;
+			CUMAT_ASSERT(op.rows() == dst.rows());
+			CUMAT_ASSERT(op.cols() == dst.cols());
+			CUMAT_ASSERT(op.batches() == dst.batches());
+			CUMAT_ASSERT(op.batches() == Op::Batches);
+
+			CUMAT_LOG_DEBUG("Evaluate SELL-C-sigma SparseMatrix-DenseVector multiplication " << typeid(op.derived()).name()
+				<< " matrix rows=" << op.derived().left().rows() << ", cols=" << op.left().cols());
+
+			const auto& pattern = op.derived().left().derived().getSparsityPattern();
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(pattern.numSlices() * pattern.sliceHeight),
+				kernels::SELLCSMVKernel_StaticBatches<_SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::Batches>);
+			kernels::SELLCSMVKernel_StaticBatches<_SrcLeft, typename _SrcRight::Type, DstActual, _AssignmentMode, Op::Batches>
+				<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+				(cfg.virtual_size, op.derived().left().derived(), op.derived().right().derived(), dst.derived());
+			CUMAT_CHECK_ERROR();
+			CUMAT_LOG_DEBUG("Evaluation done");
+		}
+	};
+
+	template<
+		typename _Dst,
+		typename _SrcLeftScalar, int _SrcLeftBatches,
+		typename _SrcRight,
+		AssignmentMode _AssignmentMode
+	>
+	struct ProductAssignment<
+		_Dst, DenseDstTag, ProductArgOp::NONE,
+		SparseMatrix<_SrcLeftScalar, _SrcLeftBatches, SparseFlags::SELLCS>, CwiseSrcTag, ProductArgOp::NONE,
+		_SrcRight, CwiseSrcTag, ProductArgOp::NONE,
+		_AssignmentMode>
+		: SELLCSProductAssignment<_Dst, SparseMatrix<_SrcLeftScalar, _SrcLeftBatches, SparseFlags::SELLCS>, _SrcRight, _AssignmentMode>
+	{};
+
+	template<
+		typename _Dst,
+		typename _SrcLeftChild,
+		typename _SrcRight,
+		AssignmentMode _AssignmentMode
+	>
+	struct ProductAssignment<
+		_Dst, DenseDstTag, ProductArgOp::NONE,
+		SparseExpressionOp<_SrcLeftChild, SparseFlags::SELLCS>, CwiseSrcTag, ProductArgOp::NONE,
+		_SrcRight, CwiseSrcTag, ProductArgOp::NONE,
+		_AssignmentMode>
+		: SELLCSProductAssignment<_Dst, SparseExpressionOp<_SrcLeftChild, SparseFlags::SELLCS>, _SrcRight, _AssignmentMode>
+	{};
+
+	namespace kernels
+	{
+		//CSR Matrix-Vector kernel that skips the batches that have converged (convergedAt[b]>=0). One thread per row
+		template <typename L, typename _VectorScalar, int Batches,
+			bool BroadcastMatrix = internal::traits<L>::BatchesAtCompileTime == 1>
+		__global__ void CSRMVKernel_MaskedBatches(dim3 virtual_size, const L matrix, const _VectorScalar* vector, Index vectorRows,
+			_VectorScalar* output, const int* convergedAt)
+		{
+			typedef typename L::Scalar LeftScalar;
+			typedef ProductElementFunctor<LeftScalar, _VectorScalar, ProductArgOp::NONE, ProductArgOp::NONE, ProductArgOp::NONE> Functor;
+			SparsityPattern<CSR>::IndexVector JA = matrix.getSparsityPattern().JA;
+			SparsityPattern<CSR>::IndexVector IA = matrix.getSparsityPattern().IA;
+			const int nnz = matrix.getSparsityPattern().nnz;
+			const Index rows = virtual_size.x;
+			bool active[Batches];
+#pragma unroll
+			for (int b = 0; b < Batches; ++b) active[b] = convergedAt[b] < 0;
+			CUMAT_KERNEL_1D_LOOP(outer, virtual_size)
+				int start = JA.getRawCoeff(outer);
+				int end = JA.getRawCoeff(outer + 1);
+				if (start >= end) continue;
+				int inner = IA.getRawCoeff(start);
+				_VectorScalar value[Batches];
+#pragma unroll
+				for (int b = 0; b < Batches; ++b) {
+					if (!active[b]) continue;
+					LeftScalar tmp1 = BroadcastMatrix
+						? matrix.getSparseCoeff(outer, inner, 0, start)
+						: matrix.getSparseCoeff(outer, inner, b, start + b * nnz);
+					value[b] = Functor::mult(tmp1, vector[inner + b * vectorRows]);
+				}
+				for (int i = start + 1; i < end; ++i)
+				{
+					inner = IA.getRawCoeff(i);
+#pragma unroll
+					for (int b = 0; b < Batches; ++b) {
+						if (!active[b]) continue;
+						LeftScalar tmp1 = BroadcastMatrix
+							? matrix.getSparseCoeff(outer, inner, 0, i)
+							: matrix.getSparseCoeff(outer, inner, b, i + b * nnz);
+						value[b] += Functor::mult(tmp1, vector[inner + b * vectorRows]);
+					}
+				}
+#pragma unroll
+				for (int b = 0; b < Batches; ++b) {
+					if (active[b]) output[outer + b * rows] = value[b];
+				}
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+	}
+
+	/**
+	 * \brief Masked matrix-vector product of the iterative solvers for the CSR SparseMatrix:
+	 * the matrix entries and vector entries of batches that have converged are not loaded.
+	 */
+	template<typename _Scalar, int _Batches>
+	struct MaskedMatrixVectorProduct<SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> >
+	{
+		using MatrixType = SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>;
+
+		template<typename _Vector, int _VectorBatches>
+		static void eval(const MatrixType& matrix, const _Vector& x, _Vector& out,
+			const Matrix<int, 1, 1, _VectorBatches, 0>& convergedAt)
+		{
+			CUMAT_STATIC_ASSERT(_VectorBatches != Dynamic, "The masked product requires a compile-time batch count");
+			typedef typename _Vector::Scalar VectorScalar;
+			CUMAT_PROFILING_INC(EvalMatmulSparse);
+			CUMAT_PROFILING_INC(EvalAny);
+			if (out.size() == 0) return;
+			CUMAT_ASSERT(matrix.rows() == out.rows());
+			CUMAT_ASSERT(matrix.cols() == x.rows());
+			CUMAT_ASSERT(x.batches() == _VectorBatches);
+			CUMAT_ASSERT(matrix.batches() == 1 || matrix.batches() == _VectorBatches);
+
+			Context& ctx = Context::current();
+			KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(out.rows()),
+				kernels::CSRMVKernel_MaskedBatches<MatrixType, VectorScalar, _VectorBatches>);
+			kernels::CSRMVKernel_MaskedBatches<MatrixType, VectorScalar, _VectorBatches>
+				<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+				(cfg.virtual_size, matrix, x.data(), x.rows(), out.data(), convergedAt.data());
+			CUMAT_CHECK_ERROR();
+		}
+	};
 #endif
 }
 
+/**
+ * \brief Performs the sparse matrix-vector multiplication <tt>y = A^H * x</tt>.
+ * This is a specialization for the adjoint of a CSR or CSC SparseMatrix,
+ * it is evaluated on the storage of \c A without creating the adjoint matrix.
+ * (The transposed matrix is already captured by the generic overload for \ref TransposeOp.)
+ * \param left the adjoint sparse matrix
+ * \param right the dense vector
+ * \return the matrix-vector product
+ */
+template<typename _Scalar, int _Batches, int _SparseFlags, typename _Right>
+ProductOp<SparseMatrix<_Scalar, _Batches, _SparseFlags>, _Right, internal::ProductArgOp::ADJOINT, internal::ProductArgOp::NONE, internal::ProductArgOp::NONE>
+operator*(const TransposeOp<SparseMatrix<_Scalar, _Batches, _SparseFlags>, true>& left, const MatrixBase<_Right>& right)
+{
+    return ProductOp<SparseMatrix<_Scalar, _Batches, _SparseFlags>, _Right, internal::ProductArgOp::ADJOINT, internal::ProductArgOp::NONE,
+        internal::ProductArgOp::NONE>(left.getUnderlyingMatrix(), right);
+}
+
 CUMAT_NAMESPACE_END
 
 #endif
\ No newline at end of file
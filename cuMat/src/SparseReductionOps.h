@@ -0,0 +1,325 @@
+#ifndef __CUMAT_SPARSE_REDUCTION_OPS_H__
+#define __CUMAT_SPARSE_REDUCTION_OPS_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Constants.h"
+#include "SparseMatrix.h"
+#include "UnaryOps.h"
+#include "BinaryOps.h"
+#include "ReductionOps.h"
+#include "SegmentedReductionOps.h"
+#include "SparseProductEvaluation.h"
+
+#include <type_traits>
+
+CUMAT_NAMESPACE_BEGIN
+
+/**
+ * \brief Reduces the non-zero entries of every outer index (rows for CSR, columns for CSC) of a sparse matrix.
+ * This only touches the stored entries, the implicit zeros are not included.
+ * E.g. for CSR, <tt>segmentedReduce(A, functor::Sum<float>(), 0.0f)</tt> computes the row sums,
+ * for CSC the column sums.
+ *
+ * \param m the sparse matrix in CSR or CSC format
+ * \param op the reduction operator, e.g. functor::Sum
+ * \param initial the initial value, must be the neutral element of the operator
+ * \tparam _Algorithm the algorithm, see segmentedReduce(const MatrixBase<_Values>&, const Matrix<int, Dynamic, 1, 1, ColumnMajor>&, const _Op&, const typename internal::traits<_Values>::Scalar&)
+ * \return a (batched) column vector of size \c m.outerSize()
+ */
+template <typename _Algorithm = ReductionAlg::Auto, typename _Scalar, int _Batches, int _SparseFlags, typename _Op>
+Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor>
+segmentedReduce(const SparseMatrix<_Scalar, _Batches, _SparseFlags>& m, const _Op& op, const _Scalar& initial)
+{
+	CUMAT_STATIC_ASSERT(_SparseFlags == SparseFlags::CSR || _SparseFlags == SparseFlags::CSC,
+		"Segmented reductions are only supported for CSR and CSC matrices");
+	return segmentedReduce<_Algorithm>(m.getData(), m.getSparsityPattern().JA, op, initial);
+}
+
+namespace internal
+{
+	/**
+	 * \brief Tests if the sum over an expression can be computed from the stored entries of a CSR or CSC matrix only:
+	 * the sparse matrix itself, unary functors that map zero to zero (absolute value, squared absolute value, negation)
+	 * and component-wise products of two such expressions (the patterns are compared at runtime).
+	 * \c SFlags is the sparse format of the matrices.
+	 */
+	template<typename _Input>
+	struct IsSparseReductionSource
+	{
+		enum { value = false, SFlags = -1 };
+	};
+	template<typename _Scalar, int _Batches, int _SparseFlags>
+	struct IsSparseReductionSource<SparseMatrix<_Scalar, _Batches, _SparseFlags>>
+	{
+		enum { value = _SparseFlags == SparseFlags::CSR || _SparseFlags == SparseFlags::CSC, SFlags = _SparseFlags };
+	};
+
+	template<typename _Functor> struct IsZeroPreservingFunctor : std::false_type {};
+	template<typename _Scalar> struct IsZeroPreservingFunctor<functor::UnaryMathFunctor_cwiseAbs<_Scalar>> : std::true_type {};
+	template<typename _Scalar> struct IsZeroPreservingFunctor<functor::UnaryMathFunctor_cwiseAbs2<_Scalar>> : std::true_type {};
+	template<typename _Scalar> struct IsZeroPreservingFunctor<functor::UnaryMathFunctor_cwiseNegate<_Scalar>> : std::true_type {};
+	template<typename _Scalar> struct IsZeroPreservingFunctor<functor::BinaryMathFunctor_cwiseMul<_Scalar>> : std::true_type {};
+	template<typename _Scalar> struct IsZeroPreservingFunctor<functor::BinaryMathFunctor_cwiseDot<_Scalar>> : std::true_type {};
+
+	template<typename _Child, typename _Functor>
+	struct IsSparseReductionSource<UnaryOp<_Child, _Functor>>
+	{
+		enum { value = IsSparseReductionSource<_Child>::value && IsZeroPreservingFunctor<_Functor>::value, SFlags = IsSparseReductionSource<_Child>::SFlags };
+	};
+	template<typename _Left, typename _Right, typename _Functor>
+	struct IsSparseReductionSource<BinaryOp<_Left, _Right, _Functor>>
+	{
+		enum
+		{
+			value = IsSparseReductionSource<_Left>::value && IsSparseReductionSource<_Right>::value && IsZeroPreservingFunctor<_Functor>::value
+				&& int(IsSparseReductionSource<_Left>::SFlags) == int(IsSparseReductionSource<_Right>::SFlags),
+			SFlags = IsSparseReductionSource<_Left>::SFlags
+		};
+	};
+
+	/**
+	 * \brief Provides the sparsity pattern and the values of the stored entries of a sparse reduction source,
+	 * only defined if IsSparseReductionSource is true.
+	 * The values are a (batched) column vector expression with one entry per stored entry.
+	 */
+	template<typename _Input>
+	struct SparseReductionSource;
+
+	template<typename _Scalar, int _Batches, int _SparseFlags>
+	struct SparseReductionSource<SparseMatrix<_Scalar, _Batches, _SparseFlags>>
+	{
+		typedef SparseMatrix<_Scalar, _Batches, _SparseFlags> Input;
+		typedef typename Input::DataMatrix Values;
+		static const SparsityPattern<_SparseFlags>& pattern(const Input& in) { return in.getSparsityPattern(); }
+		static bool sharedPattern(const Input& in) { return true; }
+		static Values values(const Input& in) { return in.getData(); }
+	};
+	template<typename _Child, typename _Functor>
+	struct SparseReductionSource<UnaryOp<_Child, _Functor>>
+	{
+		typedef UnaryOp<_Child, _Functor> Input;
+		typedef SparseReductionSource<_Child> ChildSource;
+		typedef UnaryOp<typename ChildSource::Values, _Functor> Values;
+		static const auto& pattern(const Input& in) { return ChildSource::pattern(in.getUnderlyingMatrix()); }
+		static bool sharedPattern(const Input& in) { return ChildSource::sharedPattern(in.getUnderlyingMatrix()); }
+		static Values values(const Input& in) { return Values(ChildSource::values(in.getUnderlyingMatrix()), in.getFunctor()); }
+	};
+	template<typename _Left, typename _Right, typename _Functor>
+	struct SparseReductionSource<BinaryOp<_Left, _Right, _Functor>>
+	{
+		typedef BinaryOp<_Left, _Right, _Functor> Input;
+		typedef SparseReductionSource<_Left> LeftSource;
+		typedef SparseReductionSource<_Right> RightSource;
+		typedef BinaryOp<typename LeftSource::Values, typename RightSource::Values, _Functor> Values;
+		static const auto& pattern(const Input& in) { return LeftSource::pattern(in.getLeftMatrix()); }
+		//both operands must store their values in the same order
+		static bool sharedPattern(const Input& in)
+		{
+			const auto& l = LeftSource::pattern(in.getLeftMatrix());
+			const auto& r = RightSource::pattern(in.getRightMatrix());
+			return LeftSource::sharedPattern(in.getLeftMatrix()) && RightSource::sharedPattern(in.getRightMatrix())
+				&& l.nnz == r.nnz && l.JA.data() == r.JA.data() && l.IA.data() == r.IA.data();
+		}
+		static Values values(const Input& in)
+		{
+			return Values(LeftSource::values(in.getLeftMatrix()), RightSource::values(in.getRightMatrix()), in.getFunctor());
+		}
+	};
+
+	//the types that support atomicAddScalar
+	template<typename _Scalar> struct SupportsSparseScatter : std::integral_constant<bool,
+		std::is_same<_Scalar, int>::value || std::is_same<_Scalar, float>::value || std::is_same<_Scalar, double>::value
+		|| std::is_same<_Scalar, cfloat>::value || std::is_same<_Scalar, cdouble>::value> {};
+
+#if CUMAT_NVCC==1
+	namespace kernels
+	{
+		//adds every stored entry to the entry of its inner index (column of a CSR matrix), batches are kept or summed up
+		template<typename _Values, typename _Scalar>
+		__global__ void SparseInnerReductionKernel(dim3 virtual_size, const _Values values, const int* IA, Index innerSize, bool reduceBatches, _Scalar* output)
+		{
+			CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+				atomicAddScalar(output + IA[i] + (reduceBatches ? 0 : batch * innerSize), values.coeff(i, 0, batch, -1));
+			CUMAT_KERNEL_2D_LOOP_END
+		}
+
+		//writes the stored entries into a zero-initialized dense column-major matrix
+		template<typename _Scalar, bool CSR>
+		__global__ void SparseScatterToDenseKernel(dim3 virtual_size, const _Scalar* values, const int* outerIndices, const int* IA, Index rows, _Scalar* output)
+		{
+			CUMAT_KERNEL_1D_LOOP(i, virtual_size)
+				const Index row = CSR ? outerIndices[i] : IA[i];
+				const Index col = CSR ? IA[i] : outerIndices[i];
+				output[row + rows * col] = values[i];
+			CUMAT_KERNEL_1D_LOOP_END
+		}
+	}
+
+	/**
+	 * \brief The cases of the sum over the stored entries of a sparse reduction source.
+	 */
+	struct SparseReductionCase
+	{
+		enum
+		{
+			//rows and columns: a dense reduction of the values vector of every batch
+			Entries,
+			//the outer axis (row sums of CSR, column sums of CSC): a segmented reduction over the outer indices
+			Outer,
+			//the inner axis (column sums of CSR, row sums of CSC): the entries are added with atomics to their inner index
+			Inner,
+			//only batches: the batches are summed per entry and scattered into a dense zero matrix
+			Batches
+		};
+		template<int _Axis, int _SparseFlags>
+		struct Select
+		{
+			enum
+			{
+				RowCol = _Axis & (Axis::Row | Axis::Column),
+				//reducing this axis keeps one value per outer index
+				OuterAxis = _SparseFlags == SparseFlags::CSR ? Axis::Column : Axis::Row,
+				value = RowCol == (Axis::Row | Axis::Column) ? Entries
+					: RowCol == OuterAxis ? Outer
+					: RowCol == 0 ? Batches
+					: Inner
+			};
+		};
+	};
+
+	/**
+	 * \brief Sum of a sparse reduction source over the stored entries only, see SparseReductionSource and SparseReductionCase.
+	 */
+	template <typename _Input, typename _Output, int _Axis, typename _Scalar, typename _Algorithm,
+		int _Case = SparseReductionCase::Select<_Axis, IsSparseReductionSource<_Input>::SFlags>::value>
+	struct SparseReductionEvaluator;
+
+	template <typename _Input, typename _Output, int _Axis, typename _Scalar, typename _Algorithm>
+	struct SparseReductionEvaluator<_Input, _Output, _Axis, _Scalar, _Algorithm, SparseReductionCase::Entries>
+	{
+		typedef typename SparseReductionSource<_Input>::Values Values;
+		static void eval(const _Input& in, _Output& out, const functor::Sum<_Scalar>& op, const _Scalar& initial)
+		{
+			const Values values = SparseReductionSource<_Input>::values(in);
+			ReductionEvaluator<Values, _Output, _Axis, functor::Sum<_Scalar>, _Scalar, _Algorithm>::eval(values, out, op, initial);
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+			LastReductionAlgorithm = "sparse-entries";
+#endif
+		}
+	};
+
+	template <typename _Input, typename _Output, int _Axis, typename _Scalar, typename _Algorithm>
+	struct SparseReductionEvaluator<_Input, _Output, _Axis, _Scalar, _Algorithm, SparseReductionCase::Outer>
+	{
+		typedef typename SparseReductionSource<_Input>::Values Values;
+		typedef Matrix<_Scalar, Dynamic, Dynamic, Dynamic, ColumnMajor> View;
+		static void eval(const _Input& in, _Output& out, const functor::Sum<_Scalar>& op, const _Scalar& initial)
+		{
+			const Values values = SparseReductionSource<_Input>::values(in);
+			const auto outer = segmentedReduce(values, SparseReductionSource<_Input>::pattern(in).JA, op, initial);
+			//the outer sums are a column vector, reshape them into the (row or column vector) shape of the output
+			const View view(outer.dataPointer(), out.rows(), out.cols(), outer.batches());
+			ReductionEvaluator<View, _Output, _Axis & Axis::Batch, functor::Sum<_Scalar>, _Scalar, _Algorithm>::eval(view, out, op, initial);
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+			LastReductionAlgorithm = "sparse-outer";
+#endif
+		}
+	};
+
+	template <typename _Input, typename _Output, int _Axis, typename _Scalar, typename _Algorithm>
+	struct SparseReductionEvaluator<_Input, _Output, _Axis, _Scalar, _Algorithm, SparseReductionCase::Inner>
+	{
+		typedef typename SparseReductionSource<_Input>::Values Values;
+		typedef Matrix<_Scalar, Dynamic, Dynamic, Dynamic, ColumnMajor> Tmp;
+		static void eval(const _Input& in, _Output& out, const functor::Sum<_Scalar>& op, const _Scalar& initial)
+		{
+			const Values values = SparseReductionSource<_Input>::values(in);
+			const auto& pattern = SparseReductionSource<_Input>::pattern(in);
+			const bool csr = IsSparseReductionSource<_Input>::SFlags == SparseFlags::CSR;
+			const bool reduceBatches = (_Axis & Axis::Batch) != 0;
+			const Index innerSize = csr ? in.cols() : in.rows();
+			Tmp tmp(out.rows(), out.cols(), reduceBatches ? 1 : in.batches());
+			tmp.setZero();
+			if (pattern.nnz > 0)
+			{
+				Context& ctx = Context::current();
+				KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(pattern.nnz), static_cast<unsigned int>(in.batches()),
+					kernels::SparseInnerReductionKernel<Values, _Scalar>);
+				kernels::SparseInnerReductionKernel<Values, _Scalar>
+					<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+					(cfg.virtual_size, values, pattern.IA.data(), innerSize, reduceBatches, tmp.data());
+				CUMAT_CHECK_ERROR();
+			}
+			//the initial value is the neutral element and not added
+			Assignment<_Output, Tmp, AssignmentMode::ASSIGN, typename traits<_Output>::DstTag, typename traits<Tmp>::SrcTag>::assign(out, tmp);
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+			LastReductionAlgorithm = "sparse-inner";
+#endif
+		}
+	};
+
+	template <typename _Input, typename _Output, int _Axis, typename _Scalar, typename _Algorithm>
+	struct SparseReductionEvaluator<_Input, _Output, _Axis, _Scalar, _Algorithm, SparseReductionCase::Batches>
+	{
+		typedef typename SparseReductionSource<_Input>::Values Values;
+		typedef Matrix<_Scalar, Dynamic, 1, 1, ColumnMajor> Entries;
+		typedef Matrix<_Scalar, Dynamic, Dynamic, 1, ColumnMajor> Tmp;
+		enum { CSR = IsSparseReductionSource<_Input>::SFlags == SparseFlags::CSR };
+		static void eval(const _Input& in, _Output& out, const functor::Sum<_Scalar>& op, const _Scalar& initial)
+		{
+			const auto& pattern = SparseReductionSource<_Input>::pattern(in);
+			Tmp tmp(in.rows(), in.cols(), 1);
+			tmp.setZero();
+			if (pattern.nnz > 0)
+			{
+				const Values values = SparseReductionSource<_Input>::values(in);
+				Entries entries(pattern.nnz, 1, 1);
+				ReductionEvaluator<Values, Entries, Axis::Batch, functor::Sum<_Scalar>, _Scalar, _Algorithm>::eval(values, entries, op, initial);
+				const Index outerSize = CSR ? in.rows() : in.cols();
+				const auto& outerIndices = pattern.cwiseEvaluationCache.outerIndices(pattern.JA, outerSize, pattern.nnz);
+				Context& ctx = Context::current();
+				KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(pattern.nnz),
+					kernels::SparseScatterToDenseKernel<_Scalar, CSR>);
+				kernels::SparseScatterToDenseKernel<_Scalar, CSR>
+					<<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>>
+					(cfg.virtual_size, entries.data(), outerIndices.data(), pattern.IA.data(), in.rows(), tmp.data());
+				CUMAT_CHECK_ERROR();
+			}
+			Assignment<_Output, Tmp, AssignmentMode::ASSIGN, typename traits<_Output>::DstTag, typename traits<Tmp>::SrcTag>::assign(out, tmp);
+#ifdef CUMAT_UNITTESTS_LAST_REDUCTION
+			LastReductionAlgorithm = "sparse-batches";
+#endif
+		}
+	};
+
+	/**
+	 * \brief Sums over CSR and CSC matrices (and zero-preserving expressions of them) only visit the stored entries,
+	 * instead of evaluating every coefficient of the dense matrix with a search in the sparsity pattern.
+	 * Other reductions (e.g. min, max, prod) depend on the implicit zeros and use the dense evaluators,
+	 * as do sums over the inner axis of scalar types without atomics.
+	 */
+	template <typename _Input, typename _Output, int _Axis, typename _Scalar, typename _Algorithm>
+	struct ReductionDispatcher<_Input, _Output, _Axis, functor::Sum<_Scalar>, _Scalar, _Algorithm,
+		typename std::enable_if<IsSparseReductionSource<_Input>::value && _Axis != 0
+			&& (int(SparseReductionCase::Select<_Axis, IsSparseReductionSource<_Input>::SFlags>::value) != int(SparseReductionCase::Inner)
+				|| SupportsSparseScatter<_Scalar>::value)>::type>
+	{
+		static void eval(const MatrixBase<_Input>& in, _Output& out, const functor::Sum<_Scalar>& op, const _Scalar& initial)
+		{
+			if (!SparseReductionSource<_Input>::sharedPattern(in.derived()))
+			{
+				//the operands of a product store their entries in different orders
+				ReductionEvaluator<_Input, _Output, _Axis, functor::Sum<_Scalar>, _Scalar, _Algorithm>::eval(in, out, op, initial);
+				return;
+			}
+			CUMAT_LOG_DEBUG("Sum over the stored entries of a sparse matrix, axis=" << _Axis);
+			SparseReductionEvaluator<_Input, _Output, _Axis, _Scalar, _Algorithm>::eval(in.derived(), out, op, initial);
+		}
+	};
+#endif
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,514 @@
+#ifndef __CUMAT_SPARSE_REORDERING_H__
+#define __CUMAT_SPARSE_REORDERING_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "SparseMatrix.h"
+#include "SparseFormatConversion.h"
+
+#include <vector>
+#include <algorithm>
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    /**
+     * \brief Bandwidth-reducing orderings of sparsity patterns on the host.
+     *
+     * The orderings work on the undirected graph of the pattern of A+A^T without the diagonal.
+     * A permutation is stored as <tt>permutation[newIndex] = oldIndex</tt>, the permuted matrix is <tt>P A P^T</tt>.
+     * This contains no device code and can be tested without a GPU.
+     */
+    struct HostReordering
+    {
+        /**
+         * \brief The adjacency structure of the graph of A+A^T without the diagonal, the neighbors are sorted.
+         */
+        struct Graph
+        {
+            Index n = 0;
+            std::vector<int> offsets;
+            std::vector<int> neighbors;
+
+            int degree(int v) const { return offsets[v + 1] - offsets[v]; }
+        };
+
+        static Graph symmetricGraph(const int* JA, const int* IA, Index n)
+        {
+            //pattern of A and A^T, sorted and made unique per row
+            std::vector<int> counts(n + 1, 0);
+            for (Index i = 0; i < n; ++i)
+                for (int k = JA[i]; k < JA[i + 1]; ++k)
+                    if (IA[k] != i)
+                    {
+                        counts[i + 1]++;
+                        counts[IA[k] + 1]++;
+                    }
+            for (Index i = 0; i < n; ++i) counts[i + 1] += counts[i];
+            std::vector<int> next(counts.begin(), counts.end() - 1);
+            std::vector<int> neighbors(counts[n]);
+            for (Index i = 0; i < n; ++i)
+                for (int k = JA[i]; k < JA[i + 1]; ++k)
+                    if (IA[k] != i)
+                    {
+                        neighbors[next[i]++] = IA[k];
+                        neighbors[next[IA[k]]++] = static_cast<int>(i);
+                    }
+            Graph g;
+            g.n = n;
+            g.offsets.assign(n + 1, 0);
+            for (Index i = 0; i < n; ++i)
+            {
+                auto begin = neighbors.begin() + counts[i];
+                auto end = neighbors.begin() + counts[i + 1];
+                std::sort(begin, end);
+                end = std::unique(begin, end);
+                g.neighbors.insert(g.neighbors.end(), begin, end);
+                g.offsets[i + 1] = static_cast<int>(g.neighbors.size());
+            }
+            return g;
+        }
+
+        /**
+         * \brief Breadth-first search from \c start within the nodes v with <tt>label[v]==l</tt>.
+         * The nodes of the same level are visited in the order of increasing degree (Cuthill-McKee).
+         * \param stamp per node: the search it was last visited in, \c search is unique per call
+         * \param order receives the visited nodes
+         * \param lastLevel receives the start of the last level in \c order
+         * \return the number of levels
+         */
+        static int breadthFirstSearch(const Graph& g, int start, const std::vector<int>& label, int l,
+            std::vector<int>& stamp, int search, std::vector<int>& order, size_t& lastLevel)
+        {
+            order.clear();
+            order.push_back(start);
+            stamp[start] = search;
+            lastLevel = 0;
+            size_t head = 0;
+            int levels = 1;
+            std::vector<int> children;
+            while (true)
+            {
+                const size_t levelEnd = order.size();
+                for (; head < levelEnd; ++head)
+                {
+                    const int v = order[head];
+                    children.clear();
+                    for (int k = g.offsets[v]; k < g.offsets[v + 1]; ++k)
+                    {
+                        const int w = g.neighbors[k];
+                        if (label[w] == l && stamp[w] != search)
+                        {
+                            stamp[w] = search;
+                            children.push_back(w);
+                        }
+                    }
+                    std::stable_sort(children.begin(), children.end(), [&g](int a, int b) {return g.degree(a) < g.degree(b); });
+                    order.insert(order.end(), children.begin(), children.end());
+                }
+                if (order.size() == levelEnd) return levels;
+                lastLevel = levelEnd;
+                levels++;
+            }
+        }
+
+        /**
+         * \brief Finds a pseudo-peripheral node (George-Liu): repeatedly restarts the search from a node
+         * of minimal degree in the last level as long as the number of levels grows.
+         */
+        static int pseudoPeripheralNode(const Graph& g, int start, const std::vector<int>& label, int l,
+            std::vector<int>& stamp, int& search, std::vector<int>& order)
+        {
+            int eccentricity = 0;
+            size_t lastLevel;
+            for (int iteration = 0; iteration < 8; ++iteration)
+            {
+                const int e = breadthFirstSearch(g, start, label, l, stamp, ++search, order, lastLevel);
+                int candidate = order[lastLevel];
+                for (size_t i = lastLevel; i < order.size(); ++i)
+                    if (g.degree(order[i]) < g.degree(candidate)) candidate = order[i];
+                if (e <= eccentricity) break;
+                eccentricity = e;
+                start = candidate;
+            }
+            return start;
+        }
+
+        /**
+         * \brief Reverse Cuthill-McKee ordering. Every connected component is ordered by a breadth-first search
+         * from a pseudo-peripheral node, the neighbors are visited by increasing degree. The whole order is reversed.
+         * \return the permutation, <tt>permutation[newIndex] = oldIndex</tt>
+         */
+        static std::vector<int> reverseCuthillMcKee(const int* JA, const int* IA, Index n)
+        {
+            const Graph g = symmetricGraph(JA, IA, n);
+            std::vector<int> nodesByDegree(n);
+            for (Index i = 0; i < n; ++i) nodesByDegree[i] = static_cast<int>(i);
+            std::stable_sort(nodesByDegree.begin(), nodesByDegree.end(), [&g](int a, int b) {return g.degree(a) < g.degree(b); });
+
+            const std::vector<int> label(n, 0);
+            std::vector<int> stamp(n, 0);
+            std::vector<bool> visited(n, false);
+            int search = 0;
+            std::vector<int> permutation, order;
+            permutation.reserve(n);
+            for (int s : nodesByDegree)
+            {
+                if (visited[s]) continue;
+                const int start = pseudoPeripheralNode(g, s, label, 0, stamp, search, order);
+                size_t lastLevel;
+                breadthFirstSearch(g, start, label, 0, stamp, ++search, order, lastLevel);
+                for (int v : order) visited[v] = true;
+                permutation.insert(permutation.end(), order.begin(), order.end());
+            }
+            std::reverse(permutation.begin(), permutation.end());
+            return permutation;
+        }
+
+        /**
+         * \brief Nested dissection ordering with level-structure bisection.
+         * The nodes of a part are ordered by a breadth-first search from a pseudo-peripheral node and split in the middle.
+         * The nodes of the second half that are adjacent to the first half form the separator.
+         * The first half, the rest of the second half and the separator are numbered consecutively,
+         * the halves are split recursively until they have at most \c leafSize nodes.
+         * Leaves keep the order of the search, hence neighboring nodes stay close.
+         * \return the permutation, <tt>permutation[newIndex] = oldIndex</tt>
+         */
+        static std::vector<int> nestedDissection(const int* JA, const int* IA, Index n, Index leafSize = 64)
+        {
+            CUMAT_ASSERT_ARGUMENT(leafSize > 0);
+            const Graph g = symmetricGraph(JA, IA, n);
+            std::vector<int> label(n, 0);
+            std::vector<int> stamp(n, 0);
+            int search = 0;
+            int nextLabel = 1;
+            std::vector<int> permutation;
+            permutation.reserve(n);
+
+            //explicit stack of parts, the separators are appended after both halves
+            struct Part { std::vector<int> nodes; bool separator; };
+            std::vector<Part> stack;
+            std::vector<int> all(n);
+            for (Index i = 0; i < n; ++i) all[i] = static_cast<int>(i);
+            stack.push_back({ all, false });
+            std::vector<int> order, componentOrder;
+            while (!stack.empty())
+            {
+                Part part = std::move(stack.back());
+                stack.pop_back();
+                if (part.separator || static_cast<Index>(part.nodes.size()) <= leafSize)
+                {
+                    permutation.insert(permutation.end(), part.nodes.begin(), part.nodes.end());
+                    continue;
+                }
+                //order all components of the part by level structures
+                const int l = label[part.nodes[0]];
+                const int visitedStamp = ++search;
+                std::vector<int> levelOrder;
+                levelOrder.reserve(part.nodes.size());
+                for (int s : part.nodes)
+                {
+                    if (stamp[s] == visitedStamp) continue;
+                    const int start = pseudoPeripheralNode(g, s, label, l, stamp, search, componentOrder);
+                    size_t lastLevel;
+                    breadthFirstSearch(g, start, label, l, stamp, ++search, componentOrder, lastLevel);
+                    levelOrder.insert(levelOrder.end(), componentOrder.begin(), componentOrder.end());
+                    for (int v : componentOrder) stamp[v] = visitedStamp;
+                }
+                //bisection, the separator is the boundary of the second half
+                const size_t half = levelOrder.size() / 2;
+                const int labelA = nextLabel++;
+                const int labelB = nextLabel++;
+                for (size_t i = 0; i < levelOrder.size(); ++i)
+                    label[levelOrder[i]] = i < half ? labelA : labelB;
+                Part a{ std::vector<int>(levelOrder.begin(), levelOrder.begin() + half), false };
+                Part b{ {}, false };
+                Part separator{ {}, true };
+                for (size_t i = half; i < levelOrder.size(); ++i)
+                {
+                    const int v = levelOrder[i];
+                    bool boundary = false;
+                    for (int k = g.offsets[v]; k < g.offsets[v + 1] && !boundary; ++k)
+                        boundary = label[g.neighbors[k]] == labelA;
+                    (boundary ? separator : b).nodes.push_back(v);
+                }
+                for (int v : separator.nodes) label[v] = -1;
+                //processed in the order a, b, separator
+                stack.push_back(std::move(separator));
+                if (!b.nodes.empty()) stack.push_back(std::move(b));
+                stack.push_back(std::move(a));
+            }
+            return permutation;
+        }
+
+        /**
+         * \brief The inverse permutation, <tt>inverse[oldIndex] = newIndex</tt>
+         */
+        static std::vector<int> inverse(const std::vector<int>& permutation)
+        {
+            std::vector<int> inv(permutation.size());
+            for (size_t i = 0; i < permutation.size(); ++i)
+                inv[permutation[i]] = static_cast<int>(i);
+            return inv;
+        }
+
+        /**
+         * \brief The bandwidth max|i-j| over all entries (i,j) of the pattern after the permutation.
+         * \param inverse the inverse permutation or null for the identity
+         */
+        static Index bandwidth(const int* JA, const int* IA, Index n, const int* inverse = nullptr)
+        {
+            Index b = 0;
+            for (Index i = 0; i < n; ++i)
+            {
+                const Index pi = inverse ? inverse[i] : i;
+                for (int k = JA[i]; k < JA[i + 1]; ++k)
+                {
+                    const Index pj = inverse ? inverse[IA[k]] : IA[k];
+                    b = std::max(b, pi > pj ? pi - pj : pj - pi);
+                }
+            }
+            return b;
+        }
+
+        /**
+         * \brief The profile (envelope size) of the lower triangle after the permutation:
+         * the sum over all rows i of i minus the smallest column index j<=i in row i.
+         * \param inverse the inverse permutation or null for the identity
+         */
+        static Index profile(const int* JA, const int* IA, Index n, const int* inverse = nullptr)
+        {
+            std::vector<Index> first(n);
+            for (Index i = 0; i < n; ++i)
+            {
+                const Index pi = inverse ? inverse[i] : i;
+                Index f = pi;
+                for (int k = JA[i]; k < JA[i + 1]; ++k)
+                    f = std::min(f, static_cast<Index>(inverse ? inverse[IA[k]] : IA[k]));
+                first[pi] = f;
+            }
+            Index p = 0;
+            for (Index i = 0; i < n; ++i) p += i - first[i];
+            return p;
+        }
+
+        /**
+         * \brief The symmetric permutation P A P^T of a square CSR pattern.
+         * The column indices of the result are sorted, \c source contains the old entry of every new entry.
+         */
+        static SparsePatternConversion<std::vector<int>> permuteSymmetric(const int* JA, const int* IA, Index n,
+            const std::vector<int>& permutation, const std::vector<int>& inverse)
+        {
+            SparsePatternConversion<std::vector<int>> result;
+            result.JA.assign(n + 1, 0);
+            for (Index i = 0; i < n; ++i)
+                result.JA[i + 1] = result.JA[i] + JA[permutation[i] + 1] - JA[permutation[i]];
+            result.IA.resize(JA[n]);
+            result.source.resize(JA[n]);
+            std::vector<std::pair<int, int>> row;
+            for (Index i = 0; i < n; ++i)
+            {
+                const int old = permutation[i];
+                row.clear();
+                for (int k = JA[old]; k < JA[old + 1]; ++k)
+                    row.emplace_back(inverse[IA[k]], k);
+                std::sort(row.begin(), row.end());
+                for (size_t k = 0; k < row.size(); ++k)
+                {
+                    result.IA[result.JA[i] + k] = row[k].first;
+                    result.source[result.JA[i] + k] = row[k].second;
+                }
+            }
+            return result;
+        }
+    };
+
+#if CUMAT_NVCC==1
+    namespace kernels
+    {
+        //out[i] = in[indices[i]] for every batch
+        template<typename _Scalar>
+        __global__ void PermuteVectorKernel(dim3 virtual_size, const _Scalar* in, const int* indices, _Scalar* out)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, b, virtual_size)
+                out[i + b * virtual_size.x] = in[indices[i] + b * virtual_size.x];
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+}
+
+/**
+ * \brief A symmetric permutation of the rows and columns of a square sparse matrix, computed by
+ * \ref reverseCuthillMcKee() or \ref nestedDissection(), together with the bandwidth and profile before and after.
+ * The permuted matrix is <tt>P A P^T</tt>, see \ref permuteSymmetric(), vectors are permuted with \ref permuteVector()
+ * and the results mapped back with \ref unpermuteVector().
+ */
+struct SparseReordering
+{
+    typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IndexVector;
+
+    /** \brief <tt>permutation[newIndex] = oldIndex</tt> */
+    std::vector<int> permutation;
+    /** \brief <tt>inversePermutation[oldIndex] = newIndex</tt> */
+    std::vector<int> inversePermutation;
+    /** \brief \ref permutation in device memory */
+    IndexVector devicePermutation;
+    /** \brief \ref inversePermutation in device memory */
+    IndexVector deviceInversePermutation;
+
+    Index bandwidthBefore = 0;
+    Index bandwidthAfter = 0;
+    Index profileBefore = 0;
+    Index profileAfter = 0;
+
+    /**
+     * \brief Creates the reordering from the given permutation of the pattern given by JA and IA (on the host) and computes the statistics.
+     */
+    static SparseReordering fromPermutation(const std::vector<int>& permutation, const int* JA, const int* IA, Index n)
+    {
+        CUMAT_ASSERT_DIMENSION(static_cast<Index>(permutation.size()) == n);
+        SparseReordering r;
+        r.permutation = permutation;
+        r.inversePermutation = internal::HostReordering::inverse(permutation);
+        r.devicePermutation = IndexVector(n);
+        r.deviceInversePermutation = IndexVector(n);
+        if (n > 0)
+        {
+            r.devicePermutation.copyFromHost(r.permutation.data());
+            r.deviceInversePermutation.copyFromHost(r.inversePermutation.data());
+        }
+        r.bandwidthBefore = internal::HostReordering::bandwidth(JA, IA, n);
+        r.bandwidthAfter = internal::HostReordering::bandwidth(JA, IA, n, r.inversePermutation.data());
+        r.profileBefore = internal::HostReordering::profile(JA, IA, n);
+        r.profileAfter = internal::HostReordering::profile(JA, IA, n, r.inversePermutation.data());
+        return r;
+    }
+};
+
+namespace internal
+{
+    template<typename _Ordering>
+    SparseReordering computeReordering(const SparsityPattern<SparseFlags::CSR>& pattern, const _Ordering& ordering)
+    {
+        CUMAT_ASSERT_DIMENSION(pattern.rows == pattern.cols);
+        std::vector<int> JA(pattern.rows + 1), IA(pattern.nnz);
+        pattern.JA.copyToHost(JA.data());
+        if (pattern.nnz > 0) pattern.IA.copyToHost(IA.data());
+        return SparseReordering::fromPermutation(ordering(JA.data(), IA.data(), pattern.rows), JA.data(), IA.data(), pattern.rows);
+    }
+}
+
+/**
+ * \brief Computes the reverse Cuthill-McKee ordering of a square CSR pattern on the host.
+ * It reduces the bandwidth and improves the locality of the accesses to the right hand side in the matrix-vector product.
+ * Unsymmetric patterns are ordered by the pattern of A+A^T.
+ * \param pattern the sparsity pattern
+ * \return the permutation and the bandwidth and profile before and after
+ */
+inline SparseReordering reverseCuthillMcKee(const SparsityPattern<SparseFlags::CSR>& pattern)
+{
+    return internal::computeReordering(pattern, [](const int* JA, const int* IA, Index n)
+    {
+        return internal::HostReordering::reverseCuthillMcKee(JA, IA, n);
+    });
+}
+
+/**
+ * \brief Computes a nested dissection ordering of a square CSR pattern on the host,
+ * with recursive bisections of level structures, see \ref internal::HostReordering::nestedDissection().
+ * The parts are contiguous blocks of rows with few couplings between them,
+ * this does not reduce the bandwidth as much as RCM, but keeps the accesses of each part local.
+ * \param pattern the sparsity pattern
+ * \param leafSize the size of the parts at which the recursion stops
+ * \return the permutation and the bandwidth and profile before and after
+ */
+inline SparseReordering nestedDissection(const SparsityPattern<SparseFlags::CSR>& pattern, Index leafSize = 64)
+{
+    return internal::computeReordering(pattern, [leafSize](const int* JA, const int* IA, Index n)
+    {
+        return internal::HostReordering::nestedDissection(JA, IA, n, leafSize);
+    });
+}
+
+/**
+ * \brief Computes the symmetrically permuted matrix <tt>P A P^T</tt>, all batches of the data are permuted.
+ * The pattern is computed on the host, the data is permuted on the device.
+ * \param A the square CSR matrix
+ * \param reordering the permutation
+ * \return the permuted matrix, the column indices per row are sorted
+ */
+template<typename _Scalar, int _Batches>
+SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> permuteSymmetric(
+    const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& A, const SparseReordering& reordering)
+{
+    const SparsityPattern<SparseFlags::CSR>& pattern = A.getSparsityPattern();
+    CUMAT_ASSERT_DIMENSION(pattern.rows == pattern.cols);
+    CUMAT_ASSERT_DIMENSION(static_cast<Index>(reordering.permutation.size()) == pattern.rows);
+    CUMAT_ERROR_IF_NO_NVCC(permuteSymmetric)
+#if CUMAT_NVCC==1
+    std::vector<int> JA(pattern.rows + 1), IA(pattern.nnz);
+    pattern.JA.copyToHost(JA.data());
+    if (pattern.nnz > 0) pattern.IA.copyToHost(IA.data());
+    const internal::SparsePatternConversion<std::vector<int>> c = internal::HostReordering::permuteSymmetric(
+        JA.data(), IA.data(), pattern.rows, reordering.permutation, reordering.inversePermutation);
+
+    SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> result(
+        internal::compressedPatternFromHost<SparseFlags::CSR>(pattern.rows, pattern.cols, c.JA, c.IA), A.batches());
+    internal::DeviceSparseConversion::Conversion dc;
+    dc.source = internal::DeviceSparseConversion::IndexVector(pattern.nnz);
+    if (pattern.nnz > 0) dc.source.copyFromHost(c.source.data());
+    internal::DeviceSparseConversion::gatherValues(A.getData().data(), pattern.nnz, dc, A.batches(), result.getData().data());
+    return result;
+#endif
+}
+
+namespace internal
+{
+    template<typename _Scalar, int _Batches>
+    Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor> gatherVector(
+        const Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor>& x, const Matrix<int, Dynamic, 1, 1, ColumnMajor>& indices)
+    {
+        CUMAT_ASSERT_DIMENSION(x.rows() == indices.rows());
+        CUMAT_ERROR_IF_NO_NVCC(gatherVector)
+        Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor> y(x.rows(), 1, x.batches());
+#if CUMAT_NVCC==1
+        if (x.rows() == 0) return y;
+        Context& ctx = Context::current();
+        KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(x.rows()), static_cast<unsigned int>(x.batches()),
+            kernels::PermuteVectorKernel<_Scalar>);
+        kernels::PermuteVectorKernel<_Scalar> <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+            cfg.virtual_size, x.data(), indices.data(), y.data());
+        CUMAT_CHECK_ERROR();
+#endif
+        return y;
+    }
+}
+
+/**
+ * \brief Permutes a (batched) dense vector into the new order, <tt>y = P x</tt>, i.e. <tt>y[newIndex] = x[oldIndex]</tt>.
+ * Use this for the right hand side of products and solves with the matrix from \ref permuteSymmetric().
+ */
+template<typename _Scalar, int _Batches>
+Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor> permuteVector(
+    const Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor>& x, const SparseReordering& reordering)
+{
+    return internal::gatherVector(x, reordering.devicePermutation);
+}
+
+/**
+ * \brief Permutes a (batched) dense vector back to the original order, <tt>y = P^T x</tt>, i.e. <tt>y[oldIndex] = x[newIndex]</tt>.
+ */
+template<typename _Scalar, int _Batches>
+Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor> unpermuteVector(
+    const Matrix<_Scalar, Dynamic, 1, _Batches, ColumnMajor>& x, const SparseReordering& reordering)
+{
+    return internal::gatherVector(x, reordering.deviceInversePermutation);
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef __CUMAT_SPARSE_SPARSE_PRODUCT_H__
+#define __CUMAT_SPARSE_SPARSE_PRODUCT_H__
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "SparseMatrix.h"
+#include "SparseFormatConversion.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+/**
+ * \brief The symbolic phase of the sparse matrix - sparse matrix product <tt>C = A * B</tt>, computed by \ref sparseProductSymbolic().
+ *
+ * It contains the sparsity pattern of \c C and, for every entry of \c C, the list of the partial products that are summed up:
+ * entry k of \c C is the sum of <tt>A[leftEntries[t]] * B[rightEntries[t]]</tt> for \c t from <tt>segments[k]</tt> to <tt>segments[k+1]-1</tt>.
+ * With it, \ref sparseProductNumeric() computes the values for new values of A and B with the same patterns without any sorting.
+ */
+struct SparseProductSymbolic
+{
+    typedef Matrix<int, Dynamic, 1, 1, ColumnMajor> IndexVector;
+
+    /** \brief The pattern of the product, the column indices per row are sorted */
+    SparsityPattern<SparseFlags::CSR> pattern;
+    /** \brief The number of partial products, i.e. the number of multiplications per batch */
+    Index numProducts = 0;
+    /** \brief The number of entries of the left factor */
+    Index leftNnz = 0;
+    /** \brief The number of entries of the right factor */
+    Index rightNnz = 0;
+    /** \brief Entry of the left factor per partial product, sorted by the entry of the product, size=numProducts */
+    IndexVector leftEntries;
+    /** \brief Entry of the right factor per partial product, sorted by the entry of the product, size=numProducts */
+    IndexVector rightEntries;
+    /** \brief Start of the partial products of every entry of the product, size=pattern.nnz+1 */
+    IndexVector segments;
+};
+
+namespace internal
+{
+#if CUMAT_NVCC==1
+    namespace kernels
+    {
+        //number of partial products per entry of the left factor, the last element is zero
+        __global__ void SpGEMMCountKernel(dim3 virtual_size, const int* leftIA, int leftNnz, const int* rightJA, int* counts)
+        {
+            CUMAT_KERNEL_1D_LOOP(k, virtual_size)
+                counts[k] = k < leftNnz ? rightJA[leftIA[k] + 1] - rightJA[leftIA[k]] : 0;
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        //expands the partial products, one thread per entry of the left factor
+        __global__ void SpGEMMExpandKernel(dim3 virtual_size, const int* leftRows, const int* leftIA,
+            const int* rightJA, const int* rightIA, const int* offsets,
+            int* rows, int* cols, int* leftEntries, int* rightEntries)
+        {
+            CUMAT_KERNEL_1D_LOOP(ka, virtual_size)
+                const int row = leftRows[ka];
+                const int k = leftIA[ka];
+                int t = offsets[ka];
+                for (int kb = rightJA[k]; kb < rightJA[k + 1]; ++kb, ++t)
+                {
+                    rows[t] = row;
+                    cols[t] = rightIA[kb];
+                    leftEntries[t] = static_cast<int>(ka);
+                    rightEntries[t] = kb;
+                }
+            CUMAT_KERNEL_1D_LOOP_END
+        }
+
+        //sums the partial products, one thread per entry of the product and batch
+        template<typename _Scalar>
+        __global__ void SpGEMMNumericKernel(dim3 virtual_size, const _Scalar* left, Index leftStride, const _Scalar* right, Index rightStride,
+            const int* leftEntries, const int* rightEntries, const int* segments, _Scalar* out)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, b, virtual_size)
+                const _Scalar* leftb = left + b * leftStride;
+                const _Scalar* rightb = right + b * rightStride;
+                _Scalar sum = _Scalar();
+                for (int t = segments[i]; t < segments[i + 1]; ++t)
+                    sum += leftb[leftEntries[t]] * rightb[rightEntries[t]];
+                out[i + b * virtual_size.x] = sum;
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+}
+
+/**
+ * \brief Computes the symbolic phase of the sparse matrix - sparse matrix product <tt>C = A * B</tt> of two CSR matrices.
+ *
+ * The product uses the expand-sort-compress (ESC) scheme on the device: all partial products <tt>A(i,k)*B(k,j)</tt> are expanded
+ * as coordinates (i,j), sorted by a radix sort and the duplicates are merged (as in \ref setFromTriplets()).
+ * This needs memory for all partial products, at most 2^31-1 per product, otherwise an std::invalid_argument is thrown.
+ * The result only depends on the patterns, it can be reused by \ref sparseProductNumeric() as long as the patterns don't change,
+ * e.g. for the Galerkin product <tt>R A P</tt> of a multigrid hierarchy with changing values.
+ *
+ * \param A the pattern of the left factor
+ * \param B the pattern of the right factor
+ * \return the pattern of the product and the mapping of the partial products
+ */
+inline SparseProductSymbolic sparseProductSymbolic(const SparsityPattern<SparseFlags::CSR>& A, const SparsityPattern<SparseFlags::CSR>& B)
+{
+    CUMAT_ASSERT_DIMENSION(A.cols == B.rows);
+    CUMAT_ERROR_IF_NO_NVCC(sparseProductSymbolic)
+    SparseProductSymbolic result;
+#if CUMAT_NVCC==1
+    typedef internal::DeviceSparseConversion Conv;
+    typedef SparseProductSymbolic::IndexVector IndexVector;
+    Context& ctx = Context::current();
+    result.leftNnz = A.nnz;
+    result.rightNnz = B.nnz;
+
+    //number of partial products per entry of A and their offsets
+    IndexVector offsets(A.nnz + 1);
+    int numProducts = 0;
+    if (A.nnz > 0)
+    {
+        IndexVector counts(A.nnz + 1);
+        KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(A.nnz + 1), internal::kernels::SpGEMMCountKernel);
+        internal::kernels::SpGEMMCountKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+            cfg.virtual_size, A.IA.data(), static_cast<int>(A.nnz), B.JA.data(), counts.data());
+        CUMAT_CHECK_ERROR();
+        //the total in 64 bits, the offsets of the expand buffers overflow if it exceeds the range of int
+        size_t reduce_storage_bytes = 0, scan_storage_bytes = 0;
+        CUMAT_SAFE_CALL(cub::DeviceReduce::Sum(NULL, reduce_storage_bytes, counts.data(), static_cast<long long*>(nullptr), static_cast<int>(A.nnz + 1), ctx.stream()));
+        CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(NULL, scan_storage_bytes, counts.data(), offsets.data(), static_cast<int>(A.nnz + 1), ctx.stream()));
+        size_t temp_storage_bytes = std::max(reduce_storage_bytes, scan_storage_bytes);
+        DevicePointer<uint8_t> temp_storage(temp_storage_bytes);
+        DevicePointer<long long> total(1);
+        CUMAT_SAFE_CALL(cub::DeviceReduce::Sum(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+            counts.data(), total.pointer(), static_cast<int>(A.nnz + 1), ctx.stream()));
+        long long totalProducts = 0;
+        CUMAT_SAFE_CALL(cudaMemcpyAsync(&totalProducts, total.pointer(), sizeof(long long), cudaMemcpyDeviceToHost, ctx.stream()));
+        CUMAT_SAFE_CALL(cudaStreamSynchronize(ctx.stream()));
+        if (totalProducts > std::numeric_limits<int>::max())
+            throw std::invalid_argument(__FILE__ ":" CUMAT_STR(__LINE__) ": Invalid argument: the product has more than 2^31-1 partial products");
+        CUMAT_SAFE_CALL(cub::DeviceScan::ExclusiveSum(static_cast<void*>(temp_storage.pointer()), temp_storage_bytes,
+            counts.data(), offsets.data(), static_cast<int>(A.nnz + 1), ctx.stream()));
+        numProducts = static_cast<int>(totalProducts);
+    }
+    result.numProducts = numProducts;
+
+    //expand
+    IndexVector rows(numProducts), cols(numProducts), leftEntries(numProducts), rightEntries(numProducts);
+    if (numProducts > 0)
+    {
+        IndexVector leftRows = Conv::expand(A.JA, A.rows, A.nnz);
+        KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(A.nnz), internal::kernels::SpGEMMExpandKernel);
+        internal::kernels::SpGEMMExpandKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+            cfg.virtual_size, leftRows.data(), A.IA.data(), B.JA.data(), B.IA.data(), offsets.data(),
+            rows.data(), cols.data(), leftEntries.data(), rightEntries.data());
+        CUMAT_CHECK_ERROR();
+    }
+
+    //sort and compress
+    const Conv::Conversion c = Conv::cooToCompressed(rows, cols, numProducts, A.rows, B.cols);
+    result.pattern.rows = A.rows;
+    result.pattern.cols = B.cols;
+    result.pattern.nnz = c.IA.size();
+    result.pattern.JA = c.JA;
+    result.pattern.IA = c.IA;
+    result.segments = c.segments;
+    result.leftEntries = IndexVector(numProducts);
+    result.rightEntries = IndexVector(numProducts);
+    if (numProducts > 0)
+    {
+        KernelLaunchConfig cfg = ctx.createLaunchConfig1D(static_cast<unsigned int>(numProducts), internal::kernels::SparseConversionGatherIndicesKernel);
+        internal::kernels::SparseConversionGatherIndicesKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+            cfg.virtual_size, leftEntries.data(), c.source.data(), result.leftEntries.data());
+        CUMAT_CHECK_ERROR();
+        internal::kernels::SparseConversionGatherIndicesKernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+            cfg.virtual_size, rightEntries.data(), c.source.data(), result.rightEntries.data());
+        CUMAT_CHECK_ERROR();
+    }
+#endif
+    return result;
+}
+
+/**
+ * \brief Computes the numeric phase of the sparse matrix - sparse matrix product <tt>C = A * B</tt>
+ * with the symbolic phase computed by \ref sparseProductSymbolic() for the patterns of A and B.
+ * The values of \c C are overwritten, the pattern is kept. Only this phase has to be repeated if the values of A or B change.
+ *
+ * All batches share the same pattern. If one factor has a single batch, it is broadcasted over the batches of the other factor.
+ * \param symbolic the symbolic phase
+ * \param A the left factor
+ * \param B the right factor
+ * \param C the product, must have the pattern \c symbolic.pattern and <tt>max(A.batches(), B.batches())</tt> batches
+ */
+template<typename _Scalar, int _Batches>
+void sparseProductNumeric(const SparseProductSymbolic& symbolic,
+    const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& A, const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& B,
+    SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& C)
+{
+    CUMAT_ASSERT_DIMENSION(A.getSparsityPattern().nnz == symbolic.leftNnz);
+    CUMAT_ASSERT_DIMENSION(B.getSparsityPattern().nnz == symbolic.rightNnz);
+    CUMAT_ASSERT_DIMENSION(C.getSparsityPattern().nnz == symbolic.pattern.nnz);
+    CUMAT_ASSERT_DIMENSION(A.batches() == B.batches() || A.batches() == 1 || B.batches() == 1);
+    CUMAT_ASSERT_DIMENSION(C.batches() == std::max(A.batches(), B.batches()));
+    CUMAT_ERROR_IF_NO_NVCC(sparseProductNumeric)
+#if CUMAT_NVCC==1
+    const Index n = symbolic.pattern.nnz;
+    if (n == 0) return;
+    Context& ctx = Context::current();
+    KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(n), static_cast<unsigned int>(C.batches()),
+        internal::kernels::SpGEMMNumericKernel<_Scalar>);
+    internal::kernels::SpGEMMNumericKernel<_Scalar> <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+        cfg.virtual_size, A.getData().data(), A.batches() == 1 ? 0 : symbolic.leftNnz,
+        B.getData().data(), B.batches() == 1 ? 0 : symbolic.rightNnz,
+        symbolic.leftEntries.data(), symbolic.rightEntries.data(), symbolic.segments.data(), C.getData().data());
+    CUMAT_CHECK_ERROR();
+#endif
+}
+
+/**
+ * \brief Computes the sparse matrix - sparse matrix product <tt>C = A * B</tt> of two CSR matrices,
+ * i.e. \ref sparseProductSymbolic() followed by \ref sparseProductNumeric().
+ * To compute the product repeatedly with the same patterns, call the two phases separately and keep the symbolic phase.
+ *
+ * All batches share the same pattern. If one factor has a single batch, it is broadcasted over the batches of the other factor.
+ * \param A the left factor
+ * \param B the right factor
+ * \return the product, the column indices per row are sorted
+ */
+template<typename _Scalar, int _Batches>
+SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> sparseProduct(
+    const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& A, const SparseMatrix<_Scalar, _Batches, SparseFlags::CSR>& B)
+{
+    const SparseProductSymbolic symbolic = sparseProductSymbolic(A.getSparsityPattern(), B.getSparsityPattern());
+    SparseMatrix<_Scalar, _Batches, SparseFlags::CSR> C(symbolic.pattern, std::max(A.batches(), B.batches()));
+    sparseProductNumeric(symbolic, A, B, C);
+    return C;
+}
+
+CUMAT_NAMESPACE_END
+
+#endif
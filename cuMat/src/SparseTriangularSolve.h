@@ -0,0 +1,314 @@
+#ifndef __CUMAT_SPARSE_TRIANGULAR_SOLVE_H__
+#define __CUMAT_SPARSE_TRIANGULAR_SOLVE_H__
+
+#include "Macros.h"
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "Matrix.h"
+#include "SparseMatrix.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+#if CUMAT_NVCC==1
+    namespace kernels
+    {
+        //Solves for the rows of one dependency level, one thread per row and batch.
+        //_Lower: uses the entries left of the diagonal, else right of the diagonal.
+        //_Indirect: the value of entry p is stored at valueIndices[p] (transposed solve)
+        template<typename _Scalar, bool _Lower, bool _Unit, bool _Indirect>
+        __global__ void SparseTriangularSolveKernel(dim3 virtual_size,
+            const int* levelRows, const int* JA, const int* IA,
+            const _Scalar* values, Index valueBatchStride, const int* diagonal, const int* valueIndices,
+            _Scalar* x, Index rows)
+        {
+            CUMAT_KERNEL_2D_LOOP(t, batch, virtual_size)
+                const int row = levelRows[t];
+                const _Scalar* v = values + batch * valueBatchStride;
+                _Scalar* xb = x + batch * rows;
+                _Scalar sum = xb[row];
+                const int end = JA[row + 1];
+                for (int p = JA[row]; p < end; ++p)
+                {
+                    const int col = IA[p];
+                    if (_Lower ? (col < row) : (col > row))
+                        sum -= v[_Indirect ? valueIndices[p] : p] * xb[col];
+                }
+                xb[row] = _Unit ? sum : sum / v[diagonal[row]];
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+
+    /**
+     * \brief Launch configurations of the level-scheduled kernels.
+     * The occupancy query for the block size runs once per kernel, on its first launch.
+     * The grid of every level is derived from it and shrunk to the rows of the level.
+     */
+    class LevelLaunchConfigCache
+    {
+    private:
+        std::vector<std::pair<const void*, KernelLaunchConfig>> configs_;
+
+    public:
+        template<typename _Kernel>
+        KernelLaunchConfig get(_Kernel kernel, int levelSize, unsigned int batches)
+        {
+            const void* key = reinterpret_cast<const void*>(kernel);
+            auto it = std::find_if(configs_.begin(), configs_.end(),
+                [key](const std::pair<const void*, KernelLaunchConfig>& e) {return e.first == key; });
+            if (it == configs_.end())
+            {
+                configs_.emplace_back(key, Context::current().createLaunchConfig2D(1, 1, kernel));
+                it = configs_.end() - 1;
+            }
+            KernelLaunchConfig cfg = it->second;
+            cfg.virtual_size = dim3(levelSize, batches, 1);
+            const unsigned int blocks = CUMAT_DIV_UP(static_cast<unsigned int>(levelSize) * batches, cfg.thread_per_block.x);
+            cfg.block_count.x = std::min(cfg.block_count.x, blocks);
+            return cfg;
+        }
+    };
+}
+
+/**
+ * \brief Level-scheduled solver for sparse triangular systems stored in a CSR matrix.
+ *
+ * The triangular matrix is a part of a square CSR matrix: the lower triangle (\c Lower) or upper triangle (\c Upper),
+ * including the diagonal unless \c UnitDiagonal is specified, in which case the diagonal is assumed to be one.
+ * With \c TransposedLower, the system with the transpose of the lower triangle is solved. This requires
+ * a structurally symmetric sparsity pattern and is used for <tt>L^T x = b</tt> of the incomplete Cholesky factorization.
+ *
+ * The analysis in the constructor (or \ref analyze()) runs on the host: every row is assigned to the
+ * dependency level <tt>1 + max(level of the rows it depends on)</tt>. The rows of one level are independent
+ * and are solved in parallel by one kernel launch, the levels are processed in order.
+ * The analysis only depends on the sparsity pattern, it can be reused for all matrices
+ * with this pattern, e.g. after a numeric refactorization.
+ *
+ * The column indices of every row must be sorted.
+ */
+class SparseTriangularSolver
+{
+public:
+    typedef SparsityPattern<SparseFlags::CSR> SPattern;
+    typedef SPattern::IndexVector IndexVector;
+    typedef SPattern::StorageIndex StorageIndex;
+
+    enum Mode
+    {
+        Lower = 1,
+        Upper = 2,
+        TransposedLower = 4,
+        UnitDiagonal = 8
+    };
+
+private:
+    SPattern pattern_;
+    int mode_;
+    std::vector<int> levelOffsets_;
+    IndexVector levelRows_;
+    IndexVector diagonal_;
+    IndexVector valueIndices_;
+    mutable internal::LevelLaunchConfigCache launchConfigs_;
+
+public:
+    SparseTriangularSolver()
+        : mode_(0), levelOffsets_(1, 0)
+    {}
+
+    /**
+     * \brief Analyzes the sparsity pattern
+     * \param pattern the sparsity pattern, must be square with sorted column indices
+     * \param mode a combination of \ref Mode: exactly one of Lower, Upper, TransposedLower, optionally or-ed with UnitDiagonal
+     */
+    SparseTriangularSolver(const SPattern& pattern, int mode)
+        : mode_(0), levelOffsets_(1, 0)
+    {
+        analyze(pattern, mode);
+    }
+
+    /**
+     * \brief Computes the dependency level of every row.
+     * The rows of level 0 only depend on the right hand side.
+     * \param JA the row offsets, size rows+1
+     * \param IA the column indices, size nnz
+     * \param lower true: row i depends on the rows j<i in its row, false: on the rows j>i
+     * \return the level per row
+     */
+    static std::vector<int> computeLevels(const std::vector<StorageIndex>& JA, const std::vector<StorageIndex>& IA, bool lower)
+    {
+        const Index rows = static_cast<Index>(JA.size()) - 1;
+        std::vector<int> levels(rows, 0);
+        for (Index k = 0; k < rows; ++k)
+        {
+            const Index i = lower ? k : rows - 1 - k;
+            int level = 0;
+            for (StorageIndex p = JA[i]; p < JA[i + 1]; ++p)
+            {
+                const StorageIndex j = IA[p];
+                if (lower ? (j < i) : (j > i))
+                    level = std::max(level, levels[j] + 1);
+            }
+            levels[i] = level;
+        }
+        return levels;
+    }
+
+    /**
+     * \brief Analyzes the sparsity pattern, see the constructor
+     */
+    void analyze(const SPattern& pattern, int mode)
+    {
+        CUMAT_ASSERT_ARGUMENT(pattern.rows == pattern.cols);
+        const int part = mode & (Lower | Upper | TransposedLower);
+        CUMAT_ASSERT_ARGUMENT((part == Lower || part == Upper || part == TransposedLower) && "exactly one triangular part must be selected");
+        pattern_ = pattern;
+        mode_ = mode;
+        const Index rows = pattern.rows;
+
+        std::vector<StorageIndex> JA(rows + 1), IA(pattern.nnz);
+        pattern.JA.copyToHost(JA.data());
+        if (pattern.nnz > 0) pattern.IA.copyToHost(IA.data());
+
+        //diagonal entries
+        std::vector<StorageIndex> diagonal(rows, -1);
+        for (Index i = 0; i < rows; ++i)
+        {
+            CUMAT_ASSERT_ARGUMENT(std::is_sorted(IA.begin() + JA[i], IA.begin() + JA[i + 1]) && "the column indices must be sorted");
+            for (StorageIndex p = JA[i]; p < JA[i + 1]; ++p)
+                if (IA[p] == i) diagonal[i] = p;
+            CUMAT_ASSERT_ARGUMENT(((mode & UnitDiagonal) || diagonal[i] >= 0) && "the diagonal entry is missing from the sparsity pattern");
+        }
+
+        //transposed entries
+        if (part == TransposedLower)
+        {
+            std::vector<StorageIndex> valueIndices(pattern.nnz, -1);
+            for (Index i = 0; i < rows; ++i)
+                for (StorageIndex p = JA[i]; p < JA[i + 1]; ++p)
+                {
+                    const StorageIndex j = IA[p];
+                    const auto begin = IA.begin() + JA[j];
+                    const auto end = IA.begin() + JA[j + 1];
+                    const auto it = std::lower_bound(begin, end, static_cast<StorageIndex>(i));
+                    CUMAT_ASSERT_ARGUMENT(it != end && *it == i && "the transposed solve requires a structurally symmetric pattern");
+                    valueIndices[p] = static_cast<StorageIndex>(it - IA.begin());
+                }
+            valueIndices_ = IndexVector(pattern.nnz);
+            if (pattern.nnz > 0) valueIndices_.copyFromHost(valueIndices.data());
+        }
+        else
+            valueIndices_ = IndexVector();
+
+        //levels, the rows are sorted by level with a counting sort
+        const std::vector<int> levels = computeLevels(JA, IA, part == Lower);
+        const int numLevels = rows == 0 ? 0 : 1 + *std::max_element(levels.begin(), levels.end());
+        levelOffsets_.assign(numLevels + 1, 0);
+        for (int l : levels) levelOffsets_[l + 1]++;
+        for (int l = 0; l < numLevels; ++l) levelOffsets_[l + 1] += levelOffsets_[l];
+        std::vector<StorageIndex> levelRows(rows);
+        std::vector<int> next(levelOffsets_.begin(), levelOffsets_.end() - 1);
+        for (Index i = 0; i < rows; ++i)
+            levelRows[next[levels[i]]++] = static_cast<StorageIndex>(i);
+        levelRows_ = IndexVector(rows);
+        levelRows_.copyFromHost(levelRows.data());
+        diagonal_ = IndexVector(rows);
+        diagonal_.copyFromHost(diagonal.data());
+    }
+
+    /**
+     * \brief Returns the number of rows of the triangular system
+     */
+    Index rows() const { return pattern_.rows; }
+
+    /**
+     * \brief Returns the mode that was passed to \ref analyze()
+     */
+    int mode() const { return mode_; }
+
+    /**
+     * \brief Returns the number of dependency levels, this is the number of kernel launches per solve
+     */
+    Index numLevels() const { return static_cast<Index>(levelOffsets_.size()) - 1; }
+
+    /**
+     * \brief The offsets of the levels into \ref levelRows() (host memory), size numLevels+1
+     */
+    const std::vector<int>& levelOffsets() const { return levelOffsets_; }
+
+    /**
+     * \brief The rows sorted by level (device memory)
+     */
+    const IndexVector& levelRows() const { return levelRows_; }
+
+    /**
+     * \brief The position of the diagonal entry of every row in the column index array (device memory), -1 if missing
+     */
+    const IndexVector& diagonalPositions() const { return diagonal_; }
+
+    /**
+     * \brief Solves the triangular system in-place.
+     * \param matrix the CSR matrix with the sparsity pattern that was analyzed.
+     *   If it is batched, the number of batches must match the right hand side.
+     * \param x on input the right hand side, on output the solution
+     */
+    template<typename _Scalar, int _MatrixBatches, int _VectorBatches>
+    void solveInPlace(const SparseMatrix<_Scalar, _MatrixBatches, SparseFlags::CSR>& matrix,
+        Matrix<_Scalar, Dynamic, 1, _VectorBatches, ColumnMajor>& x) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(SparseTriangularSolver)
+        CUMAT_ASSERT(mode_ != 0 && "The solver is not initialized");
+        CUMAT_ASSERT_DIMENSION(matrix.rows() == rows());
+        CUMAT_ASSERT_DIMENSION(matrix.getSparsityPattern().nnz == pattern_.nnz);
+        CUMAT_ASSERT_DIMENSION(x.rows() == rows());
+        CUMAT_ASSERT_DIMENSION(matrix.batches() == 1 || matrix.batches() == x.batches());
+#if CUMAT_NVCC==1
+        const Index valueBatchStride = matrix.batches() == 1 ? 0 : pattern_.nnz;
+        if ((mode_ & Lower) && (mode_ & UnitDiagonal))
+            launch<_Scalar, true, true, false>(matrix, x, valueBatchStride);
+        else if (mode_ & Lower)
+            launch<_Scalar, true, false, false>(matrix, x, valueBatchStride);
+        else if ((mode_ & Upper) && (mode_ & UnitDiagonal))
+            launch<_Scalar, false, true, false>(matrix, x, valueBatchStride);
+        else if (mode_ & Upper)
+            launch<_Scalar, false, false, false>(matrix, x, valueBatchStride);
+        else if (mode_ & UnitDiagonal)
+            launch<_Scalar, false, true, true>(matrix, x, valueBatchStride);
+        else
+            launch<_Scalar, false, false, true>(matrix, x, valueBatchStride);
+#endif
+    }
+
+private:
+#if CUMAT_NVCC==1
+    template<typename _Scalar, bool _Lower, bool _Unit, bool _Indirect, int _MatrixBatches, int _VectorBatches>
+    void launch(const SparseMatrix<_Scalar, _MatrixBatches, SparseFlags::CSR>& matrix,
+        Matrix<_Scalar, Dynamic, 1, _VectorBatches, ColumnMajor>& x, Index valueBatchStride) const
+    {
+        Context& ctx = Context::current();
+        const auto kernel = internal::kernels::SparseTriangularSolveKernel<_Scalar, _Lower, _Unit, _Indirect>;
+        for (Index l = 0; l < numLevels(); ++l)
+        {
+            const int levelSize = levelOffsets_[l + 1] - levelOffsets_[l];
+            KernelLaunchConfig cfg = launchConfigs_.get(kernel, levelSize, static_cast<unsigned int>(x.batches()));
+            kernel <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream() >>> (
+                cfg.virtual_size, levelRows_.data() + levelOffsets_[l],
+                pattern_.JA.data(), pattern_.IA.data(),
+                matrix.getData().data(), valueBatchStride, diagonal_.data(),
+                _Indirect ? valueIndices_.data() : nullptr,
+                x.data(), x.rows());
+            CUMAT_CHECK_ERROR();
+        }
+    }
+#endif
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef __CUMAT_STENCIL_OPERATORS_H__
+#define __CUMAT_STENCIL_OPERATORS_H__
+
+#include "Macros.h"
+#include "ForwardDeclarations.h"
+#include "Context.h"
+#include "MatrixFreeOperator.h"
+
+CUMAT_NAMESPACE_BEGIN
+
+namespace internal
+{
+    template<typename _Scalar, int _Batches>
+    struct traits<Stencil5PointOperator<_Scalar, _Batches> >
+    {
+        typedef _Scalar Scalar;
+        enum
+        {
+            Flags = ColumnMajor,
+            RowsAtCompileTime = Dynamic,
+            ColsAtCompileTime = Dynamic,
+            BatchesAtCompileTime = _Batches,
+            AccessFlags = 0
+        };
+        typedef MatrixFreeSrcTag SrcTag;
+        typedef DeletedDstTag DstTag;
+    };
+
+    template<typename _Scalar, int _Batches>
+    struct traits<Stencil7PointOperator<_Scalar, _Batches> >
+    {
+        typedef _Scalar Scalar;
+        enum
+        {
+            Flags = ColumnMajor,
+            RowsAtCompileTime = Dynamic,
+            ColsAtCompileTime = Dynamic,
+            BatchesAtCompileTime = _Batches,
+            AccessFlags = 0
+        };
+        typedef MatrixFreeSrcTag SrcTag;
+        typedef DeletedDstTag DstTag;
+    };
+
+#if CUMAT_NVCC == 1
+    namespace kernels
+    {
+        // out = center*u + wx*(u[x-1]+u[x+1]) + wy*(u[y-1]+u[y+1]) on a nx*ny grid, zero outside (Dirichlet boundary)
+        template<typename _Scalar>
+        __global__ void Stencil5PointKernel(dim3 virtual_size, Index nx, Index ny, Index inBatchStride,
+            _Scalar center, _Scalar wx, _Scalar wy, const _Scalar* in, _Scalar* out)
+        {
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                const Index y = i / nx;
+                const Index x = i - y * nx;
+                const _Scalar* u = in + batch * inBatchStride;
+                _Scalar value = center * u[i];
+                if (x > 0) value += wx * u[i - 1];
+                if (x < nx - 1) value += wx * u[i + 1];
+                if (y > 0) value += wy * u[i - nx];
+                if (y < ny - 1) value += wy * u[i + nx];
+                out[i + batch * virtual_size.x] = value;
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+
+        // out = center*u + wx*(u[x-1]+u[x+1]) + wy*(u[y-1]+u[y+1]) + wz*(u[z-1]+u[z+1]) on a nx*ny*nz grid, zero outside
+        template<typename _Scalar>
+        __global__ void Stencil7PointKernel(dim3 virtual_size, Index nx, Index ny, Index nz, Index inBatchStride,
+            _Scalar center, _Scalar wx, _Scalar wy, _Scalar wz, const _Scalar* in, _Scalar* out)
+        {
+            const Index nxy = nx * ny;
+            CUMAT_KERNEL_2D_LOOP(i, batch, virtual_size)
+                const Index z = i / nxy;
+                const Index y = (i - z * nxy) / nx;
+                const Index x = i - z * nxy - y * nx;
+                const _Scalar* u = in + batch * inBatchStride;
+                _Scalar value = center * u[i];
+                if (x > 0) value += wx * u[i - 1];
+                if (x < nx - 1) value += wx * u[i + 1];
+                if (y > 0) value += wy * u[i - nx];
+                if (y < ny - 1) value += wy * u[i + nx];
+                if (z > 0) value += wz * u[i - nxy];
+                if (z < nz - 1) value += wz * u[i + nxy];
+                out[i + batch * virtual_size.x] = value;
+            CUMAT_KERNEL_2D_LOOP_END
+        }
+    }
+#endif
+}
+
+/**
+ * \brief Matrix-free 5-point stencil on a regular 2D grid of size nx*ny with zero Dirichlet boundary.
+ *
+ * The unknowns are stored with x running fastest, i.e. the grid point (x,y) has the index <tt>x + nx*y</tt>.
+ * The operator computes
+ * \f[ (Au)_{x,y} = c\, u_{x,y} + w_x (u_{x-1,y} + u_{x+1,y}) + w_y (u_{x,y-1} + u_{x,y+1}) \f]
+ * where neighbors outside of the grid are zero.
+ * The default coefficients <tt>c=4, w_x=w_y=-1</tt> give the standard discretization of the negative Laplacian (scaled by h^2),
+ * which is symmetric positive definite and can be solved with the ConjugateGradient.
+ *
+ * The same stencil is applied to all batches of the right hand side.
+ * \tparam _Scalar the scalar type
+ * \tparam _Batches the number of batches of the right hand sides, has to be known at compile time for the iterative solvers
+ */
+template<typename _Scalar, int _Batches>
+class Stencil5PointOperator : public MatrixFreeOperatorBase<Stencil5PointOperator<_Scalar, _Batches>>
+{
+public:
+    typedef _Scalar Scalar;
+    enum
+    {
+        Flags = ColumnMajor,
+        Rows = Dynamic,
+        Columns = Dynamic,
+        Batches = _Batches
+    };
+
+private:
+    Index nx_;
+    Index ny_;
+    Index batches_;
+    Scalar center_;
+    Scalar wx_;
+    Scalar wy_;
+
+public:
+    Stencil5PointOperator()
+        : nx_(0), ny_(0), batches_(0), center_(4), wx_(-1), wy_(-1)
+    {}
+
+    /**
+     * \brief Creates the stencil with the standard coefficients of the negative Laplacian <tt>c=4, w_x=w_y=-1</tt>
+     * \param nx the grid size in x-direction
+     * \param ny the grid size in y-direction
+     * \param batches the number of batches
+     */
+    Stencil5PointOperator(Index nx, Index ny, Index batches = _Batches)
+        : nx_(nx), ny_(ny), batches_(batches), center_(4), wx_(-1), wy_(-1)
+    {
+        CUMAT_ASSERT_ARGUMENT(nx > 0);
+        CUMAT_ASSERT_ARGUMENT(ny > 0);
+        CUMAT_ASSERT_ARGUMENT(CUMAT_IMPLIES(_Batches != Dynamic, batches == _Batches));
+    }
+
+    /**
+     * \brief Creates the stencil with custom coefficients
+     * \param nx the grid size in x-direction
+     * \param ny the grid size in y-direction
+     * \param center the weight of the center point
+     * \param wx the weight of the neighbors in x-direction
+     * \param wy the weight of the neighbors in y-direction
+     * \param batches the number of batches
+     */
+    Stencil5PointOperator(Index nx, Index ny, Scalar center, Scalar wx, Scalar wy, Index batches = _Batches)
+        : nx_(nx), ny_(ny), batches_(batches), center_(center), wx_(wx), wy_(wy)
+    {
+        CUMAT_ASSERT_ARGUMENT(nx > 0);
+        CUMAT_ASSERT_ARGUMENT(ny > 0);
+        CUMAT_ASSERT_ARGUMENT(CUMAT_IMPLIES(_Batches != Dynamic, batches == _Batches));
+    }
+
+    __host__ __device__ CUMAT_STRONG_INLINE Index rows() const { return nx_ * ny_; }
+    __host__ __device__ CUMAT_STRONG_INLINE Index cols() const { return nx_ * ny_; }
+    __host__ __device__ CUMAT_STRONG_INLINE Index batches() const { return batches_; }
+
+    Index nx() const { return nx_; }
+    Index ny() const { return ny_; }
+    Scalar center() const { return center_; }
+    Scalar wx() const { return wx_; }
+    Scalar wy() const { return wy_; }
+
+    /**
+     * \brief Computes <tt>out = A * in</tt>.
+     * \param in the input vector of size nx*ny with one or \c out.batches() batches
+     * \param out the output vector of size nx*ny
+     */
+    template<typename _In, typename _Out>
+    void applyTo(const _In& in, _Out& out) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(Stencil5PointOperator)
+        CUMAT_STATIC_ASSERT((std::is_same<typename _In::Scalar, Scalar>::value), "The scalar type of the vector must match the stencil");
+        CUMAT_STATIC_ASSERT((std::is_same<typename _Out::Scalar, Scalar>::value), "The scalar type of the vector must match the stencil");
+        CUMAT_ASSERT(in.rows() == rows());
+        CUMAT_ASSERT(out.rows() == rows());
+        CUMAT_ASSERT(in.batches() == 1 || in.batches() == out.batches());
+#if CUMAT_NVCC == 1
+        Context& ctx = Context::current();
+        KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(rows()), static_cast<unsigned int>(out.batches()),
+            internal::kernels::Stencil5PointKernel<Scalar>);
+        internal::kernels::Stencil5PointKernel<Scalar>
+            <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(
+                cfg.virtual_size, nx_, ny_, in.batches() == 1 ? 0 : rows(), center_, wx_, wy_, in.data(), out.data());
+        CUMAT_CHECK_ERROR();
+#endif
+    }
+};
+
+/**
+ * \brief Matrix-free 7-point stencil on a regular 3D grid of size nx*ny*nz with zero Dirichlet boundary.
+ *
+ * The unknowns are stored with x running fastest, followed by y, i.e. the grid point (x,y,z) has the index <tt>x + nx*(y + ny*z)</tt>.
+ * The operator computes
+ * \f[ (Au)_{x,y,z} = c\, u_{x,y,z} + w_x (u_{x-1,y,z} + u_{x+1,y,z}) + w_y (u_{x,y-1,z} + u_{x,y+1,z}) + w_z (u_{x,y,z-1} + u_{x,y,z+1}) \f]
+ * where neighbors outside of the grid are zero.
+ * The default coefficients <tt>c=6, w_x=w_y=w_z=-1</tt> give the standard discretization of the negative Laplacian (scaled by h^2).
+ *
+ * The same stencil is applied to all batches of the right hand side.
+ * \tparam _Scalar the scalar type
+ * \tparam _Batches the number of batches of the right hand sides, has to be known at compile time for the iterative solvers
+ */
+template<typename _Scalar, int _Batches>
+class Stencil7PointOperator : public MatrixFreeOperatorBase<Stencil7PointOperator<_Scalar, _Batches>>
+{
+public:
+    typedef _Scalar Scalar;
+    enum
+    {
+        Flags = ColumnMajor,
+        Rows = Dynamic,
+        Columns = Dynamic,
+        Batches = _Batches
+    };
+
+private:
+    Index nx_;
+    Index ny_;
+    Index nz_;
+    Index batches_;
+    Scalar center_;
+    Scalar wx_;
+    Scalar wy_;
+    Scalar wz_;
+
+public:
+    Stencil7PointOperator()
+        : nx_(0), ny_(0), nz_(0), batches_(0), center_(6), wx_(-1), wy_(-1), wz_(-1)
+    {}
+
+    /**
+     * \brief Creates the stencil with the standard coefficients of the negative Laplacian <tt>c=6, w_x=w_y=w_z=-1</tt>
+     * \param nx the grid size in x-direction
+     * \param ny the grid size in y-direction
+     * \param nz the grid size in z-direction
+     * \param batches the number of batches
+     */
+    Stencil7PointOperator(Index nx, Index ny, Index nz, Index batches = _Batches)
+        : nx_(nx), ny_(ny), nz_(nz), batches_(batches), center_(6), wx_(-1), wy_(-1), wz_(-1)
+    {
+        CUMAT_ASSERT_ARGUMENT(nx > 0);
+        CUMAT_ASSERT_ARGUMENT(ny > 0);
+        CUMAT_ASSERT_ARGUMENT(nz > 0);
+        CUMAT_ASSERT_ARGUMENT(CUMAT_IMPLIES(_Batches != Dynamic, batches == _Batches));
+    }
+
+    /**
+     * \brief Creates the stencil with custom coefficients
+     * \param nx the grid size in x-direction
+     * \param ny the grid size in y-direction
+     * \param nz the grid size in z-direction
+     * \param center the weight of the center point
+     * \param wx the weight of the neighbors in x-direction
+     * \param wy the weight of the neighbors in y-direction
+     * \param wz the weight of the neighbors in z-direction
+     * \param batches the number of batches
+     */
+    Stencil7PointOperator(Index nx, Index ny, Index nz, Scalar center, Scalar wx, Scalar wy, Scalar wz, Index batches = _Batches)
+        : nx_(nx), ny_(ny), nz_(nz), batches_(batches), center_(center), wx_(wx), wy_(wy), wz_(wz)
+    {
+        CUMAT_ASSERT_ARGUMENT(nx > 0);
+        CUMAT_ASSERT_ARGUMENT(ny > 0);
+        CUMAT_ASSERT_ARGUMENT(nz > 0);
+        CUMAT_ASSERT_ARGUMENT(CUMAT_IMPLIES(_Batches != Dynamic, batches == _Batches));
+    }
+
+    __host__ __device__ CUMAT_STRONG_INLINE Index rows() const { return nx_ * ny_ * nz_; }
+    __host__ __device__ CUMAT_STRONG_INLINE Index cols() const { return nx_ * ny_ * nz_; }
+    __host__ __device__ CUMAT_STRONG_INLINE Index batches() const { return batches_; }
+
+    Index nx() const { return nx_; }
+    Index ny() const { return ny_; }
+    Index nz() const { return nz_; }
+    Scalar center() const { return center_; }
+    Scalar wx() const { return wx_; }
+    Scalar wy() const { return wy_; }
+    Scalar wz() const { return wz_; }
+
+    /**
+     * \brief Computes <tt>out = A * in</tt>.
+     * \param in the input vector of size nx*ny*nz with one or \c out.batches() batches
+     * \param out the output vector of size nx*ny*nz
+     */
+    template<typename _In, typename _Out>
+    void applyTo(const _In& in, _Out& out) const
+    {
+        CUMAT_ERROR_IF_NO_NVCC(Stencil7PointOperator)
+        CUMAT_STATIC_ASSERT((std::is_same<typename _In::Scalar, Scalar>::value), "The scalar type of the vector must match the stencil");
+        CUMAT_STATIC_ASSERT((std::is_same<typename _Out::Scalar, Scalar>::value), "The scalar type of the vector must match the stencil");
+        CUMAT_ASSERT(in.rows() == rows());
+        CUMAT_ASSERT(out.rows() == rows());
+        CUMAT_ASSERT(in.batches() == 1 || in.batches() == out.batches());
+#if CUMAT_NVCC == 1
+        Context& ctx = Context::current();
+        KernelLaunchConfig cfg = ctx.createLaunchConfig2D(static_cast<unsigned int>(rows()), static_cast<unsigned int>(out.batches()),
+            internal::kernels::Stencil7PointKernel<Scalar>);
+        internal::kernels::Stencil7PointKernel<Scalar>
+            <<<cfg.block_count, cfg.thread_per_block, 0, ctx.stream()>>>(
+                cfg.virtual_size, nx_, ny_, nz_, in.batches() == 1 ? 0 : rows(), center_, wx_, wy_, wz_, in.data(), out.data());
+        CUMAT_CHECK_ERROR();
+#endif
+    }
+};
+
+CUMAT_NAMESPACE_END
+
+#endif
@@ -78,6 +78,15 @@ public:
   {
     return functor_(child_.derived().coeff(row, col, batch, index), row, col, batch);
   }
+
+  const child_wrapped_t& getUnderlyingMatrix() const
+  {
+    return child_;
+  }
+  const _UnaryFunctor& getFunctor() const
+  {
+    return functor_;
+  }
 };
 
 // GENERAL UNARY OPERATIONS
@@ -10,6 +10,7 @@ using namespace cuMat;
  * in this example, the Buddhabrot fractal.
  * This is an extension to BuddhabrotSimple showcasing how a long-running kernel can be split
  * into smaller chunks to prevent the computer from freezing and to prevent timeout errors.
+ * The traced paths are accumulated into the image with cuMat::bincount.
  */
 
 //CONFIGURATION
@@ -20,6 +21,8 @@ constexpr double OFFSET_REAL = -0.5;
 constexpr double ESCAPE_RADIUS_SQ = 4.0 * 4.0;
 constexpr int ITERATIONS[3] = { 10000, 1000, 100 }; //red, green, blue
 constexpr int ITERATIONS_PER_STEP = 32;
+constexpr int TRACE_CHUNK_ROWS = 135; //image rows traced per kernel call in the second pass, limits the size of the trace matrix
+static_assert(HEIGHT % TRACE_CHUNK_ROWS == 0, "the second pass traces whole chunks of rows");
 constexpr int MSAA_SQR = 4;
 constexpr int MSAA = MSAA_SQR * MSAA_SQR;
 
@@ -27,6 +30,7 @@ constexpr int MSAA = MSAA_SQR * MSAA_SQR;
 typedef Matrix<int, MSAA, Dynamic, Dynamic, RowMajor> IterationMatrix;
 typedef Matrix<cdouble, MSAA, Dynamic, Dynamic, RowMajor> PositionMatrix;
 typedef Matrix<int, Dynamic, Dynamic, 1, ColumnMajor> OutputMatrix;
+typedef Matrix<int, ITERATIONS_PER_STEP, Dynamic, 1, ColumnMajor> TraceMatrix;
 
 //output / helper
 void writePPM(const OutputMatrix& red, const OutputMatrix& green, const OutputMatrix& blue, const char const* filename);
@@ -57,11 +61,14 @@ void generateSamplingPattern()
 //Because the buddhabrot can't be computed in one step for large iteration counts without time-out,
 //it is computed iteratively. Hence, this functor is a unary functor that updates the current 
 //position z_n in every step while keeping trace of the number of iterations.
+//In the second pass, the pixel indices of the traced points are written into the trace matrix
+//(one row per iteration of the step, one column per sample, -1 for no point), which is then counted with bincount.
+//To limit the size of the trace matrix, the second pass only traces the image rows [chunkStart, chunkStart+chunkRows).
 template<bool FirstPass>
 struct BuddhaBrotFunctor
 {
 private:
-	mutable OutputMatrix buddhabrot_;
+	mutable TraceMatrix trace_;
 	mutable IterationMatrix iterationMatrix_;
 	const double width_;
 	const double height_;
@@ -70,15 +77,19 @@ private:
 	const double offsetReal_;
 	const int iterations_;
 	const double escapeRadiusSq_;
+	const int chunkStart_;
+	const int chunkRows_;
 public:
-	BuddhaBrotFunctor(OutputMatrix buddhabrot, IterationMatrix iterationMatrix, 
-		int width, int height, double range, double offsetReal, int iterations, double escapeRadiusSq)
-		: buddhabrot_(buddhabrot),
+	BuddhaBrotFunctor(TraceMatrix trace, IterationMatrix iterationMatrix, 
+		int width, int height, double range, double offsetReal, int iterations, double escapeRadiusSq,
+		int chunkStart = 0, int chunkRows = 0)
+		: trace_(trace),
 		iterationMatrix_(iterationMatrix),
 		width_(width), height_(height),
 		range_(range), step_(width / (2.0 * range)),
 		offsetReal_(offsetReal),
-		iterations_(iterations), escapeRadiusSq_(escapeRadiusSq)
+		iterations_(iterations), escapeRadiusSq_(escapeRadiusSq),
+		chunkStart_(chunkStart), chunkRows_(chunkRows)
 	{}
 
 	typedef cdouble ReturnType;
@@ -114,18 +125,26 @@ public:
 		{
 			//second run, trace all points again that are NOT in the Mandelbulb.
 			//This means, startIteration is negative and the counter indicates how many points to trace
-			if (startIteration >= 0)
-				return z; //inside the Mandelbulb or done tracing
-			const int toTrace = min(iterations_, -startIteration);
-			//trace points and add to map
-			for (int i=0; i<toTrace; ++i)
+			if (y < chunkStart_ || y >= chunkStart_ + chunkRows_)
+				return z; //traced in another chunk
+			const Index sample = msaa + MSAA * (x + static_cast<Index>(width_) * (y - chunkStart_));
+			const int toTrace = startIteration >= 0 ? 0 : min(iterations_, -startIteration);
+			//trace points and store them in the trace matrix
+			for (int i=0; i<iterations_; ++i)
 			{
-				z = z * z + c;
-				int px = (z.real() - offsetReal_)*step_ + width_ * 0.5;
-				int py = z.imag()*step_ + height_ * 0.5;
-				if (px >= 0 && py >= 0 && px < width_ && py < height_)
-					atomicAdd(buddhabrot_.data() + buddhabrot_.index(px, py, 0), 1);
+				int bin = -1;
+				if (i < toTrace)
+				{
+					z = z * z + c;
+					int px = (z.real() - offsetReal_)*step_ + width_ * 0.5;
+					int py = z.imag()*step_ + height_ * 0.5;
+					if (px >= 0 && py >= 0 && px < width_ && py < height_)
+						bin = px + py * static_cast<int>(width_);
+				}
+				trace_.coeff(i, sample, 0, -1) = bin;
 			}
+			if (toTrace == 0)
+				return z; //inside the Mandelbulb or done tracing
 			//update number of iterations to trace
 			iterationMatrix_.coeff(msaa, x, y, -1) = startIteration + toTrace;
 		}
@@ -144,11 +163,12 @@ int main()
 	{
 		int iterations = ITERATIONS[i];
 		printf("Compute Buddhabrot with %d iterations\n", iterations);
-		buddhabrot[i] = MatrixXi::Zero(WIDTH, HEIGHT);
+		VectorXi counts = VectorXi::Zero(WIDTH * HEIGHT);
+		TraceMatrix trace(ITERATIONS_PER_STEP, MSAA * WIDTH * TRACE_CHUNK_ROWS);
 		IterationMatrix iterationMatrix = IterationMatrix::Zero(MSAA, WIDTH, HEIGHT);
 		PositionMatrix positionMatrix = PositionMatrix::Zero(MSAA, WIDTH, HEIGHT);
 		//first pass
-		BuddhaBrotFunctor<true> functor1(buddhabrot[i], iterationMatrix, WIDTH, HEIGHT, RANGE, OFFSET_REAL, ITERATIONS_PER_STEP, ESCAPE_RADIUS_SQ);
+		BuddhaBrotFunctor<true> functor1(trace, iterationMatrix, WIDTH, HEIGHT, RANGE, OFFSET_REAL, ITERATIONS_PER_STEP, ESCAPE_RADIUS_SQ);
 		for (int j=0; j<iterations; j+=ITERATIONS_PER_STEP)
 		{
 			//print and sync at every few kernel calls
@@ -162,18 +182,24 @@ int main()
 		printProgress(1.0); printf("\n");
 		//second pass
 		positionMatrix.setZero();
-		BuddhaBrotFunctor<false> functor2(buddhabrot[i], iterationMatrix, WIDTH, HEIGHT, RANGE, OFFSET_REAL, ITERATIONS_PER_STEP, ESCAPE_RADIUS_SQ);
-		for (int j = 0; j < iterations; j += ITERATIONS_PER_STEP)
+		for (int chunk = 0; chunk < HEIGHT; chunk += TRACE_CHUNK_ROWS)
 		{
-			//print and sync at every few kernel calls
-			//otherwise, your computer will freeze because of 100% GPU load.
-			if ((kernelCallCounter++) % 2 == 0) {
-				CUMAT_SAFE_CALL(cudaDeviceSynchronize());
-				printProgress(j / double(iterations));
+			BuddhaBrotFunctor<false> functor2(trace, iterationMatrix, WIDTH, HEIGHT, RANGE, OFFSET_REAL, ITERATIONS_PER_STEP, ESCAPE_RADIUS_SQ,
+				chunk, TRACE_CHUNK_ROWS);
+			for (int j = 0; j < iterations; j += ITERATIONS_PER_STEP)
+			{
+				//print and sync at every few kernel calls
+				//otherwise, your computer will freeze because of 100% GPU load.
+				if ((kernelCallCounter++) % 2 == 0) {
+					CUMAT_SAFE_CALL(cudaDeviceSynchronize());
+					printProgress((chunk * double(iterations) + j * double(TRACE_CHUNK_ROWS)) / (double(HEIGHT) * iterations));
+				}
+				positionMatrix.inplace() = positionMatrix.unaryExpr(functor2);
+				counts += bincount(trace, WIDTH * HEIGHT);
 			}
-			positionMatrix.inplace() = positionMatrix.unaryExpr(functor2);
 		}
 		printProgress(1.0); printf("\n");
+		buddhabrot[i] = OutputMatrix(counts.dataPointer(), WIDTH, HEIGHT, 1);
 	}
 
 	//save them
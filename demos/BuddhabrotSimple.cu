@@ -7,8 +7,9 @@ using namespace cuMat;
 /*
  * This Demo showcases how nullary functors can be abused to procedurally generate any data,
  * in this example, the Mandelbulb fractal.
- * As a bonus, this demo also shows how to atomically modify other matrices inside those functors
- * to generate the Buddhabrot fractal.
+ * As a bonus, this demo also shows how to write into other matrices inside those functors
+ * to generate the Buddhabrot fractal: every path writes the pixel indices it visits into a trace matrix,
+ * the image is then the histogram of that trace matrix (see cuMat::bincount).
  */
 
 //CONFIGURATION
@@ -23,11 +24,13 @@ const int ITERATIONS = 100; //red, green, blue
 void writePGM(const MatrixXi& intensities, const char const* filename);
 
 //main functor
-//computes the Buddhabrot paths and as a side-effect, also the mandelbrot
+//computes the Buddhabrot paths and as a side-effect, also the mandelbrot.
+//The i-th point of the path starting at pixel (x,y) is stored as pixel index in trace(i, x+y*width),
+//points outside of the image are left at -1 and are ignored by bincount
 struct BuddhaBrotFunctor
 {
 private:
-	mutable MatrixXi buddhabrot_;
+	mutable MatrixXi trace_;
 	const double width_;
 	const double height_;
 	const double range_;
@@ -36,8 +39,8 @@ private:
 	const int iterations_;
 	const double escapeRadiusSq_;
 public:
-	BuddhaBrotFunctor(MatrixXi buddhabrot, int width, int height, double range, double offsetReal, int iterations, double escapeRadiusSq)
-		: buddhabrot_(buddhabrot),
+	BuddhaBrotFunctor(MatrixXi trace, int width, int height, double range, double offsetReal, int iterations, double escapeRadiusSq)
+		: trace_(trace),
 		width_(width), height_(height),
 		range_(range), step_(width / (2.0 * range)),
 		offsetReal_(offsetReal),
@@ -66,7 +69,8 @@ public:
 			return 0;
 		}
 		//Outside of the mandelbulb -> consider in Buddhabrot
-		//trace points again, but this time, add to map
+		//trace points again, but this time, store them in the trace
+		const Index sample = row + col * static_cast<Index>(width_);
 		z = cdouble(0, 0);
 		for (int i2 = 0; i2 < i; ++i2)
 		{
@@ -74,7 +78,7 @@ public:
 			int x = (z.real()-offsetReal_)*step_ + width_ * 0.5;
 			int y = z.imag()*step_ + height_ * 0.5;
 			if (x >= 0 && y >= 0 && x < width_ && y < height_)
-				atomicAdd(buddhabrot_.data() + buddhabrot_.index(x, y, 0), 1);
+				trace_.coeff(i2, sample, 0, -1) = x + y * static_cast<int>(width_);
 		}
 		return i;
 	}
@@ -84,9 +88,12 @@ int main()
 {
 	//compute mandelbrot and buddhabrot, three times
 	printf("Compute Mandelbrot and Buddhabrot with %d iterations\n", ITERATIONS);
-	MatrixXi buddhabrot = MatrixXi::Zero(WIDTH, HEIGHT);
-	BuddhaBrotFunctor functor(buddhabrot, WIDTH, HEIGHT, RANGE, OFFSET_REAL, ITERATIONS, ESCAPE_RADIUS_SQ);
+	MatrixXi trace = MatrixXi::Constant(ITERATIONS, WIDTH * HEIGHT, -1);
+	BuddhaBrotFunctor functor(trace, WIDTH, HEIGHT, RANGE, OFFSET_REAL, ITERATIONS, ESCAPE_RADIUS_SQ);
 	MatrixXi mandelbrot = MatrixXi::NullaryExpr<BuddhaBrotFunctor>(WIDTH, HEIGHT, 1, functor);
+	//count how often each pixel was visited, the result is reshaped to the image size
+	VectorXi counts = bincount(trace, WIDTH * HEIGHT);
+	MatrixXi buddhabrot(counts.dataPointer(), WIDTH, HEIGHT, 1);
 
 	//save them
 	printf("Save to file\n");
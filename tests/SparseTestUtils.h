@@ -0,0 +1,118 @@
+#ifndef __CUMAT_TESTS_SPARSE_TEST_UTILS_H__
+#define __CUMAT_TESTS_SPARSE_TEST_UTILS_H__
+
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "catch2/catch.hpp"
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <Eigen/Core>
+
+// Sparse test matrices shared by the sparse matrix and solver tests
+
+/**
+ * \brief 2D Poisson matrix (5-point stencil) with nx*ny unknowns on the host, x runs fastest
+ */
+inline cuMat::internal::HostCsrMatrix<double> hostPoisson2D(int nx, int ny)
+{
+    cuMat::internal::HostCsrMatrix<double> A;
+    A.rows = A.cols = nx * ny;
+    A.JA.assign(nx * ny + 1, 0);
+    for (int y = 0; y < ny; ++y) for (int x = 0; x < nx; ++x)
+    {
+        const int i = x + nx * y;
+        auto add = [&A](int j, double v) {A.IA.push_back(j); A.values.push_back(v); };
+        if (y > 0) add(i - nx, -1);
+        if (x > 0) add(i - 1, -1);
+        add(i, 4);
+        if (x < nx - 1) add(i + 1, -1);
+        if (y < ny - 1) add(i + nx, -1);
+        A.JA[i + 1] = static_cast<int>(A.IA.size());
+    }
+    return A;
+}
+
+/**
+ * \brief 2D Poisson matrix (5-point stencil) with nx*ny unknowns on the device, x runs fastest
+ */
+inline cuMat::SparseMatrix<double, 1, cuMat::SparseFlags::CSR> poisson2D(int nx, int ny)
+{
+    return hostPoisson2D(nx, ny).toSparseMatrix();
+}
+
+/**
+ * \brief Converts the host CSR matrix to a dense Eigen matrix
+ */
+inline Eigen::MatrixXd hostToEigen(const cuMat::internal::HostCsrMatrix<double>& A)
+{
+    Eigen::MatrixXd m = Eigen::MatrixXd::Zero(A.rows, A.cols);
+    for (cuMat::Index i = 0; i < A.rows; ++i)
+        for (int k = A.JA[i]; k < A.JA[i + 1]; ++k)
+            m(i, A.IA[k]) = A.values[k];
+    return m;
+}
+
+/**
+ * \brief Random CSR matrix with the specified row lengths (clamped to cols), the columns of every row are sorted
+ */
+inline cuMat::internal::HostCsrMatrix<double> randomCsrMatrix(const std::vector<int>& rowLengths, int cols, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> value(-1, 1);
+    cuMat::internal::HostCsrMatrix<double> A;
+    A.rows = static_cast<cuMat::Index>(rowLengths.size());
+    A.cols = cols;
+    A.JA.assign(A.rows + 1, 0);
+    std::vector<int> columns(cols);
+    for (int j = 0; j < cols; ++j) columns[j] = j;
+    for (cuMat::Index i = 0; i < A.rows; ++i)
+    {
+        const int length = std::min(rowLengths[i], cols);
+        //partial shuffle, then sort the selected columns
+        for (int k = 0; k < length; ++k)
+            std::swap(columns[k], columns[k + rng() % (cols - k)]);
+        std::vector<int> row(columns.begin(), columns.begin() + length);
+        std::sort(row.begin(), row.end());
+        for (int j : row)
+        {
+            A.IA.push_back(j);
+            A.values.push_back(value(rng));
+        }
+        A.JA[i + 1] = static_cast<int>(A.IA.size());
+    }
+    return A;
+}
+
+/**
+ * \brief Random row lengths in [0, maxLength], every fifth row is empty
+ */
+inline std::vector<int> randomRowLengths(int rows, int maxLength, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<int> lengths(rows);
+    for (int i = 0; i < rows; ++i)
+        lengths[i] = (i % 5 == 3) ? 0 : static_cast<int>(rng() % (maxLength + 1));
+    return lengths;
+}
+
+/**
+ * \brief Requires that the CSR matrix has the pattern of \c expected and the values <tt>scale * expected.values</tt> in the specified batch
+ */
+template<int _Batches>
+void requireEqual(const cuMat::internal::HostCsrMatrix<double>& expected, const cuMat::SparseMatrix<double, _Batches, cuMat::SparseFlags::CSR>& actual,
+    cuMat::Index batch = 0, double scale = 1)
+{
+    std::vector<int> JA, IA;
+    std::vector<double> values;
+    cuMat::internal::copyCompressedToHost(actual, JA, IA, values);
+    REQUIRE(JA == expected.JA);
+    REQUIRE(IA == expected.IA);
+    for (cuMat::Index k = 0; k < expected.nnz(); ++k)
+        REQUIRE(values[batch * expected.nnz() + k] == Approx(scale * expected.values[k]));
+}
+
+
+#endif
@@ -0,0 +1,138 @@
+#include <catch2/catch.hpp>
+
+#include <set>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <cuMat/IterativeLinearSolvers>
+#include <cuMat/src/SimpleRandom.h>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Algebraic Multigrid - Host CSR", "[AMG]")
+{
+    const auto A = hostPoisson2D(5, 4);
+    const Eigen::MatrixXd Ad = hostToEigen(A);
+    SECTION("transpose")
+    {
+        REQUIRE(hostToEigen(A.transpose()).isApprox(Ad.transpose()));
+    }
+    SECTION("product")
+    {
+        const auto AA = internal::HostCsrMatrix<double>::product(A, A);
+        REQUIRE(hostToEigen(AA).isApprox(Ad * Ad));
+        for (Index i = 0; i < AA.rows; ++i)
+            REQUIRE(std::is_sorted(AA.IA.begin() + AA.JA[i], AA.IA.begin() + AA.JA[i + 1]));
+    }
+    SECTION("coeff")
+    {
+        REQUIRE(A.coeff(6, 6) == 4);
+        REQUIRE(A.coeff(6, 7) == -1);
+        REQUIRE(A.coeff(6, 8) == 0);
+    }
+}
+
+TEST_CASE("Algebraic Multigrid - Setup", "[AMG]")
+{
+    typedef internal::SmoothedAggregation<double> SA;
+    const auto A = hostPoisson2D(16, 12);
+    SECTION("aggregation")
+    {
+        Index numAggregates;
+        const auto agg = SA::aggregate(SA::strength(A, 0.0), numAggregates);
+        REQUIRE(numAggregates > 0);
+        REQUIRE(numAggregates < A.rows);
+        std::set<int> used;
+        for (int a : agg)
+        {
+            REQUIRE(a >= 0);
+            REQUIRE(a < numAggregates);
+            used.insert(a);
+        }
+        REQUIRE(Index(used.size()) == numAggregates);
+
+        const auto T = SA::tentativeProlongator(agg, numAggregates);
+        REQUIRE(T.rows == A.rows);
+        REQUIRE(T.cols == numAggregates);
+        const Eigen::MatrixXd Td = hostToEigen(T);
+        REQUIRE((Td.transpose() * Td).isApprox(Eigen::MatrixXd::Identity(numAggregates, numAggregates)));
+    }
+    SECTION("hierarchy")
+    {
+        AMGSettings settings;
+        settings.coarseSize = 10;
+        std::vector<double> coarseInverse;
+        const auto levels = SA::setup(A, settings, coarseInverse);
+        REQUIRE(levels.size() >= 2);
+        for (size_t l = 0; l + 1 < levels.size(); ++l)
+        {
+            INFO("level " << l);
+            REQUIRE(levels[l + 1].A.rows < levels[l].A.rows);
+            REQUIRE(levels[l].P.rows == levels[l].A.rows);
+            REQUIRE(levels[l].P.cols == levels[l + 1].A.rows);
+            //Galerkin product
+            const Eigen::MatrixXd P = hostToEigen(levels[l].P);
+            const Eigen::MatrixXd Ac = hostToEigen(levels[l + 1].A);
+            REQUIRE(Ac.isApprox(Ac.transpose()));
+            REQUIRE(Ac.isApprox(P.transpose() * hostToEigen(levels[l].A) * P));
+            REQUIRE(levels[l].rho > 0);
+            REQUIRE(levels[l].rho < 2.01);
+        }
+        if (levels.back().A.rows <= settings.coarseSize)
+        {
+            const Index n = levels.back().A.rows;
+            REQUIRE(Index(coarseInverse.size()) == n * n);
+            const Eigen::Map<const Eigen::MatrixXd> inv(coarseInverse.data(), n, n);
+            REQUIRE((inv * hostToEigen(levels.back().A)).isApprox(Eigen::MatrixXd::Identity(n, n)));
+        }
+    }
+    SECTION("max levels")
+    {
+        AMGSettings settings;
+        settings.coarseSize = 1;
+        settings.maxLevels = 2;
+        std::vector<double> coarseInverse;
+        const auto levels = SA::setup(A, settings, coarseInverse);
+        REQUIRE(levels.size() == 2);
+        REQUIRE(coarseInverse.empty());
+    }
+}
+
+template<AMGSettings::SmootherType Smoother>
+void testAMGConjugateGradient()
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    typedef Matrix<double, Dynamic, 1, 2, ColumnMajor> Vec;
+    const SMatrix A = hostPoisson2D(48, 40).toSparseMatrix();
+    SimpleRandom rand;
+    Vec xTruth(A.rows(), 1, 2);
+    rand.fillUniform(xTruth);
+    Vec b = A * xTruth;
+
+    //the diagonal of the Poisson matrix is constant, hence Jacobi preconditioning would not change the iterations
+    ConjugateGradient<SMatrix, IdentityPreconditioner<SMatrix>> cgPlain(A);
+    cgPlain.setTolerance(1e-8);
+    Vec xPlain = cgPlain.solve(b);
+    REQUIRE(cgPlain.error() <= cgPlain.tolerance());
+
+    AMGSettings settings;
+    settings.smoother = Smoother;
+    AlgebraicMultigridPreconditioner<SMatrix> amg(A, settings);
+    REQUIRE(amg.numLevels() >= 2);
+    REQUIRE(amg.levelSize(0) == A.rows());
+    ConjugateGradient<SMatrix, AlgebraicMultigridPreconditioner<SMatrix>> cg(A, amg);
+    cg.setTolerance(1e-8);
+    Vec x = cg.solve(b);
+    INFO("iterations: none=" << cgPlain.iterations() << ", AMG=" << cg.iterations());
+    REQUIRE(cg.error() <= cg.tolerance());
+    REQUIRE(cg.iterations() * 3 < cgPlain.iterations());
+    assertMatrixEqualityRelative(x, xTruth, 1e-5);
+}
+TEST_CASE("Algebraic Multigrid - Conjugate Gradient", "[AMG][CG]")
+{
+    SECTION("Jacobi") { testAMGConjugateGradient<AMGSettings::Jacobi>(); }
+    SECTION("Chebyshev") { testAMGConjugateGradient<AMGSettings::Chebyshev>(); }
+}
@@ -0,0 +1,146 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <cuMat/IterativeLinearSolvers>
+#include <cuMat/src/SimpleRandom.h>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Block Conjugate Gradient - Host routines", "[CG]")
+{
+    SECTION("eigen decomposition")
+    {
+        //column-major symmetric matrix with the eigenvalues 4, 3, 1
+        std::vector<double> A = { 2, 1, 0,   1, 2, 0,   0, 0, 4 };
+        std::vector<double> values, vectors;
+        internal::symmetricEigenDecomposition(3, A, values, vectors);
+        REQUIRE(values[0] == Approx(4));
+        REQUIRE(values[1] == Approx(3));
+        REQUIRE(values[2] == Approx(1));
+        REQUIRE(std::abs(vectors[2]) == Approx(1));
+        REQUIRE(std::abs(vectors[3 + 0]) == Approx(std::sqrt(0.5)));
+        REQUIRE(std::abs(vectors[6 + 0]) == Approx(std::sqrt(0.5)));
+    }
+    SECTION("orthonormalization with deflation")
+    {
+        //Gram matrix of the columns w0=(1,0,0), w1=(0,2,0), w2=w0+w1
+        std::vector<double> gram = { 1, 0, 1,   0, 4, 4,   1, 4, 5 };
+        std::vector<double> T;
+        REQUIRE(internal::blockOrthonormalization(3, gram, 1e-6, T) == 2);
+        //(W T)^T (W T) = T^T gram T must be the identity on the first two columns
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j)
+        {
+            double v = 0;
+            for (int k = 0; k < 3; ++k) for (int l = 0; l < 3; ++l)
+                v += T[k + 3 * i] * gram[k + 3 * l] * T[l + 3 * j];
+            INFO("i=" << i << ", j=" << j);
+            REQUIRE(v == Approx((i == j && i < 2) ? 1.0 : 0.0).margin(1e-10));
+        }
+    }
+    SECTION("Cholesky solve")
+    {
+        //only the leading 2x2 block is used
+        std::vector<double> S = { 4, 2, 0,   2, 3, 0,   0, 0, 0 };
+        std::vector<double> B = { 8, 7, 0,   2, 1, 0,   0, 0, 0 };
+        internal::smallCholeskySolve(3, 2, S, B);
+        REQUIRE(B[0] == Approx(1.25));
+        REQUIRE(B[1] == Approx(1.5));
+        REQUIRE(B[3] == Approx(0.5));
+        REQUIRE(B[4] == Approx(0.0).margin(1e-12));
+    }
+}
+
+TEST_CASE("Block Conjugate Gradient - Sparse matrix times multi-vector", "[Sparse][CG]")
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    const SMatrix A = poisson2D(13, 9);
+    const Index n = A.rows();
+    SimpleRandom rand;
+    Matrix<double, Dynamic, 4, 1, ColumnMajor> X(n, 4);
+    rand.fillUniform(X);
+    Matrix<double, Dynamic, 4, 1, ColumnMajor> Y = A * X;
+
+    //compare against the batched matrix-vector product, the memory layout of both is identical
+    std::vector<double> host(n * 4);
+    X.copyToHost(host.data());
+    Matrix<double, Dynamic, 1, 4, ColumnMajor> x(n, 1, 4);
+    x.copyFromHost(host.data());
+    Matrix<double, Dynamic, 1, 4, ColumnMajor> y = A * x;
+    std::vector<double> expected(n * 4), actual(n * 4);
+    y.copyToHost(expected.data());
+    Y.copyToHost(actual.data());
+    for (Index i = 0; i < n * 4; ++i)
+    {
+        INFO("i=" << i);
+        REQUIRE(actual[i] == Approx(expected[i]));
+    }
+}
+
+TEST_CASE("Block Conjugate Gradient - Solve", "[CG]")
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    constexpr int K = 4;
+    typedef Matrix<double, Dynamic, K, 1, ColumnMajor> Block;
+    typedef Matrix<double, Dynamic, 1, K, ColumnMajor> Vec;
+    const SMatrix A = poisson2D(48, 40);
+    const Index n = A.rows();
+    SimpleRandom rand;
+    Block XTruth(n, K);
+    rand.fillUniform(XTruth);
+
+    SECTION("independent right hand sides")
+    {
+        Block B = A * XTruth;
+        BlockConjugateGradient<SMatrix> bcg(A);
+        bcg.setTolerance(1e-8);
+        Block X = bcg.solve(B);
+        INFO("iterations=" << bcg.iterations() << ", error=" << bcg.error());
+        REQUIRE(bcg.error() <= bcg.tolerance());
+        REQUIRE(bcg.batchIterations().size() == K);
+        assertMatrixEqualityRelative(X, XTruth, 1e-5);
+
+        //the same right hand sides as batches of the single-vector CG
+        std::vector<double> host(n * K);
+        B.copyToHost(host.data());
+        Vec b(n, 1, K);
+        b.copyFromHost(host.data());
+        ConjugateGradient<SMatrix> cg(A);
+        cg.setTolerance(1e-8);
+        Vec x = cg.solve(b);
+        INFO("single-vector CG iterations=" << cg.iterations());
+        REQUIRE(bcg.iterations() < cg.iterations());
+    }
+    SECTION("linearly dependent right hand sides")
+    {
+        //columns 2 and 3 are linear combinations of columns 0 and 1
+        std::vector<double> host(n * K);
+        XTruth.copyToHost(host.data());
+        for (Index i = 0; i < n; ++i)
+        {
+            host[i + 2 * n] = host[i];
+            host[i + 3 * n] = host[i] + 2 * host[i + n];
+        }
+        XTruth.copyFromHost(host.data());
+        Block B = A * XTruth;
+        BlockConjugateGradient<SMatrix, IdentityPreconditioner<SMatrix>> bcg(A);
+        bcg.setTolerance(1e-8);
+        Block X = bcg.solve(B);
+        INFO("iterations=" << bcg.iterations() << ", rank=" << bcg.rank() << ", error=" << bcg.error());
+        REQUIRE(bcg.error() <= bcg.tolerance());
+        REQUIRE(bcg.rank() < K);
+        assertMatrixEqualityRelative(X, XTruth, 1e-5);
+    }
+    SECTION("initial guess")
+    {
+        Block B = A * XTruth;
+        BlockConjugateGradient<SMatrix> bcg(A);
+        bcg.setTolerance(1e-8);
+        Block X = bcg.solveWithGuess(B, XTruth);
+        REQUIRE(bcg.iterations() == 0);
+        assertMatrixEqualityRelative(X, XTruth, 1e-8);
+    }
+}
@@ -0,0 +1,177 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <cuMat/IterativeLinearSolvers>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+//Block tridiagonal matrix with 3x3 blocks, like a 1D chain of elastic nodes: the diagonal blocks couple the
+//three unknowns of a node, the off-diagonal blocks only couple the same unknowns of neighbouring nodes (hence they are partially filled).
+//Symmetric and strictly diagonally dominant, i.e. SPD.
+static internal::HostCsrMatrix<double> assembleElasticChain(int nodes)
+{
+    static const double D[3][3] = { {6, 1, 0.5}, {1, 5, 1}, {0.5, 1, 7} };
+    internal::HostCsrMatrix<double> A;
+    A.rows = A.cols = 3 * nodes;
+    A.JA.assign(3 * nodes + 1, 0);
+    for (int n = 0; n < nodes; ++n)
+        for (int r = 0; r < 3; ++r)
+        {
+            if (n > 0) { A.IA.push_back(3 * (n - 1) + r); A.values.push_back(-1); }
+            for (int c = 0; c < 3; ++c) { A.IA.push_back(3 * n + c); A.values.push_back(D[r][c]); }
+            if (n < nodes - 1) { A.IA.push_back(3 * (n + 1) + r); A.values.push_back(-1); }
+            A.JA[3 * n + r + 1] = static_cast<int>(A.IA.size());
+        }
+    return A;
+}
+
+TEST_CASE("Block sparse matrix - host layout", "[Sparse][BSR]")
+{
+    //{1, 2, 0, 0, 0, 0},
+    //{0, 0, 3, 0, 0, 0},
+    //{0, 0, 0, 0, 0, 0},
+    //{4, 0, 0, 0, 5, 6}
+    internal::HostCsrMatrix<float> A;
+    A.rows = 4;
+    A.cols = 6;
+    A.JA = { 0, 2, 3, 3, 6 };
+    A.IA = { 0, 1, 2, 0, 4, 5 };
+    A.values = { 1, 2, 3, 4, 5, 6 };
+    internal::HostBsrMatrix<float> B = internal::HostBsrMatrix<float>::fromCsr(A, 2, 3);
+    REQUIRE(B.blockRows == 2);
+    REQUIRE(B.blockCols == 2);
+    REQUIRE(B.JA == std::vector<int>({ 0, 1, 3 }));
+    REQUIRE(B.IA == std::vector<int>({ 0, 0, 1 }));
+    REQUIRE(B.values == std::vector<float>({
+        1, 2, 0,   0, 0, 3,
+        0, 0, 0,   4, 0, 0,
+        0, 0, 0,   0, 5, 6 }));
+}
+
+TEST_CASE("Block sparse matrix - product", "[Sparse][BSR]")
+{
+    const int nodes = 50;
+    internal::HostCsrMatrix<double> hostA = assembleElasticChain(nodes);
+    typedef BlockSparseMatrix<double, 3, 3> BSR;
+    BSR A = BSR::fromHostCsr(hostA);
+    REQUIRE(A.rows() == 3 * nodes);
+    REQUIRE(A.cols() == 3 * nodes);
+    REQUIRE(A.nnzBlocks() == 3 * nodes - 2);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    SECTION("single batch")
+    {
+        std::vector<double> x(3 * nodes), expected;
+        for (double& v : x) v = dist(rng);
+        hostA.multiply(x, expected);
+        VectorXd xDevice(3 * nodes);
+        xDevice.copyFromHost(x.data());
+        VectorXd y = A * xDevice;
+        std::vector<double> actual(3 * nodes);
+        y.copyToHost(actual.data());
+        for (int i = 0; i < 3 * nodes; ++i)
+            REQUIRE(actual[i] == Approx(expected[i]));
+    }
+    SECTION("batched, batch b scaled by b+1")
+    {
+        constexpr int batches = 2;
+        typedef BlockSparseMatrix<double, 3, 3, batches> BSR2;
+        typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+        BSR2 A2(A.getBlockPattern(), batches);
+        const Index blockEntries = A.nnzBlocks() * BSR::BlockSize;
+        std::vector<double> data(blockEntries);
+        A.getData().copyToHost(data.data());
+        data.resize(blockEntries * batches);
+        for (Index k = 0; k < blockEntries; ++k) data[blockEntries + k] = 2 * data[k];
+        A2.getData().copyFromHost(data.data());
+
+        std::vector<double> x(3 * nodes * batches);
+        for (double& v : x) v = dist(rng);
+        Vec xDevice(3 * nodes, 1, batches);
+        xDevice.copyFromHost(x.data());
+        Vec y = A2 * xDevice;
+        std::vector<double> actual(3 * nodes * batches);
+        y.copyToHost(actual.data());
+        for (int b = 0; b < batches; ++b)
+        {
+            std::vector<double> xb(x.begin() + b * 3 * nodes, x.begin() + (b + 1) * 3 * nodes), expected;
+            hostA.multiply(xb, expected);
+            for (int i = 0; i < 3 * nodes; ++i)
+                REQUIRE(actual[b * 3 * nodes + i] == Approx((b + 1) * expected[i]));
+        }
+    }
+}
+
+TEST_CASE("Block sparse matrix - block-Jacobi and Conjugate Gradient", "[Sparse][BSR][CG]")
+{
+    typedef BlockSparseMatrix<double, 3, 3> BSR;
+    SECTION("block-Jacobi is exact for block diagonal matrices")
+    {
+        internal::HostCsrMatrix<double> hostA = assembleElasticChain(1);
+        internal::HostCsrMatrix<double> hostDiag;
+        hostDiag.rows = hostDiag.cols = 30;
+        hostDiag.JA.assign(31, 0);
+        for (int i = 0; i < 30; ++i)
+        {
+            for (int k = hostA.JA[i % 3]; k < hostA.JA[i % 3 + 1]; ++k)
+            {
+                hostDiag.IA.push_back(i / 3 * 3 + hostA.IA[k]);
+                hostDiag.values.push_back(hostA.values[k] * (1 + i / 3));
+            }
+            hostDiag.JA[i + 1] = static_cast<int>(hostDiag.IA.size());
+        }
+        BSR A = BSR::fromHostCsr(hostDiag);
+        BlockJacobiPreconditioner<BSR> preconditioner(A);
+        VectorXd b(30);
+        std::vector<double> hostB(30);
+        for (int i = 0; i < 30; ++i) hostB[i] = i - 10;
+        b.copyFromHost(hostB.data());
+        VectorXd x = preconditioner.solve(b);
+        VectorXd Ax = A * x;
+        assertMatrixEqualityRelative(b, Ax, 1e-10);
+    }
+    SECTION("missing diagonal block is replaced by the identity")
+    {
+        internal::HostCsrMatrix<double> hostA;
+        hostA.rows = hostA.cols = 6;
+        hostA.JA = { 0, 1, 2, 3, 3, 3, 3 };
+        hostA.IA = { 0, 1, 2 };
+        hostA.values = { 2, 4, 8 };
+        BSR A = BSR::fromHostCsr(hostA);
+        BlockJacobiPreconditioner<BSR> preconditioner(A);
+        std::vector<double> inverse(18);
+        preconditioner.getInverseBlocks().copyToHost(inverse.data());
+        REQUIRE(inverse == std::vector<double>({
+            0.5, 0, 0,   0, 0.25, 0,   0, 0, 0.125,
+            1, 0, 0,   0, 1, 0,   0, 0, 1 }));
+    }
+    SECTION("CG with block-Jacobi")
+    {
+        const int nodes = 200;
+        BSR A = BSR::fromHostCsr(assembleElasticChain(nodes));
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<double> dist(-1, 1);
+        std::vector<double> hostTruth(3 * nodes);
+        for (double& v : hostTruth) v = dist(rng);
+        VectorXd xTruth(3 * nodes);
+        xTruth.copyFromHost(hostTruth.data());
+        VectorXd b = A * xTruth;
+
+        ConjugateGradient<BSR, BlockJacobiPreconditioner<BSR>> cg(A);
+        cg.setTolerance(1e-10);
+        VectorXd x = cg.solve(b);
+        REQUIRE(cg.error() <= cg.tolerance());
+        assertMatrixEqualityRelative(x, xTruth, 1e-6);
+
+        ConjugateGradient<BSR, IdentityPreconditioner<BSR>> cgIdentity(A);
+        cgIdentity.setTolerance(1e-10);
+        VectorXd x2 = cgIdentity.solve(b);
+        REQUIRE(cg.iterations() <= cgIdentity.iterations());
+    }
+}
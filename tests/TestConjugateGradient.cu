@@ -2,6 +2,7 @@
 
 #include <cuMat/Core>
 #include <cuMat/src/SimpleRandom.h>
+#include <cuMat/Sparse>
 #include <cuMat/IterativeLinearSolvers>
 
 #include "Utils.h"
@@ -99,4 +100,113 @@ TEST_CASE("Conjugate Gradient - Solve Dense Batched", "[CG]")
     REQUIRE(cg.iterations() <= cg.maxIterations()); //it should have converged
     REQUIRE(cg.error() <= cg.tolerance());         //the error should be lower than the tolerance
     assertMatrixEqualityRelative(x, xTruth, 1e-4);       //the true solution was found
-}
\ No newline at end of file
+}
+
+TEST_CASE("Conjugate Gradient - Convergence Check Schedule", "[CG]")
+{
+    internal::ConvergenceCheckSchedule s1(1, 10);
+    for (Index i = 0; i < 10; ++i) REQUIRE(s1.isCheckIteration(i));
+    REQUIRE(s1.numChecks() == 10);
+
+    internal::ConvergenceCheckSchedule s4(4, 10);
+    REQUIRE_FALSE(s4.isCheckIteration(0));
+    REQUIRE_FALSE(s4.isCheckIteration(2));
+    REQUIRE(s4.isCheckIteration(3));
+    REQUIRE(s4.isCheckIteration(7));
+    REQUIRE(s4.isCheckIteration(9)); //last iteration
+    REQUIRE(s4.numChecks() == 3);
+    REQUIRE(s4.nextCheckIteration(0) == 3);
+    REQUIRE(s4.nextCheckIteration(3) == 3);
+    REQUIRE(s4.nextCheckIteration(4) == 7);
+    REQUIRE(s4.nextCheckIteration(8) == 9);
+
+    internal::ConvergenceCheckSchedule s5(5, 10);
+    REQUIRE(s5.numChecks() == 2);
+    REQUIRE(s5.nextCheckIteration(9) == 9);
+}
+
+TEST_CASE("Conjugate Gradient - Device Convergence Check", "[CG]")
+{
+    constexpr int size = 50;
+    constexpr int batches = 3;
+    SimpleRandom rand;
+
+    MatrixXd A(size, size);
+    rand.fillUniform(A);
+    A += size * MatrixXd::Identity(size); //make diagonal dominant
+    typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+    Vec xTruth(size, 1, batches);
+    rand.fillUniform(xTruth);
+    Vec b = A * xTruth;
+
+    //reference: host-side check in every iteration
+    ConjugateGradient<MatrixXd> cgHost(A);
+    cgHost.setMaxIterations(10 * size);
+    cgHost.setTolerance(1e-6);
+    Vec xHost = cgHost.solve(b);
+
+    int intervals[] = { 1, 3, 8 };
+    for (int interval : intervals) SECTION("Interval=" + std::to_string(interval))
+    {
+        ConjugateGradient<MatrixXd> cg(A);
+        cg.setMaxIterations(10 * size);
+        cg.setTolerance(1e-6);
+        cg.setConvergenceCheckInterval(interval);
+        REQUIRE(cg.convergenceCheckInterval() == interval);
+        Vec x = cg.solve(b);
+        REQUIRE(cg.iterations() > 0);
+        REQUIRE(cg.iterations() <= cgHost.iterations()); //converged batches are frozen, not iterated further
+        REQUIRE(cg.error() <= cg.tolerance());
+        assertMatrixEqualityRelative(x, xTruth, 1e-4);
+        assertMatrixEqualityRelative(x, xHost, 1e-4);
+    }
+}
+
+TEST_CASE("Conjugate Gradient - Per-Batch Convergence Masking", "[CG]")
+{
+    //A = diag(1,...,n). Without preconditioning, CG terminates after as many iterations
+    //as there are distinct eigenvalues present in the right hand side, hence the batches converge at different iterations.
+    constexpr int size = 20;
+    constexpr int batches = 3;
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    typedef SparsityPattern<SparseFlags::CSR> SPattern;
+    SPattern pattern;
+    pattern.rows = size;
+    pattern.cols = size;
+    pattern.nnz = size;
+    pattern.IA = SPattern::IndexVector::fromEigen(Eigen::VectorXi::LinSpaced(size, 0, size - 1));
+    pattern.JA = SPattern::IndexVector::fromEigen(Eigen::VectorXi::LinSpaced(size + 1, 0, size));
+    SMatrix A(pattern);
+    A.getData().slice(0) = VectorXd::fromEigen(Eigen::VectorXd::LinSpaced(size, 1, size));
+
+    typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+    double bData[batches][size][1] = {};
+    double xData[batches][size][1] = {};
+    bData[0][0][0] = 1; //one eigenvalue -> converges in the first iteration
+    for (int i = 0; i < 3; ++i) bData[1][i][0] = 1; //three eigenvalues
+    for (int i = 0; i < size; ++i) bData[2][i][0] = 1; //all eigenvalues
+    for (int b = 0; b < batches; ++b) for (int i = 0; i < size; ++i) xData[b][i][0] = bData[b][i][0] / (i + 1);
+    Vec rhs(size, 1, batches);
+    rhs.copyFromHost(&bData[0][0][0]);
+    Vec xTruth(size, 1, batches);
+    xTruth.copyFromHost(&xData[0][0][0]);
+
+    int intervals[] = { 0, 1, 4 };
+    for (int interval : intervals) SECTION("Interval=" + std::to_string(interval))
+    {
+        ConjugateGradient<SMatrix, IdentityPreconditioner<SMatrix>> cg(A);
+        cg.setMaxIterations(10 * size);
+        cg.setTolerance(1e-8);
+        cg.setConvergenceCheckInterval(interval);
+        Vec x = cg.solve(rhs);
+        assertMatrixEqualityRelative(x, xTruth, 1e-6);
+
+        const std::vector<Index>& it = cg.batchIterations();
+        REQUIRE(it.size() == batches);
+        REQUIRE(it[0] == 0);
+        REQUIRE(it[1] == 2);
+        REQUIRE(it[2] > it[1]);
+        REQUIRE(it[2] < size);
+        REQUIRE(cg.iterations() == it[2]);
+    }
+}
@@ -0,0 +1,302 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+//power-law distributed row lengths, including empty rows
+static std::vector<int> powerLawRowLengths(int rows, int maxLength, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<int> lengths(rows);
+    for (int& l : lengths)
+        l = std::min(maxLength, static_cast<int>(std::pow(1 - u(rng), -1.0 / 1.2)) - 1);
+    return lengths;
+}
+
+static std::vector<double> hostProduct(const internal::HostCsrMatrix<double>& A, const std::vector<double>& x, int batches)
+{
+    std::vector<double> y(A.rows * batches, 0);
+    for (int b = 0; b < batches; ++b)
+        for (Index i = 0; i < A.rows; ++i)
+            for (int k = A.JA[i]; k < A.JA[i + 1]; ++k)
+                y[i + b * A.rows] += A.values[k] * x[A.IA[k] + b * A.cols];
+    return y;
+}
+
+static void testCsrSpMVAlgorithm(const internal::HostCsrMatrix<double>& hostA, CsrSpMVAlgorithm algorithm)
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    typedef Matrix<double, Dynamic, 1, 2, ColumnMajor> BVector;
+    SMatrix A = hostA.toSparseMatrix();
+    A.getSparsityPattern().setSpMVAlgorithm(algorithm);
+    REQUIRE(A.getSparsityPattern().rowAnalysis().algorithm == algorithm);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> value(-1, 1);
+    std::vector<double> hostX(hostA.cols * 2), hostY0(hostA.rows * 2);
+    for (double& v : hostX) v = value(rng);
+    for (double& v : hostY0) v = value(rng);
+    const std::vector<double> expected = hostProduct(hostA, hostX, 2);
+    BVector x(hostA.cols, 1, 2);
+    x.copyFromHost(hostX.data());
+
+    SECTION("assign")
+    {
+        BVector y = A * x;
+        std::vector<double> actual(hostA.rows * 2);
+        y.copyToHost(actual.data());
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            INFO("i=" << i);
+            REQUIRE(actual[i] == Approx(expected[i]).margin(1e-10));
+        }
+    }
+    SECTION("add")
+    {
+        BVector y(hostA.rows, 1, 2);
+        y.copyFromHost(hostY0.data());
+        y += A * x;
+        std::vector<double> actual(hostA.rows * 2);
+        y.copyToHost(actual.data());
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            INFO("i=" << i);
+            REQUIRE(actual[i] == Approx(expected[i] + hostY0[i]).margin(1e-10));
+        }
+    }
+}
+
+TEST_CASE("CSR SpMV - algorithm selection", "[Sparse]")
+{
+    typedef internal::CsrSpMVAlgorithmSelection Sel;
+
+    SECTION("statistics")
+    {
+        const std::vector<int> JA = { 0, 2, 2, 7, 8 };
+        internal::CsrRowStatistics s = internal::CsrRowStatistics::compute(JA.data(), 4);
+        REQUIRE(s.rows == 4);
+        REQUIRE(s.nnz == 8);
+        REQUIRE(s.minRowLength == 0);
+        REQUIRE(s.maxRowLength == 5);
+        REQUIRE(s.emptyRows == 1);
+        REQUIRE(s.meanRowLength == Approx(2));
+        REQUIRE(s.stdDevRowLength == Approx(std::sqrt(4.5)));
+    }
+    SECTION("threads per row")
+    {
+        REQUIRE(Sel::threadsPerRow(1) == 2);
+        REQUIRE(Sel::threadsPerRow(3) == 4);
+        REQUIRE(Sel::threadsPerRow(9) == 16);
+        REQUIRE(Sel::threadsPerRow(500) == 32);
+    }
+    SECTION("selection")
+    {
+        internal::CsrRowStatistics s;
+        //too small
+        s.nnz = 1000; s.meanRowLength = 100; s.maxRowLength = 5000;
+        REQUIRE(Sel::select(s) == CsrSpMVAlgorithm::Scalar);
+        //2D Poisson
+        s.nnz = 5000000; s.meanRowLength = 5; s.maxRowLength = 5;
+        REQUIRE(Sel::select(s) == CsrSpMVAlgorithm::Scalar);
+        //banded with a wide band
+        s.meanRowLength = 33; s.maxRowLength = 33;
+        REQUIRE(Sel::select(s) == CsrSpMVAlgorithm::Vector);
+        //irregular
+        s.meanRowLength = 6; s.maxRowLength = 300;
+        REQUIRE(Sel::select(s) == CsrSpMVAlgorithm::Stream);
+        s.maxRowLength = 100000;
+        REQUIRE(Sel::select(s) == CsrSpMVAlgorithm::MergePath);
+    }
+    SECTION("stream row blocks")
+    {
+        //rows of length 600, 300, 200, 2000, 0, 10
+        const std::vector<int> JA = { 0, 600, 900, 1100, 3100, 3100, 3110 };
+        const std::vector<int> blocks = Sel::streamRowBlocks(JA.data(), 6);
+        REQUIRE(blocks == std::vector<int>({ 0, 2, 3, 4, 6 }));
+        //many short rows: limited by the number of rows per block
+        const std::vector<int> empty(3001, 0);
+        REQUIRE(Sel::streamRowBlocks(empty.data(), 3000) == std::vector<int>({ 0, 1024, 2048, 3000 }));
+    }
+    SECTION("merge path threads")
+    {
+        REQUIRE(Sel::mergePathThreads(0, 0) == 1);
+        REQUIRE(Sel::mergePathThreads(10, 30) == 5);
+        REQUIRE(Sel::mergePathThreads(10, 31) == 6);
+    }
+}
+
+TEST_CASE("CSR SpMV - cached row analysis", "[Sparse]")
+{
+    internal::HostCsrMatrix<double> hostA = randomCsrMatrix(powerLawRowLengths(20000, 5000, 1), 6000, 2);
+    SparseMatrix<double, 1, SparseFlags::CSR> A = hostA.toSparseMatrix();
+    REQUIRE(A.getSparsityPattern().getSpMVAlgorithm() == CsrSpMVAlgorithm::Automatic);
+    const internal::CsrRowAnalysis& analysis = A.getSparsityPattern().rowAnalysis();
+    REQUIRE(analysis.statistics.rows == 20000);
+    REQUIRE(analysis.statistics.nnz == hostA.nnz());
+    REQUIRE(analysis.statistics.maxRowLength > internal::CsrSpMVAlgorithmSelection::STREAM_NNZ_PER_BLOCK);
+    REQUIRE(analysis.algorithm == CsrSpMVAlgorithm::MergePath);
+
+    //shared between copies, not between deep clones
+    SparseMatrix<double, 1, SparseFlags::CSR> B = A;
+    B.getSparsityPattern().setSpMVAlgorithm(CsrSpMVAlgorithm::Vector);
+    REQUIRE(A.getSparsityPattern().rowAnalysis().algorithm == CsrSpMVAlgorithm::Vector);
+    SparsityPattern<SparseFlags::CSR> clone = A.getSparsityPattern().deepClone();
+    REQUIRE(clone.getSpMVAlgorithm() == CsrSpMVAlgorithm::Vector);
+    clone.setSpMVAlgorithm(CsrSpMVAlgorithm::Automatic);
+    REQUIRE(A.getSparsityPattern().getSpMVAlgorithm() == CsrSpMVAlgorithm::Vector);
+    REQUIRE(clone.rowAnalysis().algorithm == CsrSpMVAlgorithm::MergePath);
+}
+
+TEST_CASE("CSR SpMV - row analysis after replacing the outer indices", "[Sparse]")
+{
+    //same rows and nnz, different row lengths
+    const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(std::vector<int>(200, 4), 500, 1);
+    std::vector<int> lengths(200, 2);
+    lengths[0] = 402;
+    const internal::HostCsrMatrix<double> hostB = randomCsrMatrix(lengths, 500, 2);
+    REQUIRE(hostA.nnz() == hostB.nnz());
+
+    SparsityPattern<SparseFlags::CSR> pattern = hostA.toSparsityPattern();
+    REQUIRE(pattern.rowAnalysis().statistics.maxRowLength == 4);
+    //the old outer indices are released, the new ones are allocated from the caching allocator
+    pattern.JA = SparsityPattern<SparseFlags::CSR>::IndexVector();
+    pattern.JA = SparsityPattern<SparseFlags::CSR>::IndexVector(hostB.JA.size());
+    pattern.JA.copyFromHost(hostB.JA.data());
+    pattern.IA.copyFromHost(hostB.IA.data());
+    REQUIRE(pattern.rowAnalysis().statistics.maxRowLength == 402);
+}
+
+TEST_CASE("CSR SpMV - kernels", "[Sparse]")
+{
+    SECTION("power-law")
+    {
+        internal::HostCsrMatrix<double> A = randomCsrMatrix(powerLawRowLengths(3000, 3000, 3), 4000, 4);
+        SECTION("Scalar") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Scalar); }
+        SECTION("Vector") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Vector); }
+        SECTION("Stream") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Stream); }
+        SECTION("MergePath") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::MergePath); }
+    }
+    SECTION("banded")
+    {
+        internal::HostCsrMatrix<double> A = randomCsrMatrix(std::vector<int>(2000, 17), 2000, 5);
+        SECTION("Scalar") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Scalar); }
+        SECTION("Vector") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Vector); }
+        SECTION("Stream") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Stream); }
+        SECTION("MergePath") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::MergePath); }
+    }
+    SECTION("empty rows and a dense row")
+    {
+        std::vector<int> lengths(1500, 0);
+        for (int i = 0; i < 1500; i += 7) lengths[i] = 3;
+        lengths[700] = 5000;
+        internal::HostCsrMatrix<double> A = randomCsrMatrix(lengths, 5000, 6);
+        SECTION("Scalar") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Scalar); }
+        SECTION("Vector") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Vector); }
+        SECTION("Stream") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::Stream); }
+        SECTION("MergePath") { testCsrSpMVAlgorithm(A, CsrSpMVAlgorithm::MergePath); }
+    }
+}
+
+TEST_CASE("CSR SpMM - thread mapping", "[Sparse]")
+{
+    typedef internal::CsrSpMMAlgorithmSelection Sel;
+    SECTION("column-major and few columns: row per thread")
+    {
+        REQUIRE_FALSE(Sel::useLanes(32, false));
+        REQUIRE_FALSE(Sel::useLanes(4, true));
+        REQUIRE(Sel::columnsPerThread(4, false) == 4);
+        REQUIRE(Sel::columnTiles(4) == 1);
+        REQUIRE(Sel::columnsPerThread(40, false) == 16);
+        REQUIRE(Sel::columnTiles(40) == 3);
+    }
+    SECTION("row-major: lanes over columns")
+    {
+        REQUIRE(Sel::useLanes(8, true));
+        REQUIRE(Sel::threadsPerRow(8) == 8);
+        REQUIRE(Sel::columnsPerThread(8, true) == 1);
+        REQUIRE(Sel::threadsPerRow(20) == 16);
+        REQUIRE(Sel::columnsPerThread(20, true) == 2);
+        REQUIRE(Sel::threadsPerRow(64) == 32);
+        REQUIRE(Sel::columnsPerThread(64, true) == 2);
+    }
+}
+
+//index of the entry (row, column, batch) in the memory of a dense matrix
+template<int _Flags>
+static Index denseIndex(Index row, Index col, Index batch, Index rows, Index cols)
+{
+    return CUMAT_IS_COLUMN_MAJOR(_Flags)
+        ? row + rows * (col + cols * batch)
+        : col + cols * (row + rows * batch);
+}
+
+template<int _Columns, int _Flags>
+static void testCsrSpMM(const internal::HostCsrMatrix<double>& hostA)
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    typedef Matrix<double, Dynamic, _Columns, 2, _Flags> Dense;
+    SMatrix A = hostA.toSparseMatrix();
+    const Index rows = hostA.rows, cols = hostA.cols;
+
+    std::mt19937 rng(_Columns);
+    std::uniform_real_distribution<double> value(-1, 1);
+    std::vector<double> hostX(cols * _Columns * 2), hostY0(rows * _Columns * 2);
+    for (double& v : hostX) v = value(rng);
+    for (double& v : hostY0) v = value(rng);
+    std::vector<double> expected(rows * _Columns * 2, 0);
+    for (int b = 0; b < 2; ++b)
+        for (int c = 0; c < _Columns; ++c)
+            for (Index i = 0; i < rows; ++i)
+                for (int k = hostA.JA[i]; k < hostA.JA[i + 1]; ++k)
+                    expected[denseIndex<_Flags>(i, c, b, rows, _Columns)] +=
+                        hostA.values[k] * hostX[denseIndex<_Flags>(hostA.IA[k], c, b, cols, _Columns)];
+    Dense X(cols, _Columns, 2);
+    X.copyFromHost(hostX.data());
+
+    SECTION("assign")
+    {
+        Dense Y = A * X;
+        std::vector<double> actual(rows * _Columns * 2);
+        Y.copyToHost(actual.data());
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            INFO("i=" << i);
+            REQUIRE(actual[i] == Approx(expected[i]).margin(1e-10));
+        }
+    }
+    SECTION("add")
+    {
+        Dense Y(rows, _Columns, 2);
+        Y.copyFromHost(hostY0.data());
+        Y += A * X;
+        std::vector<double> actual(rows * _Columns * 2);
+        Y.copyToHost(actual.data());
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            INFO("i=" << i);
+            REQUIRE(actual[i] == Approx(expected[i] + hostY0[i]).margin(1e-10));
+        }
+    }
+}
+
+TEST_CASE("CSR SpMM - kernels", "[Sparse]")
+{
+    std::vector<int> lengths = powerLawRowLengths(700, 300, 7);
+    lengths[5] = 0;
+    internal::HostCsrMatrix<double> A = randomCsrMatrix(lengths, 500, 8);
+    SECTION("column-major, 4 columns") { testCsrSpMM<4, ColumnMajor>(A); }
+    SECTION("column-major, 20 columns") { testCsrSpMM<20, ColumnMajor>(A); }
+    SECTION("column-major, 48 columns") { testCsrSpMM<48, ColumnMajor>(A); }
+    SECTION("row-major, 4 columns") { testCsrSpMM<4, RowMajor>(A); }
+    SECTION("row-major, 8 columns") { testCsrSpMM<8, RowMajor>(A); }
+    SECTION("row-major, 20 columns") { testCsrSpMM<20, RowMajor>(A); }
+    SECTION("row-major, 48 columns") { testCsrSpMM<48, RowMajor>(A); }
+}
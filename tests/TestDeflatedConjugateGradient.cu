@@ -0,0 +1,123 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <cuMat/IterativeLinearSolvers>
+#include <cuMat/src/SimpleRandom.h>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+//2D Poisson matrix with a diagonal shift
+static SparseMatrix<double, 1, SparseFlags::CSR> shiftedPoisson2D(int nx, int ny, double shift)
+{
+    internal::HostCsrMatrix<double> A = hostPoisson2D(nx, ny);
+    for (Index i = 0; i < A.rows; ++i)
+        for (int k = A.JA[i]; k < A.JA[i + 1]; ++k)
+            if (A.IA[k] == i) A.values[k] += shift;
+    return A.toSparseMatrix();
+}
+
+TEST_CASE("Deflated Conjugate Gradient - Deflation space update", "[CG]")
+{
+    SECTION("smallest Ritz values")
+    {
+        //orthonormal candidate space, G is diagonal
+        const int k = 4;
+        std::vector<double> G = { 5, 0, 0, 0,   0, 1, 0, 0,   0, 0, 3, 0,   0, 0, 0, 2 };
+        std::vector<double> F = { 1, 0, 0, 0,   0, 1, 0, 0,   0, 0, 1, 0,   0, 0, 0, 1 };
+        std::vector<double> U, ritz;
+        REQUIRE(internal::recycleDeflationSpace(k, G, F, 2, 1e-6, U, &ritz) == 2);
+        REQUIRE(ritz[0] == Approx(1));
+        REQUIRE(ritz[1] == Approx(2));
+        REQUIRE(std::abs(U[1]) == Approx(1));
+        REQUIRE(std::abs(U[k + 3]) == Approx(1));
+    }
+    SECTION("zero and dependent columns are dropped")
+    {
+        //Y = [y0, 2*y0, 0] with A y0 = 3 y0
+        const int k = 3;
+        std::vector<double> G = { 3, 6, 0,   6, 12, 0,   0, 0, 0 };
+        std::vector<double> F = { 1, 2, 0,   2, 4, 0,    0, 0, 0 };
+        std::vector<double> U, ritz;
+        REQUIRE(internal::recycleDeflationSpace(k, G, F, 2, 1e-6, U, &ritz) == 1);
+        REQUIRE(ritz[0] == Approx(3));
+        //Y u must have unit length: (u0 + 2 u1)^2 = 1
+        REQUIRE(std::abs(U[0] + 2 * U[1]) == Approx(1));
+        REQUIRE(U[2] == 0);
+    }
+}
+
+TEST_CASE("Deflated Conjugate Gradient - Sequence of systems", "[CG]")
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    const int nx = 48, ny = 40;
+    SimpleRandom rand;
+    DeflatedConjugateGradient<SMatrix> cg(shiftedPoisson2D(nx, ny, 0));
+    cg.setTolerance(1e-8);
+    std::vector<Index> iterations;
+    for (int step = 0; step < 6; ++step)
+    {
+        //slowly changing matrix, new right hand side in every step
+        const SMatrix A = shiftedPoisson2D(nx, ny, 0.001 * step);
+        if (step > 0) cg.setMatrix(A);
+        VectorXd xTruth(A.rows());
+        rand.fillUniform(xTruth);
+        VectorXd b = A * xTruth;
+        VectorXd x = cg.solve(b);
+        INFO("step " << step << ": iterations=" << cg.iterations() << ", error=" << cg.error());
+        REQUIRE(cg.error() <= cg.tolerance());
+        assertMatrixEqualityRelative(x, xTruth, 1e-5);
+        iterations.push_back(cg.iterations());
+    }
+    INFO("iterations: first=" << iterations.front() << ", last=" << iterations.back());
+    REQUIRE(iterations.back() * 4 < iterations.front() * 3);
+    REQUIRE(cg.deflationSpaceSize() == cg.deflationSize());
+    //the smallest Ritz value approximates the smallest eigenvalue
+    const double shift = 0.005;
+    const double lambdaMin = 4 + shift - 2 * std::cos(M_PI / (nx + 1)) - 2 * std::cos(M_PI / (ny + 1));
+    REQUIRE(cg.ritzValues()[0] >= lambdaMin * 0.999);
+    REQUIRE(cg.ritzValues()[0] <= lambdaMin * 1.2);
+
+    SECTION("carry the deflation space to a new solver")
+    {
+        const SMatrix A = shiftedPoisson2D(nx, ny, 0.01);
+        VectorXd xTruth(A.rows());
+        rand.fillUniform(xTruth);
+        VectorXd b = A * xTruth;
+
+        ConjugateGradient<SMatrix> plain(A);
+        plain.setTolerance(1e-8);
+        VectorXd x1 = plain.solve(b);
+
+        DeflatedConjugateGradient<SMatrix> deflated(A);
+        deflated.setTolerance(1e-8);
+        deflated.setDeflationSpace(cg.deflationSpace());
+        REQUIRE(deflated.deflationSpaceSize() == cg.deflationSpaceSize());
+        VectorXd x2 = deflated.solve(b);
+        INFO("iterations: plain=" << plain.iterations() << ", deflated=" << deflated.iterations());
+        REQUIRE(deflated.error() <= deflated.tolerance());
+        REQUIRE(deflated.iterations() < plain.iterations());
+        assertMatrixEqualityRelative(x2, xTruth, 1e-5);
+    }
+    SECTION("fixed deflation space")
+    {
+        cg.setRecycling(false);
+        const typename DeflatedConjugateGradient<SMatrix>::BasisType W = cg.deflationSpace();
+        VectorXd b(nx * ny);
+        rand.fillUniform(b);
+        VectorXd x = cg.solve(b);
+        REQUIRE(cg.deflationSpace().data() == W.data());
+    }
+    SECTION("clear")
+    {
+        cg.clearDeflationSpace();
+        REQUIRE(cg.deflationSpaceSize() == 0);
+        VectorXd b(nx * ny);
+        rand.fillUniform(b);
+        VectorXd x = cg.solve(b);
+        REQUIRE(cg.error() <= cg.tolerance());
+    }
+}
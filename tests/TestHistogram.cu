@@ -0,0 +1,131 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+
+#include <cuMat/Core>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Histogram - algorithm selection", "[histogram]")
+{
+    typedef internal::HistogramAlgorithmSelection Sel;
+
+    SECTION("windows")
+    {
+        REQUIRE(Sel::binsPerWindow(100, 48 * 1024, sizeof(int)) == 100);
+        REQUIRE(Sel::binsPerWindow(100000, 48 * 1024, sizeof(int)) == 12 * 1024);
+        REQUIRE(Sel::binsPerWindow(100000, 48 * 1024, sizeof(double)) == 6 * 1024);
+        REQUIRE(Sel::numWindows(100, 100) == 1);
+        REQUIRE(Sel::numWindows(100000, 12 * 1024) == 9);
+    }
+    SECTION("blocks")
+    {
+        //limited by the input size
+        REQUIRE(Sel::blocksPerWindow(100, 1000, 1, 1) == 1);
+        REQUIRE(Sel::blocksPerWindow(1000, 1000, 1, 1) == 4);
+        //limited by the resident blocks
+        REQUIRE(Sel::blocksPerWindow(1000000, 160, 2, 4) == 20);
+        //at least one block
+        REQUIRE(Sel::blocksPerWindow(1000000, 16, 4, 100) == 1);
+    }
+    SECTION("selection")
+    {
+        REQUIRE(Sel::select(1000000, 256, 1) == internal::HistogramAlgorithm::Shared);
+        REQUIRE(Sel::select(100, 256, 1) == internal::HistogramAlgorithm::Global);
+        REQUIRE(Sel::select(100000000, 1000000, 82) == internal::HistogramAlgorithm::Global);
+    }
+}
+
+template<typename _Algorithm>
+void testHistogramSmall()
+{
+    SECTION("bincount")
+    {
+        int data[1][2][5] = { { {0, 3, 3, -1, 5}, {1, 3, 0, 4, 7} } };
+        BMatrixXiR m = BMatrixXiR::fromArray(data);
+        int expected[1][5][1] = { { {2}, {1}, {0}, {3}, {1} } };
+        assertMatrixEquality(expected, bincount<_Algorithm>(m, 5));
+    }
+    SECTION("bincount - batched")
+    {
+        int data[2][1][4] = { { {0, 1, 1, 2} }, { {2, 2, 2, 0} } };
+        BMatrixXiR m = BMatrixXiR::fromArray(data);
+        int expected[2][3][1] = { { {1}, {2}, {1} }, { {1}, {0}, {3} } };
+        assertMatrixEquality(expected, bincount<_Algorithm>(m, 3));
+    }
+    SECTION("bincount - weighted")
+    {
+        int data[1][1][5] = { { {0, 2, 2, 1, 3} } };
+        float weights[1][1][5] = { { {0.5f, 1.0f, 2.0f, 4.0f, 8.0f} } };
+        BMatrixXiR m = BMatrixXiR::fromArray(data);
+        BMatrixXfR w = BMatrixXfR::fromArray(weights);
+        float expected[1][3][1] = { { {0.5f}, {4.0f}, {3.0f} } };
+        assertMatrixEquality(expected, bincount<_Algorithm>(m, w, 3));
+    }
+    SECTION("histogram")
+    {
+        //range [0,1] with 4 bins: the upper end belongs to the last bin, outside values are ignored
+        float data[1][1][8] = { { {0.0f, 0.1f, 0.3f, 0.3f, 0.6f, 1.0f, -0.1f, 1.5f} } };
+        BMatrixXfR m = BMatrixXfR::fromArray(data);
+        int expected[1][4][1] = { { {2}, {2}, {1}, {1} } };
+        assertMatrixEquality(expected, histogram<_Algorithm>(m, 4, 0.0f, 1.0f));
+    }
+    SECTION("histogram - expression")
+    {
+        float data[1][1][6] = { { {0.0f, 0.1f, 0.2f, 0.3f, 0.4f, 0.5f} } };
+        BMatrixXfR m = BMatrixXfR::fromArray(data);
+        int expected[1][2][1] = { { {3}, {3} } };
+        assertMatrixEquality(expected, histogram<_Algorithm>(m * 2.0f, 2, 0.0f, 1.0f));
+    }
+    SECTION("histogram - weighted")
+    {
+        double data[1][1][4] = { { {-1.0, 0.5, 0.9, 0.2} } };
+        double weights[1][1][4] = { { {1.0, 2.0, 3.0, 4.0} } };
+        BMatrixXdR m = BMatrixXdR::fromArray(data);
+        BMatrixXdR w = BMatrixXdR::fromArray(weights);
+        double expected[1][2][1] = { { {1.0}, {9.0} } };
+        assertMatrixEquality(expected, histogram<_Algorithm>(m, w, 2, -1.0, 1.0));
+    }
+}
+TEST_CASE("Histogram - small", "[histogram]")
+{
+    SECTION("Global") { testHistogramSmall<HistogramAlg::Global>(); }
+    SECTION("Shared") { testHistogramSmall<HistogramAlg::Shared>(); }
+    SECTION("Auto") { testHistogramSmall<HistogramAlg::Auto>(); }
+}
+
+template<typename _Algorithm>
+void testBincountLarge(int size, int bins, int batches)
+{
+    std::default_random_engine rnd(42);
+    std::uniform_int_distribution<int> distr(-10, bins + 10);
+    std::vector<int> values(size * batches);
+    std::vector<int> expected(bins * batches, 0);
+    for (int b = 0; b < batches; ++b)
+        for (int i = 0; i < size; ++i)
+        {
+            int v = distr(rnd);
+            values[i + size * b] = v;
+            if (v >= 0 && v < bins) expected[v + bins * b]++;
+        }
+    BVectorXi m(size, 1, batches);
+    m.copyFromHost(values.data());
+
+    BVectorXi counts = bincount<_Algorithm>(m, bins);
+    REQUIRE(counts.rows() == bins);
+    REQUIRE(counts.batches() == batches);
+    std::vector<int> actual(bins * batches);
+    counts.copyToHost(actual.data());
+    REQUIRE(actual == expected);
+}
+TEST_CASE("Histogram - large", "[histogram]")
+{
+    SECTION("Global - few bins") { testBincountLarge<HistogramAlg::Global>(100000, 64, 3); }
+    SECTION("Shared - few bins") { testBincountLarge<HistogramAlg::Shared>(100000, 64, 3); }
+    //more bins than fit into shared memory -> multiple windows
+    SECTION("Global - many bins") { testBincountLarge<HistogramAlg::Global>(100000, 40000, 2); }
+    SECTION("Shared - many bins") { testBincountLarge<HistogramAlg::Shared>(100000, 40000, 2); }
+    SECTION("Auto") { testBincountLarge<HistogramAlg::Auto>(200000, 1000, 2); }
+}
@@ -0,0 +1,157 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <cuMat/IterativeLinearSolvers>
+#include <cuMat/src/SimpleRandom.h>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Sparse Triangular Solve - Levels", "[Sparse][Triangular]")
+{
+    SECTION("diagonal")
+    {
+        std::vector<int> JA = { 0, 1, 2, 3 }, IA = { 0, 1, 2 };
+        REQUIRE(SparseTriangularSolver::computeLevels(JA, IA, true) == std::vector<int>({ 0, 0, 0 }));
+        REQUIRE(SparseTriangularSolver::computeLevels(JA, IA, false) == std::vector<int>({ 0, 0, 0 }));
+    }
+    SECTION("tridiagonal")
+    {
+        const auto A = hostPoisson2D(5, 1);
+        REQUIRE(SparseTriangularSolver::computeLevels(A.JA, A.IA, true) == std::vector<int>({ 0, 1, 2, 3, 4 }));
+        REQUIRE(SparseTriangularSolver::computeLevels(A.JA, A.IA, false) == std::vector<int>({ 4, 3, 2, 1, 0 }));
+    }
+    SECTION("2D Poisson, wavefronts")
+    {
+        const int nx = 6, ny = 4;
+        const auto A = hostPoisson2D(nx, ny);
+        const auto lower = SparseTriangularSolver::computeLevels(A.JA, A.IA, true);
+        const auto upper = SparseTriangularSolver::computeLevels(A.JA, A.IA, false);
+        for (int y = 0; y < ny; ++y) for (int x = 0; x < nx; ++x)
+        {
+            REQUIRE(lower[x + nx * y] == x + y);
+            REQUIRE(upper[x + nx * y] == (nx - 1 - x) + (ny - 1 - y));
+        }
+        SparseTriangularSolver solver(A.toSparsityPattern(), SparseTriangularSolver::Lower);
+        REQUIRE(solver.numLevels() == nx + ny - 1);
+    }
+}
+
+TEST_CASE("Sparse Triangular Solve - Solve", "[Sparse][Triangular]")
+{
+    //nonsymmetric values in the 2D Poisson pattern
+    auto hostA = hostPoisson2D(7, 5);
+    for (Index i = 0; i < hostA.rows; ++i)
+        for (int k = hostA.JA[i]; k < hostA.JA[i + 1]; ++k)
+            if (hostA.IA[k] != i) hostA.values[k] = -0.5 - 0.1 * ((i + 3 * hostA.IA[k]) % 5);
+    const Eigen::MatrixXd Ad = hostToEigen(hostA);
+    const SparseMatrix<double, 1, SparseFlags::CSR> A = hostA.toSparseMatrix();
+    const int n = static_cast<int>(hostA.rows);
+    constexpr int batches = 2;
+    typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+    SimpleRandom rand;
+    Vec b(n, 1, batches);
+    rand.fillUniform(b);
+    std::vector<double> bHost(n * batches);
+    b.copyToHost(bHost.data());
+
+    auto check = [&](int mode, const Eigen::MatrixXd& T)
+    {
+        SparseTriangularSolver solver(A.getSparsityPattern(), mode);
+        Vec x = b.deepClone();
+        solver.solveInPlace(A, x);
+        std::vector<double> xHost(n * batches);
+        x.copyToHost(xHost.data());
+        for (int batch = 0; batch < batches; ++batch)
+        {
+            const Eigen::VectorXd expected = T.lu().solve(Eigen::Map<const Eigen::VectorXd>(bHost.data() + batch * n, n));
+            const Eigen::VectorXd actual = Eigen::Map<const Eigen::VectorXd>(xHost.data() + batch * n, n);
+            INFO("batch " << batch);
+            REQUIRE(actual.isApprox(expected, 1e-10));
+        }
+    };
+    SECTION("lower")
+    {
+        check(SparseTriangularSolver::Lower, Ad.triangularView<Eigen::Lower>().toDenseMatrix());
+    }
+    SECTION("lower, unit diagonal")
+    {
+        check(SparseTriangularSolver::Lower | SparseTriangularSolver::UnitDiagonal, Ad.triangularView<Eigen::UnitLower>().toDenseMatrix());
+    }
+    SECTION("upper")
+    {
+        check(SparseTriangularSolver::Upper, Ad.triangularView<Eigen::Upper>().toDenseMatrix());
+    }
+    SECTION("transposed lower")
+    {
+        check(SparseTriangularSolver::TransposedLower, Ad.triangularView<Eigen::Lower>().toDenseMatrix().transpose());
+    }
+}
+
+TEST_CASE("Incomplete Factorization - Exact on tridiagonal matrices", "[Sparse][ILU]")
+{
+    //without fill-in, the incomplete factorizations of a tridiagonal matrix are exact
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    const auto hostA = hostPoisson2D(30, 1);
+    const SMatrix A = hostA.toSparseMatrix();
+    VectorXd xTruth(hostA.rows);
+    SimpleRandom rand;
+    rand.fillUniform(xTruth);
+    VectorXd b = A * xTruth;
+    SECTION("ILU(0)")
+    {
+        IncompleteLUPreconditioner<SMatrix> ilu(A);
+        VectorXd x = ilu.solve(b);
+        assertMatrixEqualityRelative(x, xTruth, 1e-8);
+    }
+    SECTION("IC(0)")
+    {
+        IncompleteCholeskyPreconditioner<SMatrix> ic(A);
+        VectorXd x = ic.solve(b);
+        assertMatrixEqualityRelative(x, xTruth, 1e-8);
+    }
+    SECTION("refactorization")
+    {
+        IncompleteCholeskyPreconditioner<SMatrix> ic;
+        ic.analyzePattern(A);
+        SMatrix A2 = A.deepClone();
+        A2 *= 4.0;
+        ic.factorize(A2);
+        VectorXd x = ic.solve(b);
+        VectorXd expected = xTruth * 0.25;
+        assertMatrixEqualityRelative(x, expected, 1e-8);
+    }
+}
+
+template<typename _Preconditioner>
+void testIncompleteFactorizationCG()
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    typedef Matrix<double, Dynamic, 1, 2, ColumnMajor> Vec;
+    const SMatrix A = hostPoisson2D(48, 40).toSparseMatrix();
+    SimpleRandom rand;
+    Vec xTruth(A.rows(), 1, 2);
+    rand.fillUniform(xTruth);
+    Vec b = A * xTruth;
+
+    ConjugateGradient<SMatrix, IdentityPreconditioner<SMatrix>> cgPlain(A);
+    cgPlain.setTolerance(1e-8);
+    Vec xPlain = cgPlain.solve(b);
+
+    ConjugateGradient<SMatrix, _Preconditioner> cg(A);
+    cg.setTolerance(1e-8);
+    Vec x = cg.solve(b);
+    INFO("iterations: none=" << cgPlain.iterations() << ", incomplete factorization=" << cg.iterations());
+    REQUIRE(cg.error() <= cg.tolerance());
+    REQUIRE(cg.iterations() * 2 < cgPlain.iterations());
+    assertMatrixEqualityRelative(x, xTruth, 1e-5);
+}
+TEST_CASE("Incomplete Factorization - Conjugate Gradient", "[Sparse][ILU][CG]")
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    SECTION("ILU(0)") { testIncompleteFactorizationCG<IncompleteLUPreconditioner<SMatrix>>(); }
+    SECTION("IC(0)") { testIncompleteFactorizationCG<IncompleteCholeskyPreconditioner<SMatrix>>(); }
+}
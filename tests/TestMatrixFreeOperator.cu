@@ -0,0 +1,136 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/src/SimpleRandom.h>
+#include <cuMat/IterativeLinearSolvers>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+//assembles the dense matrix of the 7-point stencil, x runs fastest (nz=1 gives the 5-point stencil)
+static Eigen::MatrixXd assembleStencil(int nx, int ny, int nz, double center, double wx, double wy, double wz)
+{
+    const int n = nx * ny * nz;
+    Eigen::MatrixXd A = Eigen::MatrixXd::Zero(n, n);
+    for (int z = 0; z < nz; ++z) for (int y = 0; y < ny; ++y) for (int x = 0; x < nx; ++x)
+    {
+        const int i = x + nx * (y + ny * z);
+        A(i, i) = center;
+        if (x > 0) A(i, i - 1) = wx;
+        if (x < nx - 1) A(i, i + 1) = wx;
+        if (y > 0) A(i, i - nx) = wy;
+        if (y < ny - 1) A(i, i + nx) = wy;
+        if (z > 0) A(i, i - nx * ny) = wz;
+        if (z < nz - 1) A(i, i + nx * ny) = wz;
+    }
+    return A;
+}
+
+TEST_CASE("Matrix-Free Operator - 5-point stencil", "[MatrixFree]")
+{
+    const int nx = 7, ny = 5;
+    SimpleRandom rand;
+    SECTION("default coefficients")
+    {
+        Stencil5PointOperator<double> stencil(nx, ny);
+        REQUIRE(stencil.rows() == nx * ny);
+        REQUIRE(stencil.cols() == nx * ny);
+        MatrixXd A = MatrixXd::fromEigen(assembleStencil(nx, ny, 1, 4, -1, -1, 0));
+        VectorXd v(nx * ny);
+        rand.fillUniform(v);
+        VectorXd expected = A * v;
+        VectorXd actual = stencil * v;
+        assertMatrixEqualityRelative(expected, actual, 1e-10);
+    }
+    SECTION("custom coefficients, add-assignment")
+    {
+        Stencil5PointOperator<double> stencil(nx, ny, 3.0, -0.5, -1.5);
+        MatrixXd A = MatrixXd::fromEigen(assembleStencil(nx, ny, 1, 3.0, -0.5, -1.5, 0));
+        VectorXd v(nx * ny), w(nx * ny);
+        rand.fillUniform(v);
+        rand.fillUniform(w);
+        VectorXd expected = w + A * v;
+        VectorXd actual = w.deepClone();
+        actual += stencil * v;
+        assertMatrixEqualityRelative(expected, actual, 1e-10);
+    }
+    SECTION("batched")
+    {
+        constexpr int batches = 3;
+        typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+        Stencil5PointOperator<double, batches> stencil(nx, ny);
+        MatrixXd A = MatrixXd::fromEigen(assembleStencil(nx, ny, 1, 4, -1, -1, 0));
+        Vec v(nx * ny, 1, batches);
+        rand.fillUniform(v);
+        Vec expected = A * v;
+        Vec actual = stencil * v;
+        assertMatrixEqualityRelative(expected, actual, 1e-10);
+    }
+}
+
+TEST_CASE("Matrix-Free Operator - 7-point stencil", "[MatrixFree]")
+{
+    const int nx = 4, ny = 3, nz = 5;
+    SimpleRandom rand;
+    SECTION("default coefficients")
+    {
+        Stencil7PointOperator<double> stencil(nx, ny, nz);
+        REQUIRE(stencil.rows() == nx * ny * nz);
+        MatrixXd A = MatrixXd::fromEigen(assembleStencil(nx, ny, nz, 6, -1, -1, -1));
+        VectorXd v(nx * ny * nz);
+        rand.fillUniform(v);
+        VectorXd expected = A * v;
+        VectorXd actual = stencil * v;
+        assertMatrixEqualityRelative(expected, actual, 1e-10);
+    }
+    SECTION("custom coefficients")
+    {
+        Stencil7PointOperator<double> stencil(nx, ny, nz, 8.0, -1.0, -2.0, -0.5);
+        MatrixXd A = MatrixXd::fromEigen(assembleStencil(nx, ny, nz, 8.0, -1.0, -2.0, -0.5));
+        VectorXd v(nx * ny * nz);
+        rand.fillUniform(v);
+        VectorXd expected = A * v;
+        VectorXd actual = stencil * v;
+        assertMatrixEqualityRelative(expected, actual, 1e-10);
+    }
+}
+
+TEST_CASE("Matrix-Free Operator - Conjugate Gradient", "[MatrixFree][CG]")
+{
+    const int nx = 16, ny = 12, nz = 6;
+    SimpleRandom rand;
+    SECTION("5-point")
+    {
+        typedef Stencil5PointOperator<double> Op;
+        Op stencil(nx, ny);
+        VectorXd xTruth(nx * ny);
+        rand.fillUniform(xTruth);
+        VectorXd b = stencil * xTruth;
+
+        ConjugateGradient<Op, IdentityPreconditioner<Op>> cg(stencil);
+        cg.setTolerance(1e-8);
+        VectorXd x = cg.solve(b);
+        REQUIRE(cg.iterations() > 0);
+        REQUIRE(cg.error() <= cg.tolerance());
+        assertMatrixEqualityRelative(x, xTruth, 1e-5);
+    }
+    SECTION("7-point, batched, device convergence check")
+    {
+        constexpr int batches = 2;
+        typedef Stencil7PointOperator<double, batches> Op;
+        typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+        Op stencil(nx, ny, nz);
+        Vec xTruth(nx * ny * nz, 1, batches);
+        rand.fillUniform(xTruth);
+        Vec b = stencil * xTruth;
+
+        ConjugateGradient<Op, IdentityPreconditioner<Op>> cg(stencil);
+        cg.setTolerance(1e-8);
+        cg.setConvergenceCheckInterval(4);
+        Vec x = cg.solve(b);
+        REQUIRE(cg.error() <= cg.tolerance());
+        REQUIRE(cg.batchIterations().size() == batches);
+        assertMatrixEqualityRelative(x, xTruth, 1e-5);
+    }
+}
@@ -0,0 +1,69 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/Dense>
+#include <cuMat/Sparse>
+#include <cuMat/IterativeLinearSolvers>
+#include <cuMat/src/SimpleRandom.h>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Mixed Precision Refinement - Sparse, float CG", "[Solver][MixedPrecision]")
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    typedef SparseMatrix<float, 1, SparseFlags::CSR> SMatrixF;
+    typedef ConjugateGradient<SMatrixF, DiagonalPreconditioner<SMatrixF>> InnerSolver;
+    typedef Matrix<double, Dynamic, 1, 2, ColumnMajor> Vec;
+    const SMatrix A = poisson2D(48, 40);
+    SimpleRandom rand;
+    Vec xTruth(A.rows(), 1, 2);
+    rand.fillUniform(xTruth);
+    Vec b = A * xTruth;
+
+    MixedPrecisionRefinement<SMatrix, InnerSolver> solver(A);
+    REQUIRE(solver.innerMatrix().getSparsityPattern().nnz == A.getSparsityPattern().nnz);
+    solver.setTolerance(1e-10);
+    solver.setInnerTolerance(1e-3f);
+    REQUIRE(solver.innerTolerance() == Approx(1e-3f));
+    Vec x = solver.solve(b);
+    INFO("outer iterations=" << solver.iterations() << ", inner iterations=" << solver.innerIterations() << ", error=" << solver.error());
+    REQUIRE(solver.error() <= 1e-10);
+    REQUIRE(solver.iterations() > 1);
+    REQUIRE(solver.iterations() < solver.maxIterations());
+    REQUIRE(solver.innerIterations() > solver.iterations());
+    //beyond the accuracy of a single float solve
+    assertMatrixEqualityRelative(x, xTruth, 1e-8);
+}
+
+template<typename _InnerSolver>
+void testMixedPrecisionRefinementDense()
+{
+    const int n = 64;
+    Eigen::MatrixXd M = Eigen::MatrixXd::Random(n, n);
+    Eigen::MatrixXd Ah = M * M.transpose() + n * Eigen::MatrixXd::Identity(n, n);
+    Eigen::VectorXd xh = Eigen::VectorXd::Random(n);
+    Eigen::VectorXd bh = Ah * xh;
+    MatrixXd A = MatrixXd::fromEigen(Ah);
+    VectorXd b = VectorXd::fromEigen(bh);
+    VectorXd xTruth = VectorXd::fromEigen(xh);
+
+    MixedPrecisionRefinement<MatrixXd, _InnerSolver> solver(A);
+    solver.setTolerance(1e-12);
+    VectorXd x = solver.solve(b);
+    INFO("outer iterations=" << solver.iterations() << ", error=" << solver.error());
+    REQUIRE(solver.error() <= 1e-12);
+    REQUIRE(solver.iterations() > 1);
+    REQUIRE(solver.iterations() < solver.maxIterations());
+    //direct solvers count as one inner iteration per refinement step
+    REQUIRE(solver.innerIterations() == solver.iterations());
+    REQUIRE(solver.innerTolerance() == 0);
+    assertMatrixEqualityRelative(x, xTruth, 1e-10);
+}
+TEST_CASE("Mixed Precision Refinement - Dense, float decompositions", "[Solver][MixedPrecision]")
+{
+    SECTION("LU") { testMixedPrecisionRefinementDense<LUDecomposition<MatrixXf>>(); }
+    SECTION("Cholesky") { testMixedPrecisionRefinementDense<CholeskyDecomposition<MatrixXf>>(); }
+}
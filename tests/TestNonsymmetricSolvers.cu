@@ -0,0 +1,150 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/src/SimpleRandom.h>
+#include <cuMat/IterativeLinearSolvers>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+template<typename _Solver>
+void testNonsymmetricEarlyOut()
+{
+    SimpleRandom rand;
+    MatrixXf A(10, 10);
+    rand.fillUniform(A);
+    VectorXf b = VectorXf::Zero(10);
+
+    _Solver solver(A);
+    VectorXf x = solver.solve(b);
+    REQUIRE(solver.iterations() == 0);
+    REQUIRE(solver.error() == 0);
+    REQUIRE(x.squaredNorm() == 0);
+}
+TEST_CASE("Nonsymmetric Solvers - Early Out Rhs", "[BiCGSTAB][GMRES]")
+{
+    SECTION("BiCGSTAB") { testNonsymmetricEarlyOut<BiCGSTAB<MatrixXf>>(); }
+    SECTION("GMRES") { testNonsymmetricEarlyOut<GMRES<MatrixXf>>(); }
+}
+
+template<typename _Solver>
+void testNonsymmetricSolveDense(int size, int interval)
+{
+    SimpleRandom rand;
+    MatrixXd A(size, size);
+    rand.fillUniform(A); //nonsymmetric
+    A += size * MatrixXd::Identity(size); //make diagonal dominant
+    VectorXd xTruth(size);
+    rand.fillUniform(xTruth);
+    VectorXd b = A * xTruth;
+
+    INFO("A:\n" << A.toEigen());
+    INFO("xTruth: " << xTruth.toEigen().transpose());
+
+    _Solver solver(A);
+    solver.setMaxIterations(10 * size);
+    solver.setTolerance(1e-8);
+    solver.setConvergenceCheckInterval(interval);
+    VectorXd x = solver.solve(b);
+    REQUIRE(solver.iterations() > 0);
+    REQUIRE(solver.iterations() <= solver.maxIterations()); //it should have converged
+    REQUIRE(solver.error() <= solver.tolerance());         //the error should be lower than the tolerance
+    assertMatrixEqualityRelative(x, xTruth, 1e-4);       //the true solution was found
+}
+TEST_CASE("Nonsymmetric Solvers - Solve Dense", "[BiCGSTAB][GMRES]")
+{
+    int sizes[] = { 5, 10, 50, 100 };
+    for (int size : sizes) SECTION("Size=" + std::to_string(size))
+    {
+        SECTION("BiCGSTAB") { testNonsymmetricSolveDense<BiCGSTAB<MatrixXd>>(size, 0); }
+        SECTION("BiCGSTAB - interval") { testNonsymmetricSolveDense<BiCGSTAB<MatrixXd>>(size, 4); }
+        SECTION("GMRES") { testNonsymmetricSolveDense<GMRES<MatrixXd>>(size, 0); }
+        SECTION("GMRES - interval") { testNonsymmetricSolveDense<GMRES<MatrixXd>>(size, 4); }
+    }
+}
+
+TEST_CASE("Nonsymmetric Solvers - GMRES restart", "[GMRES]")
+{
+    constexpr int size = 100;
+    SimpleRandom rand;
+    MatrixXd A(size, size);
+    rand.fillUniform(A);
+    A += size * MatrixXd::Identity(size); //make diagonal dominant
+    VectorXd xTruth(size);
+    rand.fillUniform(xTruth);
+    VectorXd b = A * xTruth;
+
+    int restarts[] = { 2, 5, 200 };
+    for (int restart : restarts) SECTION("Restart=" + std::to_string(restart))
+    {
+        GMRES<MatrixXd> gmres(A);
+        gmres.setMaxIterations(10 * size);
+        gmres.setTolerance(1e-8);
+        gmres.setRestart(restart);
+        REQUIRE(gmres.restart() == restart);
+        VectorXd x = gmres.solve(b);
+        REQUIRE(gmres.iterations() > 0);
+        REQUIRE(gmres.error() <= gmres.tolerance());
+        assertMatrixEqualityRelative(x, xTruth, 1e-4);
+    }
+}
+
+template<typename _Solver>
+void testNonsymmetricSolveBatched()
+{
+    constexpr int size = 20;
+    constexpr int batches = 3;
+    SimpleRandom rand;
+
+    MatrixXd A(size, size);
+    rand.fillUniform(A);
+    A += size * MatrixXd::Identity(size); //make diagonal dominant
+    typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+    Vec xTruth(size, 1, batches);
+    rand.fillUniform(xTruth);
+    Vec b = A * xTruth;
+
+    _Solver solver(A);
+    solver.setMaxIterations(10 * size);
+    solver.setTolerance(1e-8);
+    Vec x = solver.solve(b);
+    REQUIRE(solver.iterations() > 0);
+    REQUIRE(solver.iterations() <= solver.maxIterations()); //it should have converged
+    REQUIRE(solver.error() <= solver.tolerance());         //the error should be lower than the tolerance
+    assertMatrixEqualityRelative(x, xTruth, 1e-4);       //the true solution was found
+}
+TEST_CASE("Nonsymmetric Solvers - Solve Dense Batched", "[BiCGSTAB][GMRES]")
+{
+    SECTION("BiCGSTAB") { testNonsymmetricSolveBatched<BiCGSTAB<MatrixXd>>(); }
+    SECTION("GMRES") { testNonsymmetricSolveBatched<GMRES<MatrixXd>>(); }
+}
+
+TEST_CASE("Nonsymmetric Solvers - BiCGSTAB breakdown", "[BiCGSTAB]")
+{
+    //(b, A b) = 0 for b=(1,-1): the first step breaks down with (r0, v) = 0, the restart with r0 = r can't recover.
+    //The second batch b=(1,0) is regular and converges to x=(0.25,0.25).
+    constexpr int batches = 2;
+    typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+    const double dataA[] = { 1, -1, 3, 1 }; //column-major
+    const double dataB[] = { 1, -1, 1, 0 };
+    MatrixXd A(2, 2);
+    A.copyFromHost(dataA);
+    Vec b(2, 1, batches);
+    b.copyFromHost(dataB);
+
+    BiCGSTAB<MatrixXd> solver(A);
+    solver.setMaxIterations(100);
+    solver.setTolerance(1e-8);
+    Vec x = solver.solve(b);
+    INFO("iterations=" << solver.iterations() << ", error=" << solver.error());
+    REQUIRE(solver.batchBreakdowns().size() == batches);
+    REQUIRE(solver.batchBreakdowns()[0]);
+    REQUIRE_FALSE(solver.batchBreakdowns()[1]);
+    REQUIRE(solver.iterations() < solver.maxIterations()); //stopped at the breakdown, not at the iteration limit
+    REQUIRE(solver.error() > solver.tolerance());
+    std::vector<double> xHost(2 * batches);
+    x.copyToHost(xHost.data());
+    REQUIRE(xHost[2] == Approx(0.25));
+    REQUIRE(xHost[3] == Approx(0.25));
+}
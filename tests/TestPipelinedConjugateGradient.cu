@@ -0,0 +1,87 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/src/SimpleRandom.h>
+#include <cuMat/IterativeLinearSolvers>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Pipelined Conjugate Gradient - Early Out Rhs", "[CG]")
+{
+    SimpleRandom rand;
+    MatrixXf A(10, 10);
+    rand.fillUniform(A);
+    VectorXf b = VectorXf::Zero(10);
+
+    PipelinedConjugateGradient<MatrixXf> cg(A);
+    VectorXf x = cg.solve(b);
+    REQUIRE(cg.iterations() == 0);
+    REQUIRE(cg.error() == 0);
+    REQUIRE(x.squaredNorm() == 0);
+}
+
+TEST_CASE("Pipelined Conjugate Gradient - Solve Dense", "[CG]")
+{
+    int sizes[] = {5, 10, 50, 100};
+    SimpleRandom rand;
+    for (int size : sizes) SECTION("Size=" + std::to_string(size)) {
+        MatrixXd R(size, size);
+        rand.fillUniform(R);
+        MatrixXd A = R + R.transpose(); //symmetric
+        A += 2 * size * MatrixXd::Identity(size); //make diagonal dominant
+        VectorXd xTruth(size);
+        rand.fillUniform(xTruth);
+        VectorXd b = A * xTruth;
+
+        INFO("A:\n" << A.toEigen());
+        INFO("xTruth: " << xTruth.toEigen().transpose());
+
+        PipelinedConjugateGradient<MatrixXd> cg(A);
+        cg.setMaxIterations(10 * size);
+        cg.setTolerance(1e-8);
+        VectorXd x = cg.solve(b);
+        REQUIRE(cg.iterations() > 0);
+        REQUIRE(cg.iterations() <= cg.maxIterations()); //it should have converged
+        REQUIRE(cg.error() <= cg.tolerance());         //the error should be lower than the tolerance
+        assertMatrixEqualityRelative(x, xTruth, 1e-4);       //the true solution was found
+    }
+}
+
+TEST_CASE("Pipelined Conjugate Gradient - Solve Dense Batched", "[CG]")
+{
+    constexpr int size = 20;
+    constexpr int batches = 3;
+    SimpleRandom rand;
+
+    MatrixXd R(size, size);
+    rand.fillUniform(R);
+    MatrixXd A = R + R.transpose(); //symmetric
+    A += 2 * size * MatrixXd::Identity(size); //make diagonal dominant
+    typedef Matrix<double, Dynamic, 1, batches, ColumnMajor> Vec;
+    Vec xTruth(size, 1, batches);
+    rand.fillUniform(xTruth);
+    Vec b = A * xTruth;
+
+    int intervals[] = { 0, 4 };
+    for (int interval : intervals) SECTION("Interval=" + std::to_string(interval))
+    {
+        PipelinedConjugateGradient<MatrixXd> cg(A);
+        cg.setMaxIterations(10 * size);
+        cg.setTolerance(1e-8);
+        cg.setConvergenceCheckInterval(interval);
+        Vec x = cg.solve(b);
+        REQUIRE(cg.iterations() > 0);
+        REQUIRE(cg.iterations() <= cg.maxIterations()); //it should have converged
+        REQUIRE(cg.error() <= cg.tolerance());         //the error should be lower than the tolerance
+        assertMatrixEqualityRelative(x, xTruth, 1e-4);       //the true solution was found
+
+        //same number of iterations as the classic CG, up to the delayed convergence test
+        ConjugateGradient<MatrixXd> cgRef(A);
+        cgRef.setMaxIterations(10 * size);
+        cgRef.setTolerance(1e-8);
+        Vec xRef = cgRef.solve(b);
+        REQUIRE(cg.iterations() <= cgRef.iterations() + 2);
+    }
+}
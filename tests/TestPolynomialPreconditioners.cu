@@ -0,0 +1,85 @@
+#include <catch2/catch.hpp>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+#include <cuMat/IterativeLinearSolvers>
+#include <cuMat/src/SimpleRandom.h>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Polynomial Preconditioner - Tridiagonal eigenvalues", "[Preconditioner]")
+{
+    //tridiag(-1, 2, -1) of size m has the eigenvalues 2 - 2 cos(k pi / (m+1))
+    const int m = 7;
+    std::vector<double> alpha(m, 2.0), beta(m - 1, -1.0);
+    double lambdaMin, lambdaMax;
+    internal::tridiagonalEigenvalueBounds(alpha, beta, lambdaMin, lambdaMax);
+    REQUIRE(lambdaMin == Approx(2 - 2 * std::cos(M_PI / (m + 1))));
+    REQUIRE(lambdaMax == Approx(2 + 2 * std::cos(M_PI / (m + 1))));
+
+    std::vector<double> single = { 3.0 }, none;
+    internal::tridiagonalEigenvalueBounds(single, none, lambdaMin, lambdaMax);
+    REQUIRE(lambdaMin == Approx(3.0));
+    REQUIRE(lambdaMax == Approx(3.0));
+}
+
+TEST_CASE("Polynomial Preconditioner - Eigenvalue estimation", "[Preconditioner]")
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    const int nx = 48, ny = 40;
+    const SMatrix A = poisson2D(nx, ny);
+    //the eigenvalues of D^-1 A are 1 - (cos(i pi/(nx+1)) + cos(j pi/(ny+1)))/2
+    const double trueMax = 1 + (std::cos(M_PI / (nx + 1)) + std::cos(M_PI / (ny + 1))) / 2;
+    const double trueMin = 1 - (std::cos(M_PI / (nx + 1)) + std::cos(M_PI / (ny + 1))) / 2;
+    ChebyshevPreconditioner<SMatrix> cheb(A);
+    INFO("lower=" << cheb.lowerEigenvalueBound() << ", upper=" << cheb.upperEigenvalueBound());
+    REQUIRE(cheb.upperEigenvalueBound() >= trueMax);
+    REQUIRE(cheb.upperEigenvalueBound() <= 1.1 * trueMax);
+    REQUIRE(cheb.lowerEigenvalueBound() >= trueMin);
+    REQUIRE(cheb.lowerEigenvalueBound() < cheb.upperEigenvalueBound());
+
+    NeumannPreconditioner<SMatrix> neumann(A);
+    REQUIRE(neumann.omega() > 0);
+    REQUIRE(neumann.omega() * trueMax <= 1);
+}
+
+template<typename _Preconditioner>
+void testPolynomialPreconditionerCG(int factor)
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    typedef Matrix<double, Dynamic, 1, 2, ColumnMajor> Vec;
+    const SMatrix A = poisson2D(48, 40);
+    SimpleRandom rand;
+    Vec xTruth(A.rows(), 1, 2);
+    rand.fillUniform(xTruth);
+    Vec b = A * xTruth;
+
+    ConjugateGradient<SMatrix, IdentityPreconditioner<SMatrix>> cgPlain(A);
+    cgPlain.setTolerance(1e-8);
+    Vec xPlain = cgPlain.solve(b);
+
+    ConjugateGradient<SMatrix, _Preconditioner> cg(A);
+    cg.setTolerance(1e-8);
+    Vec x = cg.solve(b);
+    INFO("iterations: none=" << cgPlain.iterations() << ", polynomial=" << cg.iterations());
+    REQUIRE(cg.error() <= cg.tolerance());
+    REQUIRE(cg.iterations() * factor < cgPlain.iterations());
+    assertMatrixEqualityRelative(x, xTruth, 1e-5);
+
+    //the same with the device-side convergence checks
+    ConjugateGradient<SMatrix, _Preconditioner> cgDevice(A);
+    cgDevice.setTolerance(1e-8);
+    cgDevice.setConvergenceCheckInterval(4);
+    Vec xDevice = cgDevice.solve(b);
+    REQUIRE(cgDevice.error() <= cgDevice.tolerance());
+    assertMatrixEqualityRelative(xDevice, xTruth, 1e-5);
+}
+TEST_CASE("Polynomial Preconditioner - Conjugate Gradient", "[Preconditioner][CG]")
+{
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    SECTION("Chebyshev") { testPolynomialPreconditionerCG<ChebyshevPreconditioner<SMatrix>>(2); }
+    SECTION("Neumann") { testPolynomialPreconditionerCG<NeumannPreconditioner<SMatrix>>(1); }
+}
@@ -0,0 +1,161 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Segmented Reduction - algorithm selection", "[reduce][segmented]")
+{
+    typedef internal::SegmentLengthHistogram Hist;
+    typedef internal::SegmentedReductionSelection Sel;
+
+    SECTION("buckets")
+    {
+        REQUIRE(Hist::bucket(0) == 0);
+        REQUIRE(Hist::bucket(1) == 1);
+        REQUIRE(Hist::bucket(2) == 2);
+        REQUIRE(Hist::bucket(3) == 2);
+        REQUIRE(Hist::bucket(4) == 3);
+        REQUIRE(Hist::bucket(1023) == 10);
+        REQUIRE(Hist::bucket(1024) == 11);
+    }
+    SECTION("histogram")
+    {
+        Hist h = Hist::fromOffsets({ 0, 0, 3, 4, 14 });
+        REQUIRE(h.numSegments() == 4);
+        REQUIRE(h.numEntries() == 14);
+        REQUIRE(h.segments[0] == 1);
+        REQUIRE(h.segments[1] == 1);
+        REQUIRE(h.segments[2] == 1);
+        REQUIRE(h.segments[4] == 1);
+        REQUIRE(h.entries[4] == 10);
+        REQUIRE(h.entriesInSegmentsOfLength(8) == 10);
+    }
+    SECTION("selection")
+    {
+        //many short segments
+        std::vector<int> shortOffsets(10001);
+        for (int i = 0; i <= 10000; ++i) shortOffsets[i] = 10 * i;
+        REQUIRE(Sel::select(Hist::fromOffsets(shortOffsets)) == internal::ReductionAlgorithm::Warp);
+        //many medium segments
+        std::vector<int> mediumOffsets(10001);
+        for (int i = 0; i <= 10000; ++i) mediumOffsets[i] = 1000 * i;
+        REQUIRE(Sel::select(Hist::fromOffsets(mediumOffsets)) == internal::ReductionAlgorithm::Block256);
+        //few very long segments
+        REQUIRE(Sel::select(Hist::fromOffsets({ 0, 100000, 200000, 200005 })) == internal::ReductionAlgorithm::Segmented);
+    }
+}
+
+template<typename _Algorithm>
+void testSegmentedReductionSmall()
+{
+    SECTION("sum")
+    {
+        float data[1][9][1] = { { {1}, {2}, {3}, {4}, {5}, {6}, {7}, {8}, {9} } };
+        BMatrixXfR values = BMatrixXfR::fromArray(data);
+        Matrix<int, Dynamic, 1, 1, ColumnMajor> offsets = Matrix<int, Dynamic, 1, 1, ColumnMajor>::fromEigen(
+            (Eigen::VectorXi(5) << 0, 2, 2, 7, 9).finished());
+        float expected[1][4][1] = { { {3}, {0}, {25}, {17} } };
+        assertMatrixEquality(expected, segmentedReduce<_Algorithm>(values, offsets, functor::Sum<float>(), 0.0f));
+    }
+    SECTION("max - batched")
+    {
+        int data[2][5][1] = { { {1}, {7}, {3}, {-4}, {5} }, { {-1}, {2}, {9}, {4}, {-5} } };
+        BMatrixXiR values = BMatrixXiR::fromArray(data);
+        Matrix<int, Dynamic, 1, 1, ColumnMajor> offsets = Matrix<int, Dynamic, 1, 1, ColumnMajor>::fromEigen(
+            (Eigen::VectorXi(3) << 0, 3, 5).finished());
+        int expected[2][2][1] = { { {7}, {5} }, { {9}, {4} } };
+        assertMatrixEquality(expected, segmentedReduce<_Algorithm>(values, offsets, functor::Max<int>(), std::numeric_limits<int>::lowest()));
+    }
+}
+TEST_CASE("Segmented Reduction - small", "[reduce][segmented]")
+{
+    SECTION("Warp") { testSegmentedReductionSmall<ReductionAlg::Warp>(); }
+    SECTION("Block") { testSegmentedReductionSmall<ReductionAlg::Block<256>>(); }
+    SECTION("Segmented") { testSegmentedReductionSmall<ReductionAlg::Segmented>(); }
+    SECTION("Auto") { testSegmentedReductionSmall<ReductionAlg::Auto>(); }
+}
+
+template<typename _Algorithm>
+void testSegmentedReductionLarge(int numSegments, int maxLength, int batches)
+{
+    std::default_random_engine rnd(42);
+    std::uniform_int_distribution<int> lengthDistr(0, maxLength);
+    std::uniform_int_distribution<int> valueDistr(-5, 5);
+    std::vector<int> offsets(numSegments + 1);
+    offsets[0] = 0;
+    for (int i = 0; i < numSegments; ++i)
+        offsets[i + 1] = offsets[i] + lengthDistr(rnd);
+    const int numEntries = offsets[numSegments];
+
+    std::vector<int> values(numEntries * batches);
+    std::vector<int> expected(numSegments * batches, 0);
+    for (int b = 0; b < batches; ++b)
+        for (int i = 0; i < numSegments; ++i)
+            for (int n = offsets[i]; n < offsets[i + 1]; ++n)
+            {
+                int v = valueDistr(rnd);
+                values[n + numEntries * b] = v;
+                expected[i + numSegments * b] += v;
+            }
+    BVectorXi valuesDevice(numEntries, 1, batches);
+    valuesDevice.copyFromHost(values.data());
+    Matrix<int, Dynamic, 1, 1, ColumnMajor> offsetsDevice(numSegments + 1, 1, 1);
+    offsetsDevice.copyFromHost(offsets.data());
+
+    BVectorXi result = segmentedReduce<_Algorithm>(valuesDevice, offsetsDevice, functor::Sum<int>(), 0);
+    REQUIRE(result.rows() == numSegments);
+    REQUIRE(result.batches() == batches);
+    std::vector<int> actual(numSegments * batches);
+    result.copyToHost(actual.data());
+    REQUIRE(actual == expected);
+}
+TEST_CASE("Segmented Reduction - large", "[reduce][segmented]")
+{
+    SECTION("Warp") { testSegmentedReductionLarge<ReductionAlg::Warp>(5000, 100, 2); }
+    SECTION("Block") { testSegmentedReductionLarge<ReductionAlg::Block<256>>(1000, 2000, 2); }
+    SECTION("Segmented") { testSegmentedReductionLarge<ReductionAlg::Segmented>(50, 20000, 2); }
+    SECTION("Auto - short") { testSegmentedReductionLarge<ReductionAlg::Auto>(5000, 20, 1); }
+    SECTION("Auto - long") { testSegmentedReductionLarge<ReductionAlg::Auto>(20, 50000, 1); }
+}
+
+TEST_CASE("Segmented Reduction - sparse", "[reduce][segmented][Sparse]")
+{
+    SECTION("CSR - row sums")
+    {
+        typedef SparseMatrix<float, 1, SparseFlags::CSR> SMatrix_t;
+        typedef SparsityPattern<SparseFlags::CSR> SPattern;
+        SPattern pattern;
+        pattern.rows = 4;
+        pattern.cols = 5;
+        pattern.nnz = 9;
+        pattern.IA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(9) << 0, 1, 1, 2, 0, 3, 4, 2, 4).finished());
+        pattern.JA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(5) << 0, 2, 4, 7, 9).finished());
+        SMatrix_t smatrix(pattern);
+        smatrix.getData().slice(0) = VectorXf::fromEigen((Eigen::VectorXf(9) << 1, 4, 2, 3, 5, 7, 8, 9, 6).finished());
+
+        float expected[1][4][1] = { { {5}, {5}, {20}, {15} } };
+        assertMatrixEquality(expected, segmentedReduce(smatrix, functor::Sum<float>(), 0.0f));
+    }
+    SECTION("CSC - column sums")
+    {
+        typedef SparseMatrix<float, 1, SparseFlags::CSC> SMatrix_t;
+        typedef SparsityPattern<SparseFlags::CSC> SPattern;
+        SPattern pattern;
+        pattern.rows = 4;
+        pattern.cols = 5;
+        pattern.nnz = 9;
+        pattern.IA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(9) << 0, 2, 0, 1, 1, 3, 2, 2, 3).finished());
+        pattern.JA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(6) << 0, 2, 4, 6, 7, 9).finished());
+        SMatrix_t smatrix(pattern);
+        smatrix.getData().slice(0) = VectorXf::fromEigen((Eigen::VectorXf(9) << 1, 5, 4, 2, 3, 9, 7, 8, 6).finished());
+
+        float expected[1][5][1] = { { {6}, {6}, {12}, {7}, {14} } };
+        assertMatrixEquality(expected, segmentedReduce(smatrix, functor::Sum<float>(), 0.0f));
+    }
+}
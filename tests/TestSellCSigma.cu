@@ -0,0 +1,209 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+//{1, 4, 0, 0, 0},
+//{0, 2, 3, 0, 0},
+//{5, 0, 0, 7, 8},
+//{0, 0, 9, 0, 6}
+static internal::HostCsrMatrix<float> exampleMatrix()
+{
+    internal::HostCsrMatrix<float> A;
+    A.rows = 4;
+    A.cols = 5;
+    A.JA = { 0, 2, 4, 7, 9 };
+    A.IA = { 0, 1, 1, 2, 0, 3, 4, 2, 4 };
+    A.values = { 1, 4, 2, 3, 5, 7, 8, 9, 6 };
+    return A;
+}
+
+TEST_CASE("SELL-C-sigma - layout", "[Sparse]")
+{
+    const internal::HostCsrMatrix<float> A = exampleMatrix();
+    SECTION("sorted")
+    {
+        internal::SellCSigmaLayout l = internal::SellCSigmaLayout::build(A.JA.data(), A.IA.data(), A.rows, A.cols, 2, 4);
+        //the longest row first, the others keep their order
+        REQUIRE(l.permutation == std::vector<int>({ 2, 0, 1, 3 }));
+        REQUIRE(l.inversePermutation == std::vector<int>({ 1, 2, 0, 3 }));
+        //slice widths 3 and 2
+        REQUIRE(l.sliceOffsets == std::vector<int>({ 0, 6, 10 }));
+        REQUIRE(l.IA == std::vector<int>({ 0, 0, 3, 1, 4, -1,   1, 2, 2, 4 }));
+        REQUIRE(l.source == std::vector<int>({ 4, 0, 5, 1, 6, -1,   2, 7, 3, 8 }));
+        REQUIRE(l.nnz() == 10);
+        REQUIRE(l.csrNnz == 9);
+        REQUIRE(l.paddingRatio() == Approx(10.0 / 9.0));
+        REQUIRE(l.scatterValues(A.values.data()) == std::vector<float>({ 5, 1, 7, 4, 8, 0,   2, 9, 3, 6 }));
+    }
+    SECTION("unsorted, partial last slice")
+    {
+        internal::SellCSigmaLayout l = internal::SellCSigmaLayout::build(A.JA.data(), A.IA.data(), A.rows, A.cols, 3, 1);
+        REQUIRE(l.permutation == std::vector<int>({ 0, 1, 2, 3, -1, -1 }));
+        REQUIRE(l.sliceOffsets == std::vector<int>({ 0, 9, 15 }));
+        REQUIRE(l.IA == std::vector<int>({ 0, 1, 0,   1, 2, 3,   -1, -1, 4,   2, -1, -1,   4, -1, -1 }));
+    }
+    SECTION("sorting reduces the padding")
+    {
+        //alternating long and short rows
+        std::vector<int> JA(1, 0), IA;
+        for (int i = 0; i < 64; ++i)
+        {
+            const int length = (i % 2 == 0) ? 10 : 1;
+            for (int j = 0; j < length; ++j) IA.push_back(j);
+            JA.push_back(static_cast<int>(IA.size()));
+        }
+        const internal::SellCSigmaLayout unsorted = internal::SellCSigmaLayout::build(JA.data(), IA.data(), 64, 10, 8, 1);
+        const internal::SellCSigmaLayout sorted = internal::SellCSigmaLayout::build(JA.data(), IA.data(), 64, 10, 8, 64);
+        REQUIRE(unsorted.nnz() == 640);
+        REQUIRE(sorted.nnz() == 32 * 10 + 32 * 1);
+    }
+}
+
+TEST_CASE("SELL-C-sigma - conversion and cwise evaluation", "[Sparse]")
+{
+    typedef SparseMatrix<float, 1, SparseFlags::SELLCS> SMatrix_t;
+    SMatrix_t A = exampleMatrix().toSellMatrix(2, 4);
+    REQUIRE_NOTHROW(A.getSparsityPattern().assertValid());
+    INFO(A);
+    const float expectedData[1][4][5] = {
+        {
+            {1, 4, 0, 0, 0},
+            {0, 2, 3, 0, 0},
+            {5, 0, 0, 7, 8},
+            {0, 0, 9, 0, 6}
+        }
+    };
+    MatrixXfR expected = MatrixXfR::fromArray(expectedData);
+
+    SECTION("sparse -> dense")
+    {
+        Profiling::instance().resetAll();
+        MatrixXfC mat = A;
+        REQUIRE(Profiling::instance().getReset(Profiling::EvalCwise) == 1);
+        assertMatrixEquality(expected, mat);
+    }
+    SECTION("dense -> sparse")
+    {
+        const float inputData[1][4][5] = {
+            {
+                {1, 4, 42, 42, 42},
+                {42, 2, 3, 42, 42},
+                {5, 42, 42, 7, 8},
+                {42, 42, 9, 42, 6}
+            }
+        };
+        SMatrix_t B(A.getSparsityPattern());
+        Profiling::instance().resetAll();
+        B = MatrixXfR::fromArray(inputData);
+        REQUIRE(Profiling::instance().getReset(Profiling::EvalCwiseSparse) == 1);
+        MatrixXfC mat = B;
+        assertMatrixEquality(expected, mat);
+    }
+    SECTION("sparse expression")
+    {
+        SMatrix_t B(A.getSparsityPattern());
+        B = 2 * A.direct() + A;
+        MatrixXfC mat = B;
+        assertMatrixEquality(3 * expected, mat);
+    }
+}
+
+TEST_CASE("SELL-C-sigma - Matrix-Vector Product", "[Sparse]")
+{
+    typedef SparseMatrix<float, 1, SparseFlags::SELLCS> SMatrix_t;
+    SMatrix_t A = exampleMatrix().toSellMatrix(2, 4);
+    VectorXf b = VectorXf::fromEigen((Eigen::VectorXf(5) << 2, 5, 3, -4, 1).finished());
+    //the result is in the original order of the rows
+    VectorXf xExpected = VectorXf::fromEigen((Eigen::VectorXf(4) << 22, 19, -10, 33).finished());
+
+    SECTION("matrix") {
+        Profiling::instance().resetAll();
+        VectorXf xActual = A * b;
+        REQUIRE(Profiling::instance().get(Profiling::EvalAny) == 1);
+        REQUIRE(Profiling::instance().get(Profiling::EvalMatmulSparse) == 1);
+        assertMatrixEqualityRelative(xExpected, xActual);
+    }
+    SECTION("sparse matmul with search") {
+        Profiling::instance().resetAll();
+        VectorXf xActual = (2 * A).sparseView<SELLCS>(A.getSparsityPattern()) * b;
+        REQUIRE(Profiling::instance().get(Profiling::EvalAny) == 1);
+        REQUIRE(Profiling::instance().get(Profiling::EvalMatmulSparse) == 1);
+        assertMatrixEqualityRelative(2 * xExpected, xActual);
+    }
+    SECTION("sparse matmul with direct access") {
+        Profiling::instance().resetAll();
+        VectorXf xActual = (2 * A.direct()).sparseView<SELLCS>(A.getSparsityPattern()) * b;
+        REQUIRE(Profiling::instance().get(Profiling::EvalAny) == 1);
+        REQUIRE(Profiling::instance().get(Profiling::EvalMatmulSparse) == 1);
+        assertMatrixEqualityRelative(2 * xExpected, xActual);
+    }
+}
+
+TEST_CASE("SELL-C-sigma - Matrix-Vector Product, power-law rows", "[Sparse]")
+{
+    //random rows with power-law distributed lengths, including empty rows
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> u(0, 1);
+    const int rows = 3000, cols = 2000;
+    internal::HostCsrMatrix<double> hostA;
+    hostA.rows = rows;
+    hostA.cols = cols;
+    hostA.JA.assign(rows + 1, 0);
+    for (int i = 0; i < rows; ++i)
+    {
+        const int length = std::min(cols, static_cast<int>(std::pow(1 - u(rng), -1.0 / 1.2)) - 1);
+        std::vector<int> row;
+        for (int k = 0; k < length; ++k) row.push_back(static_cast<int>(rng() % cols));
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+        for (int j : row)
+        {
+            hostA.IA.push_back(j);
+            hostA.values.push_back(2 * u(rng) - 1);
+        }
+        hostA.JA[i + 1] = static_cast<int>(hostA.IA.size());
+    }
+
+    typedef Matrix<double, Dynamic, 1, 2, ColumnMajor> BVector;
+    std::vector<double> hostX(cols * 2), hostY0(rows * 2), expected(rows * 2, 0);
+    for (double& v : hostX) v = 2 * u(rng) - 1;
+    for (double& v : hostY0) v = 2 * u(rng) - 1;
+    for (int b = 0; b < 2; ++b)
+        for (int i = 0; i < rows; ++i)
+            for (int k = hostA.JA[i]; k < hostA.JA[i + 1]; ++k)
+                expected[i + b * rows] += hostA.values[k] * hostX[hostA.IA[k] + b * cols];
+    BVector x(cols, 1, 2);
+    x.copyFromHost(hostX.data());
+
+    const std::vector<std::pair<int, int>> configurations = { {32, 256}, {32, 1}, {4, 8}, {1, 1} };
+    for (const auto& c : configurations)
+    {
+        INFO("C=" << c.first << ", sigma=" << c.second);
+        SparseMatrix<double, 1, SparseFlags::SELLCS> A = hostA.toSellMatrix(c.first, c.second);
+        std::vector<double> actual(rows * 2);
+
+        BVector y = A * x;
+        y.copyToHost(actual.data());
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            INFO("i=" << i);
+            REQUIRE(actual[i] == Approx(expected[i]).margin(1e-10));
+        }
+
+        y.copyFromHost(hostY0.data());
+        y += A * x;
+        y.copyToHost(actual.data());
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            INFO("i=" << i);
+            REQUIRE(actual[i] == Approx(expected[i] + hostY0[i]).margin(1e-10));
+        }
+    }
+}
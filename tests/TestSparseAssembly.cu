@@ -0,0 +1,100 @@
+#include <catch2/catch.hpp>
+#include <vector>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+//Triplets of the 1D Laplace matrix assembled from the element matrices {{1,-1},{-1,1}} of n-1 elements,
+//scaled by (batch+1). Every inner node receives two contributions on its diagonal.
+static void laplaceTriplets(int n, std::vector<int>& rows, std::vector<int>& cols, std::vector<float>& values, float scale)
+{
+    rows.clear(); cols.clear(); values.clear();
+    for (int b = 0; b < 2; ++b)
+        for (int e = 0; e < n - 1; ++e)
+            for (int i = 0; i < 2; ++i)
+                for (int j = 0; j < 2; ++j)
+                {
+                    if (b == 0)
+                    {
+                        //elements in reverse order, the triplets need not be sorted
+                        rows.push_back(n - 2 - e + i);
+                        cols.push_back(n - 2 - e + j);
+                    }
+                    values.push_back((i == j ? 1.0f : -1.0f) * scale * (b + 1));
+                }
+}
+
+template<int _SparseFlags>
+static void testSetFromTriplets()
+{
+    const int n = 6;
+    std::vector<int> rows, cols;
+    std::vector<float> values;
+    laplaceTriplets(n, rows, cols, values, 1);
+    const Index numTriplets = static_cast<Index>(rows.size());
+
+    CooMatrix<float, 2> triplets;
+    triplets.rows = n;
+    triplets.cols = n;
+    triplets.rowIndices = CooMatrix<float, 2>::IndexVector(numTriplets);
+    triplets.rowIndices.copyFromHost(rows.data());
+    triplets.colIndices = CooMatrix<float, 2>::IndexVector(numTriplets);
+    triplets.colIndices.copyFromHost(cols.data());
+    triplets.values = CooMatrix<float, 2>::DataVector(numTriplets, 1, 2);
+    triplets.values.copyFromHost(values.data());
+
+    SparseMatrix<float, 2, _SparseFlags> A;
+    TripletPermutation permutation = setFromTriplets(A, triplets);
+    REQUIRE(permutation.numTriplets == numTriplets);
+    REQUIRE(permutation.nnz == 3 * n - 2);
+    REQUIRE(A.getSparsityPattern().nnz == 3 * n - 2);
+    REQUIRE(A.rows() == n);
+    REQUIRE(A.cols() == n);
+    REQUIRE(A.batches() == 2);
+    REQUIRE_NOTHROW(A.getSparsityPattern().assertValid());
+
+    const float expectedData[2][6][6] = {
+        {
+            { 1, -1,  0,  0,  0,  0},
+            {-1,  2, -1,  0,  0,  0},
+            { 0, -1,  2, -1,  0,  0},
+            { 0,  0, -1,  2, -1,  0},
+            { 0,  0,  0, -1,  2, -1},
+            { 0,  0,  0,  0, -1,  1}
+        },
+        {
+            { 2, -2,  0,  0,  0,  0},
+            {-2,  4, -2,  0,  0,  0},
+            { 0, -2,  4, -2,  0,  0},
+            { 0,  0, -2,  4, -2,  0},
+            { 0,  0,  0, -2,  4, -2},
+            { 0,  0,  0,  0, -2,  2}
+        }
+    };
+    BMatrixXf mat = A;
+    assertMatrixEquality(expectedData, mat);
+
+    SECTION("setValuesFromTriplets")
+    {
+        laplaceTriplets(n, rows, cols, values, 3);
+        Matrix<float, Dynamic, 1, 2, ColumnMajor> newValues(numTriplets, 1, 2);
+        newValues.copyFromHost(values.data());
+        const auto pattern = A.getSparsityPattern();
+        Profiling::instance().resetAll();
+        setValuesFromTriplets(A, permutation, newValues);
+        REQUIRE(Profiling::instance().getReset(Profiling::MemcpyDeviceToHost) == 0);
+        //same pattern, new values
+        REQUIRE(A.getSparsityPattern().JA.data() == pattern.JA.data());
+        BMatrixXf mat2 = A;
+        assertMatrixEquality(BMatrixXf::fromArray(expectedData) * 3.0f, mat2);
+    }
+}
+TEST_CASE("setFromTriplets", "[Sparse]")
+{
+    SECTION("CSR") { testSetFromTriplets<SparseFlags::CSR>(); }
+    SECTION("CSC") { testSetFromTriplets<SparseFlags::CSC>(); }
+}
@@ -0,0 +1,154 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+//a few dense rows, the remaining rows are short or empty
+static std::vector<int> denseRowLengths(int rows, int cols)
+{
+    std::vector<int> lengths(rows);
+    for (int i = 0; i < rows; ++i) lengths[i] = i % 3;
+    lengths[rows / 3] = cols;
+    lengths[rows - 1] = cols;
+    return lengths;
+}
+
+//Assigns the dense matrix with entries row*1000+col+batch/2 into the sparse matrix and tests that every entry got its coordinates.
+//For CSC, the host pattern is the CSR pattern of the transposed matrix.
+template<int _SparseFlags>
+static void testCwiseEvaluation(const internal::HostCsrMatrix<double>& outerPattern, SparseCwiseEvaluation mode)
+{
+    const bool csr = _SparseFlags == SparseFlags::CSR;
+    const Index rows = csr ? outerPattern.rows : outerPattern.cols;
+    const Index cols = csr ? outerPattern.cols : outerPattern.rows;
+    const int batches = 2;
+    typedef SparseMatrix<float, Dynamic, _SparseFlags> SMatrix;
+    typedef Matrix<float, Dynamic, Dynamic, Dynamic, RowMajor> DMatrix;
+
+    SparsityPattern<_SparseFlags> pattern;
+    pattern.rows = rows;
+    pattern.cols = cols;
+    pattern.nnz = outerPattern.nnz();
+    pattern.JA = typename SparsityPattern<_SparseFlags>::IndexVector(outerPattern.JA.size());
+    pattern.JA.copyFromHost(outerPattern.JA.data());
+    pattern.IA = typename SparsityPattern<_SparseFlags>::IndexVector(pattern.nnz);
+    pattern.IA.copyFromHost(outerPattern.IA.data());
+    pattern.setCwiseEvaluation(mode);
+    SMatrix smatrix(pattern, batches);
+
+    std::vector<float> dense(rows * cols * batches);
+    for (int b = 0; b < batches; ++b)
+        for (Index i = 0; i < rows; ++i)
+            for (Index j = 0; j < cols; ++j)
+                dense[j + cols * (i + rows * b)] = i * 1000 + j + 0.5f * b;
+    DMatrix dmatrix(rows, cols, batches);
+    dmatrix.copyFromHost(dense.data());
+
+    smatrix = dmatrix;
+    smatrix += dmatrix;
+
+    std::vector<float> values(pattern.nnz * batches);
+    smatrix.getData().copyToHost(values.data());
+    for (int b = 0; b < batches; ++b)
+        for (Index o = 0; o < outerPattern.rows; ++o)
+            for (int k = outerPattern.JA[o]; k < outerPattern.JA[o + 1]; ++k)
+            {
+                const Index i = csr ? o : outerPattern.IA[k];
+                const Index j = csr ? outerPattern.IA[k] : o;
+                INFO("outer=" << o << ", entry=" << k << ", batch=" << b);
+                REQUIRE(values[k + pattern.nnz * b] == Approx(2 * (i * 1000 + j + 0.5f * b)));
+            }
+}
+
+TEST_CASE("Sparse cwise evaluation - selection", "[Sparse]")
+{
+    typedef internal::SparseCwiseEvaluationSelection Sel;
+
+    SECTION("outer indices")
+    {
+        const std::vector<int> JA = { 0, 2, 2, 5, 6 };
+        REQUIRE(Sel::expandOuterIndices(JA.data(), 4) == std::vector<int>({ 0, 0, 2, 2, 2, 3 }));
+        const std::vector<int> empty = { 0, 0, 0 };
+        REQUIRE(Sel::expandOuterIndices(empty.data(), 2).empty());
+    }
+    SECTION("selection")
+    {
+        internal::CsrRowStatistics s;
+        //too small
+        s.rows = 10; s.nnz = 1000; s.meanRowLength = 100; s.maxRowLength = 1000;
+        REQUIRE(Sel::select(s, 1) == SparseCwiseEvaluation::PerOuter);
+        //2D Poisson
+        s.rows = 1000000; s.nnz = 5000000; s.meanRowLength = 5; s.maxRowLength = 5;
+        REQUIRE(Sel::select(s, 1) == SparseCwiseEvaluation::PerOuter);
+        //a few dense rows
+        s.maxRowLength = 1000000;
+        REQUIRE_FALSE(Sel::isBalanced(s));
+        REQUIRE(Sel::select(s, 1) == SparseCwiseEvaluation::PerEntry);
+        //few long balanced rows: one thread per row does not fill the device, unless there are enough batches
+        s.rows = 1000; s.nnz = 100000; s.meanRowLength = 100; s.maxRowLength = 120;
+        REQUIRE(Sel::isBalanced(s));
+        REQUIRE(Sel::select(s, 1) == SparseCwiseEvaluation::PerEntry);
+        REQUIRE(Sel::select(s, 16) == SparseCwiseEvaluation::PerOuter);
+    }
+    SECTION("cache")
+    {
+        const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(denseRowLengths(3000, 3000), 3000, 1);
+        SparsityPattern<SparseFlags::CSR> pattern = hostA.toSparsityPattern();
+        const auto& cache = pattern.cwiseEvaluationCache;
+        REQUIRE(cache.select(pattern.JA, pattern.rows, pattern.nnz, 1) == SparseCwiseEvaluation::PerEntry);
+        const int* outer = cache.outerIndices(pattern.JA, pattern.rows, pattern.nnz).data();
+        REQUIRE(cache.outerIndices(pattern.JA, pattern.rows, pattern.nnz).data() == outer);
+        std::vector<int> hostOuter(pattern.nnz);
+        cache.outerIndices(pattern.JA, pattern.rows, pattern.nnz).copyToHost(hostOuter.data());
+        REQUIRE(hostOuter == Sel::expandOuterIndices(hostA.JA.data(), hostA.rows));
+        //forcing a mode is shared by all copies
+        SparsityPattern<SparseFlags::CSR> copy = pattern;
+        copy.setCwiseEvaluation(SparseCwiseEvaluation::PerOuter);
+        REQUIRE(pattern.getCwiseEvaluation() == SparseCwiseEvaluation::PerOuter);
+        REQUIRE(cache.select(pattern.JA, pattern.rows, pattern.nnz, 1) == SparseCwiseEvaluation::PerOuter);
+        //in-place modification of the outer indices
+        std::vector<int> modifiedJA = hostA.JA;
+        modifiedJA[1] = modifiedJA[2];
+        pattern.JA.copyFromHost(modifiedJA.data());
+        pattern.invalidateCwiseEvaluation();
+        cache.outerIndices(pattern.JA, pattern.rows, pattern.nnz).copyToHost(hostOuter.data());
+        REQUIRE(hostOuter == Sel::expandOuterIndices(modifiedJA.data(), hostA.rows));
+        //replaced outer indices, the old ones are released and the new ones are allocated from the caching allocator
+        std::vector<int> replacedJA = hostA.JA;
+        replacedJA[2] = replacedJA[3];
+        pattern.JA = SparsityPattern<SparseFlags::CSR>::IndexVector();
+        pattern.JA = SparsityPattern<SparseFlags::CSR>::IndexVector(replacedJA.size());
+        pattern.JA.copyFromHost(replacedJA.data());
+        cache.outerIndices(pattern.JA, pattern.rows, pattern.nnz).copyToHost(hostOuter.data());
+        REQUIRE(hostOuter == Sel::expandOuterIndices(replacedJA.data(), hostA.rows));
+    }
+}
+
+TEST_CASE("Sparse cwise evaluation - modes", "[Sparse]")
+{
+    SECTION("dense rows")
+    {
+        const internal::HostCsrMatrix<double> A = randomCsrMatrix(denseRowLengths(500, 400), 400, 2);
+        SECTION("CSR - PerOuter") { testCwiseEvaluation<SparseFlags::CSR>(A, SparseCwiseEvaluation::PerOuter); }
+        SECTION("CSR - PerEntry") { testCwiseEvaluation<SparseFlags::CSR>(A, SparseCwiseEvaluation::PerEntry); }
+        SECTION("CSR - Automatic") { testCwiseEvaluation<SparseFlags::CSR>(A, SparseCwiseEvaluation::Automatic); }
+        SECTION("CSC - PerOuter") { testCwiseEvaluation<SparseFlags::CSC>(A, SparseCwiseEvaluation::PerOuter); }
+        SECTION("CSC - PerEntry") { testCwiseEvaluation<SparseFlags::CSC>(A, SparseCwiseEvaluation::PerEntry); }
+        SECTION("CSC - Automatic") { testCwiseEvaluation<SparseFlags::CSC>(A, SparseCwiseEvaluation::Automatic); }
+    }
+    SECTION("banded")
+    {
+        const internal::HostCsrMatrix<double> A = randomCsrMatrix(std::vector<int>(300, 7), 200, 3);
+        SECTION("CSR - PerOuter") { testCwiseEvaluation<SparseFlags::CSR>(A, SparseCwiseEvaluation::PerOuter); }
+        SECTION("CSR - PerEntry") { testCwiseEvaluation<SparseFlags::CSR>(A, SparseCwiseEvaluation::PerEntry); }
+        SECTION("CSC - PerEntry") { testCwiseEvaluation<SparseFlags::CSC>(A, SparseCwiseEvaluation::PerEntry); }
+    }
+}
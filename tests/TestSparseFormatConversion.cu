@@ -0,0 +1,197 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+//{1, 4, 0, 0, 0},
+//{0, 2, 3, 0, 0},
+//{5, 0, 0, 7, 8},
+//{0, 0, 9, 0, 6}
+static const std::vector<int> exampleJA = { 0, 2, 4, 7, 9 };
+static const std::vector<int> exampleIA = { 0, 1, 1, 2, 0, 3, 4, 2, 4 };
+
+TEST_CASE("Sparse format conversion - host patterns", "[Sparse]")
+{
+    typedef internal::HostSparseConversion H;
+    SECTION("CSR -> CSC")
+    {
+        H::Conversion c = H::transpose(exampleJA.data(), exampleIA.data(), 4, 5);
+        REQUIRE(c.JA == std::vector<int>({ 0, 2, 4, 6, 7, 9 }));
+        REQUIRE(c.IA == std::vector<int>({ 0, 2, 0, 1, 1, 3, 2, 2, 3 }));
+        REQUIRE(c.source == std::vector<int>({ 0, 4, 1, 2, 3, 7, 5, 6, 8 }));
+        //and back
+        H::Conversion c2 = H::transpose(c.JA.data(), c.IA.data(), 5, 4);
+        REQUIRE(c2.JA == exampleJA);
+        REQUIRE(c2.IA == exampleIA);
+    }
+    SECTION("CSR <-> ELLPACK")
+    {
+        EllpackPaddingReport report;
+        H::Conversion c = H::csrToEllpack(exampleJA.data(), exampleIA.data(), 4, &report);
+        REQUIRE(c.nnzPerRow == 3);
+        REQUIRE(c.IA == std::vector<int>({ 0, 1, 0, 2,   1, 2, 3, 4,   -1, -1, 4, -1 }));
+        REQUIRE(c.source == std::vector<int>({ 0, 2, 4, 7,   1, 3, 5, 8,   -1, -1, 6, -1 }));
+        REQUIRE(report.nnz == 9);
+        REQUIRE(report.storedEntries == 12);
+        REQUIRE(report.paddingRatio() == Approx(12.0 / 9.0));
+        REQUIRE(report.meanRowLength == Approx(9.0 / 4.0));
+
+        H::Conversion c2 = H::ellpackToCsr(c.IA.data(), 4, 3);
+        REQUIRE(c2.JA == exampleJA);
+        REQUIRE(c2.IA == exampleIA);
+        REQUIRE(c2.source == std::vector<int>({ 0, 4, 1, 5, 2, 6, 10, 3, 7 }));
+    }
+    SECTION("COO -> CSR with duplicates")
+    {
+        const std::vector<int> rows = { 2, 0, 2, 1 };
+        const std::vector<int> cols = { 1, 0, 1, 1 };
+        H::Conversion c = H::cooToCompressed(rows.data(), cols.data(), 4, 3, 2);
+        REQUIRE(c.JA == std::vector<int>({ 0, 1, 2, 3 }));
+        REQUIRE(c.IA == std::vector<int>({ 0, 1, 1 }));
+        REQUIRE(c.source == std::vector<int>({ 1, 3, 0, 2 }));
+        REQUIRE(c.segments == std::vector<int>({ 0, 1, 2, 4 }));
+        //two batches
+        const std::vector<float> values = { 1, 2, 3, 4,   10, 20, 30, 40 };
+        REQUIRE(H::sumValues(values.data(), 4, c, 2) == std::vector<float>({ 2, 4, 4,   20, 40, 40 }));
+    }
+    SECTION("CSR -> COO")
+    {
+        H::Conversion c = H::compressedToCoo(exampleJA.data(), 4);
+        REQUIRE(c.IA == std::vector<int>({ 0, 0, 1, 1, 2, 2, 2, 3, 3 }));
+    }
+}
+
+template<SparseConversionBackend Backend>
+static void testConversionRoundTrips()
+{
+    //random matrix with two batches, including empty rows and columns
+    std::mt19937 rng(42);
+    const int rows = 500, cols = 300, batches = 2;
+    internal::HostCsrMatrix<double> hostA;
+    hostA.rows = rows;
+    hostA.cols = cols;
+    hostA.JA.assign(rows + 1, 0);
+    for (int i = 0; i < rows; ++i)
+    {
+        std::vector<int> row;
+        const int length = (i % 7 == 0) ? 0 : static_cast<int>(rng() % 20);
+        for (int k = 0; k < length; ++k) row.push_back(static_cast<int>(rng() % (cols / 2)));
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+        hostA.IA.insert(hostA.IA.end(), row.begin(), row.end());
+        hostA.JA[i + 1] = static_cast<int>(hostA.IA.size());
+    }
+    const int nnz = static_cast<int>(hostA.nnz());
+    std::vector<double> values(nnz * batches);
+    for (double& v : values) v = static_cast<double>(rng() % 1000) / 10;
+
+    typedef SparseMatrix<double, Dynamic, SparseFlags::CSR> CSR_t;
+    CSR_t A(hostA.toSparsityPattern(), batches);
+    A.getData().copyFromHost(values.data());
+    typedef Matrix<double, Dynamic, Dynamic, Dynamic, ColumnMajor> Dense_t;
+    Dense_t expected = A;
+
+    SECTION("CSR <-> CSC")
+    {
+        SparseMatrix<double, Dynamic, SparseFlags::CSC> B = convertToCSC(A, Backend);
+        REQUIRE_NOTHROW(B.getSparsityPattern().assertValid());
+        REQUIRE(B.batches() == batches);
+        REQUIRE(B.getSparsityPattern().nnz == nnz);
+        assertMatrixEquality(expected, Dense_t(B));
+        CSR_t C = convertToCSR(B, Backend);
+        std::vector<int> JA(rows + 1), IA(nnz);
+        C.getSparsityPattern().JA.copyToHost(JA.data());
+        C.getSparsityPattern().IA.copyToHost(IA.data());
+        REQUIRE(JA == hostA.JA);
+        REQUIRE(IA == hostA.IA);
+        assertMatrixEquality(expected, Dense_t(C));
+    }
+    SECTION("CSR <-> ELLPACK")
+    {
+        EllpackPaddingReport report;
+        SparseMatrix<double, Dynamic, SparseFlags::ELLPACK> B = convertToELLPACK(A, Backend, &report);
+        REQUIRE_NOTHROW(B.getSparsityPattern().assertValid());
+        REQUIRE(report.nnz == nnz);
+        REQUIRE(report.storedEntries == rows * B.getSparsityPattern().nnzPerRow);
+        REQUIRE(report.paddingRatio() >= 1.0);
+        assertMatrixEquality(expected, Dense_t(B));
+        CSR_t C = convertToCSR(B, Backend);
+        REQUIRE(C.getSparsityPattern().nnz == nnz);
+        assertMatrixEquality(expected, Dense_t(C));
+    }
+    SECTION("CSR <-> COO")
+    {
+        CooMatrix<double, Dynamic> B = convertToCOO(A, Backend);
+        REQUIRE(B.nnz() == nnz);
+        std::vector<int> rowIndices(nnz);
+        B.rowIndices.copyToHost(rowIndices.data());
+        for (int i = 0; i < rows; ++i)
+            for (int k = hostA.JA[i]; k < hostA.JA[i + 1]; ++k)
+                REQUIRE(rowIndices[k] == i);
+        CSR_t C = convertToCSR(B, Backend);
+        assertMatrixEquality(expected, Dense_t(C));
+    }
+}
+TEST_CASE("Sparse format conversion - round trips", "[Sparse]")
+{
+    SECTION("host") { testConversionRoundTrips<SparseConversionBackend::Host>(); }
+    SECTION("device") { testConversionRoundTrips<SparseConversionBackend::Device>(); }
+}
+
+template<SparseConversionBackend Backend>
+static void testCooDuplicates()
+{
+    //every entry of the example matrix split into three parts, in random order
+    const std::vector<float> exampleValues = { 1, 4, 2, 3, 5, 7, 8, 9, 6 };
+    std::vector<int> order(27);
+    for (int i = 0; i < 27; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    std::vector<int> rowIndices(27), colIndices(27);
+    std::vector<float> values(27);
+    for (int i = 0; i < 27; ++i)
+    {
+        const int k = order[i] % 9;
+        rowIndices[i] = static_cast<int>(std::upper_bound(exampleJA.begin(), exampleJA.end(), k) - exampleJA.begin()) - 1;
+        colIndices[i] = exampleIA[k];
+        values[i] = exampleValues[k] / 4 * (order[i] < 9 ? 2 : 1);
+    }
+    CooMatrix<float, 1> coo;
+    coo.rows = 4;
+    coo.cols = 5;
+    coo.rowIndices = CooMatrix<float, 1>::IndexVector(27);
+    coo.rowIndices.copyFromHost(rowIndices.data());
+    coo.colIndices = CooMatrix<float, 1>::IndexVector(27);
+    coo.colIndices.copyFromHost(colIndices.data());
+    coo.values = CooMatrix<float, 1>::DataVector(27);
+    coo.values.copyFromHost(values.data());
+
+    SparseMatrix<float, 1, SparseFlags::CSR> A = convertToCSR(coo, Backend);
+    REQUIRE(A.getSparsityPattern().nnz == 9);
+    std::vector<int> JA(5), IA(9);
+    A.getSparsityPattern().JA.copyToHost(JA.data());
+    A.getSparsityPattern().IA.copyToHost(IA.data());
+    REQUIRE(JA == exampleJA);
+    REQUIRE(IA == exampleIA);
+    const float expectedData[1][4][5] = {
+        {
+            {1, 4, 0, 0, 0},
+            {0, 2, 3, 0, 0},
+            {5, 0, 0, 7, 8},
+            {0, 0, 9, 0, 6}
+        }
+    };
+    MatrixXfC mat = A;
+    assertMatrixEquality(expectedData, mat);
+}
+TEST_CASE("Sparse format conversion - COO duplicates", "[Sparse]")
+{
+    SECTION("host") { testCooDuplicates<SparseConversionBackend::Host>(); }
+    SECTION("device") { testCooDuplicates<SparseConversionBackend::Device>(); }
+}
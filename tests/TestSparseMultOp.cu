@@ -517,3 +517,176 @@ TEST_CASE("ELLPACK BMatrix-BVector Product", "[Sparse]")
 
 	assertMatrixEqualityRelative(xExpected, xActual);
 }
+
+//The matrix
+//{1, 4, 0, 0, 0},
+//{0, 2, 3, 0, 0},
+//{5, 0, 0, 7, 8},
+//{0, 0, 9, 0, 6}
+//in CSR and CSC format
+template<typename Scalar, int Batches>
+static SparseMatrix<Scalar, Batches, SparseFlags::CSR> transposedProductMatrixCSR()
+{
+    typedef SparsityPattern<SparseFlags::CSR> SPattern;
+    SPattern pattern;
+    pattern.rows = 4;
+    pattern.cols = 5;
+    pattern.nnz = 9;
+    pattern.IA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(9) << 0, 1, 1, 2, 0, 3, 4, 2, 4).finished());
+    pattern.JA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(5) << 0, 2, 4, 7, 9).finished());
+    REQUIRE_NOTHROW(pattern.assertValid());
+    SparseMatrix<Scalar, Batches, SparseFlags::CSR> A(pattern);
+    const float values[9] = { 1, 4, 2, 3, 5, 7, 8, 9, 6 };
+    std::vector<Scalar> data(9 * Batches);
+    for (int b = 0; b < Batches; ++b) for (int i = 0; i < 9; ++i)
+        data[i + 9 * b] = Scalar(values[i] * (b + 1));
+    A.getData().copyFromHost(data.data());
+    return A;
+}
+template<typename Scalar, int Batches>
+static SparseMatrix<Scalar, Batches, SparseFlags::CSC> transposedProductMatrixCSC()
+{
+    typedef SparsityPattern<SparseFlags::CSC> SPattern;
+    SPattern pattern;
+    pattern.rows = 4;
+    pattern.cols = 5;
+    pattern.nnz = 9;
+    pattern.IA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(9) << 0, 2, 0, 1, 1, 3, 2, 2, 3).finished());
+    pattern.JA = SPattern::IndexVector::fromEigen((Eigen::VectorXi(6) << 0, 2, 4, 6, 7, 9).finished());
+    REQUIRE_NOTHROW(pattern.assertValid());
+    SparseMatrix<Scalar, Batches, SparseFlags::CSC> A(pattern);
+    const float values[9] = { 1, 5, 4, 2, 3, 9, 7, 8, 6 };
+    std::vector<Scalar> data(9 * Batches);
+    for (int b = 0; b < Batches; ++b) for (int i = 0; i < 9; ++i)
+        data[i + 9 * b] = Scalar(values[i] * (b + 1));
+    A.getData().copyFromHost(data.data());
+    return A;
+}
+
+TEST_CASE("CSR Transposed Matrix-Vector Product", "[Sparse]")
+{
+    auto A = transposedProductMatrixCSR<float, 1>();
+    VectorXf b = VectorXf::fromEigen((Eigen::VectorXf(4) << 2, 5, 3, -4).finished());
+    VectorXf xExpected = VectorXf::fromEigen((Eigen::VectorXf(5) << 17, 18, -21, 21, 0).finished());
+
+    SECTION("assign") {
+        Profiling::instance().resetAll();
+        VectorXf xActual = A.transpose() * b;
+        REQUIRE(Profiling::instance().get(Profiling::EvalAny) == 1);
+        REQUIRE(Profiling::instance().get(Profiling::EvalMatmulSparse) == 1);
+        assertMatrixEqualityRelative(xExpected, xActual);
+    }
+    SECTION("adjoint of a real matrix") {
+        VectorXf xActual = A.adjoint() * b;
+        assertMatrixEqualityRelative(xExpected, xActual);
+    }
+    SECTION("compound assignment") {
+        VectorXf xActual = VectorXf::Constant(5, 1);
+        xActual += A.transpose() * b;
+        assertMatrixEqualityRelative((xExpected + 1).eval(), xActual);
+        xActual -= A.transpose() * b;
+        assertMatrixEqualityRelative(VectorXf::Constant(5, 1), xActual);
+    }
+    SECTION("into a block") {
+        VectorXf xActual = VectorXf::Zero(7);
+        xActual.block(1, 0, 0, 5, 1, 1) = A.transpose() * b;
+        std::vector<float> host(7);
+        xActual.copyToHost(host.data());
+        REQUIRE(host[0] == 0);
+        REQUIRE(host[1] == 17);
+        REQUIRE(host[3] == -21);
+        REQUIRE(host[6] == 0);
+    }
+}
+
+TEST_CASE("CSR Transposed BMatrix-BVector Product", "[Sparse]")
+{
+    auto A = transposedProductMatrixCSR<float, 3>();
+    typedef Matrix<float, Dynamic, 1, 3, ColumnMajor> VectorXfB3;
+    VectorXfB3 b(4, 1, 3);
+    b.slice(0) = VectorXf::fromEigen((Eigen::VectorXf(4) << 2, 5, 3, -4).finished());
+    b.slice(1) = b.slice(0) * 2;
+    b.slice(2) = b.slice(0) * -1;
+    VectorXfB3 xExpected(5, 1, 3);
+    xExpected.slice(0) = VectorXf::fromEigen((Eigen::VectorXf(5) << 17, 18, -21, 21, 0).finished());
+    xExpected.slice(1) = xExpected.slice(0) * 4;
+    xExpected.slice(2) = xExpected.slice(0) * -3;
+
+    VectorXfB3 xActual = A.transpose() * b;
+    assertMatrixEqualityRelative(xExpected, xActual);
+}
+
+TEST_CASE("CSC Matrix-Vector Product", "[Sparse]")
+{
+    auto A = transposedProductMatrixCSC<float, 1>();
+
+    SECTION("non-transposed") {
+        VectorXf b = VectorXf::fromEigen((Eigen::VectorXf(5) << 2, 5, 3, -4, 1).finished());
+        VectorXf xExpected = VectorXf::fromEigen((Eigen::VectorXf(4) << 22, 19, -10, 33).finished());
+        Profiling::instance().resetAll();
+        VectorXf xActual = A * b;
+        REQUIRE(Profiling::instance().get(Profiling::EvalAny) == 1);
+        REQUIRE(Profiling::instance().get(Profiling::EvalMatmulSparse) == 1);
+        assertMatrixEqualityRelative(xExpected, xActual);
+    }
+    SECTION("transposed") {
+        VectorXf b = VectorXf::fromEigen((Eigen::VectorXf(4) << 2, 5, 3, -4).finished());
+        VectorXf xExpected = VectorXf::fromEigen((Eigen::VectorXf(5) << 17, 18, -21, 21, 0).finished());
+        Profiling::instance().resetAll();
+        VectorXf xActual = A.transpose() * b;
+        REQUIRE(Profiling::instance().get(Profiling::EvalAny) == 1);
+        REQUIRE(Profiling::instance().get(Profiling::EvalMatmulSparse) == 1);
+        assertMatrixEqualityRelative(xExpected, xActual);
+    }
+}
+
+template<int _SparseFlags>
+static void testSparseAdjointProduct(const SparseMatrix<cfloat, 1, _SparseFlags>& A)
+{
+    //A has the values of the real matrix times (1+2i), b = (2, 5, 3, -4) * (1-i)
+    std::vector<cfloat> bHost = { cfloat(2, -2), cfloat(5, -5), cfloat(3, -3), cfloat(-4, 4) };
+    VectorXcf b(4);
+    b.copyFromHost(bHost.data());
+    const float real[5] = { 17, 18, -21, 21, 0 };
+
+    SECTION("transposed") {
+        //A^T b = (1+2i)(1-i) * (17, 18, -21, 21, 0) = (3+i) * ...
+        VectorXcf x = A.transpose() * b;
+        std::vector<cfloat> xHost(5);
+        x.copyToHost(xHost.data());
+        for (int i = 0; i < 5; ++i) {
+            INFO("i=" << i);
+            REQUIRE(xHost[i].real() == Approx(3 * real[i]));
+            REQUIRE(xHost[i].imag() == Approx(1 * real[i]));
+        }
+    }
+    SECTION("adjoint") {
+        //A^H b = (1-2i)(1-i) * (17, 18, -21, 21, 0) = (-1-3i) * ...
+        Profiling::instance().resetAll();
+        VectorXcf x = A.adjoint() * b;
+        REQUIRE(Profiling::instance().get(Profiling::EvalAny) == 1);
+        REQUIRE(Profiling::instance().get(Profiling::EvalMatmulSparse) == 1);
+        std::vector<cfloat> xHost(5);
+        x.copyToHost(xHost.data());
+        for (int i = 0; i < 5; ++i) {
+            INFO("i=" << i);
+            REQUIRE(xHost[i].real() == Approx(-1 * real[i]));
+            REQUIRE(xHost[i].imag() == Approx(-3 * real[i]));
+        }
+    }
+}
+TEST_CASE("Sparse Adjoint Matrix-Vector Product", "[Sparse]")
+{
+    SECTION("CSR") {
+        auto A = transposedProductMatrixCSR<float, 1>();
+        SparseMatrix<cfloat, 1, SparseFlags::CSR> Ac(A.getSparsityPattern());
+        Ac.getData() = A.getData().cast<cfloat>() * cfloat(1, 2);
+        testSparseAdjointProduct(Ac);
+    }
+    SECTION("CSC") {
+        auto A = transposedProductMatrixCSC<float, 1>();
+        SparseMatrix<cfloat, 1, SparseFlags::CSC> Ac(A.getSparsityPattern());
+        Ac.getData() = A.getData().cast<cfloat>() * cfloat(1, 2);
+        testSparseAdjointProduct(Ac);
+    }
+}
@@ -0,0 +1,191 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <map>
+#include <random>
+#include <algorithm>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+//the merged matrix on the host: union or intersection of the patterns, op(a, b) per entry
+template<typename _Op>
+static internal::HostCsrMatrix<double> hostMerge(const internal::HostCsrMatrix<double>& A, const internal::HostCsrMatrix<double>& B,
+    bool intersection, _Op op)
+{
+    internal::HostCsrMatrix<double> C;
+    C.rows = A.rows;
+    C.cols = A.cols;
+    C.JA.assign(A.rows + 1, 0);
+    for (int i = 0; i < A.rows; ++i)
+    {
+        std::map<int, std::pair<int, int>> row; //column -> (entry of A, entry of B)
+        for (int k = A.JA[i]; k < A.JA[i + 1]; ++k) row[A.IA[k]] = std::make_pair(k, -1);
+        for (int k = B.JA[i]; k < B.JA[i + 1]; ++k)
+        {
+            if (row.count(B.IA[k])) row[B.IA[k]].second = k;
+            else row[B.IA[k]] = std::make_pair(-1, k);
+        }
+        for (const auto& e : row)
+        {
+            if (intersection && (e.second.first < 0 || e.second.second < 0)) continue;
+            C.IA.push_back(e.first);
+            C.values.push_back(op(e.second.first >= 0 ? A.values[e.second.first] : 0.0, e.second.second >= 0 ? B.values[e.second.second] : 0.0));
+        }
+        C.JA[i + 1] = static_cast<int>(C.IA.size());
+    }
+    return C;
+}
+
+TEST_CASE("Sparse pattern merge - random", "[Sparse][Merge]")
+{
+    const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(randomRowLengths(50, 8, 17), 40, 18);
+    const internal::HostCsrMatrix<double> hostB = randomCsrMatrix(randomRowLengths(50, 8, 19), 40, 20);
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    SMatrix A = hostA.toSparseMatrix();
+    SMatrix B = hostB.toSparseMatrix();
+
+    SECTION("add")
+    {
+        SMatrix C = sparseAdd(A, B);
+        REQUIRE_NOTHROW(C.getSparsityPattern().assertValid());
+        requireEqual(hostMerge(hostA, hostB, false, [](double a, double b) {return a + b; }), C);
+    }
+    SECTION("sub")
+    {
+        SMatrix C = sparseSub(A, B);
+        requireEqual(hostMerge(hostA, hostB, false, [](double a, double b) {return a - b; }), C);
+    }
+    SECTION("cwiseMul")
+    {
+        SMatrix C = sparseCwiseMul(A, B);
+        REQUIRE_NOTHROW(C.getSparsityPattern().assertValid());
+        requireEqual(hostMerge(hostA, hostB, true, [](double a, double b) {return a * b; }), C);
+    }
+    SECTION("same pattern")
+    {
+        SMatrix C = sparseAdd(A, A);
+        requireEqual(hostA, C, 0, 2);
+        SMatrix D = sparseCwiseMul(A, A);
+        REQUIRE(D.getSparsityPattern().nnz == hostA.nnz());
+    }
+    SECTION("empty operand")
+    {
+        internal::HostCsrMatrix<double> hostZero;
+        hostZero.rows = 50;
+        hostZero.cols = 40;
+        hostZero.JA.assign(51, 0);
+        SMatrix Z = hostZero.toSparseMatrix();
+        SMatrix C = sparseAdd(A, Z);
+        requireEqual(hostA, C);
+        SMatrix D = sparseCwiseMul(A, Z);
+        REQUIRE(D.getSparsityPattern().nnz == 0);
+        std::vector<int> JA(51);
+        D.getSparsityPattern().JA.copyToHost(JA.data());
+        REQUIRE(JA == std::vector<int>(51, 0));
+    }
+}
+
+TEST_CASE("Sparse pattern merge - cache", "[Sparse][Merge]")
+{
+    const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(randomRowLengths(30, 5, 3), 30, 4);
+    const internal::HostCsrMatrix<double> hostB = randomCsrMatrix(randomRowLengths(30, 5, 5), 30, 6);
+    const internal::HostCsrMatrix<double> expected = hostMerge(hostA, hostB, false, [](double a, double b) {return a + b; });
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    SMatrix A = hostA.toSparseMatrix();
+    SMatrix B = hostB.toSparseMatrix();
+
+    SparsePatternMerge<SparseFlags::CSR> cache;
+    REQUIRE_FALSE(cache.matches(A.getSparsityPattern(), B.getSparsityPattern(), false));
+    SMatrix C = sparseAdd(A, B, &cache);
+    requireEqual(expected, C);
+    REQUIRE(cache.matches(A.getSparsityPattern(), B.getSparsityPattern(), false));
+    REQUIRE_FALSE(cache.matches(A.getSparsityPattern(), B.getSparsityPattern(), true));
+    const int* JA = cache.pattern.JA.data();
+
+    //new values, same patterns: the cached union is reused
+    A.getData() = A.getData() * 2.0;
+    B.getData() = B.getData() * 2.0;
+    SMatrix D = sparseAdd(A, B, &cache);
+    REQUIRE(cache.pattern.JA.data() == JA);
+    requireEqual(expected, D, 0, 2);
+
+    //the explicit numeric phase into an existing matrix
+    sparseMergeNumeric<functor::BinaryMathFunctor_cwiseSub<double>>(cache, A, B, D);
+    requireEqual(hostMerge(hostA, hostB, false, [](double a, double b) {return a - b; }), D, 0, 2);
+
+    //an intersection replaces the cached union
+    SMatrix E = sparseCwiseMul(A, B, &cache);
+    REQUIRE(cache.intersection);
+    requireEqual(hostMerge(hostA, hostB, true, [](double a, double b) {return a * b; }), E, 0, 4);
+}
+
+//the same row lengths (and nnz) with the columns shifted by one, the columns of every row stay sorted
+static internal::HostCsrMatrix<double> shiftColumns(const internal::HostCsrMatrix<double>& A)
+{
+    internal::HostCsrMatrix<double> B = A;
+    for (Index i = 0; i < A.rows; ++i)
+    {
+        std::vector<std::pair<int, double>> row;
+        for (int k = A.JA[i]; k < A.JA[i + 1]; ++k)
+            row.emplace_back(static_cast<int>((A.IA[k] + 1) % A.cols), A.values[k]);
+        std::sort(row.begin(), row.end());
+        for (int k = A.JA[i]; k < A.JA[i + 1]; ++k)
+        {
+            B.IA[k] = row[k - A.JA[i]].first;
+            B.values[k] = row[k - A.JA[i]].second;
+        }
+    }
+    return B;
+}
+
+TEST_CASE("Sparse pattern merge - cache after freeing the operands", "[Sparse][Merge]")
+{
+    const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(randomRowLengths(30, 5, 5), 30, 6);
+    const internal::HostCsrMatrix<double> hostB = randomCsrMatrix(randomRowLengths(30, 5, 7), 30, 8);
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+
+    SparsePatternMerge<SparseFlags::CSR> cache;
+    {
+        SMatrix A = hostA.toSparseMatrix();
+        SMatrix B = hostB.toSparseMatrix();
+        SMatrix C = sparseAdd(A, B, &cache);
+        requireEqual(hostMerge(hostA, hostB, false, [](double a, double b) {return a + b; }), C);
+    }
+    //A and B are freed, the new patterns have the same nnz and are allocated from the caching allocator
+    const internal::HostCsrMatrix<double> hostA2 = shiftColumns(hostA);
+    const internal::HostCsrMatrix<double> hostB2 = shiftColumns(hostB);
+    SMatrix A2 = hostA2.toSparseMatrix();
+    SMatrix B2 = hostB2.toSparseMatrix();
+    REQUIRE_FALSE(cache.matches(A2.getSparsityPattern(), B2.getSparsityPattern(), false));
+    SMatrix C2 = sparseAdd(A2, B2, &cache);
+    requireEqual(hostMerge(hostA2, hostB2, false, [](double a, double b) {return a + b; }), C2);
+    REQUIRE(cache.matches(A2.getSparsityPattern(), B2.getSparsityPattern(), false));
+}
+
+TEST_CASE("Sparse pattern merge - batched", "[Sparse][Merge]")
+{
+    const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(randomRowLengths(25, 5, 23), 20, 24);
+    const internal::HostCsrMatrix<double> hostB = randomCsrMatrix(randomRowLengths(25, 5, 25), 20, 26);
+    const internal::HostCsrMatrix<double> expected = hostMerge(hostA, hostB, true, [](double a, double b) {return a * b; });
+    typedef SparseMatrix<double, Dynamic, SparseFlags::CSR> SMatrix;
+
+    //batch b of A is scaled by b+1, B has a single batch and is broadcasted
+    const int batches = 3;
+    SMatrix A(hostA.toSparsityPattern(), batches);
+    std::vector<double> values;
+    for (int b = 0; b < batches; ++b)
+        for (double v : hostA.values) values.push_back((b + 1) * v);
+    A.getData().copyFromHost(values.data());
+    SMatrix B(hostB.toSparsityPattern(), 1);
+    B.getData().copyFromHost(hostB.values.data());
+
+    SMatrix C = sparseCwiseMul(A, B);
+    REQUIRE(C.batches() == batches);
+    for (int b = 0; b < batches; ++b)
+        requireEqual(expected, C, b, b + 1);
+}
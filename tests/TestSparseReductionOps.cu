@@ -0,0 +1,218 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+#include <cmath>
+
+#define CUMAT_UNITTESTS_LAST_REDUCTION 1
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+//random CSR pattern with a few long rows and some empty rows
+static internal::HostCsrMatrix<float> randomReductionPattern(int rows, int cols, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    internal::HostCsrMatrix<float> A;
+    A.rows = rows;
+    A.cols = cols;
+    A.JA.assign(rows + 1, 0);
+    for (int i = 0; i < rows; ++i)
+    {
+        const int stride = (i % 7 == 0) ? 1 : (i % 5 == 0 ? cols + 1 : 3 + static_cast<int>(rng() % 5));
+        for (int j = static_cast<int>(rng() % 3); j < cols; j += stride)
+            A.IA.push_back(j);
+        A.JA[i + 1] = static_cast<int>(A.IA.size());
+    }
+    return A;
+}
+
+//Compares the sums over the stored entries with the sums of the dense host matrix.
+//For CSC, the host pattern is the CSR pattern of the transposed matrix.
+template<int _SparseFlags>
+static void testSparseReductions(const internal::HostCsrMatrix<float>& outerPattern)
+{
+    const bool csr = _SparseFlags == SparseFlags::CSR;
+    const Index rows = csr ? outerPattern.rows : outerPattern.cols;
+    const Index cols = csr ? outerPattern.cols : outerPattern.rows;
+    const Index nnz = outerPattern.nnz();
+    const int batches = 3;
+    typedef SparseMatrix<float, Dynamic, _SparseFlags> SMatrix;
+    typedef Matrix<float, Dynamic, Dynamic, Dynamic, ColumnMajor> DMatrix;
+
+    SparsityPattern<_SparseFlags> pattern;
+    pattern.rows = rows;
+    pattern.cols = cols;
+    pattern.nnz = nnz;
+    pattern.JA = typename SparsityPattern<_SparseFlags>::IndexVector(outerPattern.JA.size());
+    pattern.JA.copyFromHost(outerPattern.JA.data());
+    pattern.IA = typename SparsityPattern<_SparseFlags>::IndexVector(nnz);
+    pattern.IA.copyFromHost(outerPattern.IA.data());
+    SMatrix A(pattern, batches);
+
+    //values and the dense column-major host matrix
+    std::vector<float> values(nnz * batches);
+    std::vector<float> dense(rows * cols * batches, 0.0f);
+    for (int b = 0; b < batches; ++b)
+        for (Index o = 0; o < outerPattern.rows; ++o)
+            for (int k = outerPattern.JA[o]; k < outerPattern.JA[o + 1]; ++k)
+            {
+                const Index i = csr ? o : outerPattern.IA[k];
+                const Index j = csr ? outerPattern.IA[k] : o;
+                values[k + nnz * b] = static_cast<float>((k * 7 + b * 3) % 11) - 5.0f;
+                dense[i + rows * (j + cols * b)] = values[k + nnz * b];
+            }
+    A.getData().copyFromHost(values.data());
+
+    //host sum over the axes, column-major output
+    auto hostSum = [&](int axis, bool squared)
+    {
+        const Index r = (axis & Axis::Row) ? 1 : rows;
+        const Index c = (axis & Axis::Column) ? 1 : cols;
+        const Index bs = (axis & Axis::Batch) ? 1 : batches;
+        std::vector<float> out(r * c * bs, 0.0f);
+        for (int b = 0; b < batches; ++b)
+            for (Index j = 0; j < cols; ++j)
+                for (Index i = 0; i < rows; ++i)
+                {
+                    const float v = dense[i + rows * (j + cols * b)];
+                    const Index oi = (axis & Axis::Row) ? 0 : i;
+                    const Index oj = (axis & Axis::Column) ? 0 : j;
+                    const Index ob = (axis & Axis::Batch) ? 0 : b;
+                    out[oi + r * (oj + c * ob)] += squared ? v * v : v;
+                }
+        return out;
+    };
+    auto check = [&](const DMatrix& result, const std::vector<float>& expected, const std::string& algorithm)
+    {
+        INFO("algorithm=" << algorithm);
+        REQUIRE(LastReductionAlgorithm == algorithm);
+        REQUIRE(result.size() == Index(expected.size()));
+        std::vector<float> actual(expected.size());
+        result.copyToHost(actual.data());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            INFO("i=" << i);
+            REQUIRE(actual[i] == Approx(expected[i]));
+        }
+    };
+    const std::string outerAlgorithm = csr ? "sparse-outer" : "sparse-inner";
+    const std::string innerAlgorithm = csr ? "sparse-inner" : "sparse-outer";
+
+    SECTION("row sums")
+    {
+        DMatrix result(rows, 1, batches);
+        result = A.template sum<Axis::Column>();
+        check(result, hostSum(Axis::Column, false), outerAlgorithm);
+    }
+    SECTION("column sums")
+    {
+        DMatrix result(1, cols, batches);
+        result = A.template sum<Axis::Row>();
+        check(result, hostSum(Axis::Row, false), innerAlgorithm);
+    }
+    SECTION("row sums over batches")
+    {
+        DMatrix result(rows, 1, 1);
+        result = A.template sum<Axis::Column | Axis::Batch>();
+        check(result, hostSum(Axis::Column | Axis::Batch, false), outerAlgorithm);
+    }
+    SECTION("column sums over batches")
+    {
+        DMatrix result(1, cols, 1);
+        result = A.template sum<Axis::Row | Axis::Batch>();
+        check(result, hostSum(Axis::Row | Axis::Batch, false), innerAlgorithm);
+    }
+    SECTION("batch sums")
+    {
+        DMatrix result(rows, cols, 1);
+        result = A.template sum<Axis::Batch>();
+        check(result, hostSum(Axis::Batch, false), "sparse-batches");
+    }
+    SECTION("dynamic axis")
+    {
+        DMatrix result(rows, 1, batches);
+        result = A.sum(Axis::Column);
+        check(result, hostSum(Axis::Column, false), outerAlgorithm);
+    }
+    SECTION("sum")
+    {
+        DMatrix result(1, 1, 1);
+        result = A.sum();
+        check(result, hostSum(Axis::All, false), "sparse-entries");
+    }
+    SECTION("squared norm")
+    {
+        DMatrix result(1, 1, batches);
+        result = A.squaredNorm();
+        check(result, hostSum(Axis::Row | Axis::Column, true), "sparse-entries");
+    }
+    SECTION("norm")
+    {
+        std::vector<float> expected = hostSum(Axis::Row | Axis::Column, true);
+        for (float& e : expected) e = std::sqrt(e);
+        DMatrix result(1, 1, batches);
+        result = A.norm();
+        check(result, expected, "sparse-entries");
+    }
+    SECTION("squared row norms")
+    {
+        DMatrix result(rows, 1, batches);
+        result = A.cwiseAbs2().template sum<Axis::Column>();
+        check(result, hostSum(Axis::Column, true), outerAlgorithm);
+    }
+    SECTION("product with the same pattern")
+    {
+        DMatrix result(1, 1, batches);
+        result = A.cwiseMul(A).template sum<Axis::Row | Axis::Column>();
+        check(result, hostSum(Axis::Row | Axis::Column, true), "sparse-entries");
+    }
+    SECTION("product with a copied pattern")
+    {
+        //same pattern in a different memory, evaluated densely
+        SMatrix B(pattern.deepClone(), batches);
+        B.getData().copyFromHost(values.data());
+        DMatrix result(1, 1, batches);
+        result = A.cwiseMul(B).template sum<Axis::Row | Axis::Column>();
+        REQUIRE(LastReductionAlgorithm.rfind("sparse", 0) != 0);
+        std::vector<float> expected = hostSum(Axis::Row | Axis::Column, true);
+        std::vector<float> actual(batches);
+        result.copyToHost(actual.data());
+        for (int b = 0; b < batches; ++b)
+            REQUIRE(actual[b] == Approx(expected[b]));
+    }
+    SECTION("maximum is evaluated densely")
+    {
+        //the implicit zeros take part in the maximum
+        DMatrix result(1, 1, batches);
+        result = A.template maxCoeff<Axis::Row | Axis::Column>();
+        REQUIRE(LastReductionAlgorithm.rfind("sparse", 0) != 0);
+        std::vector<float> actual(batches);
+        result.copyToHost(actual.data());
+        for (int b = 0; b < batches; ++b)
+        {
+            float expected = dense[rows * cols * b];
+            for (Index i = 0; i < rows * cols; ++i)
+                expected = std::max(expected, dense[i + rows * cols * b]);
+            REQUIRE(actual[b] == expected);
+        }
+    }
+}
+
+TEST_CASE("Sparse reductions", "[Sparse]")
+{
+    const internal::HostCsrMatrix<float> A = randomReductionPattern(150, 120, 1);
+    SECTION("CSR") { testSparseReductions<SparseFlags::CSR>(A); }
+    SECTION("CSC") { testSparseReductions<SparseFlags::CSC>(A); }
+    SECTION("empty")
+    {
+        internal::HostCsrMatrix<float> E;
+        E.rows = 10;
+        E.cols = 8;
+        E.JA.assign(11, 0);
+        testSparseReductions<SparseFlags::CSR>(E);
+    }
+}
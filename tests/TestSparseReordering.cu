@@ -0,0 +1,133 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+
+using namespace cuMat;
+
+//2D Poisson matrix on a gridSize x gridSize grid with randomly numbered nodes, like a badly ordered mesh
+static internal::HostCsrMatrix<double> shuffledPoisson(int gridSize, unsigned seed)
+{
+    const int n = gridSize * gridSize;
+    std::vector<int> number(n);
+    for (int i = 0; i < n; ++i) number[i] = i;
+    std::shuffle(number.begin(), number.end(), std::mt19937(seed));
+    std::vector<std::vector<std::pair<int, double>>> rows(n);
+    for (int x = 0; x < gridSize; ++x) for (int y = 0; y < gridSize; ++y)
+    {
+        std::vector<std::pair<int, double>>& row = rows[number[x * gridSize + y]];
+        row.emplace_back(number[x * gridSize + y], 4);
+        if (x > 0) row.emplace_back(number[(x - 1) * gridSize + y], -1);
+        if (y > 0) row.emplace_back(number[x * gridSize + y - 1], -1);
+        if (x < gridSize - 1) row.emplace_back(number[(x + 1) * gridSize + y], -1);
+        if (y < gridSize - 1) row.emplace_back(number[x * gridSize + y + 1], -1);
+    }
+    internal::HostCsrMatrix<double> A;
+    A.rows = n;
+    A.cols = n;
+    for (auto& row : rows)
+    {
+        std::sort(row.begin(), row.end());
+        for (const auto& e : row)
+        {
+            A.IA.push_back(e.first);
+            A.values.push_back(e.second);
+        }
+        A.JA.push_back(static_cast<int>(A.IA.size()));
+    }
+    return A;
+}
+
+static bool isPermutation(std::vector<int> p)
+{
+    std::sort(p.begin(), p.end());
+    for (size_t i = 0; i < p.size(); ++i)
+        if (p[i] != static_cast<int>(i)) return false;
+    return true;
+}
+
+TEST_CASE("Sparse reordering - host", "[Sparse]")
+{
+    typedef internal::HostReordering H;
+    const int gridSize = 30;
+    const internal::HostCsrMatrix<double> A = shuffledPoisson(gridSize, 1);
+    const Index n = A.rows;
+    const Index bandwidth = H::bandwidth(A.JA.data(), A.IA.data(), n);
+    const Index profile = H::profile(A.JA.data(), A.IA.data(), n);
+
+    SECTION("reverse Cuthill-McKee")
+    {
+        const std::vector<int> p = H::reverseCuthillMcKee(A.JA.data(), A.IA.data(), n);
+        REQUIRE(isPermutation(p));
+        const std::vector<int> inv = H::inverse(p);
+        //a level structure of a grid from a corner has levels of at most gridSize nodes
+        REQUIRE(H::bandwidth(A.JA.data(), A.IA.data(), n, inv.data()) <= 2 * gridSize);
+        REQUIRE(H::profile(A.JA.data(), A.IA.data(), n, inv.data()) < profile / 10);
+    }
+    SECTION("nested dissection")
+    {
+        const std::vector<int> p = H::nestedDissection(A.JA.data(), A.IA.data(), n, 32);
+        REQUIRE(isPermutation(p));
+        const std::vector<int> inv = H::inverse(p);
+        REQUIRE(H::bandwidth(A.JA.data(), A.IA.data(), n, inv.data()) < bandwidth);
+        REQUIRE(H::profile(A.JA.data(), A.IA.data(), n, inv.data()) < profile / 2);
+    }
+    SECTION("disconnected graph")
+    {
+        //{0,1} connected, 2 isolated, 3 only a diagonal entry
+        const std::vector<int> JA = { 0, 1, 2, 2, 3 };
+        const std::vector<int> IA = { 1, 0, 3 };
+        REQUIRE(isPermutation(H::reverseCuthillMcKee(JA.data(), IA.data(), 4)));
+        REQUIRE(isPermutation(H::nestedDissection(JA.data(), IA.data(), 4, 1)));
+    }
+    SECTION("symmetric permutation")
+    {
+        const std::vector<int> p = H::reverseCuthillMcKee(A.JA.data(), A.IA.data(), n);
+        const std::vector<int> inv = H::inverse(p);
+        const internal::SparsePatternConversion<std::vector<int>> c = H::permuteSymmetric(A.JA.data(), A.IA.data(), n, p, inv);
+        for (Index i = 0; i < n; ++i)
+            for (int k = c.JA[i]; k < c.JA[i + 1]; ++k)
+            {
+                //new entry (i, c.IA[k]) is old entry (p[i], p[c.IA[k]])
+                REQUIRE(c.source[k] >= A.JA[p[i]]);
+                REQUIRE(c.source[k] < A.JA[p[i] + 1]);
+                REQUIRE(A.IA[c.source[k]] == p[c.IA[k]]);
+                if (k > c.JA[i]) REQUIRE(c.IA[k - 1] < c.IA[k]);
+            }
+    }
+}
+
+TEST_CASE("Sparse reordering - permuted product", "[Sparse]")
+{
+    const internal::HostCsrMatrix<double> hostA = shuffledPoisson(20, 2);
+    const Index n = hostA.rows;
+    typedef SparseMatrix<double, 2, SparseFlags::CSR> SMatrix;
+    typedef Matrix<double, Dynamic, 1, 2, ColumnMajor> BVector;
+    SMatrix A(hostA.toSparsityPattern());
+    std::vector<double> values(hostA.values);
+    for (double v : hostA.values) values.push_back(2 * v);
+    A.getData().copyFromHost(values.data());
+    std::vector<double> hostX(2 * n);
+    std::mt19937 rng(3);
+    for (double& v : hostX) v = static_cast<double>(rng() % 100) / 10;
+    BVector x(n, 1, 2);
+    x.copyFromHost(hostX.data());
+    BVector expected = A * x;
+
+    const SparseReordering reorderings[] = { reverseCuthillMcKee(A.getSparsityPattern()), nestedDissection(A.getSparsityPattern(), 16) };
+    for (const SparseReordering& r : reorderings)
+    {
+        REQUIRE(r.bandwidthAfter < r.bandwidthBefore);
+        REQUIRE(r.profileAfter < r.profileBefore);
+        SMatrix B = permuteSymmetric(A, r);
+        REQUIRE_NOTHROW(B.getSparsityPattern().assertValid());
+        //(P A P^T)(P x) = P (A x)
+        BVector y = unpermuteVector(BVector(B * permuteVector(x, r)), r);
+        assertMatrixEquality(expected, y);
+    }
+}
@@ -0,0 +1,116 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include <cuMat/Core>
+#include <cuMat/Sparse>
+
+#include "Utils.h"
+#include "SparseTestUtils.h"
+
+using namespace cuMat;
+
+TEST_CASE("Sparse product - random", "[Sparse][SpGEMM]")
+{
+    const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(randomRowLengths(60, 6, 11), 40, 12);
+    const internal::HostCsrMatrix<double> hostB = randomCsrMatrix(randomRowLengths(40, 8, 13), 70, 14);
+    const internal::HostCsrMatrix<double> hostC = internal::HostCsrMatrix<double>::product(hostA, hostB);
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    SMatrix A = hostA.toSparseMatrix();
+    SMatrix B = hostB.toSparseMatrix();
+
+    SECTION("one step")
+    {
+        SMatrix C = sparseProduct(A, B);
+        REQUIRE(C.rows() == 60);
+        REQUIRE(C.cols() == 70);
+        REQUIRE_NOTHROW(C.getSparsityPattern().assertValid());
+        requireEqual(hostC, C);
+    }
+    SECTION("reuse the symbolic phase")
+    {
+        SparseProductSymbolic symbolic = sparseProductSymbolic(A.getSparsityPattern(), B.getSparsityPattern());
+        REQUIRE(symbolic.pattern.nnz == hostC.nnz());
+        SMatrix C(symbolic.pattern);
+        sparseProductNumeric(symbolic, A, B, C);
+        requireEqual(hostC, C);
+        //new values with the same pattern
+        A.getData() = A.getData() * 3.0;
+        B.getData() = B.getData() * -0.5;
+        sparseProductNumeric(symbolic, A, B, C);
+        requireEqual(hostC, C, 0, -1.5);
+    }
+    SECTION("empty product")
+    {
+        internal::HostCsrMatrix<double> hostZero;
+        hostZero.rows = 40;
+        hostZero.cols = 70;
+        hostZero.JA.assign(41, 0);
+        SMatrix C = sparseProduct(A, hostZero.toSparseMatrix());
+        REQUIRE(C.getSparsityPattern().nnz == 0);
+        std::vector<int> JA(61);
+        C.getSparsityPattern().JA.copyToHost(JA.data());
+        REQUIRE(JA == std::vector<int>(61, 0));
+    }
+}
+
+TEST_CASE("Sparse product - batched", "[Sparse][SpGEMM]")
+{
+    const internal::HostCsrMatrix<double> hostA = randomCsrMatrix(randomRowLengths(30, 5, 5), 20, 6);
+    const internal::HostCsrMatrix<double> hostB = randomCsrMatrix(randomRowLengths(20, 5, 7), 25, 8);
+    const internal::HostCsrMatrix<double> hostC = internal::HostCsrMatrix<double>::product(hostA, hostB);
+    typedef SparseMatrix<double, Dynamic, SparseFlags::CSR> SMatrix;
+
+    //batch b of A is scaled by b+1, B has a single batch and is broadcasted
+    const int batches = 3;
+    SMatrix A(hostA.toSparsityPattern(), batches);
+    std::vector<double> values;
+    for (int b = 0; b < batches; ++b)
+        for (double v : hostA.values) values.push_back((b + 1) * v);
+    A.getData().copyFromHost(values.data());
+    SMatrix B(hostB.toSparsityPattern(), 1);
+    B.getData().copyFromHost(hostB.values.data());
+
+    SMatrix C = sparseProduct(A, B);
+    REQUIRE(C.batches() == batches);
+    for (int b = 0; b < batches; ++b)
+        requireEqual(hostC, C, b, b + 1);
+}
+
+TEST_CASE("Sparse product - Galerkin product", "[Sparse][SpGEMM]")
+{
+    //1D Laplace on 2n+1 nodes, linear interpolation from n coarse nodes
+    const int n = 10, fine = 2 * n + 1;
+    internal::HostCsrMatrix<double> hostA;
+    hostA.rows = hostA.cols = fine;
+    for (int i = 0; i < fine; ++i)
+    {
+        if (i > 0) { hostA.IA.push_back(i - 1); hostA.values.push_back(-1); }
+        hostA.IA.push_back(i); hostA.values.push_back(2);
+        if (i < fine - 1) { hostA.IA.push_back(i + 1); hostA.values.push_back(-1); }
+        hostA.JA.push_back(static_cast<int>(hostA.IA.size()));
+    }
+    internal::HostCsrMatrix<double> hostP;
+    hostP.rows = fine;
+    hostP.cols = n;
+    for (int i = 0; i < fine; ++i)
+    {
+        if (i % 2 == 1) { hostP.IA.push_back(i / 2); hostP.values.push_back(1); }
+        else
+        {
+            if (i / 2 - 1 >= 0) { hostP.IA.push_back(i / 2 - 1); hostP.values.push_back(0.5); }
+            if (i / 2 < n) { hostP.IA.push_back(i / 2); hostP.values.push_back(0.5); }
+        }
+        hostP.JA.push_back(static_cast<int>(hostP.IA.size()));
+    }
+    const internal::HostCsrMatrix<double> hostR = hostP.transpose();
+    const internal::HostCsrMatrix<double> expected = internal::HostCsrMatrix<double>::product(
+        internal::HostCsrMatrix<double>::product(hostR, hostA), hostP);
+
+    typedef SparseMatrix<double, 1, SparseFlags::CSR> SMatrix;
+    SMatrix coarse = sparseProduct(sparseProduct(hostR.toSparseMatrix(), hostA.toSparseMatrix()), hostP.toSparseMatrix());
+    REQUIRE(coarse.rows() == n);
+    REQUIRE(coarse.cols() == n);
+    requireEqual(expected, coarse);
+}